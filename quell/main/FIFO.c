@@ -19,11 +19,13 @@ bool FIFO_put(fifo_t *fifo, char datain)
     if (fifo == NULL) //checks the pointers
         return false;
 
-    if (((fifo->tail + 1) % fifo->size) == fifo->head) //checks if the next position isnt the tail, which means that the fifo is full
+    size_t tail = fifo->tail;
+
+    if (((tail + 1) % fifo->size) == __atomic_load_n(&fifo->head, __ATOMIC_ACQUIRE)) //checks if the next position isnt the tail, which means that the fifo is full
         return false;
 
-    fifo->buffer[fifo->tail] = datain; //adds the new word
-    fifo->tail = (fifo->tail + 1) % fifo->size; //updates the head position
+    fifo->buffer[tail] = datain; //adds the new word
+    __atomic_store_n(&fifo->tail, (tail + 1) % fifo->size, __ATOMIC_RELEASE); //updates the tail position, after the word
     return true;
 }
 
@@ -32,12 +34,14 @@ bool FIFO_get(fifo_t *fifo, char *dataout)
     if (fifo == NULL || dataout == NULL) //checks the pointers
         return false;
 
-    if (fifo->tail == fifo->head) //checks if there is any word in the fifos buffer
+    size_t head = fifo->head;
+
+    if (__atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE) == head) //checks if there is any word in the fifos buffer
         return false;
 
-    *dataout = fifo->buffer[fifo->head]; //gets the data
+    *dataout = fifo->buffer[head]; //gets the data
     //fifo->data[fifo->head] = 0; ->clear the space may not be the best idea for debugging
-    fifo->head = (fifo->head + 1) % fifo->size;//updates the head position
+    __atomic_store_n(&fifo->head, (head + 1) % fifo->size, __ATOMIC_RELEASE);//updates the head position, once the data was read
     return true;
 }
 
@@ -47,28 +51,31 @@ bool FIFO_peak(fifo_t *fifo, size_t pos, char *dataout) //To analyse data withou
     if (fifo == NULL || dataout == NULL) //checks the pointers
             return false;
 
-   if (fifo->head == fifo->tail)
+   size_t head = fifo->head;
+   size_t tail = __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE);
+
+   if (head == tail)
     return false;
 
 
-   if(fifo->head > fifo->tail)
+   if(head > tail)
    {
-        if(fifo->head + pos > fifo->size - 1)
+        if(head + pos > fifo->size - 1)
         {
-          pos = (fifo->head + pos) % fifo->size;
+          pos = (head + pos) % fifo->size;
 
-          if(pos > fifo->tail)
+          if(pos >= tail)
             return false;
         }
         else
         {
-          pos = fifo->head + pos;
+          pos = head + pos;
         }
    }
    else
    {
-      pos = fifo->head + pos;
-      if(pos >= fifo->tail)
+      pos = head + pos;
+      if(pos >= tail)
         return false;
    }
 
@@ -76,15 +83,42 @@ bool FIFO_peak(fifo_t *fifo, size_t pos, char *dataout) //To analyse data withou
    return true;
 }
 
+bool FIFO_poke(fifo_t *fifo, size_t pos, char datain) //To write data after the tail without publishing it (pos = 0 is the tail position), see FIFO_commit
+{
+    if (fifo == NULL) //checks the pointer
+        return false;
+
+    pos += fifo->tail;
+    if (pos >= fifo->size)
+        pos -= fifo->size;
+
+    fifo->buffer[pos] = datain;
+    return true;
+}
+
+bool FIFO_commit(fifo_t *fifo, size_t count) //Publishes count bytes written with FIFO_poke at once (the reader never sees half of them)
+{
+    size_t free;
+
+    if (FIFO_free(fifo, &free) == false || count > free) //checks the pointer and the space
+        return false;
+
+    __atomic_store_n(&fifo->tail, (fifo->tail + count) % fifo->size, __ATOMIC_RELEASE); //updates the tail position, after the bytes
+    return true;
+}
+
 bool FIFO_count(fifo_t *fifo, size_t *count) //Returns occupied space
 {
     if (fifo == NULL) //checks the pointer
         return false;
 
-    if (fifo->head <= fifo->tail)
-      *count = fifo->tail - fifo->head;
+    size_t head = __atomic_load_n(&fifo->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE);
+
+    if (head <= tail)
+      *count = tail - head;
     else
-      *count = fifo->size - (fifo->head - fifo->tail);
+      *count = fifo->size - (head - tail);
 
     return true;
 }
@@ -94,10 +128,13 @@ bool FIFO_free(fifo_t *fifo, size_t *free) //Returns free space
     if (fifo == NULL) //checks the pointer
         return false;
 
-    if (fifo->head <= fifo->tail)
-      *free = fifo->size - (fifo->tail - fifo->head) - 1;
+    size_t head = __atomic_load_n(&fifo->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE);
+
+    if (head <= tail)
+      *free = fifo->size - (tail - head) - 1;
     else
-      *free = (fifo->head - fifo->tail) - 1;
+      *free = (head - tail) - 1;
 
     return true;
 }
@@ -107,7 +144,7 @@ bool FIFO_clean(fifo_t *fifo) //Cleans the fifo
     if (fifo == NULL) //checks the pointer
         return false;
 
-    fifo->head = fifo->tail; //clears the occupied data in the buffer
+    __atomic_store_n(&fifo->head, __atomic_load_n(&fifo->tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE); //clears the occupied data in the buffer
 
     return true;
 }
@@ -2,13 +2,20 @@
 #define _FIFO_H_
 
     #include <stdlib.h>
+    #include <stdint.h>
     #include <assert.h>
     #include <stdbool.h>
     #include <stdarg.h>
+
+    /*
+        One writer (put, poke, commit) and one reader (get, peak, clean) each on its own task, possibly on
+        the other core, without a lock: each only moves its own index, stored with release after the
+        buffer, and loads the other with acquire before touching the buffer (count and free take both once).
+    */
     typedef struct
     {
-        size_t head;
-        size_t tail;
+        volatile size_t head; //moved by the reader only
+        volatile size_t tail; //moved by the writer only
         size_t size;
         char *buffer; //the buffer must have fifo_t.size + 1, once the tail is always empty in a circular buffer (same behaviour as '/0' in a string)
     }fifo_t;
@@ -17,6 +24,8 @@
     bool FIFO_get(fifo_t *fifo, char *dataout);
     bool FIFO_put(fifo_t *fifo, char datain);
     bool FIFO_peak(fifo_t *fifo, size_t pos, char *dataout);
+    bool FIFO_poke(fifo_t *fifo, size_t pos, char datain);
+    bool FIFO_commit(fifo_t *fifo, size_t count);
     bool FIFO_count(fifo_t *fifo, size_t *count);
     bool FIFO_free(fifo_t *fifo, size_t *free);
     bool FIFO_clean(fifo_t *fifo);
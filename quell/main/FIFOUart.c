@@ -8,18 +8,52 @@
 #include "esp_log.h"
 #include "FIFO.h"
 #include "quell.h"
+#include "capture.h"
+#include "esp_timer.h"
 
-int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_t *_psFIFORx, const char* _pcTAG)
+#define UART_SEND_BUFFER_SIZE (128UL)
+#define UART_READ_BUFFER_SIZE (32UL)
+
+/* Link capture, every uart in u32CaptureUartMask records what it receives and sends */
+static capture_t *psCapture = NULL;
+static uint32_t u32CaptureUartMask = 0;
+static portMUX_TYPE sCaptureLock = portMUX_INITIALIZER_UNLOCKED;
+
+void uartSetCapture(capture_t *_psCapture, uint32_t _u32UartMask)
+{
+    portENTER_CRITICAL(&sCaptureLock);
+    psCapture = _psCapture;
+    u32CaptureUartMask = (_psCapture != NULL) ? _u32UartMask : 0;
+    portEXIT_CRITICAL(&sCaptureLock);
+}
+
+static void uartCapture(uint32_t _u32UartNumber, bool _bTx, const char *_pcData, uint16_t _u16Length)
+{
+    if((u32CaptureUartMask & (1UL << _u32UartNumber)) == 0)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&sCaptureLock);
+    if(psCapture != NULL)
+    {
+        capture_append(psCapture, (uint32_t)esp_timer_get_time(), _u32UartNumber, _bTx, (const uint8_t*)_pcData, _u16Length);
+    }
+    portEXIT_CRITICAL(&sCaptureLock);
+}
+
+int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_t *_psFIFORx, TickType_t _xTicksToWait, const char* _pcTAG)
 {
     uart_event_t event;
+    int32_t i32Received = 0;
 
     if(_xQueueRx == NULL || _psFIFORx == NULL || _pcTAG == NULL)
     {
         return QUELL_ERROR;
     }
 
-    //Waiting for UART event.
-    if(xQueueReceive(_xQueueRx, (void * )&event, 0)) 
+    //Waiting for UART event (blocking up to _xTicksToWait lets lower priority tasks run).
+    if(xQueueReceive(_xQueueRx, (void * )&event, _xTicksToWait)) 
     {
         //ESP_LOGI(TAG, "uart[%d] event:", EX_UART_NUM);
         switch(event.type) 
@@ -30,16 +64,29 @@ int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_
             be full.*/
             case UART_DATA:
                 //ESP_LOGI(TAG, "[UART DATA]: %d", event.size);
-                while(event.size--)
+                while(event.size > 0)
                 {
-                    char cData;
-                    if(uart_read_bytes(_u32UartNumber, &cData, 1, portMAX_DELAY) == 1)
+                    char acReadBuffer[UART_READ_BUFFER_SIZE];
+                    int iRead = uart_read_bytes(_u32UartNumber, acReadBuffer, (event.size < sizeof(acReadBuffer)) ? event.size : sizeof(acReadBuffer), portMAX_DELAY);
+                    if(iRead <= 0)
+                    {
+                        break;
+                    }
+                    event.size -= iRead;
+
+                    uartCapture(_u32UartNumber, false, acReadBuffer, iRead);
+
+                    for(int iIndex = 0; iIndex < iRead; iIndex++)
                     {
-                        //ESP_LOGI(_pcTAG, "%x", cData);
-                        if(FIFO_put(_psFIFORx, cData) == false)
+                        //ESP_LOGI(_pcTAG, "%x", acReadBuffer[iIndex]);
+                        if(FIFO_put(_psFIFORx, acReadBuffer[iIndex]) == false)
                         {
                             ESP_LOGI(_pcTAG, "Failed to put byte in FIFO Rx %u %u %u", _psFIFORx->head, _psFIFORx->tail, _psFIFORx->size);
                         }
+                        else
+                        {
+                            i32Received++;
+                        }
                     }
                 }
                 break;
@@ -79,12 +126,13 @@ int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_
         }
     }
 
-    return QUELL_OK;
+    /* Bytes placed in FIFO Rx (0 when there was no data event) */
+    return i32Received;
 }
 
 int32_t uartSendBytes(uint32_t _u32UartNumber, fifo_t *_psFIFOTx, const char* _pcTAG)
 {
-    char acSendBuffer[32];
+    char acSendBuffer[UART_SEND_BUFFER_SIZE];
     size_t u16FIFOCount;
     uint16_t u16Index;
 
@@ -95,7 +143,7 @@ int32_t uartSendBytes(uint32_t _u32UartNumber, fifo_t *_psFIFOTx, const char* _p
     }
 
     /* Get the bytes and transfer to the local buffer to send to uart functions all at once */
-    for(u16Index = 0; u16Index < u16FIFOCount || u16Index < sizeof(acSendBuffer); u16Index++)
+    for(u16Index = 0; u16Index < u16FIFOCount && u16Index < sizeof(acSendBuffer); u16Index++)
     {
         if(FIFO_get(_psFIFOTx, (char*)&acSendBuffer[u16Index]) == false)
         {
@@ -104,10 +152,91 @@ int32_t uartSendBytes(uint32_t _u32UartNumber, fifo_t *_psFIFOTx, const char* _p
     }
 
     /* Send data to uart */
+    uartCapture(_u32UartNumber, true, acSendBuffer, u16Index);
     if(uart_write_bytes(_u32UartNumber, (const char*) acSendBuffer, u16Index) != u16Index)
     {
         return QUELL_ERROR;
     }
 
     return QUELL_OK;
-}
\ No newline at end of file
+}
+
+/*
+    TX AGGREGATOR
+
+    Frames are gathered in one contiguous buffer and handed to uart_write_bytes in a single call.
+    While the uart is still shifting out the previous write there is no point in writing again, so
+    frames keep piling up (the more load, the bigger the writes). Once the uart went idle, or the
+    oldest byte waited u32DeadlineMs, or the buffer is full, everything held goes out at once.
+*/
+int32_t uartAggregator_init(uart_tx_aggregator_t *_psAggregator, char *_pcBuffer, uint16_t _u16Size, uint32_t _u32DeadlineMs)
+{
+    if(_psAggregator == NULL || _pcBuffer == NULL || _u16Size == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psAggregator, 0, sizeof(uart_tx_aggregator_t));
+    _psAggregator->pcBuffer = _pcBuffer;
+    _psAggregator->u16Size = _u16Size;
+    _psAggregator->u32DeadlineMs = _u32DeadlineMs;
+
+    return QUELL_OK;
+}
+
+uint16_t uartAggregator_getFree(uart_tx_aggregator_t *_psAggregator, char **_ppcTail)
+{
+    if(_psAggregator == NULL || _ppcTail == NULL)
+    {
+        return 0;
+    }
+
+    *_ppcTail = &_psAggregator->pcBuffer[_psAggregator->u16Count];
+    return _psAggregator->u16Size - _psAggregator->u16Count;
+}
+
+void uartAggregator_commit(uart_tx_aggregator_t *_psAggregator, uint16_t _u16Count, uint16_t _u16Frames, uint32_t _u32NowMs)
+{
+    if(_psAggregator == NULL || _u16Count == 0)
+    {
+        return;
+    }
+
+    if(_psAggregator->u16Count == 0)
+    {
+        _psAggregator->u32FirstByteMs = _u32NowMs;
+    }
+
+    _psAggregator->u16Count += _u16Count;
+    _psAggregator->u16Frames += _u16Frames;
+}
+
+int32_t uartAggregator_flush(uint32_t _u32UartNumber, uart_tx_aggregator_t *_psAggregator, uint32_t _u32NowMs)
+{
+    if(_psAggregator == NULL || _psAggregator->u16Count == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Keep gathering while the uart is busy, the buffer has room and nobody waited too long */
+    if(_psAggregator->u16Count < _psAggregator->u16Size &&
+       _u32NowMs - _psAggregator->u32FirstByteMs < _psAggregator->u32DeadlineMs &&
+       uart_wait_tx_done(_u32UartNumber, 0) != ESP_OK)
+    {
+        return QUELL_ERROR;
+    }
+
+    uartCapture(_u32UartNumber, true, _psAggregator->pcBuffer, _psAggregator->u16Count);
+    if(uart_write_bytes(_u32UartNumber, (const char*) _psAggregator->pcBuffer, _psAggregator->u16Count) != _psAggregator->u16Count)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psAggregator->u32Writes++;
+    _psAggregator->u32Bytes += _psAggregator->u16Count;
+    _psAggregator->u32Frames += _psAggregator->u16Frames;
+    _psAggregator->u16Count = 0;
+    _psAggregator->u16Frames = 0;
+
+    return QUELL_OK;
+}
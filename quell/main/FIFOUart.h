@@ -6,8 +6,29 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "FIFO.h"
+#include "capture.h"
 
-int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_t *_psFIFORx, const char* _pcTAG);
+typedef struct
+{
+    char *pcBuffer;
+    uint16_t u16Size;
+    uint16_t u16Count;
+    uint16_t u16Frames;         //Frames currently held in pcBuffer
+    uint32_t u32FirstByteMs;    //When the oldest byte held was queued
+    uint32_t u32DeadlineMs;     //Longest a byte is held waiting for company
+
+    /* Statistics (frames per write = u32Frames / u32Writes, bytes per write = u32Bytes / u32Writes) */
+    uint32_t u32Writes;
+    uint32_t u32Bytes;
+    uint32_t u32Frames;
+}uart_tx_aggregator_t;
+
+void uartSetCapture(capture_t *_psCapture, uint32_t _u32UartMask);
+int32_t uartAggregator_init(uart_tx_aggregator_t *_psAggregator, char *_pcBuffer, uint16_t _u16Size, uint32_t _u32DeadlineMs);
+uint16_t uartAggregator_getFree(uart_tx_aggregator_t *_psAggregator, char **_ppcTail);
+void uartAggregator_commit(uart_tx_aggregator_t *_psAggregator, uint16_t _u16Count, uint16_t _u16Frames, uint32_t _u32NowMs);
+int32_t uartAggregator_flush(uint32_t _u32UartNumber, uart_tx_aggregator_t *_psAggregator, uint32_t _u32NowMs);
+int32_t uartReceiveBytes(uint32_t _u32UartNumber, QueueHandle_t _xQueueRx, fifo_t *_psFIFORx, TickType_t _xTicksToWait, const char* _pcTAG);
 int32_t uartSendBytes(uint32_t _u32UartNumber, fifo_t *_psFIFOTx, const char* _pcTAG);
 
 #endif /* _FIFOUART_H_ */
\ No newline at end of file
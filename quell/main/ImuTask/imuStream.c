@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal/cpu_hal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "imuStream.h"
+#include "imuTask.h"
+#include "quell.h"
+#include "protocolTask.h"
+#include "congestion.h"
+
+
+/* Test source: a slow rotation around z, gravity on z and a vibration on accel x above the Nyquist of a factor 2 decimation */
+#define IMU_STREAM_TEST_ROTATION_HZ (0.5f)
+#define IMU_STREAM_TEST_ROTATION_DPS (90.0f)
+#define IMU_STREAM_TEST_VIBRATION (0.3f)    //Input sample rates
+#define IMU_STREAM_TEST_VIBRATION_G (0.25f)
+
+
+typedef struct
+{
+    /* Only imuStream_push touches the decimator and the batch */
+    decimator_t *psDecimator;       //NULL sends every sample
+    message_imu_t sMessage;         //Batch being filled
+    decimator_type_t eType;
+    uint8_t u8Up;                   //Output rate u8Up / u8Factor of the input rate
+    uint8_t u8Factor;
+    uint8_t u8Batch;                //Samples per message at the output period, 0 until the first sample
+
+    /* Test source */
+    esp_timer_handle_t tTestTimer;
+    uint32_t u32TestRate;
+    uint32_t u32TestSamples;
+
+    /* Statistics */
+    uint32_t u32Inputs;
+    uint32_t u32Outputs;
+    uint32_t u32Messages;
+    uint32_t u32Dropped;            //Messages the protocol queue had no room for
+    uint32_t u32Measured;           //Inputs since the last configuration
+    uint64_t u64Cycles;             //CPU cycles spent decimating them
+    uint32_t u32MaxCycles;
+}imu_stream_unit_t;
+
+typedef struct
+{
+    decimator_t *psDecimator;
+    decimator_type_t eType;
+    uint8_t u8Up;
+    uint8_t u8Factor;
+    bool bPending;
+}imu_stream_config_t;
+
+typedef struct
+{
+    decimator_type_t eType;
+    uint8_t u8Factor;
+}imu_stream_request_t;
+
+static const char *TAG = "imu stream";
+static const char *apcDecimatorName[DECIMATOR_TYPE_COUNT] = {"off", "fir", "cic"};
+
+static imu_stream_unit_t asStreams[IMU_UNITS];
+
+/* Posted by imuStreamPost (terminal or processing task), taken by the next push of the unit */
+static imu_stream_config_t asPendingConfig[IMU_UNITS];
+static portMUX_TYPE sConfigLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* What the terminal asked for and the rate of the congestion control on top, a configuration is designed from both */
+static imu_stream_request_t asRequested[IMU_UNITS] = {[0 ... IMU_UNITS - 1] = {DECIMATOR_OFF, 1}};
+static uint8_t u8AdaptRate = CONGESTION_RATE_STEPS;    //CONGESTION_RATE_STEPS-ths of the rate configured
+static uint32_t u32RequestGeneration;   //Changes with either
+
+static int32_t imuStreamFlush(uint8_t _u8Unit)
+{
+    imu_stream_unit_t *psStream = &asStreams[_u8Unit];
+    uint8_t au8Buffer[MESSAGE_IMU_MAX_SIZE];
+    uint16_t u16Size;
+
+    if(psStream->sMessage.u16SamplesCount == 0)
+    {
+        return QUELL_OK;
+    }
+
+    psStream->sMessage.u8Unit = _u8Unit;
+    if(messages_encodeImu(&psStream->sMessage, au8Buffer, sizeof(au8Buffer), &u16Size) == QUELL_ERROR ||
+       protocolInjectMessage(au8Buffer, u16Size) == QUELL_ERROR)
+    {
+        psStream->u32Dropped++;
+        psStream->sMessage.u16SamplesCount = 0;
+        return QUELL_ERROR;
+    }
+
+    psStream->u32Messages++;
+    psStream->sMessage.u16SamplesCount = 0;
+
+    return QUELL_OK;
+}
+
+/* _pi16Sample: the input coming, for a filter that has no inputs to take over */
+static void imuStreamApplyConfig(uint8_t _u8Unit, const int16_t *_pi16Sample)
+{
+    imu_stream_unit_t *psStream = &asStreams[_u8Unit];
+    imu_stream_config_t sConfig = {0};
+
+    portENTER_CRITICAL(&sConfigLock);
+    if(asPendingConfig[_u8Unit].bPending == true)
+    {
+        sConfig = asPendingConfig[_u8Unit];
+        asPendingConfig[_u8Unit].bPending = false;
+        asPendingConfig[_u8Unit].psDecimator = NULL;
+    }
+    portEXIT_CRITICAL(&sConfigLock);
+
+    if(sConfig.bPending == false)
+    {
+        return;
+    }
+
+    /* The samples batched so far go out at their own period, the new filter takes over the inputs of the old one */
+    imuStreamFlush(_u8Unit);
+    if(sConfig.psDecimator != NULL)
+    {
+        decimator_prime(sConfig.psDecimator, psStream->psDecimator, _pi16Sample);
+    }
+    free(psStream->psDecimator);
+    psStream->psDecimator = sConfig.psDecimator;
+    psStream->eType = sConfig.eType;
+    psStream->u8Up = sConfig.u8Up;
+    psStream->u8Factor = sConfig.u8Factor;
+    psStream->u8Batch = 0;
+    psStream->sMessage.u16SamplesCount = 0;
+    psStream->u32Measured = 0;
+    psStream->u64Cycles = 0;
+    psStream->u32MaxCycles = 0;
+}
+
+static void imuStreamTestCallback(void *_pvArgument)
+{
+    uint8_t u8Unit = (uint8_t)(uintptr_t)_pvArgument;
+    imu_stream_unit_t *psStream = &asStreams[u8Unit];
+    uint32_t u32Rate = psStream->u32TestRate;
+    uint32_t u32Sample = psStream->u32TestSamples++;
+    float fRotation;
+    float fVibration;
+    int16_t ai16Sample[MESSAGE_IMU_AXES] = {0};
+
+    if(u32Rate == 0)
+    {
+        return;
+    }
+
+    /* Both phases wrap on a whole period, so the float argument stays small */
+    fRotation = 2.0f * (float)M_PI * IMU_STREAM_TEST_ROTATION_HZ * (float)(u32Sample % (uint32_t)(u32Rate / IMU_STREAM_TEST_ROTATION_HZ)) / u32Rate;
+    fVibration = 2.0f * (float)M_PI * IMU_STREAM_TEST_VIBRATION * (float)(u32Sample % 10);
+
+    ai16Sample[0] = (int16_t)lroundf(IMU_STREAM_TEST_VIBRATION_G * MESSAGE_IMU_ACCEL_LSB_PER_G * sinf(fVibration));
+    ai16Sample[2] = MESSAGE_IMU_ACCEL_LSB_PER_G;
+    ai16Sample[5] = (int16_t)lroundf(IMU_STREAM_TEST_ROTATION_DPS * (MESSAGE_IMU_GYRO_LSB_PER_KDPS / 1000.0f) * sinf(fRotation));
+
+    imuStream_push(u8Unit, (uint32_t)esp_timer_get_time(), (uint16_t)(1000000UL / u32Rate), ai16Sample);
+}
+
+
+
+static uint32_t imuStreamCommon(uint32_t _u32A, uint32_t _u32B)
+{
+    while(_u32B != 0)
+    {
+        uint32_t u32Rest = _u32A % _u32B;
+
+        _u32A = _u32B;
+        _u32B = u32Rest;
+    }
+
+    return _u32A;
+}
+
+/* Designs the configuration of a unit from what was asked, posted only if nothing changed meanwhile (the terminal and the processing task both ask) */
+static int32_t imuStreamPost(uint8_t _u8Unit)
+{
+    imu_stream_request_t sRequest;
+    decimator_t *psDecimator;
+    decimator_t *psReplaced;
+    uint32_t u32Generation;
+    uint32_t u32Up;
+    uint32_t u32Factor;
+    uint32_t u32Common;
+    bool bPosted = false;
+
+    while(bPosted == false)
+    {
+        portENTER_CRITICAL(&sConfigLock);
+        sRequest = asRequested[_u8Unit];
+        u32Up = u8AdaptRate;
+        u32Factor = (uint32_t)sRequest.u8Factor * CONGESTION_RATE_STEPS;
+        u32Generation = u32RequestGeneration;
+        portEXIT_CRITICAL(&sConfigLock);
+
+        /* The rate asked over the congestion rate, as a fraction the FIR resamples to. Past its factors (a decimation
+           configured on top) or with a CIC, the integer factor just below the rate */
+        u32Common = imuStreamCommon(u32Factor, u32Up);
+        u32Up /= u32Common;
+        u32Factor /= u32Common;
+        if(u32Up > 1 && (u32Factor > DECIMATOR_MAX_FACTOR || sRequest.eType == DECIMATOR_CIC))
+        {
+            u32Factor = (u32Factor + u32Up - 1) / u32Up;
+            u32Up = 1;
+        }
+
+        /* A slower stream still needs its anti-alias filter */
+        sRequest.u8Factor = (u32Factor > DECIMATOR_MAX_FACTOR) ? DECIMATOR_MAX_FACTOR : (uint8_t)u32Factor;
+        sRequest.eType = (sRequest.u8Factor == 1) ? DECIMATOR_OFF : ((sRequest.eType == DECIMATOR_OFF) ? DECIMATOR_FIR : sRequest.eType);
+
+        /* Designed here, so the sample path only swaps a pointer */
+        psDecimator = NULL;
+        if(sRequest.eType != DECIMATOR_OFF)
+        {
+            psDecimator = malloc(sizeof(decimator_t));
+            if(psDecimator == NULL || decimator_initRational(psDecimator, sRequest.eType, (uint8_t)u32Up, sRequest.u8Factor, MESSAGE_IMU_AXES) == QUELL_ERROR)
+            {
+                free(psDecimator);
+                return QUELL_ERROR;
+            }
+        }
+
+        psReplaced = psDecimator;
+        portENTER_CRITICAL(&sConfigLock);
+        if(u32Generation == u32RequestGeneration)
+        {
+            psReplaced = asPendingConfig[_u8Unit].psDecimator;
+            asPendingConfig[_u8Unit].psDecimator = psDecimator;
+            asPendingConfig[_u8Unit].eType = sRequest.eType;
+            asPendingConfig[_u8Unit].u8Up = (uint8_t)u32Up;
+            asPendingConfig[_u8Unit].u8Factor = sRequest.u8Factor;
+            asPendingConfig[_u8Unit].bPending = true;
+            bPosted = true;
+        }
+        portEXIT_CRITICAL(&sConfigLock);
+
+        //A configuration no push has taken yet, or ours when it came too late
+        free(psReplaced);
+    }
+
+    return QUELL_OK;
+}
+
+
+
+int32_t imuStream_configure(uint8_t _u8Unit, decimator_type_t _eType, uint8_t _u8Factor)
+{
+    if(_u8Unit >= IMU_UNITS || _eType >= DECIMATOR_TYPE_COUNT || (_eType != DECIMATOR_OFF && (_u8Factor == 0 || _u8Factor > DECIMATOR_MAX_FACTOR)))
+    {
+        return QUELL_ERROR;
+    }
+
+    portENTER_CRITICAL(&sConfigLock);
+    asRequested[_u8Unit].eType = (_u8Factor == 1) ? DECIMATOR_OFF : _eType;
+    asRequested[_u8Unit].u8Factor = (_eType == DECIMATOR_OFF) ? 1 : _u8Factor;
+    u32RequestGeneration++;
+    portEXIT_CRITICAL(&sConfigLock);
+
+    return imuStreamPost(_u8Unit);
+}
+
+/* Congestion control (congestion.h): every unit sends at _u8Rate / CONGESTION_RATE_STEPS of the rate configured, through the filter configured or a FIR */
+int32_t imuStream_adapt(uint8_t _u8Rate)
+{
+    int32_t i32Result = QUELL_OK;
+
+    if(_u8Rate == 0 || _u8Rate > CONGESTION_RATE_STEPS)
+    {
+        return QUELL_ERROR;
+    }
+
+    portENTER_CRITICAL(&sConfigLock);
+    u8AdaptRate = _u8Rate;
+    u32RequestGeneration++;
+    portEXIT_CRITICAL(&sConfigLock);
+
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+    {
+        i32Result = (imuStreamPost(u8Unit) == QUELL_ERROR) ? QUELL_ERROR : i32Result;
+    }
+
+    return i32Result;
+}
+
+/* One raw sample of a unit (MESSAGE_IMU_AXES values), _u16Period is the input sample period in microseconds */
+int32_t imuStream_push(uint8_t _u8Unit, uint32_t _u32Timestamp, uint16_t _u16Period, const int16_t *_pi16Sample)
+{
+    imu_stream_unit_t *psStream;
+    message_imu_t *psMessage;
+    int16_t ai16Output[MESSAGE_IMU_AXES];
+    uint32_t u32Period;
+    uint32_t u32Start;
+    uint32_t u32Cycles;
+    uint8_t u8Up;
+    bool bOutput;
+
+    if(_u8Unit >= IMU_UNITS || _pi16Sample == NULL || _u16Period == 0)
+    {
+        return QUELL_ERROR;
+    }
+    psStream = &asStreams[_u8Unit];
+    psMessage = &psStream->sMessage;
+
+    imuStreamApplyConfig(_u8Unit, _pi16Sample);
+
+    /* The output period, to the microsecond when resampling by a fraction */
+    u8Up = (psStream->u8Up == 0) ? 1 : psStream->u8Up;
+    u32Period = (((uint32_t)_u16Period * ((psStream->u8Factor == 0) ? 1 : psStream->u8Factor)) + (u8Up / 2)) / u8Up;
+    if(u32Period > UINT16_MAX)
+    {
+        return QUELL_ERROR;
+    }
+
+    psStream->u32Inputs++;
+    u32Start = cpu_hal_get_cycle_count();
+    if(psStream->psDecimator != NULL)
+    {
+        bOutput = decimator_process(psStream->psDecimator, _pi16Sample, ai16Output);
+    }
+    else
+    {
+        memcpy(ai16Output, _pi16Sample, sizeof(ai16Output));
+        bOutput = true;
+    }
+    u32Cycles = cpu_hal_get_cycle_count() - u32Start;
+    psStream->u32Measured++;
+    psStream->u64Cycles += u32Cycles;
+    psStream->u32MaxCycles = (u32Cycles > psStream->u32MaxCycles) ? u32Cycles : psStream->u32MaxCycles;
+
+    if(bOutput == false)
+    {
+        return QUELL_OK;
+    }
+    psStream->u32Outputs++;
+
+    /* A batch holds one period only, the receiver derives every timestamp from it */
+    if(psMessage->u16SamplesCount > 0 && psMessage->u16Period != u32Period)
+    {
+        imuStreamFlush(_u8Unit);
+    }
+    if(psMessage->u16SamplesCount == 0)
+    {
+        /* Resampling, the output falls between this input and the next */
+        psMessage->u32Timestamp = _u32Timestamp + ((u8Up > 1) ? (((uint32_t)psStream->psDecimator->u8Offset * _u16Period) / u8Up) : 0);
+        psMessage->u16Period = (uint16_t)u32Period;
+        psStream->u8Batch = congestion_getBatch(u32Period);
+    }
+
+    memcpy(&psMessage->ai16Samples[psMessage->u16SamplesCount], ai16Output, sizeof(ai16Output));
+    psMessage->u16SamplesCount += MESSAGE_IMU_AXES;
+
+    if(psMessage->u16SamplesCount >= ((uint16_t)psStream->u8Batch * MESSAGE_IMU_AXES))
+    {
+        return imuStreamFlush(_u8Unit);
+    }
+
+    return QUELL_OK;
+}
+
+/* Feeds the stream of a unit with a synthetic sample at _u32RateHz, 0 stops it */
+int32_t imuStream_testSource(uint8_t _u8Unit, uint32_t _u32RateHz)
+{
+    imu_stream_unit_t *psStream;
+    esp_timer_create_args_t sTimerArgs = {0};
+
+    if(_u8Unit >= IMU_UNITS || _u32RateHz > IMU_STREAM_TEST_MAX_RATE)
+    {
+        return QUELL_ERROR;
+    }
+    psStream = &asStreams[_u8Unit];
+
+    if(psStream->tTestTimer == NULL)
+    {
+        sTimerArgs.callback = imuStreamTestCallback;
+        sTimerArgs.arg = (void *)(uintptr_t)_u8Unit;
+        sTimerArgs.name = "imu test";
+        if(esp_timer_create(&sTimerArgs, &psStream->tTestTimer) != ESP_OK)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    esp_timer_stop(psStream->tTestTimer);
+    psStream->u32TestRate = _u32RateHz;
+    psStream->u32TestSamples = 0;
+
+    if(_u32RateHz > 0 && esp_timer_start_periodic(psStream->tTestTimer, 1000000ULL / _u32RateHz) != ESP_OK)
+    {
+        return QUELL_ERROR;
+    }
+
+    return QUELL_OK;
+}
+
+void imuStream_printStats(void)
+{
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+    {
+        imu_stream_unit_t *psStream = &asStreams[u8Unit];
+
+        ESP_LOGI(TAG, "unit %u decimation:%s %u/%u batch:%u test:%uHz inputs:%u outputs:%u messages:%u dropped:%u cycles/input:%u max:%u",
+                 u8Unit, apcDecimatorName[psStream->eType], (psStream->u8Up == 0) ? 1 : psStream->u8Up, (psStream->u8Factor == 0) ? 1 : psStream->u8Factor,
+                 psStream->u8Batch, psStream->u32TestRate,
+                 psStream->u32Inputs, psStream->u32Outputs, psStream->u32Messages, psStream->u32Dropped,
+                 (psStream->u32Measured > 0) ? (uint32_t)(psStream->u64Cycles / psStream->u32Measured) : 0, psStream->u32MaxCycles);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef _IMU_STREAM_H_
+#define _IMU_STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+#include "decimator.h"
+
+/*
+    IMU STREAM (sending side)
+
+    Raw samples of a unit (from its IMU driver, or the test source) go through the decimator of that unit
+    and its output is batched into imu messages, which the protocol task frames onto the bulk lane
+    (protocolInjectMessage, sendMessage): up to 4 samples, as many as come in CONGESTION_MAX_FILL_US
+    (congestion_getBatch). A unit without decimation sends every sample. The message timestamp is the
+    input sample that completed the first output sample, so it lags the signal by the filter delay
+    (decimator.h).
+
+    The congestion control of the link (congestion.h) cuts the rate further (imuStream_adapt), to a
+    CONGESTION_RATE_STEPS-th of the rate configured: a unit without a filter gets a FIR, which resamples
+    to the fraction (decimator_initRational). A fraction past the FIR (on top of a decimation configured)
+    or with a CIC becomes the integer factor just below the rate, up to DECIMATOR_MAX_FACTOR. Resampling,
+    the message timestamp is where the first output falls between two inputs and the period is rounded
+    to the microsecond. On a change the batch filled so far goes out at its own period and the new
+    filter takes over the inputs of the old one (decimator_prime), so nothing is dropped and the stream
+    does not ramp up from zero again.
+*/
+
+#define IMU_STREAM_TEST_MAX_RATE (4000UL)   //Hz
+
+int32_t imuStream_configure(uint8_t _u8Unit, decimator_type_t _eType, uint8_t _u8Factor);
+int32_t imuStream_adapt(uint8_t _u8Rate);
+int32_t imuStream_push(uint8_t _u8Unit, uint32_t _u32Timestamp, uint16_t _u16Period, const int16_t *_pi16Sample);
+int32_t imuStream_testSource(uint8_t _u8Unit, uint32_t _u32RateHz);
+void imuStream_printStats(void);
+
+#endif /* _IMU_STREAM_H_ */
@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal/cpu_hal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "imuTask.h"
+#include "quell.h"
+#include "taskConfig.h"
+#include "protocolTask.h"
+#include "logTask.h"
+#include "snapshot.h"
+
+
+#define IMU_GYRO_LSB_PER_DPS ((float)MESSAGE_IMU_GYRO_LSB_PER_KDPS / 1000.0f)
+#define IMU_ACCEL_LSB_PER_G ((float)MESSAGE_IMU_ACCEL_LSB_PER_G)
+#define IMU_LOG_SAMPLES (MESSAGE_LOG_WINDOW_SAMPLES_MAX_COUNT / MESSAGE_IMU_AXES)  //Per log window record
+#define IMU_LOG_Q14 (16384.0f)
+
+
+typedef struct
+{
+    orientation_filter_t eFilter;
+    bool bFixed;
+    float fGain;                    //0 for the default gain of the filter
+    uint8_t u8Window;               //Reorder buffer: samples per window
+    uint32_t u32WatermarkUs;
+    reorder_fill_t eFill;
+}imu_config_t;
+
+typedef struct
+{
+    imu_sample_t asHistory[IMU_HISTORY_LENGTH];
+    uint32_t u32Samples;            //Samples since the start, the newest is at (u32Samples - 1) % IMU_HISTORY_LENGTH
+    snapshot_t sSnapshot;           //asHistory and the features for the readers, published after every window
+    imu_snapshot_t asSnapshots[2];
+    uint16_t u16Period;             //Microseconds, the filter restarts when it changes
+    orientation_float_t sFloat;
+    orientation_fixed_t sFixed;
+    reorder_t sReorder;
+
+    /* Statistics */
+    uint32_t u32Messages;
+    uint32_t u32Errors;             //Bad unit, period or sample count
+    uint32_t u32Updates;            //Filter updates since the last configuration
+    uint64_t u64Cycles;             //CPU cycles spent in them
+    uint32_t u32MaxCycles;
+    uint32_t u32Retries;            //Snapshot reads that raced a publish
+}imu_unit_t;
+
+static const char *TAG = "imu";
+static const char *apcFilterName[ORIENTATION_FILTER_COUNT] = {"madgwick", "complementary"};
+static const char *apcFillName[REORDER_FILL_COUNT] = {"flag", "hold", "interpolate"};
+
+static imu_unit_t asUnits[IMU_UNITS];
+static sample_bus_subscriber_t sImuBus;
+static imu_config_t sConfig = {ORIENTATION_MADGWICK, true, 0.0f, IMU_WINDOW_LENGTH, IMU_WATERMARK_US, IMU_FILL};
+
+/* Written by the terminal, taken by the imu task between messages */
+static imu_config_t sPendingConfig;
+static bool bConfigPending = false;
+static portMUX_TYPE sConfigLock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t imuNowUs(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static float imuGain(void)
+{
+    if(sConfig.fGain == 0.0f)
+    {
+        return (sConfig.eFilter == ORIENTATION_MADGWICK) ? ORIENTATION_MADGWICK_BETA : ORIENTATION_COMPLEMENTARY_KP;
+    }
+    return sConfig.fGain;
+}
+
+static int32_t imuRestartFilter(imu_unit_t *_psUnit, uint16_t _u16Period)
+{
+    float fGain = imuGain();
+
+    _psUnit->u16Period = 0;
+    if(orientation_initFloat(&_psUnit->sFloat, sConfig.eFilter, fGain, IMU_GYRO_LSB_PER_DPS, _u16Period) == QUELL_ERROR ||
+       orientation_initFixed(&_psUnit->sFixed, sConfig.eFilter, fGain, IMU_GYRO_LSB_PER_DPS, _u16Period) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+    _psUnit->u16Period = _u16Period;
+
+    return QUELL_OK;
+}
+
+static void imuInitWindows(void)
+{
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+    {
+        reorder_init(&asUnits[u8Unit].sReorder, sConfig.u8Window, sConfig.u32WatermarkUs, sConfig.eFill, imuNowUs);
+    }
+}
+
+static void imuApplyConfig(void)
+{
+    imu_config_t sOld = sConfig;
+    bool bApply = false;
+
+    portENTER_CRITICAL(&sConfigLock);
+    if(bConfigPending == true)
+    {
+        sConfig = sPendingConfig;
+        bConfigPending = false;
+        bApply = true;
+    }
+    portEXIT_CRITICAL(&sConfigLock);
+
+    if(bApply == false)
+    {
+        return;
+    }
+
+    /* New windows start empty, what was pending is lost */
+    if(sConfig.u8Window != sOld.u8Window || sConfig.u32WatermarkUs != sOld.u32WatermarkUs || sConfig.eFill != sOld.eFill)
+    {
+        imuInitWindows();
+    }
+
+    /* Every unit starts over from level with the new filter at its next window */
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS && (sConfig.eFilter != sOld.eFilter || sConfig.bFixed != sOld.bFixed || sConfig.fGain != sOld.fGain); u8Unit++)
+    {
+        asUnits[u8Unit].u16Period = 0;
+        asUnits[u8Unit].u32Updates = 0;
+        asUnits[u8Unit].u64Cycles = 0;
+        asUnits[u8Unit].u32MaxCycles = 0;
+    }
+}
+
+_Static_assert(MESSAGE_IMU_AXES == REORDER_CHANNELS, "an imu sample is one reorder sample");
+
+static void imuProcessMessage(const message_imu_t *_psMessage)
+{
+    imu_unit_t *psUnit;
+
+    if(_psMessage->u8Unit >= IMU_UNITS)
+    {
+        return;
+    }
+    psUnit = &asUnits[_psMessage->u8Unit];
+    psUnit->u32Messages++;
+
+    if((_psMessage->u16SamplesCount % MESSAGE_IMU_AXES) != 0 ||
+       reorder_push(&psUnit->sReorder, _psMessage->u32Timestamp, _psMessage->u16Period, _psMessage->ai16Samples,
+                    _psMessage->u16SamplesCount / MESSAGE_IMU_AXES) == QUELL_ERROR)
+    {
+        psUnit->u32Errors++;
+    }
+}
+
+/* The window into the flash log (a window longer than a record takes several), then the orientation after it */
+static void imuLogWindow(uint8_t _u8Unit, const reorder_window_t *_psWindow, const float *_pfQuaternion)
+{
+    static message_log_window_t sRecord;
+    message_log_result_t sResult;
+    uint8_t au8Message[MESSAGE_LOG_WINDOW_MAX_SIZE];
+    uint16_t u16Size;
+
+    for(uint8_t u8First = 0; u8First < _psWindow->u8Length; u8First += IMU_LOG_SAMPLES)
+    {
+        uint8_t u8Count = (_psWindow->u8Length - u8First > IMU_LOG_SAMPLES) ? IMU_LOG_SAMPLES : _psWindow->u8Length - u8First;
+
+        sRecord.u8Unit = _u8Unit;
+        sRecord.u32Timestamp = _psWindow->u32Timestamp + ((uint32_t)u8First * _psWindow->u16Period);
+        sRecord.u16Period = _psWindow->u16Period;
+        sRecord.u16Filled = (uint16_t)((_psWindow->u32GapMask >> u8First) & ((1UL << u8Count) - 1));
+        sRecord.u16SamplesCount = u8Count * MESSAGE_IMU_AXES;
+        memcpy(sRecord.ai16Samples, &_psWindow->aai16Samples[u8First][0], sRecord.u16SamplesCount * sizeof(int16_t));
+        if(messages_encodeLogWindow(&sRecord, au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+        {
+            logAppend(au8Message, u16Size);
+        }
+    }
+
+    sResult.u8Unit = _u8Unit;
+    sResult.u8Kind = MESSAGE_LOG_RESULT_KIND_ORIENTATION;
+    sResult.u32Timestamp = _psWindow->u32Timestamp + ((uint32_t)(_psWindow->u8Length - 1) * _psWindow->u16Period);
+    for(uint8_t u8Index = 0; u8Index < 4; u8Index++)
+    {
+        sResult.ai16Values[u8Index] = (int16_t)((_pfQuaternion[u8Index] * IMU_LOG_Q14) + ((_pfQuaternion[u8Index] >= 0.0f) ? 0.5f : -0.5f));
+    }
+    sResult.u16ValuesCount = 4;
+    if(messages_encodeLogResult(&sResult, au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+    {
+        logAppend(au8Message, u16Size);
+    }
+}
+
+/* The history newest first and the features of the window, into the buffer the readers are not in */
+static void imuPublish(imu_unit_t *_psUnit, const reorder_window_t *_psWindow)
+{
+    imu_snapshot_t *psSnapshot = (imu_snapshot_t*)snapshot_claim(&_psUnit->sSnapshot);
+    float fAccelSum = 0.0f;
+    float fAccelSquares = 0.0f;
+    float fGyroSum = 0.0f;
+
+    psSnapshot->u32Samples = _psUnit->u32Samples;
+    psSnapshot->u8Length = (_psUnit->u32Samples < IMU_HISTORY_LENGTH) ? (uint8_t)_psUnit->u32Samples : IMU_HISTORY_LENGTH;
+    for(uint8_t u8Index = 0; u8Index < psSnapshot->u8Length; u8Index++)
+    {
+        psSnapshot->asHistory[u8Index] = _psUnit->asHistory[(_psUnit->u32Samples - 1 - u8Index) % IMU_HISTORY_LENGTH];
+    }
+
+    psSnapshot->sFeatures.u8Filled = 0;
+    for(uint8_t u8Index = 0; u8Index < _psWindow->u8Length; u8Index++)
+    {
+        const int16_t *pi16Sample = _psWindow->aai16Samples[u8Index];
+        float fAccel = sqrtf(((float)pi16Sample[0] * pi16Sample[0]) + ((float)pi16Sample[1] * pi16Sample[1]) + ((float)pi16Sample[2] * pi16Sample[2])) / IMU_ACCEL_LSB_PER_G;
+
+        fAccelSum += fAccel;
+        fAccelSquares += fAccel * fAccel;
+        fGyroSum += sqrtf(((float)pi16Sample[3] * pi16Sample[3]) + ((float)pi16Sample[4] * pi16Sample[4]) + ((float)pi16Sample[5] * pi16Sample[5])) / IMU_GYRO_LSB_PER_DPS;
+        psSnapshot->sFeatures.u8Filled += ((_psWindow->u32GapMask & (1UL << u8Index)) != 0) ? 1 : 0;
+    }
+    psSnapshot->sFeatures.fAccelMean = fAccelSum / _psWindow->u8Length;
+    psSnapshot->sFeatures.fAccelVariance = fmaxf((fAccelSquares / _psWindow->u8Length) - (psSnapshot->sFeatures.fAccelMean * psSnapshot->sFeatures.fAccelMean), 0.0f);
+    psSnapshot->sFeatures.fGyroMean = fGyroSum / _psWindow->u8Length;
+
+    snapshot_publish(&_psUnit->sSnapshot);
+}
+
+/* A window of a unit out of its reorder buffer, in order */
+static void imuProcessWindow(uint8_t _u8Unit, imu_unit_t *_psUnit, const reorder_window_t *_psWindow)
+{
+    imu_sample_t sSample;
+
+    if(_psWindow->u16Period != _psUnit->u16Period && imuRestartFilter(_psUnit, _psWindow->u16Period) == QUELL_ERROR)
+    {
+        _psUnit->u32Errors++;
+        return;
+    }
+
+    for(uint8_t u8Index = 0; u8Index < _psWindow->u8Length; u8Index++)
+    {
+        const int16_t *pi16Accel = &_psWindow->aai16Samples[u8Index][0];
+        const int16_t *pi16Gyro = &_psWindow->aai16Samples[u8Index][3];
+        uint32_t u32Start = cpu_hal_get_cycle_count();
+        uint32_t u32Cycles;
+
+        if(sConfig.bFixed == true)
+        {
+            orientation_updateFixed(&_psUnit->sFixed, pi16Accel, pi16Gyro);
+            orientation_getFixed(&_psUnit->sFixed, sSample.afQuaternion);
+        }
+        else
+        {
+            orientation_updateFloat(&_psUnit->sFloat, pi16Accel, pi16Gyro);
+            memcpy(sSample.afQuaternion, _psUnit->sFloat.afQuaternion, sizeof(sSample.afQuaternion));
+        }
+
+        u32Cycles = cpu_hal_get_cycle_count() - u32Start;
+        _psUnit->u32Updates++;
+        _psUnit->u64Cycles += u32Cycles;
+        _psUnit->u32MaxCycles = (u32Cycles > _psUnit->u32MaxCycles) ? u32Cycles : _psUnit->u32MaxCycles;
+
+        sSample.u32Timestamp = _psWindow->u32Timestamp + ((uint32_t)u8Index * _psWindow->u16Period);
+        sSample.bFilled = ((_psWindow->u32GapMask & (1UL << u8Index)) != 0);
+        memcpy(sSample.ai16Accel, pi16Accel, sizeof(sSample.ai16Accel));
+        memcpy(sSample.ai16Gyro, pi16Gyro, sizeof(sSample.ai16Gyro));
+
+        _psUnit->asHistory[_psUnit->u32Samples % IMU_HISTORY_LENGTH] = sSample;
+        _psUnit->u32Samples++;
+    }
+
+    imuPublish(_psUnit, _psWindow);
+    imuLogWindow(_u8Unit, _psWindow, sSample.afQuaternion);
+}
+
+static void imu_task(void *pvParameters)
+{
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    message_imu_t sMessage;
+    reorder_window_t sWindow;
+
+    for(;;)
+    {
+        /* Lower priority than the protocol task, it only runs when that one sleeps */
+        ulTaskNotifyTake(pdTRUE, TASK_POLL_TICKS);
+
+        imuApplyConfig();
+
+        while(sampleBus_peek(&sImuBus, &pu8Message, &u16Size) == QUELL_OK)
+        {
+            /* Decoded out of the slot, only used if release says it was not overwritten meanwhile */
+            int32_t i32Decoded = messages_decodeImu(&sMessage, pu8Message, u16Size);
+
+            if(sampleBus_release(&sImuBus) == QUELL_OK && i32Decoded == QUELL_OK)
+            {
+                imuProcessMessage(&sMessage);
+            }
+        }
+
+        /* Also when nothing came, a watermark may have passed */
+        for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+        {
+            while(reorder_pop(&asUnits[u8Unit].sReorder, &sWindow) == QUELL_OK)
+            {
+                imuProcessWindow(u8Unit, &asUnits[u8Unit], &sWindow);
+            }
+        }
+
+        logTick();
+    }
+    vTaskDelete(NULL);
+}
+
+
+
+int32_t imuConfigure(orientation_filter_t _eFilter, bool _bFixed, float _fGain)
+{
+    if(_eFilter >= ORIENTATION_FILTER_COUNT || _fGain < 0.0f)
+    {
+        return QUELL_ERROR;
+    }
+
+    portENTER_CRITICAL(&sConfigLock);
+    sPendingConfig = (bConfigPending == true) ? sPendingConfig : sConfig;
+    sPendingConfig.eFilter = _eFilter;
+    sPendingConfig.bFixed = _bFixed;
+    sPendingConfig.fGain = _fGain;
+    bConfigPending = true;
+    portEXIT_CRITICAL(&sConfigLock);
+
+    return QUELL_OK;
+}
+
+int32_t imuConfigureWindow(uint8_t _u8Length, uint32_t _u32WatermarkUs, reorder_fill_t _eFill)
+{
+    if(_u8Length == 0 || _u8Length > REORDER_MAX_WINDOW || _u32WatermarkUs > INT32_MAX || _eFill >= REORDER_FILL_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    portENTER_CRITICAL(&sConfigLock);
+    sPendingConfig = (bConfigPending == true) ? sPendingConfig : sConfig;
+    sPendingConfig.u8Window = _u8Length;
+    sPendingConfig.u32WatermarkUs = _u32WatermarkUs;
+    sPendingConfig.eFill = _eFill;
+    bConfigPending = true;
+    portEXIT_CRITICAL(&sConfigLock);
+
+    return QUELL_OK;
+}
+
+/* Only the newest sample is copied out of the snapshot */
+int32_t imuGetLatest(uint8_t _u8Unit, imu_sample_t *_psSample)
+{
+    uint32_t au32Head[(IMU_SNAPSHOT_SIZE(1) + 3) / 4];
+    uint32_t u32Retries = 0;
+    int32_t i32Result;
+
+    if(_u8Unit >= IMU_UNITS || _psSample == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    i32Result = snapshot_read(&asUnits[_u8Unit].sSnapshot, au32Head, IMU_SNAPSHOT_SIZE(1), &u32Retries);
+    __atomic_fetch_add(&asUnits[_u8Unit].u32Retries, u32Retries, __ATOMIC_RELAXED);
+    if(i32Result == QUELL_OK)
+    {
+        memcpy(_psSample, &((uint8_t*)au32Head)[offsetof(imu_snapshot_t, asHistory)], sizeof(imu_sample_t));
+    }
+
+    return i32Result;
+}
+
+/* The features and the newest _u8Samples samples (up to IMU_HISTORY_LENGTH), asHistory past them is left as it was */
+int32_t imuGetSnapshot(uint8_t _u8Unit, imu_snapshot_t *_psSnapshot, uint8_t _u8Samples)
+{
+    uint32_t u32Retries = 0;
+    int32_t i32Result;
+
+    if(_u8Unit >= IMU_UNITS || _psSnapshot == NULL || _u8Samples > IMU_HISTORY_LENGTH)
+    {
+        return QUELL_ERROR;
+    }
+
+    i32Result = snapshot_read(&asUnits[_u8Unit].sSnapshot, _psSnapshot, IMU_SNAPSHOT_SIZE(_u8Samples), &u32Retries);
+    __atomic_fetch_add(&asUnits[_u8Unit].u32Retries, u32Retries, __ATOMIC_RELAXED);
+    if(i32Result == QUELL_OK && _psSnapshot->u8Length > _u8Samples)
+    {
+        _psSnapshot->u8Length = _u8Samples;
+    }
+
+    return i32Result;
+}
+
+void imuPrintStats(void)
+{
+    static imu_snapshot_t sSnapshot;    //Too big for the terminal stack
+
+    ESP_LOGI(TAG, "filter %s %s gain:%.3f bus received:%u dropped:%u", apcFilterName[sConfig.eFilter], (sConfig.bFixed == true) ? "fixed" : "float",
+             imuGain(), sImuBus.u32Received, sImuBus.u32Dropped);
+    ESP_LOGI(TAG, "window %u samples watermark:%uus fill:%s", sConfig.u8Window, sConfig.u32WatermarkUs, apcFillName[sConfig.eFill]);
+
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+    {
+        imu_unit_t *psUnit = &asUnits[u8Unit];
+
+        if(imuGetSnapshot(u8Unit, &sSnapshot, 1) == QUELL_ERROR)
+        {
+            ESP_LOGI(TAG, "unit %u no samples (messages:%u errors:%u)", u8Unit, psUnit->u32Messages, psUnit->u32Errors);
+            continue;
+        }
+        ESP_LOGI(TAG, "unit %u samples:%u messages:%u errors:%u period:%uus q:%.4f %.4f %.4f %.4f cycles/update:%u max:%u",
+                 u8Unit, sSnapshot.u32Samples, psUnit->u32Messages, psUnit->u32Errors, psUnit->u16Period,
+                 sSnapshot.asHistory[0].afQuaternion[0], sSnapshot.asHistory[0].afQuaternion[1], sSnapshot.asHistory[0].afQuaternion[2],
+                 sSnapshot.asHistory[0].afQuaternion[3], (psUnit->u32Updates > 0) ? (uint32_t)(psUnit->u64Cycles / psUnit->u32Updates) : 0,
+                 psUnit->u32MaxCycles);
+        ESP_LOGI(TAG, "unit %u window accel:%.3fg variance:%.4f gyro:%.1fdps filled:%u snapshots:%u read retries:%u",
+                 u8Unit, sSnapshot.sFeatures.fAccelMean, sSnapshot.sFeatures.fAccelVariance, sSnapshot.sFeatures.fGyroMean,
+                 sSnapshot.sFeatures.u8Filled, psUnit->sSnapshot.u32Published, psUnit->u32Retries);
+        ESP_LOGI(TAG, "unit %u windows:%u gaps:%u reordered:%u late:%u duplicates:%u dropped:%u restarts:%u wait avg:%uus max:%uus",
+                 u8Unit, psUnit->sReorder.u32Windows, psUnit->sReorder.u32Gaps, psUnit->sReorder.u32Reordered, psUnit->sReorder.u32Late,
+                 psUnit->sReorder.u32Duplicates, psUnit->sReorder.u32Dropped, psUnit->sReorder.u32Restarts,
+                 (psUnit->sReorder.u32Windows > 0) ? (uint32_t)(psUnit->sReorder.u64WaitUs / psUnit->sReorder.u32Windows) : 0,
+                 psUnit->sReorder.u32MaxWaitUs);
+    }
+}
+
+void imuTaskInit(void)
+{
+    //Set IMU log level
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    imuInitWindows();
+    for(uint8_t u8Unit = 0; u8Unit < IMU_UNITS; u8Unit++)
+    {
+        snapshot_init(&asUnits[u8Unit].sSnapshot, asUnits[u8Unit].asSnapshots, sizeof(imu_snapshot_t));
+    }
+
+    //Subscribe before the task starts, so it sees every message from now on (the protocol task must be up)
+    if(protocolSubscribe(&sImuBus) == QUELL_ERROR)
+    {
+        ESP_LOGI(TAG, "Error subscribing to the sample bus");
+        return;
+    }
+
+    xTaskCreatePinnedToCore(imu_task, "imu_task", IMU_TASK_STACK_SIZE, NULL, IMU_TASK_PRIORITY, NULL, IMU_TASK_CORE);
+}
@@ -0,0 +1,77 @@
+#ifndef _IMU_TASK_H_
+#define _IMU_TASK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "messages.h"
+#include "orientation.h"
+#include "reorder.h"
+
+/*
+    IMU HISTORY
+
+    The imu task reads the imu messages (messages.h) received on the protocol link from the sample bus
+    and puts the samples of every unit through its reorder buffer (reorder.h): late batches are slotted
+    back by timestamp and the samples come out a window at a time, in order, once the window is complete
+    or its watermark passed, gaps filled and flagged. The orientation filter of the unit then runs on
+    every sample of the window. Each unit keeps its last IMU_HISTORY_LENGTH samples, every one next to
+    the quaternion the filter gave after it.
+
+    After every window the task publishes a snapshot of each unit it touched (snapshot.h): the history,
+    newest first, and features of the window. Readers on any task or core (imuGetSnapshot, imuGetLatest)
+    get a consistent copy without a lock, the imu task never waits for them.
+
+    The window length and the watermark trade latency for completeness: a window waits at most the
+    watermark (plus the link delay) for a missing sample, "imu window" changes them.
+*/
+
+#define IMU_UNITS (MESSAGE_IMU_UNITS)
+#define IMU_HISTORY_LENGTH (32)
+
+#ifndef IMU_WINDOW_LENGTH
+#define IMU_WINDOW_LENGTH (8)           //Samples
+#endif
+#ifndef IMU_WATERMARK_US
+#define IMU_WATERMARK_US (50000UL)
+#endif
+#ifndef IMU_FILL
+#define IMU_FILL (REORDER_FILL_INTERPOLATE)
+#endif
+
+typedef struct
+{
+    uint32_t u32Timestamp;          //Microseconds since boot (wraps)
+    int16_t ai16Accel[3];           //MESSAGE_IMU_ACCEL_LSB_PER_G
+    int16_t ai16Gyro[3];            //MESSAGE_IMU_GYRO_LSB_PER_KDPS
+    float afQuaternion[4];          //w, x, y, z after this sample
+    bool bFilled;                   //Missing from the stream, made up by the reorder buffer
+}imu_sample_t;
+
+/* Of the last window */
+typedef struct
+{
+    float fAccelMean;               //g, magnitude
+    float fAccelVariance;           //g^2
+    float fGyroMean;                //Degrees per second, magnitude
+    uint8_t u8Filled;               //Samples made up
+}imu_features_t;
+
+typedef struct
+{
+    uint32_t u32Samples;            //Since the start
+    uint8_t u8Length;               //Samples in asHistory
+    imu_features_t sFeatures;
+    imu_sample_t asHistory[IMU_HISTORY_LENGTH];    //Newest first
+}imu_snapshot_t;
+
+#define IMU_SNAPSHOT_SIZE(samples) (offsetof(imu_snapshot_t, asHistory) + ((samples) * sizeof(imu_sample_t)))
+
+void imuTaskInit(void);
+int32_t imuConfigure(orientation_filter_t _eFilter, bool _bFixed, float _fGain);
+int32_t imuConfigureWindow(uint8_t _u8Length, uint32_t _u32WatermarkUs, reorder_fill_t _eFill);
+int32_t imuGetLatest(uint8_t _u8Unit, imu_sample_t *_psSample);
+int32_t imuGetSnapshot(uint8_t _u8Unit, imu_snapshot_t *_psSnapshot, uint8_t _u8Samples);
+void imuPrintStats(void);
+
+#endif /* _IMU_TASK_H_ */
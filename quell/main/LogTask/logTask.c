@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "logTask.h"
+#include "flashLog.h"
+#include "quell.h"
+#include "taskConfig.h"
+
+/* An erase stops the flash cache on both cores for up to a few hundred ms, the uart ISRs have to run from IRAM meanwhile (flashLog.h) */
+#if !CONFIG_UART_ISR_IN_IRAM
+#error "CONFIG_UART_ISR_IN_IRAM must be set: the protocol uarts lose bytes while the flash log erases"
+#endif
+
+static const char *TAG = "flashlog";
+
+static flash_log_t sFlashLog;
+static flash_log_device_t sDevice;
+static bool bMounted = false;
+static TaskHandle_t tLogTaskHandle = NULL;
+
+static uint32_t logNowUs(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static int32_t logFlashRead(void *_pvContext, uint32_t _u32Offset, void *_pvData, uint32_t _u32Size)
+{
+    return (esp_partition_read((const esp_partition_t *)_pvContext, _u32Offset, _pvData, _u32Size) == ESP_OK) ? QUELL_OK : QUELL_ERROR;
+}
+
+static int32_t logFlashWrite(void *_pvContext, uint32_t _u32Offset, const void *_pvData, uint32_t _u32Size)
+{
+    return (esp_partition_write((const esp_partition_t *)_pvContext, _u32Offset, _pvData, _u32Size) == ESP_OK) ? QUELL_OK : QUELL_ERROR;
+}
+
+static int32_t logFlashErase(void *_pvContext, uint32_t _u32Offset, uint32_t _u32Size)
+{
+    return (esp_partition_erase_range((const esp_partition_t *)_pvContext, _u32Offset, _u32Size) == ESP_OK) ? QUELL_OK : QUELL_ERROR;
+}
+
+static void log_task(void *pvParameters)
+{
+    for(;;)
+    {
+        /* Woken when a page is handed over, the timeout only retries what failed */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_TASK_RETRY_MS));
+
+        flashLog_run(&sFlashLog);
+    }
+    vTaskDelete(NULL);
+}
+
+
+
+/* Imu task only (the one appending task) */
+int32_t logAppend(const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    uint8_t u8In = sFlashLog.u8In;
+    int32_t i32Result;
+
+    if(bMounted == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    i32Result = flashLog_append(&sFlashLog, _pu8Message, _u16Size);
+    if(sFlashLog.u8In != u8In)
+    {
+        xTaskNotifyGive(tLogTaskHandle);
+    }
+
+    return i32Result;
+}
+
+/* Imu task, every loop: a page waiting for more records too long goes to the flash */
+void logTick(void)
+{
+    if(bMounted == true && flashLog_tick(&sFlashLog) == true)
+    {
+        xTaskNotifyGive(tLogTaskHandle);
+    }
+}
+
+void logSetEnabled(bool _bEnable)
+{
+    flashLog_enable(&sFlashLog, _bEnable);
+}
+
+/* Terminal: the records of the last pages written as "FLOG <page sequence> <message hex>" lines, oldest first (what is still in RAM is not) */
+int32_t logRead(uint32_t _u32Pages)
+{
+    static flash_log_cursor_t sCursor;
+    static char acLine[(FLASH_LOG_MAX_RECORD * 2) + 1];
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    uint32_t u32Records = 0;
+
+    if(bMounted == false || flashLog_seek(&sFlashLog, &sCursor, _u32Pages) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    while(flashLog_next(&sFlashLog, &sCursor, &pu8Message, &u16Size) == QUELL_OK)
+    {
+        for(uint16_t u16Index = 0; u16Index < u16Size; u16Index++)
+        {
+            sprintf(&acLine[u16Index * 2], "%02x", pu8Message[u16Index]);
+        }
+        acLine[u16Size * 2] = 0;
+        ESP_LOGI(TAG, "FLOG %08x %s", sCursor.u32Sequence, acLine);
+        u32Records++;
+    }
+    ESP_LOGI(TAG, "%u records, %u pages skipped (torn or written over)", u32Records, sCursor.u32Skipped);
+
+    return QUELL_OK;
+}
+
+void logPrintStats(void)
+{
+    if(bMounted == false)
+    {
+        ESP_LOGI(TAG, "no \"%s\" partition", LOG_PARTITION_LABEL);
+        return;
+    }
+    flashLog_print(&sFlashLog, TAG);
+}
+
+void logTaskInit(void)
+{
+    const esp_partition_t *psPartition;
+
+    //Set flash log level
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    psPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, LOG_PARTITION_LABEL);
+    if(psPartition == NULL)
+    {
+        ESP_LOGI(TAG, "No \"%s\" partition, nothing is logged", LOG_PARTITION_LABEL);
+        return;
+    }
+
+    sDevice.fpRead = logFlashRead;
+    sDevice.fpWrite = logFlashWrite;
+    sDevice.fpErase = logFlashErase;
+    sDevice.pvContext = (void *)psPartition;
+    sDevice.u32Size = psPartition->size - (psPartition->size % FLASH_LOG_SECTOR_SIZE);
+
+    /* Reads the whole partition, before the task that appends starts */
+    if(flashLog_mount(&sFlashLog, &sDevice, logNowUs) == QUELL_ERROR)
+    {
+        ESP_LOGI(TAG, "Error mounting the flash log");
+        return;
+    }
+    ESP_LOGI(TAG, "%u pages, %u found (%u torn), going on at page %u sequence %u", sFlashLog.u32Pages, sFlashLog.u32ValidPages,
+             sFlashLog.u32TornPages, sFlashLog.u32Slot, sFlashLog.u32Sequence);
+
+    if(xTaskCreatePinnedToCore(log_task, "log_task", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIORITY, &tLogTaskHandle, LOG_TASK_CORE) == pdPASS)
+    {
+        bMounted = true;
+    }
+}
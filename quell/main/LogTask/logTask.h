@@ -0,0 +1,29 @@
+#ifndef _LOG_TASK_H_
+#define _LOG_TASK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    FLASH LOG TASK
+
+    Keeps the flash log (flashLog.h) on the LOG_PARTITION_LABEL partition (partitions.csv): the imu task
+    appends the records (logAppend, logTick), this task writes and erases the flash, which stalls it for
+    as long as the flash takes (a sector erase is tens of milliseconds) instead of the imu task. Without
+    the partition nothing is logged.
+*/
+
+#ifndef LOG_PARTITION_LABEL
+#define LOG_PARTITION_LABEL "flashlog"
+#endif
+#define LOG_READ_DEFAULT_PAGES (4)
+#define LOG_TASK_RETRY_MS (100)                 //Of a write or an erase that failed
+
+void logTaskInit(void);
+int32_t logAppend(const uint8_t *_pu8Message, uint16_t _u16Size);
+void logTick(void);
+void logSetEnabled(bool _bEnable);
+int32_t logRead(uint32_t _u32Pages);
+void logPrintStats(void);
+
+#endif /* _LOG_TASK_H_ */
@@ -0,0 +1,306 @@
+#include "esp_log.h"
+#include "channel.h"
+#include "congestion.h"
+#include "quell.h"
+
+static channel_tunnel_t* channelTunnel(channel_mux_t *_psMux, uint8_t _u8Channel)
+{
+    if(_psMux == NULL || _u8Channel >= CHANNEL_TUNNELS || _psMux->asTunnels[_u8Channel].sTx.buffer == NULL)
+    {
+        return NULL;
+    }
+
+    return &_psMux->asTunnels[_u8Channel];
+}
+
+/* Bytes in whole or nothing, the reader never sees part of them */
+static bool channelPut(fifo_t *_psFIFO, const uint8_t *_pu8Header, uint16_t _u16HeaderSize, const uint8_t *_pu8Data, uint16_t _u16Size)
+{
+    size_t tFree;
+
+    if(FIFO_free(_psFIFO, &tFree) == false || tFree < (size_t)_u16HeaderSize + _u16Size)
+    {
+        return false;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < _u16HeaderSize; u16Index++)
+    {
+        FIFO_poke(_psFIFO, u16Index, (char)_pu8Header[u16Index]);
+    }
+    for(uint16_t u16Index = 0; u16Index < _u16Size; u16Index++)
+    {
+        FIFO_poke(_psFIFO, _u16HeaderSize + u16Index, (char)_pu8Data[u16Index]);
+    }
+
+    return FIFO_commit(_psFIFO, _u16HeaderSize + _u16Size);
+}
+
+/* Tokens for the time since the last look, the cap cut to the congestion rate, at most the burst */
+static void channelRefill(channel_mux_t *_psMux, channel_tunnel_t *_psTunnel)
+{
+    uint32_t u32Now = _psMux->fpNowUs();
+    uint32_t u32Elapsed = u32Now - _psTunnel->u32LastUs;
+    uint32_t u32Burst = CHANNEL_BURST_MESSAGES * (MESSAGE_CHANNEL_MAX_SIZE + CHANNEL_FRAME_OVERHEAD);
+    uint64_t u64Fraction;
+
+    _psTunnel->u32LastUs = u32Now;
+    u32Elapsed = (u32Elapsed > 1000000UL) ? 1000000UL : u32Elapsed;
+    u64Fraction = (((uint64_t)u32Elapsed * _psTunnel->u32Cap * _psMux->u8Rate) / CONGESTION_RATE_STEPS) + _psTunnel->u32Fraction;
+
+    _psTunnel->u32Tokens += (uint32_t)(u64Fraction / 1000000ULL);
+    _psTunnel->u32Fraction = (uint32_t)(u64Fraction % 1000000ULL);
+    if(_psTunnel->u32Tokens >= u32Burst)
+    {
+        _psTunnel->u32Tokens = u32Burst;
+        _psTunnel->u32Fraction = 0;
+    }
+}
+
+int32_t channel_init(channel_mux_t *_psMux, channel_clock_t _fpNowUs)
+{
+    if(_psMux == NULL || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psMux, 0, sizeof(channel_mux_t));
+    _psMux->fpNowUs = _fpNowUs;
+    _psMux->u8Rate = CONGESTION_RATE_STEPS;
+
+    return QUELL_OK;
+}
+
+/* A tunnel works once its FIFOs are there, _u32Cap 0 sends as fast as the bulk lane has room */
+int32_t channel_initTunnel(channel_mux_t *_psMux, uint8_t _u8Channel, char *_pcTxBuffer, size_t _tTxSize, char *_pcRxBuffer, size_t _tRxSize, uint32_t _u32Cap)
+{
+    channel_tunnel_t *psTunnel;
+
+    if(_psMux == NULL || _u8Channel >= CHANNEL_TUNNELS || _tRxSize <= CHANNEL_RECORD_HEADER + MESSAGE_CHANNEL_DATA_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    psTunnel = &_psMux->asTunnels[_u8Channel];
+    memset(psTunnel, 0, sizeof(channel_tunnel_t));
+    if(FIFO_init(&psTunnel->sTx, _pcTxBuffer, _tTxSize) == false || FIFO_init(&psTunnel->sRx, _pcRxBuffer, _tRxSize) == false)
+    {
+        psTunnel->sTx.buffer = NULL;
+        return QUELL_ERROR;
+    }
+    psTunnel->u32Cap = _u32Cap;
+    psTunnel->u32LastUs = _psMux->fpNowUs();
+
+    return QUELL_OK;
+}
+
+/* Where the Tx bytes go from the next message on (what is queued goes there as well) */
+int32_t channel_setPeer(channel_mux_t *_psMux, uint8_t _u8Channel, uint8_t _u8Peer)
+{
+    channel_tunnel_t *psTunnel = channelTunnel(_psMux, _u8Channel);
+
+    if(psTunnel == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    psTunnel->u8Peer = _u8Peer;
+
+    return QUELL_OK;
+}
+
+uint8_t channel_getPeer(const channel_mux_t *_psMux, uint8_t _u8Channel)
+{
+    return (_psMux != NULL && _u8Channel < CHANNEL_TUNNELS) ? _psMux->asTunnels[_u8Channel].u8Peer : 0;
+}
+
+int32_t channel_setCap(channel_mux_t *_psMux, uint8_t _u8Channel, uint32_t _u32Cap)
+{
+    channel_tunnel_t *psTunnel = channelTunnel(_psMux, _u8Channel);
+
+    if(psTunnel == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    psTunnel->u32Cap = _u32Cap;
+
+    return QUELL_OK;
+}
+
+/* The congestion control cut the samples to _u8Rate / CONGESTION_RATE_STEPS, the tunnels follow */
+void channel_throttle(channel_mux_t *_psMux, uint8_t _u8Rate)
+{
+    if(_psMux != NULL)
+    {
+        _psMux->u8Rate = (_u8Rate == 0) ? 1 : (_u8Rate > CONGESTION_RATE_STEPS) ? CONGESTION_RATE_STEPS : _u8Rate;
+    }
+}
+
+/* Queues _u16Size bytes for the peer, all of them or none (QUELL_ERROR, counted) */
+int32_t channel_write(channel_mux_t *_psMux, uint8_t _u8Channel, const char *_pcData, uint16_t _u16Size)
+{
+    channel_tunnel_t *psTunnel = channelTunnel(_psMux, _u8Channel);
+
+    if(psTunnel == NULL || _pcData == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(channelPut(&psTunnel->sTx, NULL, 0, (const uint8_t*)_pcData, _u16Size) == false)
+    {
+        psTunnel->u32TxDropped += _u16Size;
+        return QUELL_ERROR;
+    }
+
+    return QUELL_OK;
+}
+
+/* The data of the oldest message received and its source, QUELL_ERROR when there is none */
+int32_t channel_read(channel_mux_t *_psMux, uint8_t _u8Channel, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Source)
+{
+    channel_tunnel_t *psTunnel = channelTunnel(_psMux, _u8Channel);
+    char acHeader[CHANNEL_RECORD_HEADER];
+    uint8_t u8Length;
+    char cData;
+
+    if(psTunnel == NULL || _pcBuffer == NULL || _pu16Size == NULL || _pu8Source == NULL || _u16BufferSize < MESSAGE_CHANNEL_DATA_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(FIFO_get(&psTunnel->sRx, &acHeader[0]) == false || FIFO_get(&psTunnel->sRx, &acHeader[1]) == false)
+    {
+        return QUELL_ERROR;
+    }
+    *_pu8Source = (uint8_t)acHeader[0];
+    u8Length = (uint8_t)acHeader[1];
+
+    *_pu16Size = 0;
+    while(*_pu16Size < u8Length && FIFO_get(&psTunnel->sRx, &cData) == true)
+    {
+        _pcBuffer[(*_pu16Size)++] = cData;
+    }
+
+    return QUELL_OK;
+}
+
+/* The next message of the channel, when the cap allows it and it fits _u16Room message bytes. Waits for the tokens of all it has (or of a full message) */
+int32_t channel_makeMessage(channel_mux_t *_psMux, uint8_t _u8Channel, uint16_t _u16Room, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    channel_tunnel_t *psTunnel = channelTunnel(_psMux, _u8Channel);
+    message_channel_t sMessage;
+    size_t tQueued;
+    char cData;
+
+    if(psTunnel == NULL || _pu8Buffer == NULL || _pu16Size == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    channelRefill(_psMux, psTunnel);
+    if(FIFO_count(&psTunnel->sTx, &tQueued) == false || tQueued == 0 || _u16Room <= MESSAGE_CHANNEL_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    sMessage.u16DataCount = (tQueued < MESSAGE_CHANNEL_DATA_MAX_COUNT) ? (uint16_t)tQueued : MESSAGE_CHANNEL_DATA_MAX_COUNT;
+    if(psTunnel->u32Cap > 0 && psTunnel->u32Tokens < MESSAGE_CHANNEL_SIZE + sMessage.u16DataCount + CHANNEL_FRAME_OVERHEAD)
+    {
+        psTunnel->u32Throttled++;
+        return QUELL_ERROR;
+    }
+    if(sMessage.u16DataCount > _u16Room - MESSAGE_CHANNEL_SIZE)
+    {
+        sMessage.u16DataCount = _u16Room - MESSAGE_CHANNEL_SIZE;
+    }
+
+    sMessage.u8Channel = _u8Channel;
+    sMessage.u8Sequence = psTunnel->au8TxSequence[psTunnel->u8Peer % CHANNEL_SOURCES];
+    for(uint16_t u16Index = 0; u16Index < sMessage.u16DataCount; u16Index++)
+    {
+        FIFO_peak(&psTunnel->sTx, u16Index, &cData);
+        sMessage.au8Data[u16Index] = (uint8_t)cData;
+    }
+    if(messages_encodeChannel(&sMessage, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Taken off the FIFO only once the message is made */
+    for(uint16_t u16Index = 0; u16Index < sMessage.u16DataCount; u16Index++)
+    {
+        FIFO_get(&psTunnel->sTx, &cData);
+    }
+    psTunnel->au8TxSequence[psTunnel->u8Peer % CHANNEL_SOURCES]++;
+    psTunnel->u32Tokens -= (psTunnel->u32Cap > 0) ? MESSAGE_CHANNEL_SIZE + sMessage.u16DataCount + CHANNEL_FRAME_OVERHEAD : 0;
+    psTunnel->u32TxMessages++;
+    psTunnel->u32TxBytes += sMessage.u16DataCount;
+
+    return QUELL_OK;
+}
+
+/* Consumes channel messages, the data goes to the Rx FIFO of its channel. The terminal answers whoever wrote to it last */
+int32_t channel_processMessage(channel_mux_t *_psMux, const uint8_t *_pu8Message, uint16_t _u16Size, uint8_t _u8Source)
+{
+    static message_channel_t sMessage;
+    channel_tunnel_t *psTunnel;
+    uint8_t au8Header[CHANNEL_RECORD_HEADER];
+    uint8_t u8Slot = _u8Source % CHANNEL_SOURCES;
+
+    if(_psMux == NULL || messages_decodeChannel(&sMessage, _pu8Message, _u16Size) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* A channel this unit has no tunnel for is still consumed */
+    psTunnel = channelTunnel(_psMux, sMessage.u8Channel);
+    if(psTunnel == NULL)
+    {
+        return QUELL_OK;
+    }
+
+    psTunnel->u32RxMessages++;
+    psTunnel->u32RxBytes += sMessage.u16DataCount;
+    if((psTunnel->u8RxSeen & (1U << u8Slot)) != 0 && sMessage.u8Sequence != psTunnel->au8RxSequence[u8Slot])
+    {
+        psTunnel->u32RxLost += (uint8_t)(sMessage.u8Sequence - psTunnel->au8RxSequence[u8Slot]);
+    }
+    psTunnel->u8RxSeen |= (uint8_t)(1U << u8Slot);
+    psTunnel->au8RxSequence[u8Slot] = sMessage.u8Sequence + 1;
+
+    if(sMessage.u8Channel == MESSAGE_CHANNEL_TERMINAL)
+    {
+        psTunnel->u8Peer = _u8Source;
+    }
+
+    au8Header[0] = _u8Source;
+    au8Header[1] = (uint8_t)sMessage.u16DataCount;
+    if(sMessage.u16DataCount > 0 && channelPut(&psTunnel->sRx, au8Header, sizeof(au8Header), sMessage.au8Data, sMessage.u16DataCount) == false)
+    {
+        psTunnel->u32RxOverflows++;
+    }
+
+    return QUELL_OK;
+}
+
+void channel_print(const channel_mux_t *_psMux, const char *_pcTAG)
+{
+    static const char *apcNames[CHANNEL_TUNNELS] = {"terminal", "log"};
+
+    if(_psMux == NULL || _pcTAG == NULL)
+    {
+        return;
+    }
+
+    for(uint8_t u8Channel = 0; u8Channel < CHANNEL_TUNNELS; u8Channel++)
+    {
+        const channel_tunnel_t *psTunnel = &_psMux->asTunnels[u8Channel];
+
+        if(psTunnel->sTx.buffer == NULL)
+        {
+            continue;
+        }
+        ESP_LOGI(_pcTAG, "channel %s peer:%u cap:%uB/s (%u/%u) tx messages:%u bytes:%u dropped:%u throttled:%u rx messages:%u bytes:%u lost:%u overflows:%u",
+                 apcNames[u8Channel], psTunnel->u8Peer, psTunnel->u32Cap, _psMux->u8Rate, CONGESTION_RATE_STEPS, psTunnel->u32TxMessages, psTunnel->u32TxBytes,
+                 psTunnel->u32TxDropped, psTunnel->u32Throttled, psTunnel->u32RxMessages, psTunnel->u32RxBytes, psTunnel->u32RxLost,
+                 psTunnel->u32RxOverflows);
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "FIFO.h"
+#include "messages.h"
+
+/*
+    LOGICAL CHANNELS
+
+    A link carries four logical channels:
+
+    CHANNEL:        CARRIED BY:                             LANE:           PRIORITY:
+    Control         Link messages (credits, speed, FEC...)  Control         Ahead of everything
+    Data            imu messages and injected messages      Bulk, Forward   Queued first
+    Terminal        channel messages, channel 0             Bulk, Tunnel    On an idle link, capped
+    Log             channel messages, channel 1             Bulk, Tunnel    On an idle link, capped
+
+    The terminal and log channels are tunnels: byte streams with a Tx FIFO on the sending side and a
+    Rx FIFO on the receiving side, multiplexed into channel messages (0x17) and demultiplexed by
+    channel_processMessage. A hand unit's terminal takes command lines from the terminal tunnel and
+    sends what they print back through it, and its log output goes to the master over the log tunnel
+    as the link allows (deferred, a line that finds the Tx FIFO full is dropped whole and counted).
+
+    Diagnostics never starve the samples: the processing task builds channel messages only after it
+    queued the data, one at a time and only while the link has nothing else to send (txScheduler_isIdle:
+    lanes empty, the uart done with the last frame). A unit in between puts the ones of others on the
+    tunnel lane of the next link, sent on the same terms, and throws them away when it is full (router.h),
+    so a sample waits at most for one on the wire of every link it crosses (tools/linksim "-T" checks it
+    against the same run without tunnels). Every tunnel has a bandwidth cap as well (token bucket of its bytes on the wire, burst of
+    CHANNEL_BURST_MESSAGES full messages). While the congestion control cuts the sample rate
+    (congestion.h) the caps are cut to the same fraction.
+
+    Received data goes into the Rx FIFO of its channel as records (source address u8, length u8,
+    data), a message that does not fit is dropped and counted, so a reader tells the units apart and
+    gets whole messages. The sequence of every channel message shows the ones lost on the way (counted
+    per destination, followed per source, up to CHANNEL_SOURCES addresses).
+
+    channel_write and channel_read are for other tasks (the caller serialises the writers of a channel),
+    channel_makeMessage and channel_processMessage for the processing task.
+*/
+
+#define CHANNEL_TUNNELS (2)                     //MESSAGE_CHANNEL_TERMINAL and MESSAGE_CHANNEL_LOG
+#define CHANNEL_SOURCES (8)                     //Addresses whose sequence is followed
+#define CHANNEL_RECORD_HEADER (2)               //Source and length in front of every Rx record
+#define CHANNEL_FRAME_OVERHEAD (11)             //Packet (7) and address header (4) around a message, charged to the cap
+#define CHANNEL_BURST_MESSAGES (2)
+#ifndef CHANNEL_TERMINAL_CAP
+#define CHANNEL_TERMINAL_CAP (1024UL)           //Bytes per second on the wire, 9% of 115200 baud
+#endif
+#ifndef CHANNEL_LOG_CAP
+#define CHANNEL_LOG_CAP (512UL)
+#endif
+
+typedef uint32_t (*channel_clock_t)(void);     //Microseconds, wrapping
+
+typedef struct
+{
+    fifo_t sTx;
+    fifo_t sRx;
+    volatile uint8_t u8Peer;        //Destination of the Tx bytes (addressed links)
+    volatile uint32_t u32Cap;       //Bytes per second on the wire, 0 for none
+
+    /* Token bucket (processing task) */
+    uint32_t u32Tokens;             //Bytes
+    uint32_t u32Fraction;           //Millionths of a byte
+    uint32_t u32LastUs;
+    uint8_t au8TxSequence[CHANNEL_SOURCES];     //Next to every destination
+    uint8_t au8RxSequence[CHANNEL_SOURCES];     //Next expected from every source
+    uint8_t u8RxSeen;               //Bit n: source n sent before
+
+    /* Statistics */
+    uint32_t u32TxMessages;
+    uint32_t u32TxBytes;            //Data bytes sent
+    uint32_t u32TxDropped;          //Data bytes the Tx FIFO had no room for
+    uint32_t u32Throttled;          //Times the cap held a message back
+    uint32_t u32RxMessages;
+    uint32_t u32RxBytes;
+    uint32_t u32RxLost;             //Sequence gaps
+    uint32_t u32RxOverflows;        //Messages the Rx FIFO had no room for
+}channel_tunnel_t;
+
+typedef struct
+{
+    channel_clock_t fpNowUs;
+    channel_tunnel_t asTunnels[CHANNEL_TUNNELS];
+    volatile uint8_t u8Rate;        //Caps cut to u8Rate / CONGESTION_RATE_STEPS (the rate of the congestion control)
+}channel_mux_t;
+
+int32_t channel_init(channel_mux_t *_psMux, channel_clock_t _fpNowUs);
+int32_t channel_initTunnel(channel_mux_t *_psMux, uint8_t _u8Channel, char *_pcTxBuffer, size_t _tTxSize, char *_pcRxBuffer, size_t _tRxSize, uint32_t _u32Cap);
+int32_t channel_setPeer(channel_mux_t *_psMux, uint8_t _u8Channel, uint8_t _u8Peer);
+uint8_t channel_getPeer(const channel_mux_t *_psMux, uint8_t _u8Channel);
+int32_t channel_setCap(channel_mux_t *_psMux, uint8_t _u8Channel, uint32_t _u32Cap);
+void channel_throttle(channel_mux_t *_psMux, uint8_t _u8Rate);
+int32_t channel_write(channel_mux_t *_psMux, uint8_t _u8Channel, const char *_pcData, uint16_t _u16Size);
+int32_t channel_read(channel_mux_t *_psMux, uint8_t _u8Channel, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Source);
+int32_t channel_makeMessage(channel_mux_t *_psMux, uint8_t _u8Channel, uint16_t _u16Room, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t channel_processMessage(channel_mux_t *_psMux, const uint8_t *_pu8Message, uint16_t _u16Size, uint8_t _u8Source);
+void channel_print(const channel_mux_t *_psMux, const char *_pcTAG);
+
+#endif /* _CHANNEL_H_ */
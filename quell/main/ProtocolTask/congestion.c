@@ -0,0 +1,161 @@
+#include "esp_log.h"
+#include "congestion.h"
+#include "quell.h"
+
+static const char *apcCongestionCauses[CONGESTION_CAUSE_COUNT] = {"none", "refused", "quenched", "errors", "delay"};
+
+/* Bytes waiting over what the link sent in the period, the time they still need to go (a link that sent nothing counts as one byte) */
+static uint32_t congestionDelay(uint32_t _u32Queued, uint32_t _u32Sent, uint32_t _u32PeriodUs)
+{
+    uint64_t u64Delay = ((uint64_t)_u32Queued * _u32PeriodUs) / ((_u32Sent > 0) ? _u32Sent : 1);
+
+    return (u64Delay > UINT32_MAX) ? UINT32_MAX : (uint32_t)u64Delay;
+}
+
+static congestion_cause_t congestionCause(congestion_t *_psCongestion, const congestion_health_t *_psHealth, uint32_t _u32PeriodUs)
+{
+    uint32_t u32Packets = _psHealth->u32RxPackets - _psCongestion->sLast.u32RxPackets;
+    uint32_t u32Errors = _psHealth->u32RxErrors - _psCongestion->sLast.u32RxErrors;
+
+    _psCongestion->u32DelayUs = congestionDelay(_psHealth->u32Queued, _psHealth->u32TxBytes - _psCongestion->sLast.u32TxBytes, _u32PeriodUs);
+    _psCongestion->u32MaxDelayUs = (_psCongestion->u32DelayUs > _psCongestion->u32MaxDelayUs) ? _psCongestion->u32DelayUs : _psCongestion->u32MaxDelayUs;
+    _psCongestion->u32ErrorPermille = (u32Packets + u32Errors > 0) ? (u32Errors * 1000UL) / (u32Packets + u32Errors) : 0;
+
+    if(_psHealth->u32Refused != _psCongestion->sLast.u32Refused)
+    {
+        return CONGESTION_REFUSED;
+    }
+    if(_psHealth->u32Quenches != _psCongestion->sLast.u32Quenches)
+    {
+        return CONGESTION_QUENCHED;
+    }
+    if(u32Packets + u32Errors >= CONGESTION_MIN_PACKETS && _psCongestion->u32ErrorPermille > CONGESTION_MAX_ERROR_PERMILLE)
+    {
+        return CONGESTION_ERRORS;
+    }
+    if(_psCongestion->u32DelayUs > CONGESTION_MAX_DELAY_US)
+    {
+        return CONGESTION_DELAY;
+    }
+
+    return CONGESTION_NONE;
+}
+
+
+
+int32_t congestion_init(congestion_t *_psCongestion, congestion_clock_t _fpNowUs)
+{
+    if(_psCongestion == NULL || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psCongestion, 0, sizeof(congestion_t));
+    _psCongestion->fpNowUs = _fpNowUs;
+    _psCongestion->bEnabled = true;
+    _psCongestion->u8Rate = CONGESTION_RATE_STEPS;
+    _psCongestion->u32PeriodStartUs = _fpNowUs();
+    _psCongestion->u32CutUs = _psCongestion->u32PeriodStartUs - CONGESTION_HOLD_US;
+
+    return QUELL_OK;
+}
+
+/* Terminal: off goes back to the full rate at the next congestion_run */
+void congestion_enable(congestion_t *_psCongestion, bool _bEnable)
+{
+    if(_psCongestion != NULL)
+    {
+        _psCongestion->bEnabled = _bEnable;
+    }
+}
+
+/* Processing task, as often as it likes: true when u8Rate changed and the streams have to follow */
+bool congestion_run(congestion_t *_psCongestion, const congestion_health_t *_psHealth)
+{
+    uint32_t u32Now;
+    uint32_t u32PeriodUs;
+    uint8_t u8Rate;
+    congestion_cause_t eCause;
+
+    if(_psCongestion == NULL || _psHealth == NULL)
+    {
+        return false;
+    }
+    u32Now = _psCongestion->fpNowUs();
+    u32PeriodUs = u32Now - _psCongestion->u32PeriodStartUs;
+    u8Rate = _psCongestion->u8Rate;
+
+    if(u32PeriodUs < CONGESTION_PERIOD_US)
+    {
+        return false;
+    }
+
+    if(_psCongestion->bEnabled == false || _psHealth->bHeld == true)
+    {
+        _psCongestion->sLast = *_psHealth;
+        _psCongestion->u32PeriodStartUs = u32Now;
+        _psCongestion->u8CleanPeriods = 0;
+        _psCongestion->u8Rate = (_psCongestion->bEnabled == false) ? CONGESTION_RATE_STEPS : u8Rate;
+        return (_psCongestion->u8Rate != u8Rate);
+    }
+
+    eCause = congestionCause(_psCongestion, _psHealth, u32PeriodUs);
+    _psCongestion->sLast = *_psHealth;
+    _psCongestion->u32PeriodStartUs = u32Now;
+
+    /* Multiplicative decrease, once the last cut had the time to show */
+    if(eCause != CONGESTION_NONE)
+    {
+        _psCongestion->u8CleanPeriods = 0;
+        _psCongestion->au32Causes[eCause]++;
+        if(u32Now - _psCongestion->u32CutUs < CONGESTION_HOLD_US || u8Rate <= 1)
+        {
+            return false;
+        }
+        _psCongestion->u8Rate = u8Rate / 2;
+        _psCongestion->u32CutUs = u32Now;
+        _psCongestion->u32Cuts++;
+        _psCongestion->eLastCause = eCause;
+        return true;
+    }
+
+    /* Additive increase after a clean stretch with the queue well under the bound */
+    if(_psCongestion->u32DelayUs > CONGESTION_MAX_DELAY_US / 4)
+    {
+        _psCongestion->u8CleanPeriods = 0;
+        return false;
+    }
+    if(++_psCongestion->u8CleanPeriods < CONGESTION_CLEAN_PERIODS || u8Rate >= CONGESTION_RATE_STEPS)
+    {
+        return false;
+    }
+    _psCongestion->u8CleanPeriods = 0;
+    _psCongestion->u8Rate = u8Rate + 1;
+    _psCongestion->u32Steps++;
+
+    return true;
+}
+
+/* Samples per message at an output period of _u32PeriodUs, so none waits more than CONGESTION_MAX_FILL_US for the batch to fill */
+uint8_t congestion_getBatch(uint32_t _u32PeriodUs)
+{
+    uint32_t u32Batch = (_u32PeriodUs > 0) ? CONGESTION_MAX_FILL_US / _u32PeriodUs : CONGESTION_MAX_BATCH;
+
+    if(u32Batch < 1)
+    {
+        return 1;
+    }
+
+    return (u32Batch > CONGESTION_MAX_BATCH) ? CONGESTION_MAX_BATCH : (uint8_t)u32Batch;
+}
+
+void congestion_print(const congestion_t *_psCongestion, const char *_pcTAG)
+{
+    ESP_LOGI(_pcTAG, "congestion %s rate %u/%u cuts:%u (refused:%u quenched:%u errors:%u delay:%u, last %s) steps up:%u",
+             (_psCongestion->bEnabled == true) ? "on" : "off", _psCongestion->u8Rate, CONGESTION_RATE_STEPS, _psCongestion->u32Cuts,
+             _psCongestion->au32Causes[CONGESTION_REFUSED], _psCongestion->au32Causes[CONGESTION_QUENCHED],
+             _psCongestion->au32Causes[CONGESTION_ERRORS], _psCongestion->au32Causes[CONGESTION_DELAY],
+             apcCongestionCauses[_psCongestion->eLastCause], _psCongestion->u32Steps);
+    ESP_LOGI(_pcTAG, "congestion queue delay:%uus max:%uus (bound %uus) rx errors:%u permille",
+             _psCongestion->u32DelayUs, _psCongestion->u32MaxDelayUs, (uint32_t)CONGESTION_MAX_DELAY_US, _psCongestion->u32ErrorPermille);
+}
@@ -0,0 +1,108 @@
+#ifndef _CONGESTION_H_
+#define _CONGESTION_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    CONGESTION CONTROL (sending unit)
+
+    Keeps the imu stream of a unit within what its link toward the master carries, instead of queueing
+    until the protocol queue refuses messages. Every CONGESTION_PERIOD_US the processing task hands over
+    the health of that link (congestion_run) and the controller looks at what happened meanwhile:
+
+    - messages the link had no room for (protocol queue full);
+    - quench messages: a router further on (chain) forwards frames of ours into a lane backing up, or
+      threw them away, and only the units feeding its next link can help (router.h);
+    - packets dropped by the parser above CONGESTION_MAX_ERROR_PERMILLE (CRC, framing), a link going bad
+      loses its rate next (linkSpeed.h);
+    - the queue delay above CONGESTION_MAX_DELAY_US: the bytes waiting to go over what the link sent in
+      the period (credits, slots and the baud rate are all in it, a link that sent nothing counts as one byte).
+
+    Any of them halves the sample rate (down to one CONGESTION_RATE_STEPS-th of the full rate), then
+    nothing is cut for CONGESTION_HOLD_US while the queue drains at the new rate. After
+    CONGESTION_CLEAN_PERIODS periods without any of them and a queue delay under a quarter of the bound
+    the rate goes up by one step, a CONGESTION_RATE_STEPS-th of the full rate, and so on until the full
+    rate. The increase is additive in the rate, so a link that carries 70% of the full rate settles
+    around it instead of hopping between half and all of it; the streams resample to the fraction
+    (imuStream_adapt, decimator.h).
+
+    The batch follows the rate: a message holds at most CONGESTION_MAX_FILL_US of samples
+    (congestion_getBatch), so the slower stream does not wait longer to fill one. Periods while the
+    link is held (speed negotiation, linkSpeed.h) are skipped, the queue grows then on purpose.
+
+    congestion_run only decides the rate, the caller applies it (imuStream_adapt, channel_throttle) when
+    it changed.
+*/
+
+#define CONGESTION_PERIOD_US (100000UL)
+#define CONGESTION_HOLD_US (500000UL)           //After a cut, before the next one
+#define CONGESTION_CLEAN_PERIODS (10)           //Before a step back up
+#define CONGESTION_MAX_ERROR_PERMILLE (20UL)
+#define CONGESTION_MIN_PACKETS (10UL)           //In a period, for the error rate to count
+#ifndef CONGESTION_MAX_DELAY_US
+#define CONGESTION_MAX_DELAY_US (50000UL)
+#endif
+#define CONGESTION_RATE_STEPS (16)              //DECIMATOR_MAX_FACTOR, the rate is u8Rate / CONGESTION_RATE_STEPS of the full rate
+#define CONGESTION_MAX_BATCH (MESSAGE_IMU_SAMPLES_MAX_COUNT / MESSAGE_IMU_AXES)
+#ifndef CONGESTION_MAX_FILL_US
+#define CONGESTION_MAX_FILL_US (40000UL)        //4 samples at 100 Hz
+#endif
+
+typedef uint32_t (*congestion_clock_t)(void);   //Microseconds, wrapping
+
+typedef enum
+{
+    CONGESTION_NONE = 0,
+    CONGESTION_REFUSED,
+    CONGESTION_QUENCHED,
+    CONGESTION_ERRORS,
+    CONGESTION_DELAY,
+    CONGESTION_CAUSE_COUNT
+}congestion_cause_t;
+
+/* Counters since the start, only u32Queued and bHeld are of now */
+typedef struct
+{
+    uint32_t u32Refused;            //Messages the link had no room for
+    uint32_t u32Quenches;           //Received from routers on the way
+    uint32_t u32RxPackets;
+    uint32_t u32RxErrors;           //Packets dropped by the parser
+    uint32_t u32TxBytes;            //On the wire
+    uint32_t u32Queued;             //Bytes waiting to go
+    bool bHeld;                     //The link does not send on purpose (speed change)
+}congestion_health_t;
+
+typedef struct
+{
+    congestion_clock_t fpNowUs;
+    volatile bool bEnabled;         //Terminal, off keeps the full rate
+
+    /* Operating point, read by the terminal */
+    volatile uint8_t u8Rate;        //Steps of the full sample rate, CONGESTION_RATE_STEPS is the full rate
+
+    congestion_health_t sLast;
+    uint32_t u32PeriodStartUs;
+    uint32_t u32CutUs;              //Of the last cut
+    uint8_t u8CleanPeriods;
+    uint32_t u32DelayUs;            //Estimate of the last period
+    uint32_t u32ErrorPermille;
+
+    /* Statistics */
+    uint32_t u32Cuts;
+    uint32_t u32Steps;              //Back up
+    uint32_t au32Causes[CONGESTION_CAUSE_COUNT];
+    congestion_cause_t eLastCause;
+    uint32_t u32MaxDelayUs;
+}congestion_t;
+
+int32_t congestion_init(congestion_t *_psCongestion, congestion_clock_t _fpNowUs);
+void congestion_enable(congestion_t *_psCongestion, bool _bEnable);
+bool congestion_run(congestion_t *_psCongestion, const congestion_health_t *_psHealth);
+uint8_t congestion_getBatch(uint32_t _u32PeriodUs);
+void congestion_print(const congestion_t *_psCongestion, const char *_pcTAG);
+
+#endif /* _CONGESTION_H_ */
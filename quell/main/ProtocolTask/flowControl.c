@@ -0,0 +1,168 @@
+#include "flowControl.h"
+#include "protocol.h"
+#include "quell.h"
+#include "FIFO.h"
+
+/*
+    CREDIT BASED FLOW CONTROL
+
+    The receiver advertises an absolute byte limit: consumed + window, where consumed is every byte
+    it took from the wire (credit packets excluded) and window is its free FIFO Rx space. The sender
+    never lets its own byte count pass that limit, so FIFO Rx can not overflow whatever the baud rate.
+    Since the limit is absolute, a lost credit packet is healed by the next one.
+
+    The credit message (id, flags, consumed, window) is defined in messages.schema.
+
+    Credit packets are sent outside of the credit accounting (between packets) and the receiver keeps
+    tRxReserve bytes for them, otherwise two units out of credit could never tell each other.
+
+    A credit goes out when a quarter of the FIFO opened up, or after the period when the limit moved at
+    all. An unchanged limit is repeated FLOW_CONTROL_REPEATS times, in case the last credit got lost, and
+    then not any more: a unit whose processing stalls keeps receiving the credits of its peer into the
+    reserve, and a peer repeating itself forever would fill it up.
+*/
+
+#define FLOW_CONTROL_ADVERTISEMENT_PERIOD_MS (100UL)
+#ifndef FLOW_CONTROL_REPEATS
+#define FLOW_CONTROL_REPEATS (2)
+#endif
+
+int32_t flowControl_init(flow_control_t *_psFlowControl, size_t _tRxFIFOSize, size_t _tRxReserve)
+{
+    if(_psFlowControl == NULL || _tRxFIFOSize <= _tRxReserve + 1)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psFlowControl, 0, sizeof(flow_control_t));
+    _psFlowControl->tRxReserve = _tRxReserve;
+
+    /* Both ends start empty and run the same FIFO sizes, so the first window is known without asking */
+    _psFlowControl->u32TxLimit = _tRxFIFOSize - 1 - _tRxReserve;
+    _psFlowControl->u32RxAdvertised = _psFlowControl->u32TxLimit;
+    _psFlowControl->tMaxWindow = _psFlowControl->u32TxLimit;
+    _psFlowControl->bRxJustStarted = true;
+
+    return QUELL_OK;
+}
+
+uint16_t flowControl_getTxAllowance(flow_control_t *_psFlowControl)
+{
+    int32_t i32Allowance;
+
+    if(_psFlowControl == NULL)
+    {
+        return UINT16_MAX;
+    }
+
+    /* Apply a resync requested by the processing task, only the io task writes u32TxSent */
+    if(_psFlowControl->u32TxResyncsApplied != _psFlowControl->u32TxResyncRequests)
+    {
+        _psFlowControl->u32TxSent = _psFlowControl->u32TxResyncTo;
+        _psFlowControl->u32TxResyncsApplied = _psFlowControl->u32TxResyncRequests;
+    }
+
+    i32Allowance = (int32_t)(_psFlowControl->u32TxLimit - _psFlowControl->u32TxSent);
+    if(i32Allowance <= 0)
+    {
+        return 0;
+    }
+
+    return (i32Allowance > UINT16_MAX) ? UINT16_MAX : (uint16_t)i32Allowance;
+}
+
+void flowControl_txSent(flow_control_t *_psFlowControl, uint16_t _u16Count)
+{
+    if(_psFlowControl != NULL)
+    {
+        _psFlowControl->u32TxSent += _u16Count;
+    }
+}
+
+void flowControl_rxReceived(flow_control_t *_psFlowControl, uint16_t _u16Count)
+{
+    if(_psFlowControl != NULL)
+    {
+        _psFlowControl->u32RxReceived += _u16Count;
+    }
+}
+
+int32_t flowControl_makeCredit(flow_control_t *_psFlowControl, fifo_t *_psFIFORx, uint32_t _u32NowMs, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize)
+{
+    uint8_t au8Message[MESSAGE_CREDIT_SIZE];
+    message_credit_t sCredit;
+    uint16_t u16MessageSize;
+    uint32_t u32Consumed;
+    size_t tWindow;
+
+    if(_psFlowControl == NULL || _psFIFORx == NULL || _pu8PacketBuffer == NULL || _pu16PacketSize == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Read the counter before the free space, a byte arriving in between only makes the window smaller */
+    u32Consumed = _psFlowControl->u32RxReceived - _psFlowControl->u32RxCreditBytes;
+    if(FIFO_free(_psFIFORx, &tWindow) == false)
+    {
+        return QUELL_ERROR;
+    }
+    tWindow = (tWindow > _psFlowControl->tRxReserve) ? tWindow - _psFlowControl->tRxReserve : 0;
+
+    /* Only advertise when a quarter of the FIFO opened up, or periodically when the limit moved (or a few times over to heal a lost credit) */
+    if(_psFlowControl->bRxJustStarted == false &&
+       (u32Consumed + tWindow) - _psFlowControl->u32RxAdvertised < (_psFIFORx->size / 4) &&
+       (_u32NowMs - _psFlowControl->u32LastAdvertisementMs < FLOW_CONTROL_ADVERTISEMENT_PERIOD_MS ||
+        (u32Consumed + tWindow == _psFlowControl->u32RxAdvertised && _psFlowControl->u8RxRepeats >= FLOW_CONTROL_REPEATS)))
+    {
+        return QUELL_ERROR;
+    }
+
+    sCredit.u8Flags = (_psFlowControl->bRxJustStarted == true) ? MESSAGE_CREDIT_FLAG_RESET : 0;
+    sCredit.u32Consumed = u32Consumed;
+    sCredit.u16Window = (tWindow > UINT16_MAX) ? UINT16_MAX : tWindow;
+
+    if(messages_encodeCredit(&sCredit, au8Message, sizeof(au8Message), &u16MessageSize) == QUELL_ERROR ||
+       makePacket(_pu8PacketBuffer, _u16PacketBufferSize, au8Message, u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16PacketSize = PACKE_SIZE(u16MessageSize);
+    _psFlowControl->u8RxRepeats = (u32Consumed + tWindow == _psFlowControl->u32RxAdvertised) ? _psFlowControl->u8RxRepeats + 1 : 0;
+    _psFlowControl->u32RxAdvertised = u32Consumed + tWindow;
+    _psFlowControl->u32LastAdvertisementMs = _u32NowMs;
+    _psFlowControl->u32CreditsSent++;
+    _psFlowControl->bRxJustStarted = false;
+
+    return QUELL_OK;
+}
+
+int32_t flowControl_processMessage(flow_control_t *_psFlowControl, uint8_t *_pu8Message, uint16_t _u16MessageSize)
+{
+    message_credit_t sCredit;
+
+    if(_psFlowControl == NULL || messages_decodeCredit(&sCredit, _pu8Message, _u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* The credit packet itself took space in FIFO Rx, but the peer never counted it as sent */
+    _psFlowControl->u32RxCreditBytes += PACKE_SIZE(MESSAGE_CREDIT_SIZE);
+
+    /* The sender never passes the limit, so bytes in flight can not be negative or bigger than a window.
+       If so, one of the units restarted (the peer also says so explicitly in its first credit). A reset
+       that is the first credit heard, with the counts in line, is both units coming up together: what
+       went out already is consumed or still on its way and stays counted */
+    if(((sCredit.u8Flags & MESSAGE_CREDIT_FLAG_RESET) != 0 && _psFlowControl->u32CreditsReceived > 0) ||
+       (int32_t)(_psFlowControl->u32TxSent - sCredit.u32Consumed) < 0 || 
+       (int32_t)(_psFlowControl->u32TxSent - sCredit.u32Consumed) > (int32_t)_psFlowControl->tMaxWindow)
+    {
+        _psFlowControl->u32TxResyncTo = sCredit.u32Consumed;
+        _psFlowControl->u32TxResyncRequests++;
+    }
+
+    _psFlowControl->u32TxLimit = sCredit.u32Consumed + sCredit.u16Window;
+    _psFlowControl->u32CreditsReceived++;
+
+    return QUELL_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef _FLOW_CONTROL_H_
+#define _FLOW_CONTROL_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "FIFO.h"
+#include "messages.h"
+
+typedef struct
+{
+    /* Sender side: u32TxSent is written by the io task, u32TxLimit and the resync request by the processing task */
+    volatile uint32_t u32TxSent;        //Bytes put on the wire, credit packets excluded
+    volatile uint32_t u32TxLimit;       //Peer may receive up to this byte count
+    volatile uint32_t u32TxResyncTo;    //Value for u32TxSent after one of the units restarted
+    volatile uint32_t u32TxResyncRequests;
+    uint32_t u32TxResyncsApplied;
+
+    /* Receiver side: u32RxReceived is written by the io task, u32RxCreditBytes by the processing task */
+    volatile uint32_t u32RxReceived;    //Bytes placed in FIFO Rx
+    volatile uint32_t u32RxCreditBytes; //Part of u32RxReceived that were credit packets
+    uint32_t u32RxAdvertised;           //Last limit sent to the peer
+    uint32_t u32LastAdvertisementMs;
+    uint8_t u8RxRepeats;                //Times the last limit went out unchanged
+    bool bRxJustStarted;                //Next credit carries MESSAGE_CREDIT_FLAG_RESET
+    size_t tRxReserve;                  //FIFO Rx space kept for credit packets (they are not flow controlled)
+    size_t tMaxWindow;                  //Largest window a peer can ever advertise
+
+    /* Statistics */
+    uint32_t u32CreditsSent;
+    uint32_t u32CreditsReceived;
+}flow_control_t;
+
+int32_t flowControl_init(flow_control_t *_psFlowControl, size_t _tRxFIFOSize, size_t _tRxReserve);
+uint16_t flowControl_getTxAllowance(flow_control_t *_psFlowControl);
+void flowControl_txSent(flow_control_t *_psFlowControl, uint16_t _u16Count);
+void flowControl_rxReceived(flow_control_t *_psFlowControl, uint16_t _u16Count);
+int32_t flowControl_makeCredit(flow_control_t *_psFlowControl, fifo_t *_psFIFORx, uint32_t _u32NowMs, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize);
+int32_t flowControl_processMessage(flow_control_t *_psFlowControl, uint8_t *_pu8Message, uint16_t _u16MessageSize);
+
+#endif /* _FLOW_CONTROL_H_ */
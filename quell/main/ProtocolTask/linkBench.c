@@ -0,0 +1,429 @@
+#include "esp_log.h"
+#include "linkBench.h"
+#include "quell.h"
+
+#define LINK_BENCH_BAR_WIDTH (40)
+
+/* Two buckets per power of two: [2^n, 1.5 x 2^n) and [1.5 x 2^n, 2^(n+1)) */
+static uint8_t linkBenchBucket(uint32_t _u32Us)
+{
+    uint8_t u8Power = 0;
+    uint8_t u8Bucket;
+
+    while((_u32Us >> u8Power) > 1)
+    {
+        u8Power++;
+    }
+    u8Bucket = (uint8_t)(2 * u8Power) + ((u8Power > 0) ? (uint8_t)((_u32Us >> (u8Power - 1)) & 1) : 0);
+
+    return (u8Bucket < LINK_BENCH_BUCKETS) ? u8Bucket : LINK_BENCH_BUCKETS - 1;
+}
+
+static uint32_t linkBenchBucketFloor(uint8_t _u8Bucket)
+{
+    uint8_t u8Power = _u8Bucket / 2;
+
+    return (1UL << u8Power) + (((_u8Bucket & 1) != 0 && u8Power > 0) ? (1UL << (u8Power - 1)) : 0);
+}
+
+static void linkBenchFinish(link_bench_t *_psBench)
+{
+    _psBench->bRunning = false;
+    _psBench->bWaiting = false;
+    _psBench->u32ElapsedUs = _psBench->u32LastSentUs - _psBench->u32StartUs;
+    _psBench->bFinished = true;
+}
+
+/* Takes the run the terminal handed over, a run in progress is dropped */
+static void linkBenchStart(link_bench_t *_psBench, uint32_t _u32Now)
+{
+    if(_psBench->bPending == false)
+    {
+        return;
+    }
+
+    _psBench->sRun = _psBench->sPending;
+    _psBench->bPending = false;
+
+    _psBench->bRunning = true;
+    _psBench->bFinished = false;
+    _psBench->bWaiting = false;
+    _psBench->bReport = false;
+    _psBench->u32StartUs = _u32Now;
+    _psBench->u32NextUs = _u32Now;
+    _psBench->u32LastSentUs = _u32Now;
+    _psBench->u32Sequence = 0;
+    _psBench->u32Sent = 0;
+    _psBench->u32Pongs = 0;
+    _psBench->u32Lost = 0;
+    _psBench->u32Late = 0;
+    _psBench->u32Skipped = 0;
+    _psBench->u32RttMinUs = UINT32_MAX;
+    _psBench->u32RttMaxUs = 0;
+    _psBench->u64RttSumUs = 0;
+    memset(_psBench->au32Histogram, 0, sizeof(_psBench->au32Histogram));
+}
+
+static int32_t linkBenchEncode(uint8_t _u8Kind, uint32_t _u32Sequence, uint32_t _u32Timestamp, uint16_t _u16Size, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    message_bench_t sMessage;
+
+    sMessage.u8Kind = _u8Kind;
+    sMessage.u32Sequence = _u32Sequence;
+    sMessage.u32Timestamp = _u32Timestamp;
+    sMessage.u16PayloadCount = _u16Size - MESSAGE_BENCH_SIZE;
+
+    /* A pattern rather than zeros, so a slipped byte shows in the CRC */
+    for(uint16_t u16Index = 0; u16Index < sMessage.u16PayloadCount; u16Index++)
+    {
+        sMessage.au8Payload[u16Index] = (uint8_t)(_u32Sequence + u16Index);
+    }
+
+    return messages_encodeBench(&sMessage, _pu8Buffer, _u16BufferSize, _pu16Size);
+}
+
+int32_t linkBench_init(link_bench_t *_psBench, link_bench_clock_t _fpNowUs)
+{
+    if(_psBench == NULL || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psBench, 0, sizeof(link_bench_t));
+    _psBench->fpNowUs = _fpNowUs;
+
+    return QUELL_OK;
+}
+
+/* Terminal: the processing task starts it at its next linkBench_makeMessage */
+int32_t linkBench_request(link_bench_t *_psBench, const link_bench_request_t *_psRequest)
+{
+    if(_psBench == NULL || _psRequest == NULL || _psBench->bPending == true ||
+       _psRequest->u16Size < MESSAGE_BENCH_SIZE || _psRequest->u16Size > LINK_BENCH_MAX_SIZE ||
+       (_psRequest->eMode == LINK_BENCH_PING && _psRequest->u32Count == 0) ||
+       (_psRequest->eMode == LINK_BENCH_LOAD && (_psRequest->u32DurationUs == 0 || _psRequest->u32DurationUs > INT32_MAX)) ||
+       _psRequest->eMode > LINK_BENCH_LOAD)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psBench->sPending = *_psRequest;
+    _psBench->bPending = true;
+
+    return QUELL_OK;
+}
+
+/* Bench messages received on the link: QUELL_OK when consumed. _u8Source is where answers go, _u32RxErrors the packets the link dropped so far */
+int32_t linkBench_processMessage(link_bench_t *_psBench, const uint8_t *_pu8Message, uint16_t _u16Size, uint8_t _u8Source, uint32_t _u32RxErrors)
+{
+    message_bench_t sMessage;
+    message_bench_report_t sReport;
+    uint32_t u32Now;
+
+    if(_psBench == NULL || _pu8Message == NULL || _u16Size == 0)
+    {
+        return QUELL_ERROR;
+    }
+    u32Now = _psBench->fpNowUs();
+
+    if(messages_decodeBenchReport(&sReport, _pu8Message, _u16Size) == QUELL_OK)
+    {
+        if(_psBench->bRunning == true && _psBench->sRun.eMode == LINK_BENCH_LOAD && _psBench->bWaiting == true)
+        {
+            _psBench->sReport = sReport;
+            _psBench->bReport = true;
+            linkBenchFinish(_psBench);
+        }
+        return QUELL_OK;
+    }
+
+    if(messages_decodeBench(&sMessage, _pu8Message, _u16Size) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    switch(sMessage.u8Kind)
+    {
+        case MESSAGE_BENCH_KIND_PING:
+            /* One pong owed at a time, a ping arriving before it went replaces it (the sender times out on the first) */
+            _psBench->bPongDue = true;
+            _psBench->u8PongTo = _u8Source;
+            _psBench->u16PongSize = _u16Size;
+            _psBench->u32PongSequence = sMessage.u32Sequence;
+            _psBench->u32PongTimestamp = sMessage.u32Timestamp;
+            break;
+
+        case MESSAGE_BENCH_KIND_PONG:
+            if(_psBench->bRunning == true && _psBench->sRun.eMode == LINK_BENCH_PING && _psBench->bWaiting == true &&
+               sMessage.u32Sequence + 1 == _psBench->u32Sequence)
+            {
+                uint32_t u32Rtt = u32Now - sMessage.u32Timestamp;
+
+                _psBench->bWaiting = false;
+                _psBench->u32Pongs++;
+                _psBench->u64RttSumUs += u32Rtt;
+                _psBench->u32RttMinUs = (u32Rtt < _psBench->u32RttMinUs) ? u32Rtt : _psBench->u32RttMinUs;
+                _psBench->u32RttMaxUs = (u32Rtt > _psBench->u32RttMaxUs) ? u32Rtt : _psBench->u32RttMaxUs;
+                _psBench->au32Histogram[linkBenchBucket(u32Rtt)]++;
+            }
+            else
+            {
+                _psBench->u32Late++;
+            }
+            break;
+
+        case MESSAGE_BENCH_KIND_LOAD:
+            /* A sequence going back is a new run */
+            if(_psBench->bRxActive == false || sMessage.u32Sequence < _psBench->u32RxNext)
+            {
+                memset(&_psBench->sRx, 0, sizeof(_psBench->sRx));
+                _psBench->bRxActive = true;
+                _psBench->u32RxNext = 0;
+                _psBench->u32RxErrorsAtStart = _u32RxErrors;
+                _psBench->u32RxFirstUs = u32Now;
+            }
+            _psBench->sRx.u32Lost += sMessage.u32Sequence - _psBench->u32RxNext;
+            _psBench->sRx.u32Received++;
+            _psBench->sRx.u32Bytes += _u16Size;
+            _psBench->u32RxLastUs = u32Now;
+            _psBench->u32RxNext = sMessage.u32Sequence + 1;
+            _psBench->sRx.u32Errors = _u32RxErrors - _psBench->u32RxErrorsAtStart;
+            _psBench->sRx.u32Elapsed = _psBench->u32RxLastUs - _psBench->u32RxFirstUs;
+            break;
+
+        case MESSAGE_BENCH_KIND_LOAD_END:
+            /* Whatever did not arrive of the sequence sent is lost, a run of which nothing arrived reports zeros */
+            if(_psBench->bRxActive == false)
+            {
+                memset(&_psBench->sRx, 0, sizeof(_psBench->sRx));
+                _psBench->u32RxNext = 0;
+            }
+            _psBench->sRx.u32Lost += (sMessage.u32Sequence > _psBench->u32RxNext) ? sMessage.u32Sequence - _psBench->u32RxNext : 0;
+            _psBench->bRxActive = false;
+            _psBench->bReportDue = true;
+            _psBench->u8ReportTo = _u8Source;
+            break;
+
+        default:
+            break;
+    }
+
+    return QUELL_OK;
+}
+
+/* Processing task: the next message due (answers first), for the caller to send; _u16Room is the biggest message the lane takes now,
+   _u32Credit the byte count the peer allows so far (flow control), a new one restarts the wait for the report */
+int32_t linkBench_makeMessage(link_bench_t *_psBench, uint16_t _u16Room, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Destination, uint32_t _u32Credit)
+{
+    uint32_t u32Now;
+
+    if(_psBench == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _pu8Destination == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    u32Now = _psBench->fpNowUs();
+    linkBenchStart(_psBench, u32Now);
+
+    if(_psBench->bPongDue == true)
+    {
+        if(_psBench->u16PongSize > _u16Room ||
+           linkBenchEncode(MESSAGE_BENCH_KIND_PONG, _psBench->u32PongSequence, _psBench->u32PongTimestamp, _psBench->u16PongSize, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        *_pu8Destination = _psBench->u8PongTo;
+        _psBench->bPongDue = false;
+        return QUELL_OK;
+    }
+
+    if(_psBench->bReportDue == true)
+    {
+        if(MESSAGE_BENCH_REPORT_SIZE > _u16Room || messages_encodeBenchReport(&_psBench->sRx, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        *_pu8Destination = _psBench->u8ReportTo;
+        _psBench->bReportDue = false;
+        return QUELL_OK;
+    }
+
+    if(_psBench->bRunning == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(_psBench->bWaiting == true)
+    {
+        /* The peer still takes what was queued before the load end */
+        if(_psBench->sRun.eMode == LINK_BENCH_LOAD && _u32Credit != _psBench->u32WaitCredit)
+        {
+            _psBench->u32WaitCredit = _u32Credit;
+            _psBench->u32WaitSinceUs = u32Now;
+        }
+        if(u32Now - _psBench->u32WaitSinceUs < ((_psBench->sRun.eMode == LINK_BENCH_LOAD) ? LINK_BENCH_REPORT_TIMEOUT_US : LINK_BENCH_TIMEOUT_US))
+        {
+            return QUELL_ERROR;
+        }
+        _psBench->bWaiting = false;
+        _psBench->u32Lost++;
+
+        /* No report after the load end: done, without the receiving side */
+        if(_psBench->sRun.eMode == LINK_BENCH_LOAD)
+        {
+            linkBenchFinish(_psBench);
+            return QUELL_ERROR;
+        }
+    }
+
+    if(_psBench->sRun.eMode == LINK_BENCH_PING)
+    {
+        if(_psBench->u32Sequence == _psBench->sRun.u32Count)
+        {
+            linkBenchFinish(_psBench);
+            return QUELL_ERROR;
+        }
+        if(_psBench->sRun.u16Size > _u16Room ||
+           linkBenchEncode(MESSAGE_BENCH_KIND_PING, _psBench->u32Sequence, u32Now, _psBench->sRun.u16Size, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psBench->bWaiting = true;
+        _psBench->u32WaitSinceUs = u32Now;
+    }
+    else if(u32Now - _psBench->u32StartUs >= _psBench->sRun.u32DurationUs)
+    {
+        /* Time is up: the load end tells the receiver how many went */
+        if(MESSAGE_BENCH_SIZE > _u16Room ||
+           linkBenchEncode(MESSAGE_BENCH_KIND_LOAD_END, _psBench->u32Sequence, u32Now, MESSAGE_BENCH_SIZE, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psBench->bWaiting = true;
+        _psBench->u32WaitSinceUs = u32Now;
+        _psBench->u32WaitCredit = _u32Credit;
+        *_pu8Destination = _psBench->sRun.u8Destination;
+        return QUELL_OK;
+    }
+    else
+    {
+        if(_psBench->sRun.u32Rate > 0 && (int32_t)(u32Now - _psBench->u32NextUs) < 0)
+        {
+            return QUELL_ERROR;
+        }
+
+        /* At a rate the schedule goes on without the frames the lane had no room for */
+        if(_psBench->sRun.u32Rate > 0)
+        {
+            _psBench->u32NextUs += 1000000UL / _psBench->sRun.u32Rate;
+        }
+        if(_psBench->sRun.u16Size > _u16Room)
+        {
+            _psBench->u32Skipped += (_psBench->sRun.u32Rate > 0) ? 1 : 0;
+            return QUELL_ERROR;
+        }
+        if(linkBenchEncode(MESSAGE_BENCH_KIND_LOAD, _psBench->u32Sequence, u32Now, _psBench->sRun.u16Size, _pu8Buffer, _u16BufferSize, _pu16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    *_pu8Destination = _psBench->sRun.u8Destination;
+    _psBench->u32Sequence++;
+    _psBench->u32Sent++;
+    _psBench->u32LastSentUs = u32Now;
+
+    return QUELL_OK;
+}
+
+/* Upper edge of the histogram bucket reaching _u8Percent of the pongs (capped by the max) */
+uint32_t linkBench_getPercentileUs(const link_bench_t *_psBench, uint8_t _u8Percent)
+{
+    uint64_t u64Target;
+    uint64_t u64Count = 0;
+
+    if(_psBench == NULL || _psBench->u32Pongs == 0)
+    {
+        return 0;
+    }
+
+    u64Target = (((uint64_t)_psBench->u32Pongs * _u8Percent) + 99) / 100;
+    for(uint8_t u8Bucket = 0; u8Bucket < LINK_BENCH_BUCKETS; u8Bucket++)
+    {
+        u64Count += _psBench->au32Histogram[u8Bucket];
+        if(u64Count >= u64Target)
+        {
+            uint32_t u32Edge = (u8Bucket + 1 < LINK_BENCH_BUCKETS) ? linkBenchBucketFloor(u8Bucket + 1) : UINT32_MAX;
+            return (u32Edge < _psBench->u32RttMaxUs) ? u32Edge : _psBench->u32RttMaxUs;
+        }
+    }
+
+    return _psBench->u32RttMaxUs;
+}
+
+void linkBench_print(const link_bench_t *_psBench, const char *_pcTAG)
+{
+    const link_bench_request_t *psRun = &_psBench->sRun;
+    uint32_t u32Peak = 0;
+
+    if(_psBench->bRunning == true)
+    {
+        ESP_LOGI(_pcTAG, "bench running (%u sent)", _psBench->u32Sent);
+    }
+    else if(psRun->u16Size == 0)
+    {
+        if(_psBench->sRx.u32Received == 0 && _psBench->bRxActive == false)
+        {
+            ESP_LOGI(_pcTAG, "bench no run yet");
+        }
+    }
+    else if(psRun->eMode == LINK_BENCH_PING)
+    {
+        ESP_LOGI(_pcTAG, "ping to %u size:%u sent:%u received:%u lost:%u late:%u rtt min:%u avg:%u p99:%u max:%u us",
+                 psRun->u8Destination, psRun->u16Size, _psBench->u32Sent, _psBench->u32Pongs, _psBench->u32Lost, _psBench->u32Late,
+                 (_psBench->u32Pongs > 0) ? _psBench->u32RttMinUs : 0, (_psBench->u32Pongs > 0) ? (uint32_t)(_psBench->u64RttSumUs / _psBench->u32Pongs) : 0,
+                 linkBench_getPercentileUs(_psBench, 99), _psBench->u32RttMaxUs);
+
+        for(uint8_t u8Bucket = 0; u8Bucket < LINK_BENCH_BUCKETS; u8Bucket++)
+        {
+            u32Peak = (_psBench->au32Histogram[u8Bucket] > u32Peak) ? _psBench->au32Histogram[u8Bucket] : u32Peak;
+        }
+        for(uint8_t u8Bucket = 0; u8Bucket < LINK_BENCH_BUCKETS && u32Peak > 0; u8Bucket++)
+        {
+            char acBar[LINK_BENCH_BAR_WIDTH + 1];
+            uint32_t u32Width;
+
+            if(_psBench->au32Histogram[u8Bucket] == 0)
+            {
+                continue;
+            }
+            u32Width = ((_psBench->au32Histogram[u8Bucket] * LINK_BENCH_BAR_WIDTH) + u32Peak - 1) / u32Peak;
+            memset(acBar, '#', u32Width);
+            acBar[u32Width] = '\0';
+            ESP_LOGI(_pcTAG, "%8u us %6u %s", linkBenchBucketFloor(u8Bucket), _psBench->au32Histogram[u8Bucket], acBar);
+        }
+    }
+    else
+    {
+        ESP_LOGI(_pcTAG, "load to %u size:%u rate:%u/s sent:%u skipped:%u in %u ms (%u B/s)",
+                 psRun->u8Destination, psRun->u16Size, psRun->u32Rate, _psBench->u32Sent, _psBench->u32Skipped, _psBench->u32ElapsedUs / 1000,
+                 (_psBench->u32ElapsedUs > 0) ? (uint32_t)(((uint64_t)_psBench->u32Sent * psRun->u16Size * 1000000ULL) / _psBench->u32ElapsedUs) : 0);
+        if(_psBench->bReport == true)
+        {
+            ESP_LOGI(_pcTAG, "load receiver received:%u lost:%u crc/framing errors:%u goodput:%u B/s",
+                     _psBench->sReport.u32Received, _psBench->sReport.u32Lost, _psBench->sReport.u32Errors,
+                     (_psBench->sReport.u32Elapsed > 0) ? (uint32_t)(((uint64_t)_psBench->sReport.u32Bytes * 1000000ULL) / _psBench->sReport.u32Elapsed) : 0);
+        }
+        else
+        {
+            ESP_LOGI(_pcTAG, "load receiver did not report");
+        }
+    }
+
+    /* This unit as the receiving side */
+    if(_psBench->sRx.u32Received > 0 || _psBench->bRxActive == true)
+    {
+        ESP_LOGI(_pcTAG, "load received%s:%u lost:%u crc/framing errors:%u goodput:%u B/s", (_psBench->bRxActive == true) ? " (running)" : "",
+                 _psBench->sRx.u32Received, _psBench->sRx.u32Lost, _psBench->sRx.u32Errors,
+                 (_psBench->sRx.u32Elapsed > 0) ? (uint32_t)(((uint64_t)_psBench->sRx.u32Bytes * 1000000ULL) / _psBench->sRx.u32Elapsed) : 0);
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef _LINK_BENCH_H_
+#define _LINK_BENCH_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    LINK BENCH
+
+    Traffic to qualify a link (cable, baud rate, firmware build), run by the processing task of the
+    link on its bulk lane and answered by the peer (or by the same unit on a loopback wire):
+
+    Ping:   bench messages of the size chosen, one at a time, each answered with a pong of the same size.
+            RTT min, average, p99 and max plus a histogram (two buckets per power of two). A pong not
+            back within LINK_BENCH_TIMEOUT_US is lost and the next ping goes.
+    Load:   bench messages of the size chosen at a rate (frames per second, or as fast as the lane takes
+            them) for a while, then a load end carrying how many went. The receiver counts what arrived,
+            the sequence gaps and the packets the link dropped meanwhile (CRC, framing) and answers
+            with a bench_report, so the sender shows both sides: sent, skipped (due while the lane was
+            full), received, lost, errors and goodput. The load end leaves only after the frames queued
+            before it and is answered once the receiver took them all, so the report is waited for up to
+            LINK_BENCH_REPORT_TIMEOUT_US from the last credit the peer returned.
+
+    The terminal hands a run over with linkBench_request (written only while bPending is false), the
+    processing task starts it at its next linkBench_makeMessage and sets bFinished when it is over.
+    linkBench_makeMessage only returns the next message due, the caller puts it on the bulk lane.
+*/
+
+#define LINK_BENCH_MAX_SIZE ((uint16_t)MESSAGE_BENCH_MAX_SIZE)     //Message bytes, an addressed frame of it still fits the packet buffer (protocol.c)
+#define LINK_BENCH_TIMEOUT_US (500000UL)    //For a pong
+#define LINK_BENCH_REPORT_TIMEOUT_US (2000000UL)    //For the report after the load end, from the last credit (a receiver may stall its processing a while)
+#define LINK_BENCH_BUCKETS (48)             //RTT histogram from 1 us, two per power of two
+
+typedef uint32_t (*link_bench_clock_t)(void);  //Microseconds, wrapping
+
+typedef enum
+{
+    LINK_BENCH_PING = 0,
+    LINK_BENCH_LOAD
+}link_bench_mode_t;
+
+typedef struct
+{
+    link_bench_mode_t eMode;
+    uint8_t u8Destination;          //Addressed links only
+    uint16_t u16Size;               //Message bytes, MESSAGE_BENCH_SIZE to LINK_BENCH_MAX_SIZE
+    uint32_t u32Count;              //Ping: pings to send
+    uint32_t u32Rate;               //Load: frames per second, 0 as fast as the lane takes them
+    uint32_t u32DurationUs;         //Load
+}link_bench_request_t;
+
+typedef struct
+{
+    link_bench_clock_t fpNowUs;
+
+    /* Handoff from the terminal */
+    volatile bool bPending;
+    link_bench_request_t sPending;
+
+    /* Run in progress */
+    bool bRunning;
+    link_bench_request_t sRun;
+    uint32_t u32StartUs;
+    uint32_t u32Sequence;           //Of the next ping or load frame
+    bool bWaiting;                  //For the pong (ping) or the report (load) since u32WaitSinceUs
+    uint32_t u32WaitSinceUs;
+    uint32_t u32WaitCredit;         //Load: the peer's limit when the wait (re)started
+    uint32_t u32NextUs;             //Load: when the next frame is due at the rate
+    uint32_t u32LastSentUs;
+
+    /* Answers owed to the peer, sent by linkBench_makeMessage */
+    bool bPongDue;
+    uint8_t u8PongTo;
+    uint16_t u16PongSize;
+    uint32_t u32PongSequence;
+    uint32_t u32PongTimestamp;
+    bool bReportDue;
+    uint8_t u8ReportTo;
+
+    /* Receiving side of a load run */
+    bool bRxActive;
+    uint32_t u32RxNext;             //Sequence expected
+    uint32_t u32RxErrorsAtStart;
+    uint32_t u32RxFirstUs;
+    uint32_t u32RxLastUs;
+    message_bench_report_t sRx;     //Of the run going on, or of the last one
+
+    /* Results of the last run sent from here */
+    volatile bool bFinished;        //Set when a run ends, cleared by whoever shows it
+    uint32_t u32Sent;
+    uint32_t u32Pongs;
+    uint32_t u32Lost;               //Pongs not back in time
+    uint32_t u32Late;               //Pongs after their timeout, or unexpected
+    uint32_t u32Skipped;            //Load frames due while the lane was full
+    uint32_t u32RttMinUs;
+    uint32_t u32RttMaxUs;
+    uint64_t u64RttSumUs;
+    uint32_t au32Histogram[LINK_BENCH_BUCKETS];
+    uint32_t u32ElapsedUs;          //Load: first to last frame sent
+    bool bReport;
+    message_bench_report_t sReport; //What the receiver counted
+}link_bench_t;
+
+int32_t linkBench_init(link_bench_t *_psBench, link_bench_clock_t _fpNowUs);
+int32_t linkBench_request(link_bench_t *_psBench, const link_bench_request_t *_psRequest);
+int32_t linkBench_processMessage(link_bench_t *_psBench, const uint8_t *_pu8Message, uint16_t _u16Size, uint8_t _u8Source, uint32_t _u32RxErrors);
+int32_t linkBench_makeMessage(link_bench_t *_psBench, uint16_t _u16Room, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Destination, uint32_t _u32Credit);
+uint32_t linkBench_getPercentileUs(const link_bench_t *_psBench, uint8_t _u8Percent);
+void linkBench_print(const link_bench_t *_psBench, const char *_pcTAG);
+
+#endif /* _LINK_BENCH_H_ */
@@ -0,0 +1,575 @@
+#include "esp_log.h"
+#include "linkSpeed.h"
+#include "protocol.h"
+#include "quell.h"
+
+#define LINK_SPEED_NOTHING_OWED (UINT8_MAX)
+
+static const uint32_t au32LinkSpeedRates[LINK_SPEED_RATES] = {LINK_SPEED_BASE_BAUD, 230400UL, 460800UL, 921600UL, 2000000UL};
+static const char *apcLinkSpeedStates[] = {"steady", "proposed", "switching", "probing", "reporting"};
+
+static bool linkSpeedValid(uint32_t _u32Baud)
+{
+    for(uint8_t u8Rate = 0; u8Rate < LINK_SPEED_RATES; u8Rate++)
+    {
+        if(au32LinkSpeedRates[u8Rate] == _u32Baud)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Next rate of the ladder up to the maximum, 0 at the top */
+static uint32_t linkSpeedAbove(const link_speed_t *_psSpeed)
+{
+    for(uint8_t u8Rate = 0; u8Rate < LINK_SPEED_RATES; u8Rate++)
+    {
+        if(au32LinkSpeedRates[u8Rate] > _psSpeed->u32Baud)
+        {
+            return (au32LinkSpeedRates[u8Rate] <= _psSpeed->u32MaxBaud) ? au32LinkSpeedRates[u8Rate] : 0;
+        }
+    }
+
+    return 0;
+}
+
+static uint32_t linkSpeedBelow(uint32_t _u32Baud)
+{
+    uint32_t u32Below = LINK_SPEED_BASE_BAUD;
+
+    for(uint8_t u8Rate = 0; u8Rate < LINK_SPEED_RATES && au32LinkSpeedRates[u8Rate] < _u32Baud; u8Rate++)
+    {
+        u32Below = au32LinkSpeedRates[u8Rate];
+    }
+
+    return u32Below;
+}
+
+static void linkSpeedEnter(link_speed_t *_psSpeed, link_speed_state_t _eState, uint32_t _u32Now)
+{
+    _psSpeed->eState = _eState;
+    _psSpeed->u32SinceUs = _u32Now;
+}
+
+static void linkSpeedOwe(link_speed_t *_psSpeed, uint8_t _u8Kind, uint32_t _u32Baud)
+{
+    _psSpeed->u8Owed = _u8Kind;
+    _psSpeed->u32OwedBaud = _u32Baud;
+}
+
+/* Quiet from now on, the io task switches the uart once what is owed went out and the uart drained */
+static void linkSpeedSwitch(link_speed_t *_psSpeed, uint32_t _u32Baud, link_speed_state_t _eAfterSwitch, uint32_t _u32Now)
+{
+    _psSpeed->u32SwitchBaud = _u32Baud;
+    _psSpeed->eAfterSwitch = _eAfterSwitch;
+    linkSpeedEnter(_psSpeed, LINK_SPEED_SWITCHING, _u32Now);
+}
+
+/* A step to the rate agreed, probes of this negotiation are counted from now */
+static void linkSpeedStep(link_speed_t *_psSpeed, uint32_t _u32Baud, uint32_t _u32Now)
+{
+    _psSpeed->u16ProbesId = _psSpeed->u16Id;
+    _psSpeed->u16ProbesReceived = 0;
+    _psSpeed->u16ProbesSeen = 0;
+    _psSpeed->u32PreviousBaud = _psSpeed->u32Baud;
+    if(_u32Baud >= _psSpeed->u32CeilingBaud)
+    {
+        _psSpeed->u32CeilingBaud = 0;   //The peer proposed it, the retry is its call
+    }
+    linkSpeedSwitch(_psSpeed, _u32Baud, LINK_SPEED_PROBING, _u32Now);
+}
+
+/* _u32Baud is not tried again before LINK_SPEED_RETRY_US */
+static void linkSpeedFailed(link_speed_t *_psSpeed, uint32_t _u32Baud, uint32_t _u32Now)
+{
+    _psSpeed->u32CeilingBaud = _u32Baud;
+    _psSpeed->u32RetryAtUs = _u32Now + LINK_SPEED_RETRY_US;
+    _psSpeed->u32LastChangeUs = _u32Now;
+}
+
+/* The step did not work out: both units go back to the rate before */
+static void linkSpeedBack(link_speed_t *_psSpeed, uint32_t _u32Now)
+{
+    _psSpeed->u32Failures++;
+    linkSpeedFailed(_psSpeed, _psSpeed->u32Baud, _u32Now);
+    linkSpeedSwitch(_psSpeed, _psSpeed->u32PreviousBaud, LINK_SPEED_STEADY, _u32Now);
+}
+
+/* A proposal of the peer: accepted when it is a rate of the ladder this unit allows */
+static void linkSpeedAnswer(link_speed_t *_psSpeed, const message_speed_t *_psMessage, uint32_t _u32Now)
+{
+    _psSpeed->u16Id = _psMessage->u16Id;
+
+    /* While another link was quiet the proposal may have waited behind forwarded frames, the proposer gave up on it by now */
+    if(_psSpeed->bUnitBusy == true || _u32Now - _psSpeed->u32BusyUs < LINK_SPEED_ANSWER_US)
+    {
+        linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_REJECT, 0);
+        linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+        return;
+    }
+
+    if(linkSpeedValid(_psMessage->u32Baud) == false || _psMessage->u32Baud > _psSpeed->u32MaxBaud || _psMessage->u32Baud == _psSpeed->u32Baud)
+    {
+        linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_REJECT, _psMessage->u32Baud);
+        linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+        return;
+    }
+
+    linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_ACCEPT, _psMessage->u32Baud);
+    linkSpeedStep(_psSpeed, _psMessage->u32Baud, _u32Now);
+}
+
+static void linkSpeedSteady(link_speed_t *_psSpeed, const message_speed_t *_psMessage, uint32_t _u32RxPackets, uint32_t _u32RxErrors, uint32_t _u32Now)
+{
+    uint32_t u32Above;
+
+    if(_psMessage != NULL)
+    {
+        switch(_psMessage->u8Kind)
+        {
+            case MESSAGE_SPEED_KIND_PROPOSE:
+                linkSpeedAnswer(_psSpeed, _psMessage, _u32Now);
+                return;
+
+            case MESSAGE_SPEED_KIND_DOWN:
+                if(linkSpeedValid(_psMessage->u32Baud) == true && _psMessage->u32Baud < _psSpeed->u32Baud)
+                {
+                    _psSpeed->u32Downs++;
+                    linkSpeedFailed(_psSpeed, _psSpeed->u32Baud, _u32Now);
+                    linkSpeedSwitch(_psSpeed, _psMessage->u32Baud, LINK_SPEED_STEADY, _u32Now);
+                    return;
+                }
+                break;
+
+            case MESSAGE_SPEED_KIND_REPORT:
+                /* The peer decides on our report too, it asks again while ours did not arrive */
+                if(_psMessage->u16Id == _psSpeed->u16Id && (_psMessage->u8Flags & MESSAGE_SPEED_FLAG_HAVE_REPORT) == 0)
+                {
+                    linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_REPORT, _psSpeed->u32Baud);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if(_psSpeed->u32Baud > LINK_SPEED_BASE_BAUD && _u32Now - _psSpeed->u32LastRxUs >= LINK_SPEED_SILENCE_US)
+    {
+        /* Lost each other: the peer ends at the base rate as well */
+        _psSpeed->u32Fallbacks++;
+        linkSpeedFailed(_psSpeed, _psSpeed->u32Baud, _u32Now);
+        linkSpeedSwitch(_psSpeed, LINK_SPEED_BASE_BAUD, LINK_SPEED_STEADY, _u32Now);
+        return;
+    }
+
+    if(_u32Now - _psSpeed->u32MonitorStartUs >= LINK_SPEED_MONITOR_US)
+    {
+        uint32_t u32Packets = _u32RxPackets - _psSpeed->u32MonitorPackets;
+        uint32_t u32Errors = _u32RxErrors - _psSpeed->u32MonitorErrors;
+
+        _psSpeed->u32MonitorStartUs = _u32Now;
+        _psSpeed->u32MonitorPackets = _u32RxPackets;
+        _psSpeed->u32MonitorErrors = _u32RxErrors;
+
+        if(_psSpeed->u32Baud > LINK_SPEED_BASE_BAUD && u32Errors * 1000UL > (u32Packets + u32Errors) * LINK_SPEED_MAX_ERROR_PERMILLE)
+        {
+            _psSpeed->u32Downs++;
+            linkSpeedFailed(_psSpeed, _psSpeed->u32Baud, _u32Now);
+            linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_DOWN, linkSpeedBelow(_psSpeed->u32Baud));
+            linkSpeedSwitch(_psSpeed, linkSpeedBelow(_psSpeed->u32Baud), LINK_SPEED_STEADY, _u32Now);
+            return;
+        }
+    }
+
+    /* The terminal lowered the maximum */
+    if(_psSpeed->u32Baud > _psSpeed->u32MaxBaud)
+    {
+        linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_DOWN, _psSpeed->u32MaxBaud);
+        linkSpeedSwitch(_psSpeed, _psSpeed->u32MaxBaud, LINK_SPEED_STEADY, _u32Now);
+        return;
+    }
+
+    u32Above = linkSpeedAbove(_psSpeed);
+    if(u32Above == 0 || _psSpeed->bUnitBusy == true || _u32Now - _psSpeed->u32LastChangeUs < LINK_SPEED_STEP_US ||
+       (_psSpeed->u32CeilingBaud != 0 && u32Above >= _psSpeed->u32CeilingBaud && (int32_t)(_u32Now - _psSpeed->u32RetryAtUs) < 0))
+    {
+        return;
+    }
+
+    /* Propose the next rate, an id out of the clock and the address tells the negotiations (and the two units) apart */
+    _psSpeed->u32CeilingBaud = 0;
+    _psSpeed->u16Id = (uint16_t)((_u32Now * 2654435761UL) >> 16) ^ (uint16_t)(_psSpeed->u16Id + 1) ^ _psSpeed->u8Salt;
+    _psSpeed->u32SwitchBaud = u32Above;
+    linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_PROPOSE, u32Above);
+    linkSpeedEnter(_psSpeed, LINK_SPEED_PROPOSED, _u32Now);
+}
+
+static void linkSpeedProposed(link_speed_t *_psSpeed, const message_speed_t *_psMessage, uint32_t _u32Now)
+{
+    if(_psMessage != NULL && _psMessage->u8Kind == MESSAGE_SPEED_KIND_PROPOSE)
+    {
+        /* Both proposed: the higher id goes on, equal ones both back off */
+        _psSpeed->u32Collisions++;
+        if(_psMessage->u16Id > _psSpeed->u16Id)
+        {
+            linkSpeedAnswer(_psSpeed, _psMessage, _u32Now);
+        }
+        else if(_psMessage->u16Id == _psSpeed->u16Id)
+        {
+            _psSpeed->u32LastChangeUs = _u32Now;
+            linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+        }
+        return;
+    }
+
+    if(_psMessage != NULL && _psMessage->u16Id == _psSpeed->u16Id && _psMessage->u8Kind == MESSAGE_SPEED_KIND_ACCEPT &&
+       _psMessage->u32Baud == _psSpeed->u32SwitchBaud)
+    {
+        linkSpeedStep(_psSpeed, _psSpeed->u32SwitchBaud, _u32Now);
+        return;
+    }
+
+    if(_psMessage != NULL && _psMessage->u16Id == _psSpeed->u16Id && _psMessage->u8Kind == MESSAGE_SPEED_KIND_REJECT && _psMessage->u32Baud == 0)
+    {
+        /* Busy with another link: nothing wrong with the rate, ask again after a step time */
+        _psSpeed->u32LastChangeUs = _u32Now;
+        linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+        return;
+    }
+
+    if((_psMessage != NULL && _psMessage->u16Id == _psSpeed->u16Id && _psMessage->u8Kind == MESSAGE_SPEED_KIND_REJECT) ||
+       _u32Now - _psSpeed->u32SinceUs >= LINK_SPEED_ANSWER_US)
+    {
+        /* Rejected, or a peer that does not negotiate */
+        linkSpeedFailed(_psSpeed, _psSpeed->u32SwitchBaud, _u32Now);
+        linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+    }
+}
+
+static void linkSpeedProbing(link_speed_t *_psSpeed, const message_speed_t *_psMessage, uint32_t _u32Now)
+{
+    /* A report can beat the end of our own probes */
+    if(_psMessage != NULL && _psMessage->u8Kind == MESSAGE_SPEED_KIND_REPORT && _psMessage->u16Id == _psSpeed->u16Id)
+    {
+        _psSpeed->u16PeerProbes = _psMessage->u16Count;
+        _psSpeed->bPeerReport = true;
+        if((_psMessage->u8Flags & MESSAGE_SPEED_FLAG_HAVE_REPORT) == 0 && _psSpeed->bReportSent == true)
+        {
+            linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_REPORT, _psSpeed->u32Baud);
+        }
+    }
+
+    /* Probes that can not go (no credit from a peer that is not there) time out as a missing report does */
+    if(_psSpeed->eState == LINK_SPEED_PROBING)
+    {
+        if(_psSpeed->u16ProbesSent >= LINK_SPEED_PROBES)
+        {
+            linkSpeedEnter(_psSpeed, LINK_SPEED_REPORTING, _u32Now);
+        }
+        else if(_u32Now - _psSpeed->u32SinceUs >= LINK_SPEED_PROBING_US)
+        {
+            linkSpeedBack(_psSpeed, _u32Now);
+        }
+        return;
+    }
+
+    /* Reporting: ours once the peer's probes all arrived (or stopped coming), again while the peer's report is missing */
+    if(_psSpeed->u16ProbesReceived != _psSpeed->u16ProbesSeen)
+    {
+        _psSpeed->u16ProbesSeen = _psSpeed->u16ProbesReceived;
+        _psSpeed->u32LastProbeUs = _u32Now;
+    }
+    if(_psSpeed->u8Owed == LINK_SPEED_NOTHING_OWED &&
+       (_psSpeed->u16ProbesReceived >= LINK_SPEED_PROBES ||
+        (_u32Now - _psSpeed->u32SinceUs >= LINK_SPEED_REPORT_WAIT_US && _u32Now - _psSpeed->u32LastProbeUs >= LINK_SPEED_REPORT_WAIT_US)) &&
+       (_psSpeed->bReportSent == false || (_psSpeed->bPeerReport == false && _u32Now - _psSpeed->u32ReportSentUs >= LINK_SPEED_REPORT_RETRY_US)))
+    {
+        linkSpeedOwe(_psSpeed, MESSAGE_SPEED_KIND_REPORT, _psSpeed->u32Baud);
+    }
+
+    if(_psSpeed->bPeerReport == true && _psSpeed->bReportSent == true && _psSpeed->u8Owed == LINK_SPEED_NOTHING_OWED)
+    {
+        /* Both units decide on the same two counts */
+        if(LINK_SPEED_PROBES - _psSpeed->u16PeerProbes <= LINK_SPEED_MAX_PROBES_LOST &&
+           LINK_SPEED_PROBES - _psSpeed->u16ProbesCounted <= LINK_SPEED_MAX_PROBES_LOST)
+        {
+            _psSpeed->u32StepsUp++;
+            _psSpeed->u32LastChangeUs = _u32Now;
+            linkSpeedEnter(_psSpeed, LINK_SPEED_STEADY, _u32Now);
+        }
+        else
+        {
+            linkSpeedBack(_psSpeed, _u32Now);
+        }
+        return;
+    }
+
+    if(_u32Now - _psSpeed->u32SinceUs >= LINK_SPEED_ANSWER_US)
+    {
+        linkSpeedBack(_psSpeed, _u32Now);
+    }
+}
+
+int32_t linkSpeed_init(link_speed_t *_psSpeed, uint32_t _u32MaxBaud, uint8_t _u8Salt, link_speed_clock_t _fpNowUs)
+{
+    if(_psSpeed == NULL || _fpNowUs == NULL || linkSpeedValid(_u32MaxBaud) == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psSpeed, 0, sizeof(link_speed_t));
+    _psSpeed->fpNowUs = _fpNowUs;
+    _psSpeed->u8Salt = _u8Salt;
+    _psSpeed->u32MaxBaud = _u32MaxBaud;
+    _psSpeed->u32Baud = LINK_SPEED_BASE_BAUD;
+    _psSpeed->u8Owed = LINK_SPEED_NOTHING_OWED;
+    _psSpeed->u32LastChangeUs = _fpNowUs();
+    _psSpeed->u32MonitorStartUs = _psSpeed->u32LastChangeUs;
+    _psSpeed->u32SwitchedUs = _psSpeed->u32LastChangeUs - LINK_SPEED_SETTLE_US;
+    _psSpeed->u32BusyUs = _psSpeed->u32LastChangeUs - LINK_SPEED_ANSWER_US;
+
+    return QUELL_OK;
+}
+
+/* Terminal: a rate of the ladder, the link steps up to it (or goes down to it) by itself */
+int32_t linkSpeed_setMaximum(link_speed_t *_psSpeed, uint32_t _u32MaxBaud)
+{
+    if(_psSpeed == NULL || linkSpeedValid(_u32MaxBaud) == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psSpeed->u32MaxBaud = _u32MaxBaud;
+
+    return QUELL_OK;
+}
+
+/* io task, every pass: _u32RxPackets and _u32RxErrors are the counters of the link (processing task) */
+void linkSpeed_run(link_speed_t *_psSpeed, uint32_t _u32RxPackets, uint32_t _u32RxErrors)
+{
+    message_speed_t sMessage;
+    const message_speed_t *psMessage = NULL;
+    uint32_t u32Now;
+
+    if(_psSpeed == NULL)
+    {
+        return;
+    }
+    u32Now = _psSpeed->fpNowUs();
+
+    if(_u32RxPackets != _psSpeed->u32RxPackets)
+    {
+        _psSpeed->u32RxPackets = _u32RxPackets;
+        _psSpeed->u32LastRxUs = u32Now;
+    }
+
+    if(_psSpeed->u8PendingOut != _psSpeed->u8PendingIn)
+    {
+        sMessage = _psSpeed->asPending[_psSpeed->u8PendingOut % LINK_SPEED_PENDING];
+        psMessage = &sMessage;
+        _psSpeed->u8PendingOut++;
+    }
+
+    /* The error monitor only counts steady time, a switch garbles what is in flight */
+    if(_psSpeed->eState != LINK_SPEED_STEADY || u32Now - _psSpeed->u32SwitchedUs < LINK_SPEED_SETTLE_US)
+    {
+        _psSpeed->u32MonitorStartUs = u32Now;
+        _psSpeed->u32MonitorPackets = _u32RxPackets;
+        _psSpeed->u32MonitorErrors = _u32RxErrors;
+    }
+
+    switch(_psSpeed->eState)
+    {
+        case LINK_SPEED_STEADY:
+            linkSpeedSteady(_psSpeed, psMessage, _u32RxPackets, _u32RxErrors, u32Now);
+            break;
+
+        case LINK_SPEED_PROPOSED:
+            linkSpeedProposed(_psSpeed, psMessage, u32Now);
+            break;
+
+        case LINK_SPEED_PROBING:
+        case LINK_SPEED_REPORTING:
+            linkSpeedProbing(_psSpeed, psMessage, u32Now);
+            break;
+
+        case LINK_SPEED_SWITCHING:
+            /* What is owed needs credit of a peer that may not listen at this rate any more, the switch does not wait for it forever */
+            if(_psSpeed->u8Owed != LINK_SPEED_NOTHING_OWED && u32Now - _psSpeed->u32SinceUs >= LINK_SPEED_ANSWER_US)
+            {
+                _psSpeed->u8Owed = LINK_SPEED_NOTHING_OWED;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* From the agreement until the switch settled: nothing but speed messages, credits included (a proposal waits for an accept that needs credit) */
+bool linkSpeed_isSwitching(const link_speed_t *_psSpeed)
+{
+    return _psSpeed != NULL && (_psSpeed->eState == LINK_SPEED_SWITCHING || _psSpeed->fpNowUs() - _psSpeed->u32SwitchedUs < LINK_SPEED_SETTLE_US);
+}
+
+/* io task: another link of the unit is quiet (linkSpeed_isQuiet of it), this one waits with its own steps */
+void linkSpeed_setUnitBusy(link_speed_t *_psSpeed, bool _bBusy)
+{
+    if(_psSpeed != NULL)
+    {
+        _psSpeed->bUnitBusy = _bBusy;
+        if(_bBusy == true)
+        {
+            _psSpeed->u32BusyUs = _psSpeed->fpNowUs();
+        }
+    }
+}
+
+/* No new frames from the lanes from the proposal on (the peer switches as soon as it accepted) until the own probes went */
+bool linkSpeed_isQuiet(const link_speed_t *_psSpeed)
+{
+    return linkSpeed_isSwitching(_psSpeed) == true ||
+           (_psSpeed != NULL && (_psSpeed->eState == LINK_SPEED_PROPOSED || _psSpeed->eState == LINK_SPEED_PROBING));
+}
+
+/* io task: the next speed packet due (owed answers, probes, keepalives), the caller pays its credit */
+int32_t linkSpeed_makePacket(link_speed_t *_psSpeed, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize)
+{
+    uint8_t au8Message[LINK_SPEED_PROBE_SIZE];
+    message_speed_t sMessage;
+    uint16_t u16MessageSize;
+    uint32_t u32Now;
+
+    if(_psSpeed == NULL || _pu8PacketBuffer == NULL || _pu16PacketSize == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    u32Now = _psSpeed->fpNowUs();
+
+    memset(&sMessage, 0, sizeof(sMessage));
+    sMessage.u16Id = _psSpeed->u16Id;
+    sMessage.u32Baud = _psSpeed->u32Baud;
+
+    if(_psSpeed->eState == LINK_SPEED_PROBING && _psSpeed->u16ProbesSent < LINK_SPEED_PROBES &&
+       u32Now - _psSpeed->u32SwitchedUs >= LINK_SPEED_SETTLE_US && u32Now - _psSpeed->u32LastSentUs >= LINK_SPEED_PROBE_GAP_US)
+    {
+        sMessage.u8Kind = MESSAGE_SPEED_KIND_PROBE;
+        sMessage.u16Count = _psSpeed->u16ProbesSent;
+        sMessage.u16PayloadCount = LINK_SPEED_PROBE_SIZE - MESSAGE_SPEED_SIZE;
+
+        /* Alternating bits and runs, the patterns a marginal line gets wrong first */
+        for(uint16_t u16Index = 0; u16Index < sMessage.u16PayloadCount; u16Index++)
+        {
+            sMessage.au8Payload[u16Index] = ((u16Index & 2) != 0) ? 0x55 : (uint8_t)(0xFF << (u16Index & 7));
+        }
+    }
+    else if(_psSpeed->u8Owed != LINK_SPEED_NOTHING_OWED)
+    {
+        sMessage.u8Kind = _psSpeed->u8Owed;
+        sMessage.u32Baud = _psSpeed->u32OwedBaud;
+        if(sMessage.u8Kind == MESSAGE_SPEED_KIND_REPORT)
+        {
+            /* The count is frozen by the first report, resends carry the same one the peer may decide on */
+            if(_psSpeed->bReportSent == false)
+            {
+                _psSpeed->u16ProbesCounted = _psSpeed->u16ProbesReceived;
+            }
+            sMessage.u16Count = _psSpeed->u16ProbesCounted;
+            sMessage.u8Flags = (_psSpeed->bPeerReport == true) ? MESSAGE_SPEED_FLAG_HAVE_REPORT : 0;
+            _psSpeed->bReportSent = true;
+            _psSpeed->u32ReportSentUs = u32Now;
+        }
+        _psSpeed->u8Owed = LINK_SPEED_NOTHING_OWED;
+    }
+    else if(_psSpeed->eState <= LINK_SPEED_PROPOSED && _psSpeed->u32Baud > LINK_SPEED_BASE_BAUD &&
+            u32Now - _psSpeed->u32LastSentUs >= LINK_SPEED_KEEPALIVE_US)
+    {
+        sMessage.u8Kind = MESSAGE_SPEED_KIND_KEEPALIVE;
+    }
+    else
+    {
+        return QUELL_ERROR;
+    }
+
+    if(messages_encodeSpeed(&sMessage, au8Message, sizeof(au8Message), &u16MessageSize) == QUELL_ERROR ||
+       makePacket(_pu8PacketBuffer, _u16PacketBufferSize, au8Message, u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16PacketSize = PACKE_SIZE(u16MessageSize);
+    _psSpeed->u32LastSentUs = u32Now;
+    _psSpeed->u16ProbesSent += (sMessage.u8Kind == MESSAGE_SPEED_KIND_PROBE) ? 1 : 0;
+
+    return QUELL_OK;
+}
+
+/* io task: QUELL_OK with the rate to switch the uart to, once nothing is owed at the current one */
+int32_t linkSpeed_getSwitch(const link_speed_t *_psSpeed, uint32_t *_pu32Baud)
+{
+    if(_psSpeed == NULL || _pu32Baud == NULL || _psSpeed->eState != LINK_SPEED_SWITCHING || _psSpeed->u8Owed != LINK_SPEED_NOTHING_OWED)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu32Baud = _psSpeed->u32SwitchBaud;
+
+    return QUELL_OK;
+}
+
+/* io task: the uart runs at the rate of linkSpeed_getSwitch now */
+void linkSpeed_switched(link_speed_t *_psSpeed)
+{
+    uint32_t u32Now = _psSpeed->fpNowUs();
+
+    _psSpeed->u32Baud = _psSpeed->u32SwitchBaud;
+    _psSpeed->u32LastRxUs = u32Now;
+    _psSpeed->u32LastChangeUs = u32Now;
+    _psSpeed->u32SwitchedUs = u32Now;
+    _psSpeed->u16ProbesSent = 0;
+    _psSpeed->bPeerReport = false;
+    _psSpeed->bReportSent = false;
+    linkSpeedEnter(_psSpeed, _psSpeed->eAfterSwitch, u32Now);
+}
+
+/* Processing task: speed messages received, QUELL_OK when consumed */
+int32_t linkSpeed_processMessage(link_speed_t *_psSpeed, uint8_t *_pu8Message, uint16_t _u16MessageSize)
+{
+    message_speed_t sMessage;
+
+    if(_psSpeed == NULL || messages_decodeSpeed(&sMessage, _pu8Message, _u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Probes are only counted, keepalives only had to arrive. A message while LINK_SPEED_PENDING were not taken is lost, as on the wire */
+    if(sMessage.u8Kind == MESSAGE_SPEED_KIND_PROBE)
+    {
+        if(sMessage.u16Id == _psSpeed->u16ProbesId)
+        {
+            _psSpeed->u16ProbesReceived++;
+        }
+    }
+    else if(sMessage.u8Kind != MESSAGE_SPEED_KIND_KEEPALIVE && (uint8_t)(_psSpeed->u8PendingIn - _psSpeed->u8PendingOut) < LINK_SPEED_PENDING)
+    {
+        _psSpeed->asPending[_psSpeed->u8PendingIn % LINK_SPEED_PENDING] = sMessage;
+        _psSpeed->u8PendingIn++;
+    }
+
+    return QUELL_OK;
+}
+
+void linkSpeed_print(const link_speed_t *_psSpeed, const char *_pcTAG)
+{
+    ESP_LOGI(_pcTAG, "speed %u baud (max %u) %s steps up:%u failed:%u downs:%u fallbacks:%u collisions:%u",
+             _psSpeed->u32Baud, _psSpeed->u32MaxBaud, apcLinkSpeedStates[_psSpeed->eState],
+             _psSpeed->u32StepsUp, _psSpeed->u32Failures, _psSpeed->u32Downs, _psSpeed->u32Fallbacks, _psSpeed->u32Collisions);
+    if(_psSpeed->u32CeilingBaud != 0)
+    {
+        ESP_LOGI(_pcTAG, "speed %u baud failed, tried again in %d s", _psSpeed->u32CeilingBaud,
+                 (int32_t)(_psSpeed->u32RetryAtUs - _psSpeed->fpNowUs()) / 1000000);
+    }
+}
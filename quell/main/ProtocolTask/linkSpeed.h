@@ -0,0 +1,146 @@
+#ifndef _LINK_SPEED_H_
+#define _LINK_SPEED_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    LINK SPEED (point to point links)
+
+    Both units start at the base rate, which always works. A unit steps up one rate of the ladder at a
+    time: it proposes the next rate and goes quiet (no new frames from the lanes), the peer accepts and
+    goes quiet too, both let the uart drain and switch. At the new rate each sends LINK_SPEED_PROBES
+    probes (64 byte speed messages) and reports how many of the peer's it received; the lanes resume once
+    the own probes went. After any switch nothing is sent for LINK_SPEED_SETTLE_US, the peer may switch a
+    frame later. Both decide from the same two counts: the
+    rate is kept when neither side lost more than LINK_SPEED_MAX_PROBES_LOST, otherwise both go back to
+    the rate before and that rate waits LINK_SPEED_RETRY_US before being tried again. Stepping goes on
+    until the top of the ladder, the maximum set (terminal "speed") or a rate that fails.
+
+    PROPOSE ->  <- ACCEPT   quiet, drain, switch   PROBE x N <->   REPORT <->   keep or go back
+
+    Above the base rate both units send a keepalive every LINK_SPEED_KEEPALIVE_US, and:
+    - packets dropped by the parser (CRC, framing) above LINK_SPEED_MAX_ERROR_PERMILLE of a monitor
+      period: the unit tells the peer to go down one rate (DOWN) and goes itself;
+    - nothing valid received for LINK_SPEED_SILENCE_US (the units lost each other, a report or a DOWN
+      got lost): the unit falls back to the base rate, where the peer ends as well.
+
+    Any negotiation step that gets no answer times out into the rate both had before, so the units never
+    need more than the base rate to find each other again. Both units may propose at once: the higher id
+    wins and the other answers it. A unit in the middle of a chain negotiates one link at a time (the
+    frames it forwards would back up behind a quiet link): while another of its links is quiet it does
+    not step up and answers proposals busy (a reject of baud 0), the proposer asks again later. So are
+    proposals up to LINK_SPEED_ANSWER_US after: they may have waited behind the forwarded frames long
+    enough for the proposer to give up.
+
+    Speed messages are made and acted on by the io task (it owns the uart and the switch), within the
+    peer credit like any frame; the credits themselves pause from the switch until it settled. The
+    processing task hands what it received over through asPending (a proposal and the answer to ours may
+    come in together) and counts the probes. The credit byte counts go on across a switch: the unit switching first is quiet
+    until the other one switched too, so only bytes the other one sent before its switch (credits) can
+    cross the change. They arrive garbled but counted, the peer then sees more consumed than it sent and
+    takes the receiver's count (flowControl.c).
+*/
+
+#define LINK_SPEED_BASE_BAUD (115200UL)
+#define LINK_SPEED_RATES (5)                    //Ladder: 115200, 230400, 460800, 921600, 2000000
+#define LINK_SPEED_PROBES (32)
+#define LINK_SPEED_PROBE_SIZE (64U)             //Message bytes
+#define LINK_SPEED_MAX_PROBES_LOST (1)          //Per direction
+#define LINK_SPEED_PROBE_GAP_US (1000UL)        //Between probes, the peer parses them as they come
+#define LINK_SPEED_SETTLE_US (30000UL)          //After a switch before anything is sent: the peer may finish a frame first (22 ms at the base rate)
+#define LINK_SPEED_REPORT_WAIT_US (50000UL)     //After our probes, for the peer's still on the way (since the last one)
+#define LINK_SPEED_ANSWER_US (200000UL)         //For the accept, and for the report after the probes
+#define LINK_SPEED_PROBING_US (2 * LINK_SPEED_ANSWER_US)   //For the own probes to go, the peer switches when the accept arrives
+#define LINK_SPEED_REPORT_RETRY_US (30000UL)
+#define LINK_SPEED_KEEPALIVE_US (100000UL)
+#define LINK_SPEED_SILENCE_US (1000000UL)
+#define LINK_SPEED_MONITOR_US (1000000UL)
+#define LINK_SPEED_MAX_ERROR_PERMILLE (20UL)
+#define LINK_SPEED_STEP_US (500000UL)           //Between a rate change and the next step up
+#define LINK_SPEED_PENDING (4)                  //Messages received and not acted on yet, a power of two
+#ifndef LINK_SPEED_RETRY_US
+#define LINK_SPEED_RETRY_US (60000000UL)        //Before a rate that failed (or a peer that did not answer) is tried again
+#endif
+
+typedef uint32_t (*link_speed_clock_t)(void);  //Microseconds, wrapping
+
+typedef enum
+{
+    LINK_SPEED_STEADY = 0,
+    LINK_SPEED_PROPOSED,            //Quiet, waiting for the accept
+    LINK_SPEED_SWITCHING,           //Quiet until the io task switched the uart to u32SwitchBaud
+    LINK_SPEED_PROBING,             //At the new rate: settle, then the probes
+    LINK_SPEED_REPORTING            //Probes sent, reports going both ways
+}link_speed_state_t;
+
+typedef struct
+{
+    link_speed_clock_t fpNowUs;
+    uint8_t u8Salt;                 //Address of the unit, keeps the ids of two units proposing at once apart
+    volatile uint32_t u32MaxBaud;   //Terminal: top of the ladder to step up to, LINK_SPEED_BASE_BAUD stays there
+    bool bUnitBusy;                 //Another link of the unit is quiet (linkSpeed_setUnitBusy)
+    uint32_t u32BusyUs;             //When it last was
+
+    /* io task */
+    volatile link_speed_state_t eState;     //Read by the io tasks of the other links (linkSpeed_isQuiet)
+    volatile uint32_t u32Baud;      //The uart runs at it
+    uint32_t u32PreviousBaud;       //Where a failed step goes back to
+    uint32_t u32SwitchBaud;
+    link_speed_state_t eAfterSwitch;
+    uint32_t u32SinceUs;            //Of the current state
+    uint16_t u16Id;                 //Of the negotiation going on
+    uint32_t u32CeilingBaud;        //Failed, not tried again before u32RetryAtUs
+    uint32_t u32RetryAtUs;
+    uint32_t u32LastChangeUs;
+    uint32_t u32SwitchedUs;         //Quiet until LINK_SPEED_SETTLE_US after it
+    uint32_t u32LastSentUs;
+    uint32_t u32LastRxUs;
+    uint32_t u32RxPackets;
+    uint32_t u32MonitorStartUs;
+    uint32_t u32MonitorPackets;
+    uint32_t u32MonitorErrors;
+    uint16_t u16ProbesSent;
+    uint16_t u16ProbesCounted;      //Of the peer's we received, as our report said
+    uint16_t u16ProbesSeen;         //u16ProbesReceived when it last changed, at u32LastProbeUs
+    uint32_t u32LastProbeUs;
+    uint16_t u16PeerProbes;         //Of ours the peer received, from its report
+    bool bPeerReport;
+    bool bReportSent;
+    uint32_t u32ReportSentUs;
+
+    /* Messages owed to the peer */
+    uint8_t u8Owed;                 //MESSAGE_SPEED_KIND_xxx, UINT8_MAX for none
+    uint32_t u32OwedBaud;
+
+    /* Handoff from the processing task: asPending[u8PendingIn] written by it, taken by the io task up to u8PendingIn */
+    message_speed_t asPending[LINK_SPEED_PENDING];
+    volatile uint8_t u8PendingIn;
+    volatile uint8_t u8PendingOut;
+    volatile uint16_t u16ProbesId;  //Probes of this negotiation are counted (set by the io task)
+    volatile uint16_t u16ProbesReceived;
+
+    /* Statistics */
+    uint32_t u32StepsUp;
+    uint32_t u32Failures;           //Steps that went back
+    uint32_t u32Downs;              //Errors rose
+    uint32_t u32Fallbacks;          //Silence, back to the base rate
+    uint32_t u32Collisions;         //Both units proposed
+}link_speed_t;
+
+int32_t linkSpeed_init(link_speed_t *_psSpeed, uint32_t _u32MaxBaud, uint8_t _u8Salt, link_speed_clock_t _fpNowUs);
+int32_t linkSpeed_setMaximum(link_speed_t *_psSpeed, uint32_t _u32MaxBaud);
+void linkSpeed_run(link_speed_t *_psSpeed, uint32_t _u32RxPackets, uint32_t _u32RxErrors);
+bool linkSpeed_isQuiet(const link_speed_t *_psSpeed);
+bool linkSpeed_isSwitching(const link_speed_t *_psSpeed);
+void linkSpeed_setUnitBusy(link_speed_t *_psSpeed, bool _bBusy);
+int32_t linkSpeed_makePacket(link_speed_t *_psSpeed, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize);
+int32_t linkSpeed_getSwitch(const link_speed_t *_psSpeed, uint32_t *_pu32Baud);
+void linkSpeed_switched(link_speed_t *_psSpeed);
+int32_t linkSpeed_processMessage(link_speed_t *_psSpeed, uint8_t *_pu8Message, uint16_t _u16MessageSize);
+void linkSpeed_print(const link_speed_t *_psSpeed, const char *_pcTAG);
+
+#endif /* _LINK_SPEED_H_ */
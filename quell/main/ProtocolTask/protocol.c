@@ -4,15 +4,16 @@
 #include "esp_log.h"
 #include "crc.h"
 
-#define SOH 1
-#define SOT 2
-#define EOT 3
-
 #define MESSAGE_MARCO "marco"
 #define MESSAGE_POLO "polo"
 #define MESSAGE_OK  "ok"
 #define MESSAGE_ERROR "error"
 
+#define PROTOCOL_PACKET_BUFFER_SIZE (256)
+
+/* Any schema message fits the packet and message buffers as an addressed frame (bus, chain), with the terminator extractMessageFromPacket adds */
+_Static_assert(ADDRESSED_SIZE(PACKE_SIZE(MESSAGES_MAX_SIZE)) < PROTOCOL_PACKET_BUFFER_SIZE, "messages.schema max_size does not fit PROTOCOL_PACKET_BUFFER_SIZE as an addressed frame");
+
 
 int32_t calculatePacketCRC16(uint16_t *_pu16CRC16, uint8_t *_pu8Packet, uint16_t _u16PacketSize)
 {
@@ -39,6 +40,20 @@ int32_t calculatePacketCRC16(uint16_t *_pu16CRC16, uint8_t *_pu8Packet, uint16_t
     Message                 Variable            Message content                 NO
     EOT                     u8                  End of Text                     0x03
     CRC16                   u16                 CRC16 of header + message       NO
+
+    ADDRESSED FRAME (multi-drop bus and chains, in front of the packet above)
+
+    FRAME ITEM:             LENGTH:             DESCRIPTION:                    CONST VALUE:
+    SOA                     u8                  Start of addressed frame        0x0E
+    Destination             u8                  ADDRESS_BROADCAST for all       NO
+    Source                  u8                  Sender address                  NO
+    Header CRC8             u8                  CRC8 of the two addresses and   NO
+                                                the packet size (u16)
+    Packet                  Variable            As above, from SOH              NO
+
+    The header CRC8 makes the addresses and the length trustworthy before the packet is complete, a unit
+    skips the frames of others (or cuts them through to the next link, see router.h) without looking at
+    their CRC16.
 */
 int32_t verifyPacket(uint8_t *_pu8Packet, uint16_t _u16PacketSize)
 {
@@ -78,6 +93,24 @@ int32_t verifyPacket(uint8_t *_pu8Packet, uint16_t _u16PacketSize)
 }
 
 
+/* The first 7 bytes of an addressed frame: SOA, addresses, CRC8 and the SOH and size of the packet */
+int32_t verifyAddressHeader(const uint8_t *_pu8Header)
+{
+    uint8_t au8Covered[4];
+
+    if(_pu8Header == NULL || _pu8Header[0] != SOA || _pu8Header[ADDRESS_HEADER_SIZE] != SOH)
+    {
+        return QUELL_ERROR;
+    }
+
+    au8Covered[0] = _pu8Header[1];
+    au8Covered[1] = _pu8Header[2];
+    au8Covered[2] = _pu8Header[ADDRESS_HEADER_SIZE + 1];
+    au8Covered[3] = _pu8Header[ADDRESS_HEADER_SIZE + 2];
+
+    return (calculateCRC8(au8Covered, sizeof(au8Covered)) == _pu8Header[3]) ? QUELL_OK : QUELL_ERROR;
+}
+
 int32_t extractMessageFromPacket(uint8_t *_pu8Packet, uint16_t _u16PacketSize, uint8_t *_pu8Message, uint16_t *_pu16MessageSize)
 {
     if(_pu8Packet == NULL || _u16PacketSize == 0 || _pu8Message == NULL || _pu16MessageSize == NULL)
@@ -113,7 +146,7 @@ int32_t trimFIFOForPacket(fifo_t *_psFIFORx)
 
     while(FIFO_count(_psFIFORx, &tFIFOCount) == true && tFIFOCount > 0)
     {
-        if(FIFO_peak(_psFIFORx, 0, &cData) == true && cData == SOH)
+        if(FIFO_peak(_psFIFORx, 0, &cData) == true && (cData == SOH || cData == FEC_SOF || cData == SOA))
         {
             break;
         }
@@ -129,7 +162,125 @@ int32_t trimFIFOForPacket(fifo_t *_psFIFORx)
 
     return QUELL_OK;
 }
-int32_t getPacketFromFIFO(fifo_t *_psFIFORx, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16PacketSize)
+
+/*
+    Takes a FEC frame from the FIFO Rx and repairs it into the packet it carries. A size that can not be
+    repaired (or does not fit) only drops the start byte, so the search for the next packet resumes right
+    after it. A frame with too many errors is consumed and counted.
+*/
+static int32_t getFECFrameFromFIFO(fifo_t *_psFIFORx, protocol_link_t *_psLink, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16PacketSize)
+{
+    char cData;
+    size_t tCount = 0;
+    uint16_t u16SizeCode = 0;
+    uint16_t u16PacketSize;
+    uint16_t u16FrameSize;
+    uint16_t u16Corrected;
+    bool bSizeCorrected;
+
+    if(FIFO_count(_psFIFORx, &tCount) == false || tCount < FEC_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    FIFO_peak(_psFIFORx, 1, &cData);
+    u16SizeCode = ((uint16_t)cData) << 8;
+    FIFO_peak(_psFIFORx, 2, &cData);
+    u16SizeCode |= ((uint16_t)cData) & 0xFF;
+
+    if(fec_decodeSECDED(u16SizeCode, &u16PacketSize, &bSizeCorrected) == QUELL_ERROR ||
+       u16PacketSize < MINIMUM_PACKET_SIZE || FEC_ENCODED_SIZE(u16PacketSize) > _u16BufferSize)
+    {
+        FIFO_get(_psFIFORx, &cData);
+        return QUELL_ERROR;
+    }
+
+    /* Not a full frame yet */
+    u16FrameSize = FEC_ENCODED_SIZE(u16PacketSize);
+    if(tCount < u16FrameSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < u16FrameSize; u16Index++)
+    {
+        if(FIFO_get(_psFIFORx, (char*)&_pu8Buffer[u16Index]) == false)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    if(_psLink != NULL)
+    {
+        _psLink->u32RxFECFrames++;
+    }
+
+    /* Repair in place, the packet ends up at the start of the buffer */
+    if(fec_decodeFrame(_pu8Buffer, u16FrameSize, &u16PacketSize, &u16Corrected) == QUELL_ERROR)
+    {
+        if(_psLink != NULL)
+        {
+            _psLink->u32RxFECFailures++;
+        }
+        return QUELL_ERROR;
+    }
+
+    if(_psLink != NULL)
+    {
+        _psLink->u32RxFECCorrected += u16Corrected;
+    }
+
+    *_pu16PacketSize = u16PacketSize;
+
+    return QUELL_OK;
+}
+
+/*
+    Takes a whole addressed frame (header and packet) from the FIFO Rx once its header checks out, a
+    header that does not only drops the start byte. The destination is left for the caller to look at.
+*/
+static int32_t getAddressedFrameFromFIFO(fifo_t *_psFIFORx, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16FrameSize)
+{
+    char cData;
+    size_t tCount = 0;
+    uint16_t u16FrameSize;
+
+    if(FIFO_count(_psFIFORx, &tCount) == false || tCount < ADDRESSED_SIZE(3))
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < ADDRESSED_SIZE(3); u16Index++)
+    {
+        FIFO_peak(_psFIFORx, u16Index, (char*)&_pu8Buffer[u16Index]);
+    }
+
+    u16FrameSize = ADDRESSED_SIZE(((uint16_t)_pu8Buffer[ADDRESS_HEADER_SIZE + 1] << 8) | _pu8Buffer[ADDRESS_HEADER_SIZE + 2]);
+    if(verifyAddressHeader(_pu8Buffer) == QUELL_ERROR || u16FrameSize < ADDRESSED_SIZE(MINIMUM_PACKET_SIZE) || u16FrameSize > _u16BufferSize)
+    {
+        FIFO_get(_psFIFORx, &cData);
+        return QUELL_ERROR;
+    }
+
+    /* Not a full frame yet */
+    if(tCount < u16FrameSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < u16FrameSize; u16Index++)
+    {
+        if(FIFO_get(_psFIFORx, (char*)&_pu8Buffer[u16Index]) == false)
+        {
+            return QUELL_ERROR;
+        }
+    }
+    *_pu16FrameSize = u16FrameSize;
+
+    return QUELL_OK;
+}
+
+int32_t getPacketFromFIFO(fifo_t *_psFIFORx, protocol_link_t *_psLink, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16PacketSize)
 {
     char cData;
     size_t tCount = 0;
@@ -150,6 +301,18 @@ int32_t getPacketFromFIFO(fifo_t *_psFIFORx, uint8_t *_pu8Buffer, uint16_t _u16B
         return QUELL_ERROR;
     }
 
+    /* FEC frames are repaired into a regular packet before anything else looks at them */
+    if(FIFO_peak(_psFIFORx, 0, &cData) == true && cData == FEC_SOF)
+    {
+        return getFECFrameFromFIFO(_psFIFORx, _psLink, _pu8Buffer, _u16BufferSize, _pu16PacketSize);
+    }
+
+    /* Addressed frames come out whole, header included */
+    if(FIFO_peak(_psFIFORx, 0, &cData) == true && cData == SOA)
+    {
+        return getAddressedFrameFromFIFO(_psFIFORx, _pu8Buffer, _u16BufferSize, _pu16PacketSize);
+    }
+
     /* Check if there is at least the smallest amount of data for the packet */
     if(FIFO_count(_psFIFORx, &tCount) == false || tCount < MINIMUM_PACKET_SIZE)
     {
@@ -166,6 +329,13 @@ int32_t getPacketFromFIFO(fifo_t *_psFIFORx, uint8_t *_pu8Buffer, uint16_t _u16B
         }
     }
 
+    /* A size no packet can have is noise that looked like a start (collisions on a bus), drop the start byte */
+    if(u16PacketSize < MINIMUM_PACKET_SIZE || u16PacketSize > _u16BufferSize)
+    {
+        FIFO_get(_psFIFORx, &cData);
+        return QUELL_ERROR;
+    }
+
     /* If the amount in FIFO is smaller than the packet size, it means that it is not a full packet yet */
     if(tCount < u16PacketSize)
     {
@@ -175,6 +345,7 @@ int32_t getPacketFromFIFO(fifo_t *_psFIFORx, uint8_t *_pu8Buffer, uint16_t _u16B
     /* Just a last check of one of the known bytes from the packet */
     if(FIFO_peak(_psFIFORx, (u16PacketSize - 1) - 2, &cData) == false || cData != EOT)
     {
+        FIFO_get(_psFIFORx, &cData);
         return QUELL_ERROR;
     }
 
@@ -242,41 +413,152 @@ int32_t makePacket(uint8_t * _pu8PacketBuffer, uint16_t _u16PacketBufferSize, ui
     return QUELL_OK;
 }
 
-int32_t sendMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u16MessageSize)
+static void makeAddressHeader(uint8_t *_pu8Header, uint8_t _u8Destination, uint8_t _u8Source, uint16_t _u16PacketSize)
 {
-    uint8_t au8PacketBuffer[64];
+    uint8_t au8Covered[4] = {_u8Destination, _u8Source, (_u16PacketSize >> 8) & 0xFF, _u16PacketSize & 0xFF};
 
-    if(_psFIFOTx == NULL || _pu8Message == NULL || _u16MessageSize == 0)
+    _pu8Header[0] = SOA;
+    _pu8Header[1] = _u8Destination;
+    _pu8Header[2] = _u8Source;
+    _pu8Header[3] = calculateCRC8(au8Covered, sizeof(au8Covered));
+}
+
+int32_t makeAddressedPacket(uint8_t * _pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint8_t _u8Destination, uint8_t _u8Source, uint8_t * _pu8Message, uint16_t _u16MessageSize)
+{
+    if(_pu8PacketBuffer == NULL || _u16PacketBufferSize < ADDRESSED_SIZE(PACKE_SIZE(_u16MessageSize)) ||
+       makePacket(&_pu8PacketBuffer[ADDRESS_HEADER_SIZE], _u16PacketBufferSize - ADDRESS_HEADER_SIZE, _pu8Message, _u16MessageSize) == QUELL_ERROR)
     {
         return QUELL_ERROR;
     }
 
-    /* Check if the buffer has enough space (this buffer could be dinamic, but static buffer makes it more predictable) */
-    if(MINIMUM_PACKET_SIZE + _u16MessageSize > sizeof(au8PacketBuffer))
+    makeAddressHeader(_pu8PacketBuffer, _u8Destination, _u8Source, PACKE_SIZE(_u16MessageSize));
+
+    return QUELL_OK;
+}
+
+static inline void protocolPokeByte(fifo_t *_psFIFOTx, size_t *_ptPosition, uint8_t _u8Data, uint16_t *_pu16CRC16)
+{
+    *_pu16CRC16 = updateCRC16CCITT(*_pu16CRC16, (char)_u8Data);
+    FIFO_poke(_psFIFOTx, (*_ptPosition)++, (char)_u8Data);
+}
+
+/*
+    Builds the packet straight into FIFO Tx: the header, every fragment of the message and the trailer
+    are written after the tail while the CRC16 is calculated, then the whole packet is published at once.
+    One copy per message byte, and the only size limit is the free space in the FIFO. With _psLink the
+    address header goes in front (multi-drop bus).
+*/
+static int32_t protocolWriteFrame(fifo_t *_psFIFOTx, const protocol_link_t *_psLink, uint8_t _u8Destination, const protocol_fragment_t *_psFragments, uint16_t _u16FragmentCount)
+{
+    uint8_t au8Header[ADDRESS_HEADER_SIZE];
+    uint32_t u32MessageSize = 0;
+    uint16_t u16PacketSize;
+    uint16_t u16CRC16 = 0;
+    size_t tPosition = 0;
+    size_t tFIFOFree;
+
+    if(_psFIFOTx == NULL || _psFragments == NULL || _u16FragmentCount == 0)
     {
         return QUELL_ERROR;
     }
 
-    /* Make the packet to send */
-    if(makePacket(au8PacketBuffer, sizeof(au8PacketBuffer), _pu8Message, _u16MessageSize) == QUELL_OK)
+    for(uint16_t u16Index = 0; u16Index < _u16FragmentCount; u16Index++)
     {
-        /* Send the packet */
-        for(uint16_t u16Index = 0; u16Index < MINIMUM_PACKET_SIZE + _u16MessageSize; u16Index++)
+        if(_psFragments[u16Index].pu8Data == NULL && _psFragments[u16Index].u16Size > 0)
         {
-            /* Place the packet in FIFO */
-            if(FIFO_put(_psFIFOTx, au8PacketBuffer[u16Index]) == false)
-            {
-                return QUELL_ERROR;
-            }
+            return QUELL_ERROR;
+        }
+        u32MessageSize += _psFragments[u16Index].u16Size;
+    }
+
+    /* The packet size has to fit in its u16 header field */
+    if(u32MessageSize == 0 || MINIMUM_PACKET_SIZE + u32MessageSize > UINT16_MAX)
+    {
+        return QUELL_ERROR;
+    }
+    u16PacketSize = PACKE_SIZE(u32MessageSize);
+
+    /* All or nothing, a packet is never left half way in the FIFO */
+    if(FIFO_free(_psFIFOTx, &tFIFOFree) == false || tFIFOFree < ((_psLink != NULL) ? ADDRESSED_SIZE(u16PacketSize) : u16PacketSize))
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Address header, outside of the packet CRC16 */
+    if(_psLink != NULL)
+    {
+        makeAddressHeader(au8Header, _u8Destination, _psLink->u8Address, u16PacketSize);
+        for(uint16_t u16Index = 0; u16Index < ADDRESS_HEADER_SIZE; u16Index++)
+        {
+            FIFO_poke(_psFIFOTx, tPosition++, (char)au8Header[u16Index]);
+        }
+    }
+
+    /* Start of heading, Packet Size and Start of Text */
+    protocolPokeByte(_psFIFOTx, &tPosition, SOH, &u16CRC16);
+    protocolPokeByte(_psFIFOTx, &tPosition, (u16PacketSize >> 8) & 0xFF, &u16CRC16);
+    protocolPokeByte(_psFIFOTx, &tPosition, u16PacketSize & 0xFF, &u16CRC16);
+    protocolPokeByte(_psFIFOTx, &tPosition, SOT, &u16CRC16);
+
+    /* Message, gathered from every fragment */
+    for(uint16_t u16Index = 0; u16Index < _u16FragmentCount; u16Index++)
+    {
+        const uint8_t *pu8Data = _psFragments[u16Index].pu8Data;
+        for(uint16_t u16Byte = 0; u16Byte < _psFragments[u16Index].u16Size; u16Byte++)
+        {
+            protocolPokeByte(_psFIFOTx, &tPosition, pu8Data[u16Byte], &u16CRC16);
         }
     }
 
+    /* End of Text */
+    protocolPokeByte(_psFIFOTx, &tPosition, EOT, &u16CRC16);
+
+    /* CRC16 (not part of itself) */
+    FIFO_poke(_psFIFOTx, tPosition++, (u16CRC16 >> 8) & 0xFF);
+    FIFO_poke(_psFIFOTx, tPosition++, u16CRC16 & 0xFF);
+
+    /* Publish the packet */
+    if(FIFO_commit(_psFIFOTx, tPosition) == false)
+    {
+        return QUELL_ERROR;
+    }
+
     return QUELL_OK;
 }
 
+int32_t sendMessageFragments(fifo_t *_psFIFOTx, const protocol_fragment_t *_psFragments, uint16_t _u16FragmentCount)
+{
+    return protocolWriteFrame(_psFIFOTx, NULL, 0, _psFragments, _u16FragmentCount);
+}
+
+int32_t sendMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u16MessageSize)
+{
+    protocol_fragment_t sFragment = {.pu8Data = _pu8Message, .u16Size = _u16MessageSize};
+
+    if(_psFIFOTx == NULL || _pu8Message == NULL || _u16MessageSize == 0)
+    {
+        return QUELL_ERROR;
+    }
 
+    return sendMessageFragments(_psFIFOTx, &sFragment, 1);
+}
 
-int32_t acknowledgeMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u16MessageSize, const char* _pcTAG)
+/* A message to _u8Destination, addressed on a bus or chain link and a plain packet otherwise */
+int32_t protocolLink_send(protocol_link_t *_psLink, fifo_t *_psFIFOTx, uint8_t _u8Destination, uint8_t * _pu8Message, uint16_t _u16MessageSize)
+{
+    protocol_fragment_t sFragment = {.pu8Data = _pu8Message, .u16Size = _u16MessageSize};
+
+    if(_psLink == NULL || _psFIFOTx == NULL || _pu8Message == NULL || _u16MessageSize == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    return protocolWriteFrame(_psFIFOTx, (_psLink->bAddressed == true) ? _psLink : NULL, _u8Destination, &sFragment, 1);
+}
+
+
+
+int32_t acknowledgeMessage(fifo_t *_psFIFOTx, protocol_link_t *_psLink, uint8_t * _pu8Message, uint16_t _u16MessageSize, const char* _pcTAG)
 {
     struct
     {
@@ -288,11 +570,17 @@ int32_t acknowledgeMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u
                          {MESSAGE_ERROR, NULL},
                          {NULL, NULL}};
 
-    if(_psFIFOTx == NULL || _pu8Message == NULL || _u16MessageSize == 0)
+    if(_psFIFOTx == NULL || _psLink == NULL || _pu8Message == NULL || _u16MessageSize == 0)
     {
         return QUELL_ERROR;
     }
 
+    /* IMU samples stream at the sample rate, a lost one is not worth an answer */
+    if(_pu8Message[0] == MESSAGE_IMU_ID)
+    {
+        return QUELL_OK;
+    }
+
     for(uint16_t u16Index = 0; ; u16Index++)
     {
         /* Check if the message received is known */
@@ -315,7 +603,7 @@ int32_t acknowledgeMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u
                     }
 
                     /* Acknowledge the message */
-                    return (sendMessage(_psFIFOTx, (uint8_t*)sMessageAnswer[u16Index].pu8AknowledgementMessage, strlen((char*)sMessageAnswer[u16Index].pu8AknowledgementMessage)));
+                    return (protocolLink_send(_psLink, _psFIFOTx, _psLink->u8ReplyAddress, (uint8_t*)sMessageAnswer[u16Index].pu8AknowledgementMessage, strlen((char*)sMessageAnswer[u16Index].pu8AknowledgementMessage)));
                 }
                 else
                 {
@@ -327,40 +615,193 @@ int32_t acknowledgeMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u
         /* The message received is unkwonw */
         else
         {
-            return (sendMessage(_psFIFOTx, (uint8_t*)MESSAGE_ERROR, strlen(MESSAGE_ERROR)));
+            return (protocolLink_send(_psLink, _psFIFOTx, _psLink->u8ReplyAddress, (uint8_t*)MESSAGE_ERROR, strlen(MESSAGE_ERROR)));
+        }
+    }
+
+
+    return QUELL_ERROR;
+}
+
+int32_t protocolLink_init(protocol_link_t *_psLink, size_t _tRxFIFOSize, size_t _tRxReserve)
+{
+    if(_psLink == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psLink, 0, sizeof(protocol_link_t));
+
+    /* Received FEC frames are decoded from the start, sending them waits for the negotiation */
+    fec_init();
+
+    return flowControl_init(&_psLink->sFlowControl, _tRxFIFOSize, _tRxReserve);
+}
+
+/* Frames on an initialized link carry addresses from now on (a link of a chain, or of the bus) */
+int32_t protocolLink_initAddressed(protocol_link_t *_psLink, uint8_t _u8Address)
+{
+    if(_psLink == NULL || _u8Address == ADDRESS_BROADCAST)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psLink->bAddressed = true;
+    _psLink->u8Address = _u8Address;
+    _psLink->u8DefaultPeer = (_u8Address == ADDRESS_MASTER) ? ADDRESS_BROADCAST : ADDRESS_MASTER;
+    _psLink->u8ReplyAddress = _psLink->u8DefaultPeer;
+
+    return QUELL_OK;
+}
+
+/* Turns an initialized link into a multi-drop bus node (_psTdma already initialized with the same address) */
+int32_t protocolLink_initBus(protocol_link_t *_psLink, uint8_t _u8Address, tdma_t *_psTdma)
+{
+    if(_psTdma == NULL || protocolLink_initAddressed(_psLink, _u8Address) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psLink->psTdma = _psTdma;
+
+    return QUELL_OK;
+}
+
+/* Frames for other units arriving on this link are cut through by _psRouter (port _u8Port of it) */
+int32_t protocolLink_initRouted(protocol_link_t *_psLink, router_t *_psRouter, uint8_t _u8Port)
+{
+    if(_psLink == NULL || _psRouter == NULL || _u8Port >= ROUTER_MAX_PORTS || _psLink->bAddressed == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psLink->psRouter = _psRouter;
+    _psLink->u8Port = _u8Port;
+
+    return QUELL_OK;
+}
+
+/* Consumes the FEC negotiation messages, the request is accepted and switches our side as well */
+static int32_t processLinkMessage(fifo_t *_psFIFOTx, protocol_link_t *_psLink, uint8_t * _pu8Message, uint16_t _u16MessageSize, const char* _pcTAG)
+{
+    message_quench_t sQuench;
+
+    /* A router on the way dropped our frames, the congestion control reads the count */
+    if(messages_decodeQuench(&sQuench, _pu8Message, _u16MessageSize) == QUELL_OK)
+    {
+        _psLink->u32RxQuenches++;
+        return QUELL_OK;
+    }
+
+    if(strcmp((char*)_pu8Message, MESSAGE_FEC_REQUEST) == 0 || strcmp((char*)_pu8Message, MESSAGE_NOFEC_REQUEST) == 0)
+    {
+        _psLink->bFECTx = (strcmp((char*)_pu8Message, MESSAGE_FEC_REQUEST) == 0);
+        if(_pcTAG != NULL)
+        {
+            ESP_LOGI(_pcTAG, "FEC Tx %s (peer request)", (_psLink->bFECTx == true) ? "on" : "off");
         }
+        return (_psLink->bFECTx == true) ? protocolLink_send(_psLink, _psFIFOTx, _psLink->u8ReplyAddress, (uint8_t*)MESSAGE_FEC_ACCEPT, strlen(MESSAGE_FEC_ACCEPT)) :
+                                           protocolLink_send(_psLink, _psFIFOTx, _psLink->u8ReplyAddress, (uint8_t*)MESSAGE_NOFEC_ACCEPT, strlen(MESSAGE_NOFEC_ACCEPT));
     }
 
+    if(strcmp((char*)_pu8Message, MESSAGE_FEC_ACCEPT) == 0 || strcmp((char*)_pu8Message, MESSAGE_NOFEC_ACCEPT) == 0)
+    {
+        _psLink->bFECTx = (strcmp((char*)_pu8Message, MESSAGE_FEC_ACCEPT) == 0);
+        if(_pcTAG != NULL)
+        {
+            ESP_LOGI(_pcTAG, "FEC Tx %s (peer accepted)", (_psLink->bFECTx == true) ? "on" : "off");
+        }
+        return QUELL_OK;
+    }
 
     return QUELL_ERROR;
 }
 
-int32_t processIncomingCommunication(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, const char* _pcTAG)
+int32_t processIncomingCommunication(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, protocol_link_t *_psLink, const char* _pcTAG)
 {
-    uint8_t au8PacketBuffer[64];
-    uint8_t au8MessageBuffer[64];
+    uint8_t au8PacketBuffer[PROTOCOL_PACKET_BUFFER_SIZE];
+    uint8_t au8MessageBuffer[PROTOCOL_PACKET_BUFFER_SIZE];
     uint16_t u16PacketSize;
     uint16_t u16MessageSize;
 
-    if(_psFIFORx == NULL || _psFIFOTx == NULL)
+    if(_psFIFORx == NULL || _psFIFOTx == NULL || _psLink == NULL)
     {
         return QUELL_ERROR;
     }
     
 
+    /* Frames for other units are cut through to their next link before anything parses them */
+    if(_psLink->psRouter != NULL)
+    {
+        router_result_t eForward = router_forward(_psLink->psRouter, _psLink->u8Port, _psFIFORx);
+        if(eForward != ROUTER_LOCAL)
+        {
+            return (eForward == ROUTER_FORWARDED) ? QUELL_OK : QUELL_ERROR;
+        }
+    }
+
     /* Get packet from fifo Rx */
-    if(getPacketFromFIFO(_psFIFORx, au8PacketBuffer, sizeof(au8PacketBuffer), &u16PacketSize) == QUELL_OK)
+    if(getPacketFromFIFO(_psFIFORx, _psLink, au8PacketBuffer, sizeof(au8PacketBuffer), &u16PacketSize) == QUELL_OK)
     {
+        /* Addressed frames (the header of FEC decoded ones was not checked yet): skip the ones for others, answer the source */
+        uint8_t *pu8Packet = au8PacketBuffer;
+        _psLink->u8ReplyAddress = _psLink->u8DefaultPeer;
+        if(au8PacketBuffer[0] == SOA)
+        {
+            if(u16PacketSize < ADDRESSED_SIZE(3) || verifyAddressHeader(au8PacketBuffer) == QUELL_ERROR)
+            {
+                _psLink->u32RxErrors++;
+                return QUELL_ERROR;
+            }
+            if(_psLink->bAddressed == true && au8PacketBuffer[1] != _psLink->u8Address && au8PacketBuffer[1] != ADDRESS_BROADCAST)
+            {
+                _psLink->u32RxForeign++;
+                return QUELL_OK;
+            }
+            _psLink->u8ReplyAddress = au8PacketBuffer[2];
+            pu8Packet += ADDRESS_HEADER_SIZE;
+            u16PacketSize -= ADDRESS_HEADER_SIZE;
+        }
+
         /* When a confirmed packet arrived, check it */
-        if(verifyPacket(au8PacketBuffer, u16PacketSize) == QUELL_OK)
+        if(verifyPacket(pu8Packet, u16PacketSize) == QUELL_OK)
         {
+            _psLink->u32RxPackets++;
+
+            /* The message is extracted straight into the next bus slot when it fits (with its terminator), so publishing costs no copy */
+            uint8_t *pu8Message = au8MessageBuffer;
+            if(_psLink->psBus != NULL && MESSAGE_SIZE(u16PacketSize) < _psLink->psBus->u16SlotSize)
+            {
+                pu8Message = sampleBus_claim(_psLink->psBus);
+            }
+
             /*Everything ok, extract the packet*/
-            if(extractMessageFromPacket(au8PacketBuffer, u16PacketSize, au8MessageBuffer, &u16MessageSize) == QUELL_OK)
+            if(extractMessageFromPacket(pu8Packet, u16PacketSize, pu8Message, &u16MessageSize) == QUELL_OK)
             {
+                /* Link messages (credits, link speed, FEC negotiation, quenches, bus beacons, bench probes) and tunnel bytes are consumed here and never acknowledged */
+                if(linkSpeed_processMessage(_psLink->psSpeed, pu8Message, u16MessageSize) == QUELL_OK ||
+                   flowControl_processMessage(&_psLink->sFlowControl, pu8Message, u16MessageSize) == QUELL_OK ||
+                   processLinkMessage(_psFIFOTx, _psLink, pu8Message, u16MessageSize, _pcTAG) == QUELL_OK ||
+                   tdma_processMessage(_psLink->psTdma, pu8Message, u16MessageSize) == QUELL_OK ||
+                   linkBench_processMessage(_psLink->psBench, pu8Message, u16MessageSize, _psLink->u8ReplyAddress, _psLink->u32RxErrors) == QUELL_OK ||
+                   channel_processMessage(_psLink->psChannels, pu8Message, u16MessageSize, _psLink->u8ReplyAddress) == QUELL_OK)
+                {
+                    return QUELL_OK;
+                }
+
+                if(pu8Message != au8MessageBuffer)
+                {
+                    sampleBus_publish(_psLink->psBus, u16MessageSize);
+                }
+
                 /* Acknowledge message received*/
-                return (acknowledgeMessage(_psFIFOTx, au8MessageBuffer, u16MessageSize, _pcTAG));
+                return (acknowledgeMessage(_psFIFOTx, _psLink, pu8Message, u16MessageSize, _pcTAG));
             }
         }
+        else
+        {
+            _psLink->u32RxErrors++;
+        }
     }
 
     return QUELL_ERROR;
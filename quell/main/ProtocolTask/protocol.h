@@ -1,15 +1,87 @@
-#ifndef _TERMIANL_TASK_H_
-#define _TERMINAL_TASK_H_
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
 
 #include <stdio.h>
 #include <string.h>
 #include "FIFO.h"
+#include "flowControl.h"
+#include "fec.h"
+#include "sampleBus.h"
+#include "tdma.h"
+#include "router.h"
+#include "linkBench.h"
+#include "linkSpeed.h"
+#include "channel.h"
+
+#define SOH 1
+#define SOT 2
+#define EOT 3
 
 #define MINIMUM_PACKET_SIZE 7
 #define PACKE_SIZE(msg_lenght) (MINIMUM_PACKET_SIZE + msg_lenght)
 #define MESSAGE_SIZE(packet_length) (packet_length - MINIMUM_PACKET_SIZE)
 
-int32_t processIncomingCommunication(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, const char* _pcTAG);
+/* Multi-drop bus and chains: an address header in front of the packet (see protocol.c) */
+#define SOA 0x0E
+#define ADDRESS_HEADER_SIZE 4
+#define ADDRESSED_SIZE(packet_length) (ADDRESS_HEADER_SIZE + (packet_length))
+#define ADDRESS_MASTER 0x00
+#define ADDRESS_BROADCAST 0xFF
+
+/* Link messages, the FEC of packets sent to the peer is switched per link by request/accept */
+#define MESSAGE_FEC_REQUEST "fec?"
+#define MESSAGE_FEC_ACCEPT "fec!"
+#define MESSAGE_NOFEC_REQUEST "nofec?"
+#define MESSAGE_NOFEC_ACCEPT "nofec!"
+
+typedef struct
+{
+    const uint8_t *pu8Data;
+    uint16_t u16Size;
+}protocol_fragment_t;
+
+/* State of one protocol link (one uart and its peer) */
+typedef struct
+{
+    flow_control_t sFlowControl;
+    volatile bool bFECTx;           //Packets to the peer go out FEC encoded (negotiated, received FEC frames are always accepted)
+    sample_bus_t *psBus;            //Every message received (link messages excluded) is published here, NULL for none
+    link_bench_t *psBench;          //Answers bench probes and counts load frames, NULL for none
+    link_speed_t *psSpeed;          //Baud rate negotiation (point to point links), NULL for a fixed rate
+    channel_mux_t *psChannels;      //Terminal and log tunnels (channel.h), NULL for none
+
+    /* Addressed links (protocolLink_initAddressed): frames carry addresses, replies go back to the source of the packet */
+    bool bAddressed;
+    tdma_t *psTdma;                 //Slot schedule of a multi-drop bus, NULL on a point to point link
+    router_t *psRouter;             //Forwards frames for other units (chain), NULL for none
+    uint8_t u8Port;                 //Of this link on psRouter
+    uint8_t u8Address;
+    uint8_t u8DefaultPeer;          //Destination of messages nobody addressed (the master, or everybody from the master)
+    uint8_t u8ReplyAddress;         //Source of the packet being processed
+
+    /* Statistics (processing task) */
+    uint32_t u32RxPackets;          //Packets that passed verifyPacket
+    uint32_t u32RxErrors;           //Packets dropped by verifyPacket (CRC, framing)
+    uint32_t u32RxFECFrames;
+    uint32_t u32RxFECCorrected;     //Bytes (and size bits) repaired before the CRC check
+    uint32_t u32RxFECFailures;      //FEC frames with more errors than the code can repair
+    uint32_t u32RxForeign;          //Addressed frames for other units that were not forwarded, skipped
+    uint32_t u32RxQuenches;         //A router on the way dropped frames of ours (chain)
+}protocol_link_t;
+
+int32_t sendMessage(fifo_t *_psFIFOTx, uint8_t * _pu8Message, uint16_t _u16MessageSize);
+int32_t sendMessageFragments(fifo_t *_psFIFOTx, const protocol_fragment_t *_psFragments, uint16_t _u16FragmentCount);
+int32_t protocolLink_init(protocol_link_t *_psLink, size_t _tRxFIFOSize, size_t _tRxReserve);
+int32_t protocolLink_initAddressed(protocol_link_t *_psLink, uint8_t _u8Address);
+int32_t protocolLink_initBus(protocol_link_t *_psLink, uint8_t _u8Address, tdma_t *_psTdma);
+int32_t protocolLink_initRouted(protocol_link_t *_psLink, router_t *_psRouter, uint8_t _u8Port);
+int32_t protocolLink_send(protocol_link_t *_psLink, fifo_t *_psFIFOTx, uint8_t _u8Destination, uint8_t * _pu8Message, uint16_t _u16MessageSize);
+int32_t processIncomingCommunication(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, protocol_link_t *_psLink, const char* _pcTAG);
+int32_t trimFIFOForPacket(fifo_t *_psFIFORx);
+int32_t getPacketFromFIFO(fifo_t *_psFIFORx, protocol_link_t *_psLink, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16PacketSize);
+int32_t verifyPacket(uint8_t *_pu8Packet, uint16_t _u16PacketSize);
 int32_t makePacket(uint8_t * _pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint8_t * _pu8Message, uint16_t _u16MessageSize);
+int32_t makeAddressedPacket(uint8_t * _pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint8_t _u8Destination, uint8_t _u8Source, uint8_t * _pu8Message, uint16_t _u16MessageSize);
+int32_t verifyAddressHeader(const uint8_t *_pu8Header);
 
-#endif /* _TERMINAL_TASK_H_ */
\ No newline at end of file
+#endif /* _PROTOCOL_H_ */
\ No newline at end of file
@@ -5,106 +5,773 @@
 #include "freertos/queue.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "protocolTask.h"
 #include "protocol.h"
 #include "FIFO.h"
 #include "quell.h"
 #include "FIFOUart.h"
+#include "taskConfig.h"
+#include "txScheduler.h"
+#include "flowControl.h"
+#include "tdma.h"
+#include "router.h"
+#include "linkBench.h"
+#include "linkSpeed.h"
+#include "congestion.h"
+#include "channel.h"
+#include "imuStream.h"
 
 
 #define PROTOCOL_UART_NUM UART_NUM_1
+#define PROTOCOL_DOWNLINK_UART_NUM UART_NUM_2
+#define PROTOCOL_BAUD_RATE (LINK_SPEED_BASE_BAUD)
+/* Point to point links step up to this rate when both units and the cable manage it, see linkSpeed.h (PROTOCOL_BAUD_RATE: fixed rate) */
+#ifndef PROTOCOL_MAX_BAUD_RATE
+#define PROTOCOL_MAX_BAUD_RATE (2000000UL)
+#endif
+
+/* 1: multi-drop half-duplex bus (RS-485, DE on the RTS pin) with addressed frames and TDMA slots, see tdma.h */
+#ifndef PROTOCOL_BUS_MODE
+#define PROTOCOL_BUS_MODE (0)
+#endif
+/* 1: one unit of a chain (hand -> elbow -> chest) with addressed frames and a second link (UART2) toward the next unit down, frames for others are cut through, see router.h */
+#ifndef PROTOCOL_CHAIN_MODE
+#define PROTOCOL_CHAIN_MODE (0)
+#endif
+/* On the bus or a chain: 0 is the chest unit (it runs the slot schedule), the hand units use their imu unit number */
+#ifndef PROTOCOL_NODE_ADDRESS
+#define PROTOCOL_NODE_ADDRESS (ADDRESS_MASTER)
+#endif
+#define PROTOCOL_PORTS ((PROTOCOL_CHAIN_MODE == 1) ? 2 : 1)
 #define UART_BUF_SIZE (512UL)
 
 #define FIFO_BUF_SIZE (128UL)
+#define RX_FIFO_BUF_SIZE (512UL)
+#define RX_CREDIT_RESERVE (4 * PACKE_SIZE(MESSAGE_CREDIT_SIZE))
+#define TX_BULK_FIFO_BUF_SIZE (512UL)
+#define TX_FORWARD_FIFO_BUF_SIZE (512UL)
+#define TX_TUNNEL_FIFO_BUF_SIZE (256UL)   //A few tunnel frames of the units further out, more are thrown away
+#define TX_AGGREGATOR_BUFFER_SIZE (256UL)
+#define TX_AGGREGATOR_DEADLINE_MS (2UL)
+#define TX_MAX_CONTROL_BURST (4)
+#define TX_FEC_PACKET_BUFFER_SIZE (128UL) //Bigger packets go out plain even with FEC on
 #define RX_READ_BUFFER_SIZE (32UL)
 
-#define PROTOCOL_QUEUE_SIZE (128UL)
+#define PROTOCOL_BUS_SLOT_SIZE (64UL)
+#define PROTOCOL_BUS_SLOT_COUNT (32UL)
+
+#define PROTOCOL_QUEUE_SIZE (8UL)
+#define PROTOCOL_INJECT_MESSAGE_SIZE (64UL)
+
+/* Tunnels (channel.h): the buffers of every tunnel */
+#define TERMINAL_TX_BUF_SIZE (512UL)
+#define TERMINAL_RX_BUF_SIZE (256UL)
+#define LOG_TX_BUF_SIZE (1024UL)
+#define LOG_RX_BUF_SIZE (512UL)
+#define PROTOCOL_LOG_LINE_SIZE (128UL)      //Longer log lines reach the tunnels cut
+#define PROTOCOL_TUNNEL_WAIT_MS (2000UL)    //A captured command waits this long for room in the terminal tunnel, once, then the rest of its output is cut
+/* 1: the log output of this unit goes to the master over the log tunnel as well (hand units), what remote commands print goes back either way */
+#ifndef PROTOCOL_LOG_TUNNEL
+#define PROTOCOL_LOG_TUNNEL ((PROTOCOL_NODE_ADDRESS != ADDRESS_MASTER) ? 1 : 0)
+#endif
+
+
+/* One uart and its link, served by an io task of its own. Port 0 is UART1 (toward the chest on a chain), port 1 the chain downlink */
+typedef struct
+{
+    uint32_t u32Uart;
+    QueueHandle_t tQueueRx;
+
+    /* FIFO Rx is written only by the io task and the Tx lanes only by the processing task, so all stay single producer/single consumer */
+    fifo_t sFIFORx;
+    tx_scheduler_t sTxScheduler;
+    protocol_link_t sLink;
+    uart_tx_aggregator_t sTxAggregator;
+
+    /* FEC encoding of the io task: the packet popped from a lane and its frame waiting for room in the aggregator */
+    uint8_t au8FECPacket[TX_FEC_PACKET_BUFFER_SIZE];
+    uint8_t au8FECFrame[FEC_ENCODED_SIZE(TX_FEC_PACKET_BUFFER_SIZE)];
+    uint16_t u16FECFramePending;
+
+    /* Bench runs sent from here and the answers owed to the peer, processing task only (the terminal hands runs over) */
+    link_bench_t sBench;
 
+    /* Baud rate of a point to point link, io task (the processing task hands received speed messages over) */
+    link_speed_t sSpeed;
+}protocol_port_t;
 
 static const char *TAG = "protocol";
-static QueueHandle_t uart_queue_rx;
 QueueHandle_t tQueueProtocol;
 
-//@todo: It would be a perfect idea to inject as a whole message or packet, and use the FreeRTOS Queue to send a message struct. Much better organization of the code.
-int32_t protocolInjectData(char* _pcData, uint16_t _u16DataLenght)
+static protocol_port_t asPorts[PROTOCOL_PORTS];
+static sample_bus_t sSampleBus;
+static TaskHandle_t tProtocolTaskHandle = NULL;
+static tdma_t sTdma;
+static router_t sRouter;
+
+/* Sample rate of the imu streams against the health of the link toward the master, processing task only (the terminal switches it) */
+static congestion_t sCongestion;
+static uint32_t u32InjectRefused;   //Messages the queue had no room for
+static uint16_t u16QuenchPending;   //Chain: sources the router dropped or marked frames of, not told yet (bit per address)
+static uint32_t au32QuenchUs[ROUTER_MAX_ADDRESSES];     //Chain: when each source was last told
+static portMUX_TYPE sInjectLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Terminal and log tunnels of every link: any task writes them (under sChannelLock), the processing task sends what they hold */
+static channel_mux_t sChannels;
+static portMUX_TYPE sChannelLock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t volatile tCaptureTask = NULL;  //Its log output goes to the terminal tunnel (a remote command running)
+static uint32_t u32CaptureCut;      //Lines of the capture not sent, from the first that found no room in time (capturing task only)
+static vprintf_like_t volatile fpLogVprintf = NULL;    //The console behind the tunnels (UART0), swapped by a terminal stream
+
+typedef struct
+{
+    uint16_t u16Size;
+    uint8_t u8Destination;          //Bus address, ignored on a point to point link
+    uint8_t au8Message[PROTOCOL_INJECT_MESSAGE_SIZE];
+}protocol_inject_t;
+
+/* Other tasks inject whole messages, the protocol task frames them straight into the bulk lane */
+int32_t protocolInjectMessageTo(uint8_t _u8Destination, uint8_t* _pu8Message, uint16_t _u16MessageSize)
 {
-    if(_pcData == NULL || _u16DataLenght == 0)
+    protocol_inject_t sInject;
+
+    if(_pu8Message == NULL || _u16MessageSize == 0 || _u16MessageSize > sizeof(sInject.au8Message) || tQueueProtocol == NULL)
     {
         return QUELL_ERROR;
     }
 
-    for(uint16_t u16Index = 0; u16Index < _u16DataLenght; u16Index++)
+    sInject.u16Size = _u16MessageSize;
+    sInject.u8Destination = _u8Destination;
+    memcpy(sInject.au8Message, _pu8Message, _u16MessageSize);
+
+    if(xQueueSend(tQueueProtocol, (void *)&sInject, 0) != pdTRUE)
     {
-        xQueueSend(tQueueProtocol, (void *)&_pcData[u16Index], 0);
+        portENTER_CRITICAL(&sInjectLock);
+        u32InjectRefused++;
+        portEXIT_CRITICAL(&sInjectLock);
+        return QUELL_ERROR;
     }
 
     return QUELL_OK;
 }
 
-static int32_t protocolTransferInjectedDataToFIFO(fifo_t *_psFIFOTx)
+/* To the peer: the master from a bus or chain node, every node from the master */
+int32_t protocolInjectMessage(uint8_t* _pu8Message, uint16_t _u16MessageSize)
+{
+    return protocolInjectMessageTo(asPorts[0].sLink.u8DefaultPeer, _pu8Message, _u16MessageSize);
+}
+
+/* The master from a bus or chain node, every node (broadcast) from the master, ignored on a point to point link */
+uint8_t protocolGetDefaultPeer(void)
+{
+    return asPorts[0].sLink.u8DefaultPeer;
+}
+
+/* The link toward _u8Destination: the one its route points to on a chain, the only one otherwise */
+static protocol_port_t* protocolPortTo(uint8_t _u8Destination)
 {
-    char cData;
-    size_t u16FIFOCount;
+    uint8_t u8Port = 0;
 
-    if(_psFIFOTx == NULL)
+    if(asPorts[0].sLink.psRouter != NULL && _u8Destination != ADDRESS_BROADCAST)
     {
-        return QUELL_ERROR;
+        u8Port = router_getPort(asPorts[0].sLink.psRouter, _u8Destination);
+    }
+
+    return &asPorts[(u8Port < PROTOCOL_PORTS) ? u8Port : 0];
+}
+
+static int32_t protocolTransferInjectedDataToFIFO(void)
+{
+    protocol_inject_t sInject;
+    protocol_port_t *psPort;
+
+    /* A message only leaves the queue once its whole packet fit in the lane */
+    while(xQueuePeek(tQueueProtocol, (void*)&sInject, 0) == pdTRUE)
+    {
+        psPort = protocolPortTo(sInject.u8Destination);
+        if(protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK), sInject.u8Destination, sInject.au8Message, sInject.u16Size) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+
+        /* A broadcast reaches every neighbour (it is never forwarded), the other links as far as they have room */
+        for(uint8_t u8Port = 1; u8Port < PROTOCOL_PORTS && sInject.u8Destination == ADDRESS_BROADCAST; u8Port++)
+        {
+            protocolLink_send(&asPorts[u8Port].sLink, txScheduler_getLane(&asPorts[u8Port].sTxScheduler, TX_LANE_BULK), sInject.u8Destination, sInject.au8Message, sInject.u16Size);
+        }
+        xQueueReceive(tQueueProtocol, (void*)&sInject, 0);
     }
 
-    if(FIFO_count(_psFIFOTx, &u16FIFOCount) == false || u16FIFOCount > 0)
+    return QUELL_OK;
+}
+
+static uint32_t protocolTxFrameCount(protocol_port_t *_psPort)
+{
+    return _psPort->sTxScheduler.sStats.u32Frames[TX_LANE_CONTROL] + _psPort->sTxScheduler.sStats.u32Frames[TX_LANE_BULK] +
+           _psPort->sTxScheduler.sStats.u32Frames[TX_LANE_FORWARD] + _psPort->sTxScheduler.sStats.u32Frames[TX_LANE_TUNNEL];
+}
+
+static uint32_t protocolNowUs(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+/* What may go on the wire now: the peer credit on a point to point link, the rest of our slot on the bus */
+static uint16_t protocolTxAllowance(protocol_port_t *_psPort)
+{
+    return (_psPort->sLink.psTdma != NULL) ? tdma_getTxAllowance(_psPort->sLink.psTdma) : flowControl_getTxAllowance(&_psPort->sLink.sFlowControl);
+}
+
+static void protocolTxSent(protocol_port_t *_psPort, uint16_t _u16Count)
+{
+    if(_psPort->sLink.psTdma != NULL)
     {
-        // It is protecting to not conflict other packets
-        return QUELL_ERROR; //That is why you should have created the queue with FreeRTOS queue and a message struct (this protection should not exist)
+        tdma_txSent(_psPort->sLink.psTdma, _u16Count);
     }
+    else
+    {
+        flowControl_txSent(&_psPort->sLink.sFlowControl, _u16Count);
+    }
+}
 
-    if (xQueueReceive(tQueueProtocol, (void*)&cData, 0) == pdTRUE)
+/* Chain: a link holding its lanes for a speed change backs up what the other links forward to it */
+static bool protocolOtherLinkQuiet(const protocol_port_t *_psPort)
+{
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
     {
-        FIFO_put(_psFIFOTx, cData);
+        if(&asPorts[u8Port] != _psPort && linkSpeed_isQuiet(asPorts[u8Port].sLink.psSpeed) == true)
+        {
+            return true;
+        }
     }
 
-    return QUELL_OK;
+    return false;
 }
 
-static void protocol_task(void *pvParameters)
+static void protocolEncodeFECFrames(protocol_port_t *_psPort, uint32_t _u32NowMs)
 {
-    fifo_t sFIFORx;
-    fifo_t sFIFOTx;
-    char* pu8FIFORxBuffer = (char*) malloc(FIFO_BUF_SIZE);
-    char* pu8FIFOTxBuffer = (char*) malloc(FIFO_BUF_SIZE);
-    if(FIFO_init(&sFIFORx, pu8FIFORxBuffer, FIFO_BUF_SIZE) == false || FIFO_init(&sFIFOTx, pu8FIFOTxBuffer, FIFO_BUF_SIZE) == false)
+    tx_scheduler_t *psTxScheduler = &_psPort->sTxScheduler;
+    char *pcTail;
+    uint16_t u16Count;
+
+    for(;;)
     {
-        ESP_LOGI(TAG, "Error initializing FIFO Rx or Tx");
-        while(1);
+        /* The encoded frame waits here until the aggregator has room for all of it */
+        if(_psPort->u16FECFramePending > 0)
+        {
+            if(uartAggregator_getFree(&_psPort->sTxAggregator, &pcTail) < _psPort->u16FECFramePending)
+            {
+                return;
+            }
+            memcpy(pcTail, _psPort->au8FECFrame, _psPort->u16FECFramePending);
+            uartAggregator_commit(&_psPort->sTxAggregator, _psPort->u16FECFramePending, 1, _u32NowMs);
+            _psPort->u16FECFramePending = 0;
+        }
+
+        if(_psPort->sLink.bFECTx == false || psTxScheduler->u16FrameRemaining > 0 || linkSpeed_isQuiet(_psPort->sLink.psSpeed) == true ||
+           txScheduler_startFrame(psTxScheduler, fec_getMaxPacketSize(protocolTxAllowance(_psPort))) == QUELL_ERROR)
+        {
+            return;
+        }
+
+        /* Too big to encode here, or cut through (its end is still on the way): the plain path sends it (its credit is smaller than the FEC one) */
+        if(psTxScheduler->u16FrameRemaining > sizeof(_psPort->au8FECPacket) || psTxScheduler->eCurrentLane == TX_LANE_FORWARD || psTxScheduler->eCurrentLane == TX_LANE_TUNNEL)
+        {
+            return;
+        }
+
+        if(txScheduler_pop(psTxScheduler, 0, (char*)_psPort->au8FECPacket, sizeof(_psPort->au8FECPacket), &u16Count) == QUELL_ERROR ||
+           psTxScheduler->u16FrameRemaining > 0 ||
+           fec_encodeFrame(_psPort->au8FECPacket, u16Count, _psPort->au8FECFrame, sizeof(_psPort->au8FECFrame), &_psPort->u16FECFramePending) == QUELL_ERROR)
+        {
+            return;
+        }
+
+        protocolTxSent(_psPort, _psPort->u16FECFramePending);
+    }
+}
+
+static void protocol_io_task(void *pvParameters)
+{
+    protocol_port_t *psPort = (protocol_port_t *)pvParameters;
+    tx_scheduler_t *psTxScheduler = &psPort->sTxScheduler;
+    protocol_link_t *psLink = &psPort->sLink;
+
+    for(;;)
+    {
+        /* Transfer received bytes from uart to FIFO Rx (blocks on the uart event queue) */
+        int32_t i32Received = uartReceiveBytes(psPort->u32Uart, psPort->tQueueRx, &psPort->sFIFORx, TASK_POLL_TICKS, TAG);
+        if(i32Received > 0)
+        {
+            flowControl_rxReceived(&psLink->sFlowControl, i32Received);
+        }
+
+        /* Gather queued packets, control lane first, switching lanes only between packets and within the peer credit */
+        uint32_t u32NowMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        uint32_t u32Frames;
+        char *pcTail;
+        uint16_t u16Free;
+        uint16_t u16Count;
+        uint32_t u32Baud;
+
+        /* Speed negotiation ahead of everything, between packets and within the peer credit (answers, probes, keepalives) */
+        linkSpeed_setUnitBusy(psLink->psSpeed, protocolOtherLinkQuiet(psPort));
+        linkSpeed_run(psLink->psSpeed, psLink->u32RxPackets, psLink->u32RxErrors);
+        router_holdPort(psLink->psRouter, psLink->u8Port, linkSpeed_isQuiet(psLink->psSpeed));
+        router_creditPort(psLink->psRouter, psLink->u8Port, protocolTxAllowance(psPort));
+        while(psLink->psSpeed != NULL && psTxScheduler->u16FrameRemaining == 0 && protocolTxAllowance(psPort) >= PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE) &&
+              uartAggregator_getFree(&psPort->sTxAggregator, &pcTail) >= PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE) &&
+              linkSpeed_makePacket(psLink->psSpeed, (uint8_t*)pcTail, PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE), &u16Count) == QUELL_OK)
+        {
+            protocolTxSent(psPort, u16Count);
+            uartAggregator_commit(&psPort->sTxAggregator, u16Count, 1, u32NowMs);
+        }
+
+        /* On the bus the master opens every cycle with its beacon, ahead of anything else */
+        if(psLink->psTdma != NULL && psTxScheduler->u16FrameRemaining == 0 && psPort->u16FECFramePending == 0 &&
+           uartAggregator_getFree(&psPort->sTxAggregator, &pcTail) >= ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_TDMA_MAX_SIZE)) &&
+           tdma_makeBeacon(psLink->psTdma, (uint8_t*)pcTail, ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_TDMA_MAX_SIZE)), &u16Count) == QUELL_OK)
+        {
+            uartAggregator_commit(&psPort->sTxAggregator, u16Count, 1, u32NowMs);
+        }
+
+        /* With FEC on, whole packets are encoded (the peer FIFO Rx holds the encoded frame, so that is what the credit pays for) */
+        protocolEncodeFECFrames(psPort, u32NowMs);
+
+        /* While the link speed changes only a frame already started goes on */
+        u32Frames = protocolTxFrameCount(psPort);
+        while((psLink->bFECTx == false || psTxScheduler->u16FrameRemaining > 0) &&
+              (linkSpeed_isQuiet(psLink->psSpeed) == false || psTxScheduler->u16FrameRemaining > 0) &&
+              (u16Free = uartAggregator_getFree(&psPort->sTxAggregator, &pcTail)) > 0 &&
+              txScheduler_pop(psTxScheduler, protocolTxAllowance(psPort), pcTail, u16Free, &u16Count) == QUELL_OK)
+        {
+            protocolTxSent(psPort, u16Count);
+            uartAggregator_commit(&psPort->sTxAggregator, u16Count, protocolTxFrameCount(psPort) - u32Frames, u32NowMs);
+            u32Frames = protocolTxFrameCount(psPort);
+        }
+
+        /* Advertise our free FIFO Rx space, only between packets (credit packets are outside of the credit). Not on the bus, the slots pace it */
+        if(psLink->psTdma == NULL && psTxScheduler->u16FrameRemaining == 0 && linkSpeed_isSwitching(psLink->psSpeed) == false &&
+           uartAggregator_getFree(&psPort->sTxAggregator, &pcTail) >= PACKE_SIZE(MESSAGE_CREDIT_SIZE) &&
+           flowControl_makeCredit(&psLink->sFlowControl, &psPort->sFIFORx, u32NowMs, (uint8_t*)pcTail, PACKE_SIZE(MESSAGE_CREDIT_SIZE), &u16Count) == QUELL_OK)
+        {
+            uartAggregator_commit(&psPort->sTxAggregator, u16Count, 1, u32NowMs);
+        }
+
+        /* One uart_write_bytes for everything gathered */
+        uartAggregator_flush(psPort->u32Uart, &psPort->sTxAggregator, u32NowMs);
+        txScheduler_setIdle(psTxScheduler, psTxScheduler->u16FrameRemaining == 0 && psPort->u16FECFramePending == 0 && psPort->sTxAggregator.u16Count == 0 &&
+                            uart_wait_tx_done(psPort->u32Uart, 0) == ESP_OK);
+
+        /* A new baud rate once everything before it left the uart */
+        if(linkSpeed_getSwitch(psLink->psSpeed, &u32Baud) == QUELL_OK && psTxScheduler->u16FrameRemaining == 0 && psPort->u16FECFramePending == 0 &&
+           psPort->sTxAggregator.u16Count == 0 && uart_wait_tx_done(psPort->u32Uart, 0) == ESP_OK)
+        {
+            uart_set_baudrate(psPort->u32Uart, u32Baud);
+            linkSpeed_switched(psLink->psSpeed);
+        }
+
+        /* Wake the processing task if there is something to parse */
+        size_t tFIFOCount;
+        if(FIFO_count(&psPort->sFIFORx, &tFIFOCount) == true && tFIFOCount > 0 && tProtocolTaskHandle != NULL)
+        {
+            xTaskNotifyGive(tProtocolTaskHandle);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/* Bench messages due go on the bulk lane as far as it has room, each is built for the room left */
+static void protocolRunBench(protocol_port_t *_psPort)
+{
+    fifo_t *psFIFOBulk = txScheduler_getLane(&_psPort->sTxScheduler, TX_LANE_BULK);
+    uint8_t au8Message[LINK_BENCH_MAX_SIZE];
+    uint16_t u16Size;
+    uint8_t u8Destination;
+    size_t tFree;
+
+    while(FIFO_free(psFIFOBulk, &tFree) == true && tFree > ADDRESSED_SIZE(PACKE_SIZE(0)) &&
+          linkBench_makeMessage(&_psPort->sBench, tFree - ADDRESSED_SIZE(PACKE_SIZE(0)), au8Message, sizeof(au8Message), &u16Size, &u8Destination, _psPort->sLink.sFlowControl.u32TxLimit) == QUELL_OK)
+    {
+        protocolLink_send(&_psPort->sLink, psFIFOBulk, u8Destination, au8Message, u16Size);
+    }
+
+    if(_psPort->sBench.bFinished == true)
+    {
+        _psPort->sBench.bFinished = false;
+        linkBench_print(&_psPort->sBench, TAG);
+    }
+}
+
+/* Chain: a quench to every unit whose frames the router dropped or marked, on the control lane toward it, at most one per period to each */
+static void protocolSendQuenches(void)
+{
+    message_quench_t sQuench = {.u32Dropped = router_getDropped(&sRouter)};
+    uint8_t au8Message[MESSAGE_QUENCH_SIZE];
+    uint16_t u16Size;
+    uint32_t u32Now = protocolNowUs();
+
+    if(asPorts[0].sLink.psRouter == NULL)
+    {
+        return;
+    }
+
+    /* Every source is spaced on its own: one told a moment ago does not hold back one that just started to back up the link */
+    u16QuenchPending |= router_takeQuenchSources(&sRouter);
+    for(uint8_t u8Address = 0; u16QuenchPending != 0 && u8Address < ROUTER_MAX_ADDRESSES; u8Address++)
+    {
+        protocol_port_t *psPort = protocolPortTo(u8Address);
+
+        if((u16QuenchPending & (1U << u8Address)) == 0 || u32Now - au32QuenchUs[u8Address] < CONGESTION_PERIOD_US)
+        {
+            continue;
+        }
+        u16QuenchPending &= (uint16_t)~(1U << u8Address);
+        au32QuenchUs[u8Address] = u32Now;
+        if(messages_encodeQuench(&sQuench, au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+        {
+            protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_CONTROL), u8Address, au8Message, u16Size);
+        }
+    }
+}
+
+/* What the congestion control looks at: the link toward the master and what waits for it (a queued message counts as a whole inject) */
+static void protocolRunCongestion(void)
+{
+    protocol_port_t *psPort = protocolPortTo(asPorts[0].sLink.u8DefaultPeer);
+    congestion_health_t sHealth;
+    size_t tQueued = 0;
+
+    protocolSendQuenches();
+
+    sHealth.u32Refused = u32InjectRefused;
+    sHealth.u32Quenches = psPort->sLink.u32RxQuenches;
+    sHealth.u32RxPackets = psPort->sLink.u32RxPackets;
+    sHealth.u32RxErrors = psPort->sLink.u32RxErrors;
+    sHealth.u32TxBytes = psPort->sTxAggregator.u32Bytes;
+    FIFO_count(txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK), &tQueued);
+    sHealth.u32Queued = (uint32_t)tQueued + (uint32_t)uxQueueMessagesWaiting(tQueueProtocol) * ADDRESSED_SIZE(PACKE_SIZE(PROTOCOL_INJECT_MESSAGE_SIZE));
+    sHealth.bHeld = linkSpeed_isQuiet(psPort->sLink.psSpeed);
+
+    if(congestion_run(&sCongestion, &sHealth) == true && imuStream_adapt(sCongestion.u8Rate) == QUELL_ERROR)
+    {
+        ESP_LOGI(TAG, "Error adapting the imu streams to %u/%u", sCongestion.u8Rate, CONGESTION_RATE_STEPS);
     }
+    channel_throttle(&sChannels, sCongestion.u8Rate);
+}
+
+/* Tunnel messages go on the bulk lane after the data, within their caps, one at a time and only on a link with nothing else to send */
+static void protocolRunChannels(void)
+{
+    uint8_t au8Message[MESSAGE_CHANNEL_MAX_SIZE];
+    uint16_t u16Size;
+    size_t tFree;
 
+    for(uint8_t u8Channel = 0; u8Channel < CHANNEL_TUNNELS; u8Channel++)
+    {
+        uint8_t u8Peer = channel_getPeer(&sChannels, u8Channel);
+        protocol_port_t *psPort = protocolPortTo(u8Peer);
+        fifo_t *psFIFOBulk = txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK);
+
+        if(txScheduler_isIdle(&psPort->sTxScheduler) == true &&
+           FIFO_free(psFIFOBulk, &tFree) == true && tFree > ADDRESSED_SIZE(PACKE_SIZE(0)) &&
+           channel_makeMessage(&sChannels, u8Channel, tFree - ADDRESSED_SIZE(PACKE_SIZE(0)), au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+        {
+            protocolLink_send(&psPort->sLink, psFIFOBulk, u8Peer, au8Message, u16Size);
+        }
+    }
+}
+
+static void protocol_task(void *pvParameters)
+{
     for(;;) 
     {
-        /* Transfer received bytes from uart to FIFO Rx */
-        uartReceiveBytes(PROTOCOL_UART_NUM, uart_queue_rx, &sFIFORx, TAG);
-        /* Transfer received bytes from FIFO Rx to uart*/
-        uartSendBytes(PROTOCOL_UART_NUM, &sFIFOTx, TAG);
+        /* Sleep until an io task has new bytes (or the poll time for injected data elapses) */
+        ulTaskNotifyTake(pdTRUE, TASK_POLL_TICKS);
 
         /* Transfer injected packet to FIFO */
-        protocolTransferInjectedDataToFIFO(&sFIFOTx);
+        protocolTransferInjectedDataToFIFO();
+
+        /* Process incoming data (frames for others are cut through first), acknowledgements go out on the control lane of the same link */
+        for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+        {
+            protocol_port_t *psPort = &asPorts[u8Port];
+            while(processIncomingCommunication(&psPort->sFIFORx, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_CONTROL), &psPort->sLink, TAG) == QUELL_OK);
+            protocolRunBench(psPort);
+        }
+        protocolRunChannels();
 
-        /* Process incoming data */
-        processIncomingCommunication(&sFIFORx, &sFIFOTx, TAG);
+        protocolRunCongestion();
     }
-    free(pu8FIFORxBuffer);
-    pu8FIFORxBuffer = NULL;
-    free(pu8FIFOTxBuffer);
-    pu8FIFOTxBuffer = NULL;
     vTaskDelete(NULL);
 }
 
 
 
-void protocolTaskInit(void)
+/* Consumers (history window, classifier, logger, terminal) each get their own cursor on the received messages */
+int32_t protocolSubscribe(sample_bus_subscriber_t *_psSubscriber)
+{
+    if(asPorts[0].sLink.psBus == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    return sampleBus_subscribe(asPorts[0].sLink.psBus, _psSubscriber);
+}
+
+/* Asks the peer to switch FEC on the link, both directions follow once it accepts */
+int32_t protocolRequestFEC(bool _bEnable)
+{
+    const char *pcRequest = (_bEnable == true) ? MESSAGE_FEC_REQUEST : MESSAGE_NOFEC_REQUEST;
+
+    return protocolInjectMessage((uint8_t*)pcRequest, strlen(pcRequest));
+}
+
+/* Bus master only: owners[0] must be the master, starts with the next cycle */
+int32_t protocolSetSchedule(const uint8_t *_pu8Owners, uint8_t _u8Slots, uint16_t _u16SlotUs, uint16_t _u16GuardUs)
+{
+    return tdma_setSchedule(asPorts[0].sLink.psTdma, _pu8Owners, _u8Slots, _u16SlotUs, _u16GuardUs);
+}
+
+/* Chain only: frames for _u8Address leave through _u8Port (ROUTER_PORT_NONE: back to learning it) */
+int32_t protocolSetRoute(uint8_t _u8Address, uint8_t _u8Port)
+{
+    if(asPorts[0].sLink.psRouter == NULL || (_u8Port >= PROTOCOL_PORTS && _u8Port != ROUTER_PORT_NONE))
+    {
+        return QUELL_ERROR;
+    }
+
+    return router_setRoute(asPorts[0].sLink.psRouter, _u8Address, _u8Port);
+}
+
+/* Pings _u32Count bench messages of _u16Size bytes to _u8Destination one at a time, the results are printed when done */
+int32_t protocolBench(uint8_t _u8Destination, uint32_t _u32Count, uint16_t _u16Size)
+{
+    link_bench_request_t sRequest = {.eMode = LINK_BENCH_PING, .u8Destination = _u8Destination, .u16Size = _u16Size, .u32Count = _u32Count};
+
+    return linkBench_request(&protocolPortTo(_u8Destination)->sBench, &sRequest);
+}
+
+/* Streams bench messages of _u16Size bytes to _u8Destination at _u32Rate per second (0: as fast as the link takes them) for _u32Seconds */
+int32_t protocolLoad(uint8_t _u8Destination, uint16_t _u16Size, uint32_t _u32Rate, uint32_t _u32Seconds)
+{
+    link_bench_request_t sRequest = {.eMode = LINK_BENCH_LOAD, .u8Destination = _u8Destination, .u16Size = _u16Size, .u32Rate = _u32Rate,
+                                     .u32DurationUs = _u32Seconds * 1000000UL};
+
+    if(_u32Seconds > (INT32_MAX / 1000000UL))
+    {
+        return QUELL_ERROR;
+    }
+
+    return linkBench_request(&protocolPortTo(_u8Destination)->sBench, &sRequest);
+}
+
+/* Maximum baud rate of every point to point link (a rate of the ladder in linkSpeed.h), PROTOCOL_BAUD_RATE keeps them there */
+int32_t protocolSetMaxBaud(uint32_t _u32Baud)
+{
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        if(asPorts[u8Port].sLink.psSpeed != NULL && linkSpeed_setMaximum(asPorts[u8Port].sLink.psSpeed, _u32Baud) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+/* Congestion control of the imu streams, off sends them at the rate configured */
+void protocolSetCongestion(bool _bEnable)
+{
+    congestion_enable(&sCongestion, _bEnable);
+}
+
+void protocolPrintCongestion(void)
+{
+    congestion_print(&sCongestion, TAG);
+}
+
+/* Queues _u16Size bytes for the peer of tunnel _u8Channel (MESSAGE_CHANNEL_TERMINAL or MESSAGE_CHANNEL_LOG), all of them or none */
+int32_t protocolTunnelWrite(uint8_t _u8Channel, const char *_pcData, uint16_t _u16Size)
+{
+    int32_t i32Result;
+
+    portENTER_CRITICAL(&sChannelLock);
+    i32Result = channel_write(&sChannels, _u8Channel, _pcData, _u16Size);
+    portEXIT_CRITICAL(&sChannelLock);
+
+    return i32Result;
+}
+
+/* One message received on tunnel _u8Channel and the address of the unit that sent it, one reader task per tunnel */
+int32_t protocolTunnelRead(uint8_t _u8Channel, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Source)
+{
+    return channel_read(&sChannels, _u8Channel, _pcBuffer, _u16BufferSize, _pu16Size, _pu8Source);
+}
+
+/* The terminal tunnel leads to _u8Address from now on (a unit answers whoever wrote to it last by itself) */
+int32_t protocolTunnelOpen(uint8_t _u8Address)
+{
+    return channel_setPeer(&sChannels, MESSAGE_CHANNEL_TERMINAL, _u8Address);
+}
+
+/* While on, the log output of the calling task goes to the terminal tunnel (what a remote command prints), returns the lines cut when switched off */
+uint32_t protocolTunnelCapture(bool _bEnable)
+{
+    if(_bEnable == true)
+    {
+        u32CaptureCut = 0;
+    }
+    tCaptureTask = (_bEnable == true) ? xTaskGetCurrentTaskHandle() : NULL;
+
+    return u32CaptureCut;
+}
+
+/* Where log lines go after the tunnels, returns the one replaced: a terminal stream keeps text off UART0 without cutting the tunnels */
+vprintf_like_t protocolSetLogConsole(vprintf_like_t _fpConsole)
+{
+    vprintf_like_t fpReplaced = fpLogVprintf;
+
+    fpLogVprintf = _fpConsole;
+
+    return fpReplaced;
+}
+
+/* Bytes per second on the wire, 0 for no cap (the lane reserve of the data still holds) */
+int32_t protocolSetTunnelCap(uint8_t _u8Channel, uint32_t _u32Cap)
+{
+    return channel_setCap(&sChannels, _u8Channel, _u32Cap);
+}
+
+void protocolPrintChannels(void)
+{
+    channel_print(&sChannels, TAG);
+}
+
+/* Log lines of the capturing task go to the terminal tunnel (waiting for room, until one line did not get it), the others to the log tunnel if it has room (PROTOCOL_LOG_TUNNEL) */
+static int protocolLogVprintf(const char *_pcFormat, va_list _tArgs)
+{
+    char acLine[PROTOCOL_LOG_LINE_SIZE];
+    uint8_t u8Channel = (tCaptureTask != NULL && xTaskGetCurrentTaskHandle() == tCaptureTask) ? MESSAGE_CHANNEL_TERMINAL : MESSAGE_CHANNEL_LOG;
+    TickType_t tStart = xTaskGetTickCount();
+    va_list tArgs;
+    int iLength;
+
+    va_copy(tArgs, _tArgs);
+    iLength = vsnprintf(acLine, sizeof(acLine), _pcFormat, tArgs);
+    va_end(tArgs);
+
+    /* The peer is gone or stalled: the rest of the command is not held up line by line */
+    if(u8Channel == MESSAGE_CHANNEL_TERMINAL && u32CaptureCut > 0)
+    {
+        u32CaptureCut++;
+    }
+    else if(iLength > 0 && (u8Channel == MESSAGE_CHANNEL_TERMINAL || PROTOCOL_LOG_TUNNEL == 1))
+    {
+        /* A cut line still ends the line */
+        if(iLength >= (int)sizeof(acLine))
+        {
+            iLength = sizeof(acLine) - 1;
+            acLine[iLength - 1] = '\n';
+        }
+        while(protocolTunnelWrite(u8Channel, acLine, (uint16_t)iLength) == QUELL_ERROR && u8Channel == MESSAGE_CHANNEL_TERMINAL)
+        {
+            if((xTaskGetTickCount() - tStart) >= pdMS_TO_TICKS(PROTOCOL_TUNNEL_WAIT_MS))
+            {
+                u32CaptureCut = 1;
+                break;
+            }
+            vTaskDelay(1);
+        }
+    }
+
+    return fpLogVprintf(_pcFormat, _tArgs);
+}
+
+/* Last bench run of every link and what each received */
+void protocolPrintBench(void)
+{
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        if(PROTOCOL_PORTS > 1)
+        {
+            ESP_LOGI(TAG, "port %u (uart %u)", u8Port, asPorts[u8Port].u32Uart);
+        }
+        linkBench_print(&asPorts[u8Port].sBench, TAG);
+    }
+}
+
+void protocolPrintStats(void)
+{
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        protocol_port_t *psPort = &asPorts[u8Port];
+        tx_scheduler_t *psTxScheduler = &psPort->sTxScheduler;
+        protocol_link_t *psLink = &psPort->sLink;
+
+        if(PROTOCOL_PORTS > 1)
+        {
+            ESP_LOGI(TAG, "port %u (uart %u)", u8Port, psPort->u32Uart);
+        }
+        ESP_LOGI(TAG, "tx frames control:%u bulk:%u forward:%u tunnel:%u starvation grants:%u credit stalls:%u",
+                 psTxScheduler->sStats.u32Frames[TX_LANE_CONTROL], psTxScheduler->sStats.u32Frames[TX_LANE_BULK], psTxScheduler->sStats.u32Frames[TX_LANE_FORWARD],
+                 psTxScheduler->sStats.u32Frames[TX_LANE_TUNNEL],
+                 psTxScheduler->sStats.u32StarvationGrants, psTxScheduler->sStats.u32CreditStalls);
+        ESP_LOGI(TAG, "tx writes:%u frames/write:%u.%02u bytes/write:%u",
+                 psPort->sTxAggregator.u32Writes,
+                 (psPort->sTxAggregator.u32Writes > 0) ? psPort->sTxAggregator.u32Frames / psPort->sTxAggregator.u32Writes : 0,
+                 (psPort->sTxAggregator.u32Writes > 0) ? ((psPort->sTxAggregator.u32Frames * 100) / psPort->sTxAggregator.u32Writes) % 100 : 0,
+                 (psPort->sTxAggregator.u32Writes > 0) ? psPort->sTxAggregator.u32Bytes / psPort->sTxAggregator.u32Writes : 0);
+        ESP_LOGI(TAG, "credits sent:%u received:%u rx bytes:%u tx bytes:%u",
+                 psLink->sFlowControl.u32CreditsSent, psLink->sFlowControl.u32CreditsReceived, psLink->sFlowControl.u32RxReceived, psLink->sFlowControl.u32TxSent);
+        ESP_LOGI(TAG, "rx packets:%u errors:%u foreign:%u fec tx:%s fec rx frames:%u corrected:%u failures:%u",
+                 psLink->u32RxPackets, psLink->u32RxErrors, psLink->u32RxForeign, (psLink->bFECTx == true) ? "on" : "off",
+                 psLink->u32RxFECFrames, psLink->u32RxFECCorrected, psLink->u32RxFECFailures);
+        if(psLink->psSpeed != NULL)
+        {
+            linkSpeed_print(psLink->psSpeed, TAG);
+        }
+        if(psLink->psRouter != NULL)
+        {
+            router_port_t *psRouterPort = &psLink->psRouter->asPorts[u8Port];
+            ESP_LOGI(TAG, "forwarded:%u padded:%u no route:%u dropped:%u marked:%u yielded:%u",
+                     psRouterPort->u32Forwarded, psRouterPort->u32Padded, psRouterPort->u32NoRoute, psRouterPort->u32Dropped, psRouterPort->u32Marked,
+                     psRouterPort->u32Yielded);
+        }
+    }
+    protocolPrintCongestion();
+    ESP_LOGI(TAG, "bus published:%u slots:%u x %u bytes",
+             sSampleBus.u32Head, sSampleBus.u32SlotCount, sSampleBus.u16SlotSize);
+    if(asPorts[0].sLink.psTdma != NULL)
+    {
+        ESP_LOGI(TAG, "tdma address:%u %s cycle:%u slots:%u x %uus guard:%uus beacons:%u lost:%u tx bytes:%u",
+                 sTdma.u8Address, (sTdma.bSynchronised == true) ? "in sync" : "waiting for beacon", sTdma.u16Cycle,
+                 sTdma.sSchedule.u8Slots, sTdma.sSchedule.u16SlotUs, sTdma.sSchedule.u16GuardUs,
+                 sTdma.u32Beacons, sTdma.u32BeaconsLost, sTdma.u32TxBytes);
+    }
+    if(asPorts[0].sLink.psRouter != NULL)
+    {
+        char acRoutes[ROUTER_MAX_ADDRESSES * 6 + 1] = "";
+        size_t tLength = 0;
+        for(uint8_t u8Address = 0; u8Address < ROUTER_MAX_ADDRESSES; u8Address++)
+        {
+            if(sRouter.au8Route[u8Address] != ROUTER_PORT_NONE)
+            {
+                tLength += snprintf(&acRoutes[tLength], sizeof(acRoutes) - tLength, " %u>%u", u8Address, sRouter.au8Route[u8Address]);
+            }
+        }
+        ESP_LOGI(TAG, "chain address:%u default port:%u routes (address>port):%s", sRouter.u8Address, sRouter.u8DefaultPort, acRoutes);
+    }
+}
+
+/* Installs the uart of a port and its link, _iRTS is the DE of the transceiver on the bus */
+static int32_t protocolPortInit(protocol_port_t *_psPort, uint32_t _u32Uart, int _iTx, int _iRx, int _iRTS, int _iCTS)
 {
     /* Configure parameters of an UART driver,
      * communication pins and install the driver */
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = PROTOCOL_BAUD_RATE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -112,18 +779,141 @@ void protocolTaskInit(void)
         .source_clk = UART_SCLK_APB,
     };
 
-    //Install UART driver, and get the queue.
-    uart_driver_install(PROTOCOL_UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 20, &uart_queue_rx, 0);
-    uart_param_config(PROTOCOL_UART_NUM, &uart_config);
+    _psPort->u32Uart = _u32Uart;
+
+    //Install UART driver, and get the queue. Its ISR in IRAM keeps emptying the hardware FIFO while the flash log erases (flashLog.h)
+    uart_driver_install(_u32Uart, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 20, &_psPort->tQueueRx, ESP_INTR_FLAG_IRAM);
+    uart_param_config(_u32Uart, &uart_config);
+    uart_set_pin(_u32Uart, _iTx, _iRx, _iRTS, _iCTS);
+
+    //Create the FIFOs shared by the io and processing tasks
+    char* pu8FIFORxBuffer = (char*) malloc(RX_FIFO_BUF_SIZE);
+    char* pu8FIFOTxControlBuffer = (char*) malloc(FIFO_BUF_SIZE);
+    char* pu8FIFOTxBulkBuffer = (char*) malloc(TX_BULK_FIFO_BUF_SIZE);
+    char* pu8TxAggregatorBuffer = (char*) malloc(TX_AGGREGATOR_BUFFER_SIZE);
+    if(FIFO_init(&_psPort->sFIFORx, pu8FIFORxBuffer, RX_FIFO_BUF_SIZE) == false || 
+       uartAggregator_init(&_psPort->sTxAggregator, pu8TxAggregatorBuffer, TX_AGGREGATOR_BUFFER_SIZE, (PROTOCOL_BUS_MODE == 1) ? 0 : TX_AGGREGATOR_DEADLINE_MS) == QUELL_ERROR ||
+       protocolLink_init(&_psPort->sLink, RX_FIFO_BUF_SIZE, RX_CREDIT_RESERVE) == QUELL_ERROR ||
+       txScheduler_init(&_psPort->sTxScheduler, pu8FIFOTxControlBuffer, FIFO_BUF_SIZE, pu8FIFOTxBulkBuffer, TX_BULK_FIFO_BUF_SIZE, TX_MAX_CONTROL_BURST) == QUELL_ERROR)
+    {
+        free(pu8FIFORxBuffer);
+        free(pu8FIFOTxControlBuffer);
+        free(pu8FIFOTxBulkBuffer);
+        free(pu8TxAggregatorBuffer);
+        return QUELL_ERROR;
+    }
+    _psPort->sLink.psBus = &sSampleBus;
+    linkBench_init(&_psPort->sBench, protocolNowUs);
+    _psPort->sLink.psBench = &_psPort->sBench;
+
+    return QUELL_OK;
+}
 
+void protocolTaskInit(void)
+{
     //Set UART log level
     esp_log_level_set(TAG, ESP_LOG_INFO);
-    //Set UART pins (using UART0 default pins ie no changes.)
-    uart_set_pin(PROTOCOL_UART_NUM, 4, 5, 18, 19);
 
     //Create Protocol queue (to inject messages from other tasks to go out through uart) @todo: Make the others FIFOs from FreeRTOS Queues 
-    tQueueProtocol = xQueueCreate(PROTOCOL_QUEUE_SIZE, sizeof(char));
+    tQueueProtocol = xQueueCreate(PROTOCOL_QUEUE_SIZE, sizeof(protocol_inject_t));
+
+    //Every link publishes what it receives on the same sample bus (only the processing task writes it)
+    uint8_t* pu8SampleBusBuffer = (uint8_t*) malloc(SAMPLE_BUS_BUFFER_SIZE(PROTOCOL_BUS_SLOT_SIZE, PROTOCOL_BUS_SLOT_COUNT));
+    if(sampleBus_init(&sSampleBus, pu8SampleBusBuffer, SAMPLE_BUS_BUFFER_SIZE(PROTOCOL_BUS_SLOT_SIZE, PROTOCOL_BUS_SLOT_COUNT), PROTOCOL_BUS_SLOT_SIZE) == QUELL_ERROR ||
+       protocolPortInit(&asPorts[0], PROTOCOL_UART_NUM, 4, 5, 18, 19) == QUELL_ERROR ||
+       (PROTOCOL_PORTS > 1 && protocolPortInit(&asPorts[PROTOCOL_PORTS - 1], PROTOCOL_DOWNLINK_UART_NUM, 17, 16, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) == QUELL_ERROR))
+    {
+        ESP_LOGI(TAG, "Error initializing FIFO Rx or Tx");
+        free(pu8SampleBusBuffer);
+        return;
+    }
+
+#if (PROTOCOL_BUS_MODE == 1)
+    //The driver raises RTS (the transceiver DE) while it transmits
+    uart_set_mode(PROTOCOL_UART_NUM, UART_MODE_RS485_HALF_DUPLEX);
+
+    //Written to the uart as soon as they are in the aggregator (deadline 0 above), the slot allowance counts from then
+    const uint8_t au8Owners[] = {ADDRESS_MASTER, 1, 2};
+    if(tdma_init(&sTdma, PROTOCOL_NODE_ADDRESS, PROTOCOL_BAUD_RATE, protocolNowUs) == QUELL_ERROR ||
+       protocolLink_initBus(&asPorts[0].sLink, PROTOCOL_NODE_ADDRESS, &sTdma) == QUELL_ERROR ||
+       (sTdma.bMaster == true && tdma_setSchedule(&sTdma, au8Owners, sizeof(au8Owners), TDMA_DEFAULT_SLOT_US, TDMA_DEFAULT_GUARD_US) == QUELL_ERROR))
+    {
+        ESP_LOGI(TAG, "Error initializing the bus");
+        return;
+    }
+#endif
 
-    //Create Protocol task
-    xTaskCreate(protocol_task, "protocol_task", 4096, NULL, 0, NULL);
-}
\ No newline at end of file
+#if (PROTOCOL_CHAIN_MODE == 1)
+    //Port 0 leads to the chest. A frame only goes onto the bus once all of it arrived (it must fit the slot)
+    if(router_init(&sRouter, PROTOCOL_NODE_ADDRESS, 0, protocolNowUs) == QUELL_ERROR)
+    {
+        ESP_LOGI(TAG, "Error initializing the chain");
+        return;
+    }
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        protocol_port_t *psPort = &asPorts[u8Port];
+        char* pu8FIFOTxForwardBuffer = (char*) malloc(TX_FORWARD_FIFO_BUF_SIZE);
+        char* pu8FIFOTxTunnelBuffer = (char*) malloc(TX_TUNNEL_FIFO_BUF_SIZE);
+        if(txScheduler_initForward(&psPort->sTxScheduler, pu8FIFOTxForwardBuffer, TX_FORWARD_FIFO_BUF_SIZE, pu8FIFOTxTunnelBuffer, TX_TUNNEL_FIFO_BUF_SIZE) == QUELL_ERROR ||
+           (psPort->sLink.bAddressed == false && protocolLink_initAddressed(&psPort->sLink, PROTOCOL_NODE_ADDRESS) == QUELL_ERROR) ||
+           router_attachPort(&sRouter, u8Port, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_FORWARD), txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_TUNNEL),
+                             psPort->sLink.psTdma != NULL) == QUELL_ERROR ||
+           protocolLink_initRouted(&psPort->sLink, &sRouter, u8Port) == QUELL_ERROR)
+        {
+            ESP_LOGI(TAG, "Error initializing the chain");
+            free(pu8FIFOTxForwardBuffer);
+            free(pu8FIFOTxTunnelBuffer);
+            return;
+        }
+    }
+#endif
+
+    //Point to point links negotiate their baud rate (a bus runs at the one rate all units share)
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        protocol_port_t *psPort = &asPorts[u8Port];
+        if(psPort->sLink.psTdma == NULL)
+        {
+            if(linkSpeed_init(&psPort->sSpeed, PROTOCOL_MAX_BAUD_RATE, PROTOCOL_NODE_ADDRESS, protocolNowUs) == QUELL_ERROR)
+            {
+                ESP_LOGI(TAG, "Error initializing the link speed");
+                return;
+            }
+            psPort->sLink.psSpeed = &psPort->sSpeed;
+        }
+    }
+
+    congestion_init(&sCongestion, protocolNowUs);
+
+    //Terminal and log tunnels, toward the master (or every unit from the master) until a session opens
+    char* pu8TerminalTxBuffer = (char*) malloc(TERMINAL_TX_BUF_SIZE);
+    char* pu8TerminalRxBuffer = (char*) malloc(TERMINAL_RX_BUF_SIZE);
+    char* pu8LogTxBuffer = (char*) malloc(LOG_TX_BUF_SIZE);
+    char* pu8LogRxBuffer = (char*) malloc(LOG_RX_BUF_SIZE);
+    if(channel_init(&sChannels, protocolNowUs) == QUELL_ERROR ||
+       channel_initTunnel(&sChannels, MESSAGE_CHANNEL_TERMINAL, pu8TerminalTxBuffer, TERMINAL_TX_BUF_SIZE, pu8TerminalRxBuffer, TERMINAL_RX_BUF_SIZE, CHANNEL_TERMINAL_CAP) == QUELL_ERROR ||
+       channel_initTunnel(&sChannels, MESSAGE_CHANNEL_LOG, pu8LogTxBuffer, LOG_TX_BUF_SIZE, pu8LogRxBuffer, LOG_RX_BUF_SIZE, CHANNEL_LOG_CAP) == QUELL_ERROR)
+    {
+        ESP_LOGI(TAG, "Error initializing the tunnels");
+        free(pu8TerminalTxBuffer);
+        free(pu8TerminalRxBuffer);
+        free(pu8LogTxBuffer);
+        free(pu8LogRxBuffer);
+        return;
+    }
+    channel_setPeer(&sChannels, MESSAGE_CHANNEL_TERMINAL, asPorts[0].sLink.u8DefaultPeer);
+    channel_setPeer(&sChannels, MESSAGE_CHANNEL_LOG, asPorts[0].sLink.u8DefaultPeer);
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        asPorts[u8Port].sLink.psChannels = &sChannels;
+    }
+    fpLogVprintf = esp_log_set_vprintf(protocolLogVprintf);
+
+    //Create Protocol tasks (processing first, so the io tasks always have someone to notify)
+    xTaskCreatePinnedToCore(protocol_task, "protocol_task", PROTOCOL_TASK_STACK_SIZE, NULL, PROTOCOL_TASK_PRIORITY, &tProtocolTaskHandle, PROTOCOL_TASK_CORE);
+    for(uint8_t u8Port = 0; u8Port < PROTOCOL_PORTS; u8Port++)
+    {
+        xTaskCreatePinnedToCore(protocol_io_task, (u8Port == 0) ? "protocol_io" : "protocol_io_down", PROTOCOL_IO_TASK_STACK_SIZE, &asPorts[u8Port], PROTOCOL_IO_TASK_PRIORITY, NULL, PROTOCOL_IO_TASK_CORE);
+    }
+}
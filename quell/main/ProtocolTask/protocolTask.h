@@ -1,8 +1,29 @@
 #ifndef _PROTOCOL_TASK_H_
 #define _PROTOCOL_TASK_H_
 #include "protocol.h"
+#include "esp_log.h"
 
 void protocolTaskInit(void);
-int32_t protocolInjectData(char* _pcData, uint16_t _u16DataLenght);
+int32_t protocolInjectMessage(uint8_t* _pu8Message, uint16_t _u16MessageSize);
+int32_t protocolInjectMessageTo(uint8_t _u8Destination, uint8_t* _pu8Message, uint16_t _u16MessageSize);
+uint8_t protocolGetDefaultPeer(void);
+int32_t protocolSubscribe(sample_bus_subscriber_t *_psSubscriber);
+int32_t protocolRequestFEC(bool _bEnable);
+int32_t protocolSetSchedule(const uint8_t *_pu8Owners, uint8_t _u8Slots, uint16_t _u16SlotUs, uint16_t _u16GuardUs);
+int32_t protocolSetRoute(uint8_t _u8Address, uint8_t _u8Port);
+int32_t protocolBench(uint8_t _u8Destination, uint32_t _u32Count, uint16_t _u16Size);
+int32_t protocolLoad(uint8_t _u8Destination, uint16_t _u16Size, uint32_t _u32Rate, uint32_t _u32Seconds);
+void protocolPrintBench(void);
+int32_t protocolTunnelWrite(uint8_t _u8Channel, const char *_pcData, uint16_t _u16Size);
+int32_t protocolTunnelRead(uint8_t _u8Channel, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Size, uint8_t *_pu8Source);
+int32_t protocolTunnelOpen(uint8_t _u8Address);
+uint32_t protocolTunnelCapture(bool _bEnable);
+vprintf_like_t protocolSetLogConsole(vprintf_like_t _fpConsole);
+int32_t protocolSetTunnelCap(uint8_t _u8Channel, uint32_t _u32Cap);
+void protocolPrintChannels(void);
+int32_t protocolSetMaxBaud(uint32_t _u32Baud);
+void protocolSetCongestion(bool _bEnable);
+void protocolPrintCongestion(void);
+void protocolPrintStats(void);
 
 #endif /* _PROTOCOL_TASK_H_ */
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "router.h"
+#include "protocol.h"
+#include "quell.h"
+
+int32_t router_init(router_t *_psRouter, uint8_t _u8Address, uint8_t _u8DefaultPort, router_clock_t _fpNowUs)
+{
+    if(_psRouter == NULL || _u8Address == ADDRESS_BROADCAST || _u8DefaultPort >= ROUTER_MAX_PORTS || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psRouter, 0, sizeof(router_t));
+    _psRouter->fpNowUs = _fpNowUs;
+    _psRouter->u8Address = _u8Address;
+    _psRouter->u8DefaultPort = _u8DefaultPort;
+    memset(_psRouter->au8Route, ROUTER_PORT_NONE, sizeof(_psRouter->au8Route));
+    for(uint8_t u8Port = 0; u8Port < ROUTER_MAX_PORTS; u8Port++)
+    {
+        _psRouter->asPorts[u8Port].u8Feeder = ROUTER_PORT_NONE;
+    }
+
+    return QUELL_OK;
+}
+
+int32_t router_attachPort(router_t *_psRouter, uint8_t _u8Port, fifo_t *_psForwardLane, fifo_t *_psTunnelLane, bool _bWholeFrames)
+{
+    if(_psRouter == NULL || _u8Port >= ROUTER_MAX_PORTS || _psForwardLane == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psRouter->asPorts[_u8Port].psForwardLane = _psForwardLane;
+    _psRouter->asPorts[_u8Port].psTunnelLane = _psTunnelLane;
+    _psRouter->asPorts[_u8Port].bWholeFrames = _bWholeFrames;
+
+    return QUELL_OK;
+}
+
+/* ROUTER_PORT_NONE forgets the route, the address goes to the default port again */
+int32_t router_setRoute(router_t *_psRouter, uint8_t _u8Address, uint8_t _u8Port)
+{
+    if(_psRouter == NULL || _u8Address >= ROUTER_MAX_ADDRESSES || (_u8Port >= ROUTER_MAX_PORTS && _u8Port != ROUTER_PORT_NONE))
+    {
+        return QUELL_ERROR;
+    }
+
+    _psRouter->au8Route[_u8Address] = _u8Port;
+
+    return QUELL_OK;
+}
+
+/* io task: the lanes of _u8Port are held on purpose (link speed change), frames for it wait instead of being dropped */
+void router_holdPort(router_t *_psRouter, uint8_t _u8Port, bool _bHeld)
+{
+    if(_psRouter != NULL && _u8Port < ROUTER_MAX_PORTS)
+    {
+        _psRouter->asPorts[_u8Port].bHeld = _bHeld;
+    }
+}
+
+/* io task: peer credit left on _u8Port, below what its forward lane holds the frames for it wait up to ROUTER_CREDIT_US */
+void router_creditPort(router_t *_psRouter, uint8_t _u8Port, uint16_t _u16Allowance)
+{
+    size_t tCount;
+
+    if(_psRouter != NULL && _u8Port < ROUTER_MAX_PORTS && _psRouter->asPorts[_u8Port].psForwardLane != NULL &&
+       FIFO_count(_psRouter->asPorts[_u8Port].psForwardLane, &tCount) == true)
+    {
+        _psRouter->asPorts[_u8Port].bStarved = (tCount > _u16Allowance);
+    }
+}
+
+uint8_t router_getPort(router_t *_psRouter, uint8_t _u8Address)
+{
+    uint8_t u8Port;
+
+    if(_psRouter == NULL)
+    {
+        return ROUTER_PORT_NONE;
+    }
+
+    u8Port = (_u8Address < ROUTER_MAX_ADDRESSES) ? _psRouter->au8Route[_u8Address] : ROUTER_PORT_NONE;
+
+    return (u8Port == ROUTER_PORT_NONE) ? _psRouter->u8DefaultPort : u8Port;
+}
+
+/* Looks at the head of the FIFO Rx of a port, starts or continues cutting a frame through to the next link */
+router_result_t router_forward(router_t *_psRouter, uint8_t _u8Port, fifo_t *_psFIFORx)
+{
+    router_port_t *psIn;
+    router_port_t *psOut;
+    uint8_t au8Header[ADDRESSED_SIZE(5)];     //Up to the message id
+    fifo_t *psLane;
+    bool bTunnel;
+    uint16_t u16FrameSize;
+    uint16_t u16Moved = 0;
+    uint8_t u8OutPort;
+    uint32_t u32Now;
+    size_t tCount;
+    size_t tFree;
+    char cData;
+
+    if(_psRouter == NULL || _u8Port >= ROUTER_MAX_PORTS || _psFIFORx == NULL)
+    {
+        return ROUTER_LOCAL;
+    }
+    psIn = &_psRouter->asPorts[_u8Port];
+    u32Now = _psRouter->fpNowUs();
+
+    if(psIn->u16Remaining == 0)
+    {
+        if(trimFIFOForPacket(_psFIFORx) == QUELL_ERROR || FIFO_count(_psFIFORx, &tCount) == false || tCount < sizeof(au8Header))
+        {
+            return ROUTER_LOCAL;
+        }
+
+        for(uint16_t u16Index = 0; u16Index < sizeof(au8Header); u16Index++)
+        {
+            FIFO_peak(_psFIFORx, u16Index, (char*)&au8Header[u16Index]);
+        }
+
+        /* Anything but a sound address header is the parser's business (it drops the noise) */
+        if(au8Header[0] != SOA || verifyAddressHeader(au8Header) == QUELL_ERROR)
+        {
+            return ROUTER_LOCAL;
+        }
+
+        /* Answers to the source go back where it came from */
+        if(au8Header[2] < ROUTER_MAX_ADDRESSES && au8Header[2] != _psRouter->u8Address)
+        {
+            _psRouter->au8Route[au8Header[2]] = _u8Port;
+        }
+
+        if(au8Header[1] == _psRouter->u8Address || au8Header[1] == ADDRESS_BROADCAST)
+        {
+            return ROUTER_LOCAL;
+        }
+
+        u8OutPort = router_getPort(_psRouter, au8Header[1]);
+        if(u8OutPort == _u8Port && (au8Header[1] >= ROUTER_MAX_ADDRESSES || _psRouter->au8Route[au8Header[1]] == ROUTER_PORT_NONE))
+        {
+            /* Not learnt yet and came in from the default side: it lives further out, on the other port */
+            for(uint8_t u8Port = 0; u8Port < ROUTER_MAX_PORTS; u8Port++)
+            {
+                if(u8Port != _u8Port && _psRouter->asPorts[u8Port].psForwardLane != NULL)
+                {
+                    u8OutPort = u8Port;
+                    break;
+                }
+            }
+        }
+        u16FrameSize = ADDRESSED_SIZE(((uint16_t)au8Header[ADDRESS_HEADER_SIZE + 1] << 8) | au8Header[ADDRESS_HEADER_SIZE + 2]);
+        bTunnel = (_psRouter->asPorts[u8OutPort].psTunnelLane != NULL && au8Header[ADDRESS_HEADER_SIZE + 4] == MESSAGE_CHANNEL_ID);
+        psLane = (bTunnel == true) ? _psRouter->asPorts[u8OutPort].psTunnelLane : _psRouter->asPorts[u8OutPort].psForwardLane;
+        if(u8OutPort == _u8Port || psLane == NULL || u16FrameSize < ADDRESSED_SIZE(MINIMUM_PACKET_SIZE) || u16FrameSize >= psLane->size)
+        {
+            psIn->u32NoRoute++;
+            return ROUTER_LOCAL;
+        }
+        psOut = &_psRouter->asPorts[u8OutPort];
+
+        if(psOut->bWholeFrames == true && tCount < u16FrameSize)
+        {
+            return ROUTER_IN_FLIGHT;
+        }
+
+        /* A tunnel frame never waits for its lane: the frames behind it in the FIFO Rx would */
+        if(bTunnel == true && psOut->u8Feeder == ROUTER_PORT_NONE && (FIFO_free(psLane, &tFree) == false || tFree < u16FrameSize))
+        {
+            u8OutPort = ROUTER_PORT_NONE;
+            psIn->u32Yielded++;
+        }
+        /* Wait for the lane to take all of it (the FIFO Rx fills meanwhile, which holds the upstream unit back) */
+        else if(psOut->u8Feeder != ROUTER_PORT_NONE || FIFO_free(psLane, &tFree) == false || tFree < u16FrameSize)
+        {
+            if(psIn->bWaiting == false || psOut->bHeld == true || psLane->head != psIn->tWaitHead)
+            {
+                psIn->bWaiting = true;
+                psIn->u32WaitSinceUs = u32Now;
+                psIn->tWaitHead = psLane->head;
+            }
+            if(u32Now - psIn->u32WaitSinceUs <= ((psOut->bStarved == true) ? ROUTER_CREDIT_US : ROUTER_DRAIN_US))
+            {
+                return ROUTER_IN_FLIGHT;
+            }
+
+            /* The next link does not drain (its neighbour is gone or stalled for too long), the frame is thrown away as it comes */
+            u8OutPort = ROUTER_PORT_NONE;
+            psIn->u32Dropped++;
+            _psRouter->u16QuenchSources |= (au8Header[2] < ROUTER_MAX_ADDRESSES) ? (uint16_t)(1U << au8Header[2]) : 0;
+        }
+        else
+        {
+            psOut->u8Feeder = _u8Port;
+
+            /* The next link backs up: its source hears about it before a frame has to go */
+            if(bTunnel == false && psLane->size - 1 - tFree + u16FrameSize > ROUTER_MARK_FILL(psLane->size))
+            {
+                psIn->u32Marked++;
+                _psRouter->u16QuenchSources |= (au8Header[2] < ROUTER_MAX_ADDRESSES) ? (uint16_t)(1U << au8Header[2]) : 0;
+            }
+        }
+
+        psIn->bWaiting = false;
+        psIn->u8OutPort = u8OutPort;
+        psIn->psOutLane = psLane;
+        psIn->u16Remaining = u16FrameSize;
+        psIn->u32LastByteUs = u32Now;
+    }
+
+    psOut = (psIn->u8OutPort != ROUTER_PORT_NONE) ? &_psRouter->asPorts[psIn->u8OutPort] : NULL;
+    while(psIn->u16Remaining > 0 && FIFO_get(_psFIFORx, &cData) == true)
+    {
+        if(psOut != NULL)
+        {
+            FIFO_put(psIn->psOutLane, cData);
+        }
+        psIn->u16Remaining--;
+        u16Moved++;
+    }
+
+    if(u16Moved > 0)
+    {
+        psIn->u32LastByteUs = u32Now;
+    }
+    else if(psIn->u16Remaining > 0 && u32Now - psIn->u32LastByteUs > ROUTER_STALL_US)
+    {
+        /* The upstream unit stopped half way: finish the frame with filler, the destination drops it on the CRC */
+        while(psIn->u16Remaining > 0)
+        {
+            if(psOut != NULL)
+            {
+                FIFO_put(psIn->psOutLane, 0);
+            }
+            psIn->u16Remaining--;
+        }
+        psIn->u32Padded++;
+    }
+
+    if(psIn->u16Remaining > 0)
+    {
+        return ROUTER_IN_FLIGHT;
+    }
+
+    if(psOut != NULL)
+    {
+        psOut->u8Feeder = ROUTER_PORT_NONE;
+        psIn->u32Forwarded++;
+    }
+
+    return ROUTER_FORWARDED;
+}
+
+/* Sources of the frames dropped or marked since the last call (bit per address), cleared */
+uint16_t router_takeQuenchSources(router_t *_psRouter)
+{
+    uint16_t u16Sources;
+
+    if(_psRouter == NULL)
+    {
+        return 0;
+    }
+
+    u16Sources = _psRouter->u16QuenchSources;
+    _psRouter->u16QuenchSources = 0;
+    return u16Sources;
+}
+
+uint32_t router_getDropped(const router_t *_psRouter)
+{
+    uint32_t u32Dropped = 0;
+
+    for(uint8_t u8Port = 0; _psRouter != NULL && u8Port < ROUTER_MAX_PORTS; u8Port++)
+    {
+        u32Dropped += _psRouter->asPorts[u8Port].u32Dropped;
+    }
+
+    return u32Dropped;
+}
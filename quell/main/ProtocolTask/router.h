@@ -0,0 +1,119 @@
+#ifndef _ROUTER_H_
+#define _ROUTER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "FIFO.h"
+
+/*
+    ROUTER (daisy chained units)
+
+    A unit in the middle of a chain (hand -> elbow -> chest) has one link per neighbour (a port) and every
+    frame carries the address header (see protocol.c). Frames for the unit itself or for everybody
+    (broadcast, never forwarded: it reaches the neighbours only) are parsed as usual, the others are cut
+    through: as soon as the address header of a frame at the head of the FIFO Rx checks out (its own CRC8),
+    the frame is copied to the forward lane of the port its destination is routed to, and the rest of it
+    follows byte by byte as it arrives. The CRC16 is only checked by the destination, so a frame
+    corrupted after its header travels all the way and is dropped there.
+
+    Routing table: one port per address below ROUTER_MAX_ADDRESSES, learnt from the source of every frame
+    that arrives (the answers go back where the question came from) or set by hand (terminal "route").
+    Unknown destinations go to the default port (toward the master), or away from it when the frame came
+    in from there. A frame is never sent back out of the port it came in on (no route, dropped by the
+    parser as foreign).
+
+    A frame only starts on the next link when its forward lane has room for all of it, so once started it
+    only waits for the upstream unit. While it waits for room the FIFO Rx fills, which holds the upstream
+    unit back. A lane that drains, however slowly (the next link sends its own frames first, or its peer is
+    backed up), keeps the frame waiting; one that does not drain a byte for ROUTER_DRAIN_US (the next unit
+    is gone) gets the frame thrown away instead of holding this port, unless the next link holds its lanes
+    on purpose (bHeld, a link speed change) and the frame waits for it. A lane whose peer gave no credit for
+    what it holds (bStarved, the processing of the next unit is behind) waits up to ROUTER_CREDIT_US. When
+    the upstream unit stops half way (reset, unplugged), the rest is padded after ROUTER_STALL_US so the
+    next link is not held forever, the destination drops it on the CRC. A port with bWholeFrames (a TDMA
+    bus, where a frame must fit its slot) gets store and forward instead: the frame is only started once
+    all of it is in the FIFO Rx.
+
+    The sources of the frames thrown away are kept (router_takeQuenchSources), the processing task tells
+    them to slow down (a quench message, congestion.h): a unit further out can not see the link that is
+    full. So are the sources of frames forwarded into a lane filled past ROUTER_MARK_FILL of its size, the
+    link is backing up and they are told before anything has to be thrown away.
+
+    Tunnel frames (a channel message, channel.h) go to the tunnel lane of the next link instead, which
+    only sends when the link has nothing else: the diagnostics of a unit further out never get ahead of
+    the data of this one. One that does not fit the lane is thrown away at once rather than holding the
+    FIFO Rx (and the data behind it), its source is not quenched for it (the tunnel reports the gap).
+
+    Only the processing task calls router_forward and owns the forwarding state; the terminal may change a
+    route at any time (single byte writes).
+*/
+
+#define ROUTER_MAX_PORTS (2)
+#define ROUTER_MAX_ADDRESSES (16)
+#define ROUTER_PORT_NONE (0xFF)
+#define ROUTER_STALL_US (5000UL)
+#define ROUTER_DRAIN_US (50000UL)       //Several frames at the lowest speed, a backed up chain still drains within it
+#define ROUTER_CREDIT_US (1000000UL)    //A peer whose processing stalls gives credit again within it
+#define ROUTER_MARK_FILL(_size) ((_size) / 2)   //Lane bytes with the frame in, past which its source gets quenched
+
+typedef uint32_t (*router_clock_t)(void);  //Microseconds, wrapping
+
+typedef enum
+{
+    ROUTER_LOCAL = 0,       /* Nothing in flight, the head of the FIFO Rx is for the parser */
+    ROUTER_IN_FLIGHT,       /* A frame is being cut through and waits for more bytes, do not parse */
+    ROUTER_FORWARDED        /* A whole frame went to the next link, look at the FIFO Rx again */
+}router_result_t;
+
+typedef struct
+{
+    fifo_t *psForwardLane;          //Forward lane of the tx scheduler of this port, NULL when not attached
+    fifo_t *psTunnelLane;           //Tunnel lane of it, NULL: tunnel frames take the forward lane
+    bool bWholeFrames;              //Store and forward onto this port
+
+    /* Frame coming in on this port being cut through */
+    uint8_t u8OutPort;              //ROUTER_PORT_NONE: being thrown away
+    fifo_t *psOutLane;              //Lane of the out port it goes to (forward or tunnel)
+    uint16_t u16Remaining;          //Bytes of it still to copy, 0 on a frame boundary
+    uint32_t u32LastByteUs;
+    bool bWaiting;                  //For room in the forward lane, since u32WaitSinceUs
+    uint32_t u32WaitSinceUs;        //Or since the lane last drained a byte
+    size_t tWaitHead;               //Read index of the lane then
+
+    /* Frame going out on this port: the port feeding its lanes, one at a time */
+    uint8_t u8Feeder;
+    volatile bool bHeld;            //Set by the io task of this port, no stall meanwhile
+    volatile bool bStarved;         //Set by the io task of this port, the peer credit is below what the lane holds
+
+    /* Statistics */
+    uint32_t u32Forwarded;          //Frames that came in here and went out elsewhere
+    uint32_t u32Padded;             //Of those, cut short upstream
+    uint32_t u32NoRoute;            //Frames for others that had nowhere to go
+    uint32_t u32Dropped;            //Frames whose next link did not drain for ROUTER_DRAIN_US (ROUTER_CREDIT_US)
+    uint32_t u32Marked;             //Frames forwarded into a lane past ROUTER_MARK_FILL
+    uint32_t u32Yielded;            //Tunnel frames thrown away, their lane was full
+}router_port_t;
+
+typedef struct
+{
+    router_clock_t fpNowUs;
+    uint8_t u8Address;
+    uint8_t u8DefaultPort;
+    uint8_t au8Route[ROUTER_MAX_ADDRESSES];
+    router_port_t asPorts[ROUTER_MAX_PORTS];
+    uint16_t u16QuenchSources;      //Bit per address below ROUTER_MAX_ADDRESSES, since router_takeQuenchSources
+}router_t;
+
+int32_t router_init(router_t *_psRouter, uint8_t _u8Address, uint8_t _u8DefaultPort, router_clock_t _fpNowUs);
+int32_t router_attachPort(router_t *_psRouter, uint8_t _u8Port, fifo_t *_psForwardLane, fifo_t *_psTunnelLane, bool _bWholeFrames);
+int32_t router_setRoute(router_t *_psRouter, uint8_t _u8Address, uint8_t _u8Port);
+uint8_t router_getPort(router_t *_psRouter, uint8_t _u8Address);
+void router_holdPort(router_t *_psRouter, uint8_t _u8Port, bool _bHeld);
+void router_creditPort(router_t *_psRouter, uint8_t _u8Port, uint16_t _u16Allowance);
+router_result_t router_forward(router_t *_psRouter, uint8_t _u8Port, fifo_t *_psFIFORx);
+uint16_t router_takeQuenchSources(router_t *_psRouter);
+uint32_t router_getDropped(const router_t *_psRouter);
+
+#endif /* _ROUTER_H_ */
@@ -0,0 +1,245 @@
+#include "tdma.h"
+#include "protocol.h"
+#include "quell.h"
+
+static uint32_t tdmaAirtimeUs(tdma_t *_psTdma, uint16_t _u16Count)
+{
+    return (((uint32_t)_u16Count * _psTdma->u32ByteNs) + 999UL) / 1000UL;
+}
+
+static uint32_t tdmaCycleUs(const tdma_schedule_t *_psSchedule)
+{
+    return (uint32_t)_psSchedule->u8Slots * _psSchedule->u16SlotUs;
+}
+
+static bool tdmaScheduleValid(const tdma_schedule_t *_psSchedule)
+{
+    return _psSchedule->u8Slots > 0 && _psSchedule->u8Slots <= MESSAGE_TDMA_MAX_SLOTS &&
+           _psSchedule->au8Owners[0] == ADDRESS_MASTER && _psSchedule->u16GuardUs < _psSchedule->u16SlotUs;
+}
+
+/* Takes what the terminal (master) or the processing task (node) handed over */
+static void tdmaTakePending(tdma_t *_psTdma)
+{
+    if(_psTdma->bPending == false)
+    {
+        return;
+    }
+
+    _psTdma->sSchedule = _psTdma->sPendingSchedule;
+    if(_psTdma->bMaster == false)
+    {
+        _psTdma->u16Cycle = _psTdma->u16PendingCycle;
+        _psTdma->u32CycleStartUs = _psTdma->u32PendingStartUs;
+        _psTdma->bSynchronised = true;
+    }
+    _psTdma->bPending = false;
+}
+
+int32_t tdma_init(tdma_t *_psTdma, uint8_t _u8Address, uint32_t _u32Baud, tdma_clock_t _fpNowUs)
+{
+    if(_psTdma == NULL || _u8Address == ADDRESS_BROADCAST || _u32Baud == 0 || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psTdma, 0, sizeof(tdma_t));
+    _psTdma->fpNowUs = _fpNowUs;
+    _psTdma->u8Address = _u8Address;
+    _psTdma->bMaster = (_u8Address == ADDRESS_MASTER);
+    _psTdma->u32ByteNs = (10UL * 1000000000UL) / _u32Baud;
+
+    /* The master alone until it gets a schedule, nodes take theirs from the beacon */
+    _psTdma->sSchedule.u8Slots = 1;
+    _psTdma->sSchedule.au8Owners[0] = ADDRESS_MASTER;
+    _psTdma->sSchedule.u16SlotUs = TDMA_DEFAULT_SLOT_US;
+    _psTdma->sSchedule.u16GuardUs = TDMA_DEFAULT_GUARD_US;
+
+    return QUELL_OK;
+}
+
+/* Master only, starts with the next cycle. Fails while the previous one was not taken yet */
+int32_t tdma_setSchedule(tdma_t *_psTdma, const uint8_t *_pu8Owners, uint8_t _u8Slots, uint16_t _u16SlotUs, uint16_t _u16GuardUs)
+{
+    if(_psTdma == NULL || _pu8Owners == NULL || _psTdma->bMaster == false || _u8Slots > MESSAGE_TDMA_MAX_SLOTS || _psTdma->bPending == true)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psTdma->sPendingSchedule.u8Slots = _u8Slots;
+    memcpy(_psTdma->sPendingSchedule.au8Owners, _pu8Owners, _u8Slots);
+    _psTdma->sPendingSchedule.u16SlotUs = _u16SlotUs;
+    _psTdma->sPendingSchedule.u16GuardUs = _u16GuardUs;
+    if(tdmaScheduleValid(&_psTdma->sPendingSchedule) == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psTdma->bPending = true;
+
+    return QUELL_OK;
+}
+
+/* Bytes that can be started now and still be on the wire before the guard of our slot, 0 outside of it */
+uint16_t tdma_getTxAllowance(tdma_t *_psTdma)
+{
+    uint32_t u32Now;
+    uint32_t u32Offset;
+    uint32_t u32Start;
+    uint32_t u32End;
+    uint32_t u32Bytes;
+    uint8_t u8Slot;
+
+    if(_psTdma == NULL)
+    {
+        return 0;
+    }
+
+    if(_psTdma->bMaster == false)
+    {
+        tdmaTakePending(_psTdma);
+    }
+
+    if(_psTdma->bSynchronised == false)
+    {
+        return 0;
+    }
+
+    u32Now = _psTdma->fpNowUs();
+    u32Offset = u32Now - _psTdma->u32CycleStartUs;
+
+    /* Past the cycle: the master owes a beacon, a node waits for it */
+    if(u32Offset >= tdmaCycleUs(&_psTdma->sSchedule))
+    {
+        if(_psTdma->bMaster == false)
+        {
+            _psTdma->bSynchronised = false;
+        }
+        return 0;
+    }
+
+    u8Slot = u32Offset / _psTdma->sSchedule.u16SlotUs;
+    if(_psTdma->sSchedule.au8Owners[u8Slot] != _psTdma->u8Address)
+    {
+        return 0;
+    }
+
+    u32End = _psTdma->u32CycleStartUs + (((uint32_t)u8Slot + 1) * _psTdma->sSchedule.u16SlotUs) - _psTdma->sSchedule.u16GuardUs;
+    u32Start = ((int32_t)(_psTdma->u32TxBusyUntilUs - u32Now) > 0) ? _psTdma->u32TxBusyUntilUs : u32Now;
+    if((int32_t)(u32End - u32Start) <= 0)
+    {
+        return 0;
+    }
+
+    u32Bytes = ((u32End - u32Start) * 1000UL) / _psTdma->u32ByteNs;
+
+    return (u32Bytes > UINT16_MAX) ? UINT16_MAX : (uint16_t)u32Bytes;
+}
+
+void tdma_txSent(tdma_t *_psTdma, uint16_t _u16Count)
+{
+    uint32_t u32Now;
+
+    if(_psTdma == NULL || _u16Count == 0)
+    {
+        return;
+    }
+
+    u32Now = _psTdma->fpNowUs();
+    if((int32_t)(_psTdma->u32TxBusyUntilUs - u32Now) < 0)
+    {
+        _psTdma->u32TxBusyUntilUs = u32Now;
+    }
+    _psTdma->u32TxBusyUntilUs += tdmaAirtimeUs(_psTdma, _u16Count);
+    _psTdma->u32TxBytes += _u16Count;
+}
+
+/* Master only: once the cycle is over, starts the next one with its beacon (its airtime is accounted here) */
+int32_t tdma_makeBeacon(tdma_t *_psTdma, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize)
+{
+    uint8_t au8Message[MESSAGE_TDMA_MAX_SIZE];
+    message_tdma_t sBeacon;
+    uint16_t u16MessageSize;
+    uint32_t u32Now;
+
+    if(_psTdma == NULL || _psTdma->bMaster == false || _pu8PacketBuffer == NULL || _pu16PacketSize == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    u32Now = _psTdma->fpNowUs();
+    if(_psTdma->bSynchronised == true && u32Now - _psTdma->u32CycleStartUs < tdmaCycleUs(&_psTdma->sSchedule))
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Nothing of ours is still on the wire (the guard of the last slot covers the nodes) */
+    if((int32_t)(_psTdma->u32TxBusyUntilUs - u32Now) > 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    tdmaTakePending(_psTdma);
+
+    sBeacon.u16Cycle = _psTdma->u16Cycle + 1;
+    sBeacon.u16Slot = _psTdma->sSchedule.u16SlotUs;
+    sBeacon.u16Guard = _psTdma->sSchedule.u16GuardUs;
+    sBeacon.u16OwnersCount = _psTdma->sSchedule.u8Slots;
+    memcpy(sBeacon.au8Owners, _psTdma->sSchedule.au8Owners, _psTdma->sSchedule.u8Slots);
+
+    if(messages_encodeTdma(&sBeacon, au8Message, sizeof(au8Message), &u16MessageSize) == QUELL_ERROR ||
+       makeAddressedPacket(_pu8PacketBuffer, _u16PacketBufferSize, ADDRESS_BROADCAST, _psTdma->u8Address, au8Message, u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16PacketSize = ADDRESSED_SIZE(PACKE_SIZE(u16MessageSize));
+    _psTdma->u16Cycle = sBeacon.u16Cycle;
+    _psTdma->u32CycleStartUs = u32Now;
+    _psTdma->bSynchronised = true;
+    _psTdma->u32Beacons++;
+    tdma_txSent(_psTdma, *_pu16PacketSize);
+
+    return QUELL_OK;
+}
+
+/* Node: a beacon starts its cycle (back dated by the beacon airtime) and brings the schedule */
+int32_t tdma_processMessage(tdma_t *_psTdma, uint8_t *_pu8Message, uint16_t _u16MessageSize)
+{
+    message_tdma_t sBeacon;
+    uint32_t u32Now;
+
+    if(_psTdma == NULL || messages_decodeTdma(&sBeacon, _pu8Message, _u16MessageSize) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    u32Now = _psTdma->fpNowUs();
+
+    /* Consumed either way, a master ignores the beacons of others and the io task may still hold the last one */
+    if(_psTdma->bMaster == true || _psTdma->bPending == true)
+    {
+        return QUELL_OK;
+    }
+
+    _psTdma->sPendingSchedule.u8Slots = (uint8_t)sBeacon.u16OwnersCount;
+    memcpy(_psTdma->sPendingSchedule.au8Owners, sBeacon.au8Owners, sBeacon.u16OwnersCount);
+    _psTdma->sPendingSchedule.u16SlotUs = sBeacon.u16Slot;
+    _psTdma->sPendingSchedule.u16GuardUs = sBeacon.u16Guard;
+    if(tdmaScheduleValid(&_psTdma->sPendingSchedule) == false)
+    {
+        return QUELL_OK;
+    }
+
+    if(_psTdma->u32Beacons > 0 && (uint16_t)(sBeacon.u16Cycle - _psTdma->u16Cycle) > 1)
+    {
+        _psTdma->u32BeaconsLost += (uint16_t)(sBeacon.u16Cycle - _psTdma->u16Cycle) - 1;
+    }
+    _psTdma->u32Beacons++;
+
+    _psTdma->u16PendingCycle = sBeacon.u16Cycle;
+    _psTdma->u32PendingStartUs = u32Now - tdmaAirtimeUs(_psTdma, ADDRESSED_SIZE(PACKE_SIZE(_u16MessageSize)));
+    _psTdma->bPending = true;
+
+    return QUELL_OK;
+}
@@ -0,0 +1,75 @@
+#ifndef _TDMA_H_
+#define _TDMA_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    TDMA (multi-drop bus)
+
+    Several units share one half-duplex pair (RS-485, the uart driver drives DE) and every frame carries
+    an address header (see protocol.c). The master (ADDRESS_MASTER, the chest unit) runs a cycle of slots:
+    it broadcasts a beacon (tdma message) at the start of every cycle, which carries the schedule, and
+    sends its own traffic in slot 0. Every other slot belongs to one address, only its owner sends in it.
+    A node that has not heard the beacon of the current cycle keeps quiet, so a lost beacon costs that
+    node one cycle, never a collision.
+
+    | beacon, master | owners[1] | owners[2] | ... | beacon, master | ...
+    |<---- slot ---->|
+               |guard|      |guard|                   guard: nobody sends, absorbs the beacon parse delay
+
+    The allowance is how many bytes still finish on the wire before the guard of our slot, counting the
+    ones already handed to the uart. Schedule and beacon times only change in the io task: the terminal
+    (new schedule) and the processing task (beacon received) hand them over through bPending.
+*/
+
+#define TDMA_DEFAULT_SLOT_US (10000U)
+#define TDMA_DEFAULT_GUARD_US (2000U)
+
+typedef uint32_t (*tdma_clock_t)(void);    //Microseconds, wrapping
+
+typedef struct
+{
+    uint8_t u8Slots;
+    uint8_t au8Owners[MESSAGE_TDMA_MAX_SLOTS];
+    uint16_t u16SlotUs;
+    uint16_t u16GuardUs;
+}tdma_schedule_t;
+
+typedef struct
+{
+    tdma_clock_t fpNowUs;
+    uint8_t u8Address;
+    bool bMaster;
+    uint32_t u32ByteNs;             //Time on the wire of one byte (start and stop bits included)
+
+    /* io task */
+    tdma_schedule_t sSchedule;
+    bool bSynchronised;             //Master: a cycle is running. Node: heard the beacon of the current cycle
+    uint16_t u16Cycle;
+    uint32_t u32CycleStartUs;
+    uint32_t u32TxBusyUntilUs;      //The uart is still shifting out bytes until then
+
+    /* Handoff to the io task, written only while bPending is false */
+    volatile bool bPending;
+    tdma_schedule_t sPendingSchedule;
+    uint16_t u16PendingCycle;
+    uint32_t u32PendingStartUs;
+
+    /* Statistics */
+    uint32_t u32Beacons;            //Sent (master) or received (node)
+    uint32_t u32BeaconsLost;        //Gaps in the cycle counter (node)
+    uint32_t u32TxBytes;
+}tdma_t;
+
+int32_t tdma_init(tdma_t *_psTdma, uint8_t _u8Address, uint32_t _u32Baud, tdma_clock_t _fpNowUs);
+int32_t tdma_setSchedule(tdma_t *_psTdma, const uint8_t *_pu8Owners, uint8_t _u8Slots, uint16_t _u16SlotUs, uint16_t _u16GuardUs);
+uint16_t tdma_getTxAllowance(tdma_t *_psTdma);
+void tdma_txSent(tdma_t *_psTdma, uint16_t _u16Count);
+int32_t tdma_makeBeacon(tdma_t *_psTdma, uint8_t *_pu8PacketBuffer, uint16_t _u16PacketBufferSize, uint16_t *_pu16PacketSize);
+int32_t tdma_processMessage(tdma_t *_psTdma, uint8_t *_pu8Message, uint16_t _u16MessageSize);
+
+#endif /* _TDMA_H_ */
@@ -0,0 +1,246 @@
+#include "txScheduler.h"
+#include "protocol.h"
+#include "quell.h"
+#include "FIFO.h"
+
+/*
+    TX SCHEDULER
+
+    Each lane is a plain fifo_t holding whole packets back to back. The scheduler only switches
+    lanes on a packet boundary (the packet size is read from the header at the head of the lane),
+    so a control packet waits at most for the bulk packet already on the wire, never for the whole
+    bulk backlog. Bulk is guaranteed one packet after u16MaxControlBurst control packets.
+    A packet is only started when the whole of it fits in the flow control credit, so the link never
+    stalls half way through a packet (where nothing else, not even a credit packet, could be sent).
+
+    The forward lane (chains, only once txScheduler_initForward gave it a buffer) holds frames of other
+    units that the router cuts through while they still arrive: one may be at the head with only its
+    header in, the pops then follow it as its bytes come (the upstream unit already paid its credit for
+    them). It is as urgent as the control lane, the two take turns, and counts in the control burst.
+    The tunnel lane (given with it) gets the tunnel frames of other units the same way, but is the least
+    urgent: it only goes when no other lane has a frame and the uart sent everything before it (bIdle),
+    so a frame of data waits at most for the one tunnel frame on the wire.
+*/
+
+static bool txScheduler_frameLength(fifo_t *_psLane, uint16_t *_pu16Length)
+{
+    char cData;
+    uint16_t u16Length;
+    size_t tCount;
+    size_t tHeader;
+
+    if(FIFO_count(_psLane, &tCount) == false || tCount == 0)
+    {
+        return false;
+    }
+
+    /* Anything not starting a packet is sent on its own, it can not be held behind a header */
+    if(FIFO_peak(_psLane, 0, &cData) == false || (cData != SOH && cData != SOA))
+    {
+        *_pu16Length = 1;
+        return true;
+    }
+
+    /* An addressed frame is its header plus the packet behind it */
+    tHeader = (cData == SOA) ? ADDRESS_HEADER_SIZE : 0;
+
+    /* The producer may be half way through the header */
+    if(tCount < tHeader + 3)
+    {
+        return false;
+    }
+
+    FIFO_peak(_psLane, tHeader + 1, &cData);
+    u16Length = ((uint16_t)cData) << 8;
+    FIFO_peak(_psLane, tHeader + 2, &cData);
+    u16Length |= ((uint16_t)cData) & 0xFF;
+
+    *_pu16Length = (u16Length < MINIMUM_PACKET_SIZE) ? 1 : u16Length + tHeader;
+    return true;
+}
+
+int32_t txScheduler_init(tx_scheduler_t *_psScheduler, char *_pcControlBuffer, size_t _tControlSize, char *_pcBulkBuffer, size_t _tBulkSize, uint16_t _u16MaxControlBurst)
+{
+    if(_psScheduler == NULL || _u16MaxControlBurst == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psScheduler, 0, sizeof(tx_scheduler_t));
+
+    if(FIFO_init(&_psScheduler->asLane[TX_LANE_CONTROL], _pcControlBuffer, _tControlSize) == false ||
+       FIFO_init(&_psScheduler->asLane[TX_LANE_BULK], _pcBulkBuffer, _tBulkSize) == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psScheduler->eCurrentLane = TX_LANE_CONTROL;
+    _psScheduler->u16MaxControlBurst = _u16MaxControlBurst;
+
+    return QUELL_OK;
+}
+
+int32_t txScheduler_initForward(tx_scheduler_t *_psScheduler, char *_pcForwardBuffer, size_t _tForwardSize, char *_pcTunnelBuffer, size_t _tTunnelSize)
+{
+    if(_psScheduler == NULL || FIFO_init(&_psScheduler->asLane[TX_LANE_FORWARD], _pcForwardBuffer, _tForwardSize) == false ||
+       FIFO_init(&_psScheduler->asLane[TX_LANE_TUNNEL], _pcTunnelBuffer, _tTunnelSize) == false)
+    {
+        return QUELL_ERROR;
+    }
+
+    return QUELL_OK;
+}
+
+fifo_t* txScheduler_getLane(tx_scheduler_t *_psScheduler, tx_lane_t _eLane)
+{
+    if(_psScheduler == NULL || _eLane >= TX_LANE_COUNT)
+    {
+        return NULL;
+    }
+
+    /* Never initialized: no forward lane */
+    if(_psScheduler->asLane[_eLane].buffer == NULL)
+    {
+        return NULL;
+    }
+
+    return &_psScheduler->asLane[_eLane];
+}
+
+/* io task: whether the uart has sent all it was given */
+void txScheduler_setIdle(tx_scheduler_t *_psScheduler, bool _bIdle)
+{
+    if(_psScheduler != NULL)
+    {
+        _psScheduler->bIdle = _bIdle;
+    }
+}
+
+/* Producer side: the uart had nothing left when the io task last looked and no lane holds a frame since, a tunnel frame (channel.h) may go */
+bool txScheduler_isIdle(tx_scheduler_t *_psScheduler)
+{
+    size_t tCount;
+
+    if(_psScheduler == NULL || _psScheduler->bIdle == false)
+    {
+        return false;
+    }
+
+    for(uint8_t u8Lane = 0; u8Lane < TX_LANE_COUNT; u8Lane++)
+    {
+        if(_psScheduler->asLane[u8Lane].buffer != NULL && (FIFO_count(&_psScheduler->asLane[u8Lane], &tCount) == false || tCount > 0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* On a packet boundary, picks the lane of the next packet and starts it (u16FrameRemaining holds its length) */
+int32_t txScheduler_startFrame(tx_scheduler_t *_psScheduler, uint16_t _u16Credit)
+{
+    uint16_t au16Length[TX_LANE_COUNT];
+    bool abReady[TX_LANE_COUNT];
+    tx_lane_t eUrgent;
+    tx_lane_t eLane;
+
+    if(_psScheduler == NULL || _psScheduler->u16FrameRemaining > 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    abReady[TX_LANE_CONTROL] = txScheduler_frameLength(&_psScheduler->asLane[TX_LANE_CONTROL], &au16Length[TX_LANE_CONTROL]);
+    abReady[TX_LANE_BULK] = txScheduler_frameLength(&_psScheduler->asLane[TX_LANE_BULK], &au16Length[TX_LANE_BULK]);
+    abReady[TX_LANE_FORWARD] = txScheduler_frameLength(&_psScheduler->asLane[TX_LANE_FORWARD], &au16Length[TX_LANE_FORWARD]);
+    abReady[TX_LANE_TUNNEL] = _psScheduler->bIdle == true && txScheduler_frameLength(&_psScheduler->asLane[TX_LANE_TUNNEL], &au16Length[TX_LANE_TUNNEL]);
+
+    /* Forwarded and control frames take turns */
+    if(abReady[TX_LANE_FORWARD] == true && (abReady[TX_LANE_CONTROL] == false || _psScheduler->eCurrentLane != TX_LANE_FORWARD))
+    {
+        eUrgent = TX_LANE_FORWARD;
+    }
+    else
+    {
+        eUrgent = (abReady[TX_LANE_CONTROL] == true) ? TX_LANE_CONTROL : TX_LANE_COUNT;
+    }
+
+    if(eUrgent != TX_LANE_COUNT && (abReady[TX_LANE_BULK] == false || _psScheduler->u16ControlBurst < _psScheduler->u16MaxControlBurst))
+    {
+        eLane = eUrgent;
+    }
+    else if(abReady[TX_LANE_BULK] == true)
+    {
+        eLane = TX_LANE_BULK;
+    }
+    else if(abReady[TX_LANE_TUNNEL] == true)
+    {
+        eLane = TX_LANE_TUNNEL;
+    }
+    else
+    {
+        /* Nothing to send */
+        return QUELL_ERROR;
+    }
+
+    /* Wait for the peer to make room for the whole packet */
+    if(au16Length[eLane] > _u16Credit)
+    {
+        _psScheduler->sStats.u32CreditStalls++;
+        return QUELL_ERROR;
+    }
+
+    if(eLane == TX_LANE_CONTROL || eLane == TX_LANE_FORWARD)
+    {
+        _psScheduler->u16ControlBurst = (abReady[TX_LANE_BULK] == true) ? _psScheduler->u16ControlBurst + 1 : 0;
+    }
+    else if(eLane == TX_LANE_BULK)
+    {
+        if(eUrgent != TX_LANE_COUNT)
+        {
+            _psScheduler->sStats.u32StarvationGrants++;
+        }
+        _psScheduler->u16ControlBurst = 0;
+    }
+
+    _psScheduler->eCurrentLane = eLane;
+    _psScheduler->bIdle = false;
+    _psScheduler->u16FrameRemaining = au16Length[eLane];
+    _psScheduler->sStats.u32Frames[eLane]++;
+
+    return QUELL_OK;
+}
+
+int32_t txScheduler_pop(tx_scheduler_t *_psScheduler, uint16_t _u16Credit, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Count)
+{
+    fifo_t *psLane;
+
+    if(_psScheduler == NULL || _pcBuffer == NULL || _u16BufferSize == 0 || _pu16Count == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16Count = 0;
+
+    /* On a packet boundary, pick the lane for the next packet */
+    if(_psScheduler->u16FrameRemaining == 0 && txScheduler_startFrame(_psScheduler, _u16Credit) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Continue the packet in flight, never past its end */
+    psLane = &_psScheduler->asLane[_psScheduler->eCurrentLane];
+    while(*_pu16Count < _u16BufferSize && _psScheduler->u16FrameRemaining > 0)
+    {
+        if(FIFO_get(psLane, &_pcBuffer[*_pu16Count]) == false)
+        {
+            break;
+        }
+        (*_pu16Count)++;
+        _psScheduler->u16FrameRemaining--;
+    }
+
+    _psScheduler->sStats.u32Bytes[_psScheduler->eCurrentLane] += *_pu16Count;
+
+    return (*_pu16Count > 0) ? QUELL_OK : QUELL_ERROR;
+}
@@ -0,0 +1,44 @@
+#ifndef _TX_SCHEDULER_H_
+#define _TX_SCHEDULER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "FIFO.h"
+
+typedef enum
+{
+    TX_LANE_CONTROL = 0,    /* Acknowledgements, time sync, link management */
+    TX_LANE_BULK,           /* Streamed data (IMU batches, injected packets) */
+    TX_LANE_FORWARD,        /* Frames of other units cut through from another link (router.h), optional */
+    TX_LANE_TUNNEL,         /* Tunnel frames of other units (channel.h) cut through the same way, optional */
+    TX_LANE_COUNT
+}tx_lane_t;
+
+typedef struct
+{
+    uint32_t u32Frames[TX_LANE_COUNT];
+    uint32_t u32Bytes[TX_LANE_COUNT];
+    uint32_t u32StarvationGrants; //Bulk frames sent ahead of waiting control or forwarded frames
+    uint32_t u32CreditStalls;     //Frames held back because the peer had no room for them
+}tx_scheduler_stats_t;
+
+typedef struct
+{
+    fifo_t asLane[TX_LANE_COUNT];
+    tx_lane_t eCurrentLane;
+    uint16_t u16FrameRemaining;     //Bytes of the frame in flight still to be sent (0 means on a frame boundary)
+    uint16_t u16ControlBurst;       //Control (and forwarded) frames sent in a row while bulk was waiting
+    uint16_t u16MaxControlBurst;    //Starvation guard, after this many of them a waiting bulk frame goes
+    volatile bool bIdle;            //Set by the io task while its uart has nothing left, cleared as a frame starts
+    tx_scheduler_stats_t sStats;
+}tx_scheduler_t;
+
+int32_t txScheduler_init(tx_scheduler_t *_psScheduler, char *_pcControlBuffer, size_t _tControlSize, char *_pcBulkBuffer, size_t _tBulkSize, uint16_t _u16MaxControlBurst);
+int32_t txScheduler_initForward(tx_scheduler_t *_psScheduler, char *_pcForwardBuffer, size_t _tForwardSize, char *_pcTunnelBuffer, size_t _tTunnelSize);
+fifo_t* txScheduler_getLane(tx_scheduler_t *_psScheduler, tx_lane_t _eLane);
+void txScheduler_setIdle(tx_scheduler_t *_psScheduler, bool _bIdle);
+bool txScheduler_isIdle(tx_scheduler_t *_psScheduler);
+int32_t txScheduler_startFrame(tx_scheduler_t *_psScheduler, uint16_t _u16Credit);
+int32_t txScheduler_pop(tx_scheduler_t *_psScheduler, uint16_t _u16Credit, char *_pcBuffer, uint16_t _u16BufferSize, uint16_t *_pu16Count);
+
+#endif /* _TX_SCHEDULER_H_ */
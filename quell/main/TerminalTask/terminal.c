@@ -4,7 +4,26 @@
 #include "FIFO.h"
 #include "esp_log.h"
 #include "crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "FIFOUart.h"
+#include "capture.h"
+#include "terminalStream.h"
+#include "imuTask.h"
+#include "imuStream.h"
+#include "logTask.h"
 #define _TERMINAL_MAX_ARGS 10
+#define _TERMINAL_TOP_MAX_TASKS 24
+#define _TERMINAL_CAPTURE_DEFAULT_UART 1
+#define _TERMINAL_CAPTURE_DEFAULT_SIZE 8192
+#define _TERMINAL_CAPTURE_DUMP_LINE 32
+#define _TERMINAL_BUS_PRINT_BYTES 16
+#define _TERMINAL_LINE_SIZE 64
+#define _TERMINAL_TUNNEL_SOURCES 4                  //Units whose tunnel lines are put together (addresses 0 to 3)
+#define _TERMINAL_TUNNEL_LINE_SIZE 128              //Lines of the remote units, longer ones are printed in pieces
+#define _TERMINAL_TUNNEL_TX_SIZE 128                //What a remote command writes to the terminal FIFO
+#define _TERMINAL_TUNNEL_WAIT_MS 2000
 
 typedef struct
 {
@@ -14,9 +33,44 @@ typedef struct
 	char *pcComment;
 } s_terminal_commands_t;
 
+static sample_bus_subscriber_t sTerminalBus;
+static bool bTerminalBusOn = false;
+
+/* Remote terminal: lines typed here go to a unit while a session is open, and what units send back is printed here once "remote" was used */
+static bool bRemoteSession = false;
+static bool bRemoteClient = false;
+static char acRemoteCommand[_TERMINAL_LINE_SIZE];
+static uint16_t u16RemoteCommandIndex = 0;
+
+typedef struct
+{
+    char acLine[_TERMINAL_TUNNEL_LINE_SIZE];
+    uint16_t u16Length;
+}terminal_tunnel_line_t;
+
+static terminal_tunnel_line_t asTunnelLines[CHANNEL_TUNNELS][_TERMINAL_TUNNEL_SOURCES];
+
 static int32_t terminal_sendMarco(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
 static int32_t terminal_help(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
 static int32_t  terminal_crc16(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_top(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_stats(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_capture(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_fec(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_bus(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_tdma(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_route(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_stream(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_imu(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_decimate(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_imugen(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_bench(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_load(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_speed(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_congestion(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_flashlog(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_remote(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
+static int32_t terminal_channel(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs);
 
 
 s_terminal_commands_t asTerminalCommands[] = {
@@ -24,6 +78,24 @@ s_terminal_commands_t asTerminalCommands[] = {
                                              { "help",  &terminal_help, 			" ",        "Help"},
                                              { "?",     &terminal_help, 			" ",        "Help"},
                                              { "crc",   &terminal_crc16,            "<string>", "CRC16-CCITT(XMODEM)"},
+                                             { "stats", &terminal_stats,            " ",        "Protocol link statistics"},
+                                             { "capture", &terminal_capture,        "start [uart] [bytes]|stop|dump", "Record uart Rx/Tx bytes (QCAP), dump as CAP hex lines"},
+                                             { "fec",   &terminal_fec,              "on|off",   "Negotiate forward error correction on the protocol link"},
+                                             { "bus",   &terminal_bus,              "[on|off]", "Print the messages received on the protocol link (subscriber of the sample bus)"},
+                                             { "tdma",  &terminal_tdma,             "<slot us> <guard us> 0 <address>...", "Bus master: slot owners of the next cycles, slot 0 is the master (see \"stats\")"},
+                                             { "route", &terminal_route,            "<address> <port>|auto", "Chain: frames for the address leave through the port (0 toward the chest), auto learns it again"},
+                                             { "stream", &terminal_stream,          "bus|stats|all [baud]", "Binary packets on this uart (see terminalStream.h) until \"+++\""},
+                                             { "imu",   &terminal_imu,              "[madgwick|complementary [float|fixed] [gain]] | [window <samples> <watermark us> [flag|hold|interpolate]]", "Orientation of every unit, choose its filter (restarts them) or its reorder windows"},
+                                             { "decimate", &terminal_decimate,      "[<unit> off|fir|cic [factor]]", "IMU stream of every unit, or the decimation of one before it is sent"},
+                                             { "imugen", &terminal_imugen,          "<unit> <Hz>|off", "Feed the IMU stream of a unit with a test signal"},
+                                             { "bench", &terminal_bench,            "[<count> [size] [address]]", "Ping-pong bench messages over the protocol link: RTT min/avg/p99/max and histogram (no argument: last results)"},
+                                             { "load",  &terminal_load,             "[<rate>|max <seconds> [size] [address]]", "Stream bench messages (IMU size by default) at a rate per second: goodput, drops and CRC errors of the receiver"},
+                                             { "speed", &terminal_speed,            "<max baud>", "Protocol links step up to the rate (115200 230400 460800 921600 2000000) as far as the cable allows, see \"stats\""},
+                                             { "congestion", &terminal_congestion,  "[on|off]", "Sample rate and batch of the IMU streams against the link health (no argument: operating point)"},
+                                             { "flashlog", &terminal_flashlog,      "[on|off|read [pages]]", "Flash ring log of the IMU windows and orientation (no argument: statistics), read prints the records of the last pages as FLOG hex lines"},
+                                             { "remote", &terminal_remote,          "<address> [command...]", "Run the command on the unit through the terminal tunnel (no command: every line goes there until \"exit\"), its logs come as \"unit n log:\" lines"},
+                                             { "channel", &terminal_channel,        "[cap terminal|log <bytes/s>]", "Terminal and log tunnels of the protocol link (no argument: statistics), cap 0 for none"},
+                                             { "top",   &terminal_top,              " ",        "Tasks core, priority, CPU share and stack high-water mark"},
                                              { NULL,    NULL,                    NULL,   NULL}
                                              };
 
@@ -44,14 +116,452 @@ static int32_t  terminal_crc16(uint16_t _u8Argc, char **_ppcArgv, void* _interna
     return QUELL_OK;
 }
 
+static int32_t terminal_capture(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    static capture_t sCapture;
+    static uint8_t *pu8CaptureBuffer = NULL;
+    char acLine[(_TERMINAL_CAPTURE_DUMP_LINE * 2) + 1];
+
+    if(_u8Argc < 2)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(strcmp(_ppcArgv[1], "start") == 0)
+    {
+        uint32_t u32Uart = (_u8Argc > 2) ? strtoul(_ppcArgv[2], NULL, 0) : _TERMINAL_CAPTURE_DEFAULT_UART;
+        size_t tSize = (_u8Argc > 3) ? strtoul(_ppcArgv[3], NULL, 0) : _TERMINAL_CAPTURE_DEFAULT_SIZE;
+
+        /* Only uarts this chip has, the capture mask has a bit per uart */
+        if(u32Uart >= UART_NUM_MAX)
+        {
+            return QUELL_ERROR;
+        }
+
+        /* A new capture replaces the previous one */
+        uartSetCapture(NULL, 0);
+        free(pu8CaptureBuffer);
+        pu8CaptureBuffer = (uint8_t*) malloc(tSize);
+        if(capture_init(&sCapture, pu8CaptureBuffer, tSize) == QUELL_ERROR)
+        {
+            free(pu8CaptureBuffer);
+            pu8CaptureBuffer = NULL;
+            return QUELL_ERROR;
+        }
+        uartSetCapture(&sCapture, 1UL << u32Uart);
+        return QUELL_OK;
+    }
+    else if(strcmp(_ppcArgv[1], "stop") == 0)
+    {
+        uartSetCapture(NULL, 0);
+        ESP_LOGI("terminal", "capture %u bytes, %u dropped", sCapture.tUsed, sCapture.u32Dropped);
+        return QUELL_OK;
+    }
+    else if(strcmp(_ppcArgv[1], "dump") == 0 && pu8CaptureBuffer != NULL)
+    {
+        /* Stop first, the buffer can not be growing while it is printed. The host turns the CAP lines back into a .qcap file */
+        uartSetCapture(NULL, 0);
+        for(size_t tOffset = 0; tOffset < sCapture.tUsed; tOffset += _TERMINAL_CAPTURE_DUMP_LINE)
+        {
+            size_t tIndex;
+            for(tIndex = 0; tIndex < _TERMINAL_CAPTURE_DUMP_LINE && tOffset + tIndex < sCapture.tUsed; tIndex++)
+            {
+                sprintf(&acLine[tIndex * 2], "%02x", pu8CaptureBuffer[tOffset + tIndex]);
+            }
+            acLine[tIndex * 2] = 0;
+            ESP_LOGI("terminal", "CAP %06x %s", tOffset, acLine);
+        }
+        return QUELL_OK;
+    }
+
+    return QUELL_ERROR;
+}
+
+static int32_t terminal_fec(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2 || (strcmp(_ppcArgv[1], "on") != 0 && strcmp(_ppcArgv[1], "off") != 0))
+    {
+        return QUELL_ERROR;
+    }
+
+    /* The link switches when the peer accepts, see "stats" */
+    return protocolRequestFEC(strcmp(_ppcArgv[1], "on") == 0);
+}
+
+static int32_t terminal_bus(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        ESP_LOGI("terminal", "bus %s received:%u dropped:%u", (bTerminalBusOn == true) ? "on" : "off", sTerminalBus.u32Received, sTerminalBus.u32Dropped);
+        return QUELL_OK;
+    }
+
+    if(strcmp(_ppcArgv[1], "on") == 0)
+    {
+        if(protocolSubscribe(&sTerminalBus) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        bTerminalBusOn = true;
+        return QUELL_OK;
+    }
+    else if(strcmp(_ppcArgv[1], "off") == 0)
+    {
+        bTerminalBusOn = false;
+        return QUELL_OK;
+    }
+
+    return QUELL_ERROR;
+}
+
+static int32_t terminal_stream(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    uint32_t u32Sources = 0;
+
+    if(_u8Argc < 2)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(strcmp(_ppcArgv[1], "bus") == 0 || strcmp(_ppcArgv[1], "all") == 0)
+    {
+        u32Sources |= TERMINAL_STREAM_SOURCE_BUS;
+    }
+    if(strcmp(_ppcArgv[1], "stats") == 0 || strcmp(_ppcArgv[1], "all") == 0)
+    {
+        u32Sources |= TERMINAL_STREAM_SOURCE_STATS;
+    }
+
+    /* The terminal task switches once this command's answer went out */
+    return terminalStream_request(u32Sources, (_u8Argc > 2) ? strtoul(_ppcArgv[2], NULL, 0) : TERMINAL_STREAM_TEXT_BAUD_RATE);
+}
+
+static int32_t terminal_stats(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    /* Same as help, the list is longer than the terminal FIFO Tx */
+    protocolPrintStats();
+
+    return QUELL_OK;
+}
+
+static int32_t terminal_tdma(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    uint8_t au8Owners[_TERMINAL_MAX_ARGS];
+    uint8_t u8Slots = 0;
+
+    if(_u8Argc < 4)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint16_t u16Arg = 3; u16Arg < _u8Argc && u8Slots < sizeof(au8Owners); u16Arg++)
+    {
+        au8Owners[u8Slots++] = (uint8_t)strtoul(_ppcArgv[u16Arg], NULL, 10);
+    }
+
+    return protocolSetSchedule(au8Owners, u8Slots, (uint16_t)strtoul(_ppcArgv[1], NULL, 10), (uint16_t)strtoul(_ppcArgv[2], NULL, 10));
+}
+
+static int32_t terminal_route(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 3)
+    {
+        return QUELL_ERROR;
+    }
+
+    return protocolSetRoute((uint8_t)strtoul(_ppcArgv[1], NULL, 10), (strcmp(_ppcArgv[2], "auto") == 0) ? ROUTER_PORT_NONE : (uint8_t)strtoul(_ppcArgv[2], NULL, 10));
+}
+
+/* Results are printed by the protocol task when the run is over, the address defaults to the peer (the master from a node) */
+static int32_t terminal_bench(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        protocolPrintBench();
+        return QUELL_OK;
+    }
+
+    return protocolBench((_u8Argc > 3) ? (uint8_t)strtoul(_ppcArgv[3], NULL, 10) : protocolGetDefaultPeer(), strtoul(_ppcArgv[1], NULL, 10),
+                         (_u8Argc > 2) ? (uint16_t)strtoul(_ppcArgv[2], NULL, 10) : MESSAGE_IMU_MAX_SIZE);
+}
+
+static int32_t terminal_load(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        protocolPrintBench();
+        return QUELL_OK;
+    }
+
+    if(_u8Argc < 3)
+    {
+        return QUELL_ERROR;
+    }
+
+    return protocolLoad((_u8Argc > 4) ? (uint8_t)strtoul(_ppcArgv[4], NULL, 10) : protocolGetDefaultPeer(),
+                        (_u8Argc > 3) ? (uint16_t)strtoul(_ppcArgv[3], NULL, 10) : MESSAGE_IMU_MAX_SIZE,
+                        (strcmp(_ppcArgv[1], "max") == 0) ? 0 : strtoul(_ppcArgv[1], NULL, 10), strtoul(_ppcArgv[2], NULL, 10));
+}
+
+static int32_t terminal_speed(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Lower than the rate running: both units go down to it right away */
+    return protocolSetMaxBaud(strtoul(_ppcArgv[1], NULL, 10));
+}
+
+static int32_t terminal_congestion(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        protocolPrintCongestion();
+        imuStream_printStats();
+        return QUELL_OK;
+    }
+
+    if(strcmp(_ppcArgv[1], "on") != 0 && strcmp(_ppcArgv[1], "off") != 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Off goes back to the rate configured ("decimate") */
+    protocolSetCongestion(strcmp(_ppcArgv[1], "on") == 0);
+    return QUELL_OK;
+}
+
+static int32_t terminal_flashlog(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        logPrintStats();
+        return QUELL_OK;
+    }
+
+    if(strcmp(_ppcArgv[1], "read") == 0)
+    {
+        return logRead((_u8Argc > 2) ? strtoul(_ppcArgv[2], NULL, 0) : LOG_READ_DEFAULT_PAGES);
+    }
+    else if(strcmp(_ppcArgv[1], "on") == 0 || strcmp(_ppcArgv[1], "off") == 0)
+    {
+        logSetEnabled(strcmp(_ppcArgv[1], "on") == 0);
+        return QUELL_OK;
+    }
+
+    return QUELL_ERROR;
+}
+
+/* Writes to the terminal tunnel, waiting for room as long as the terminal would for the uart */
+static int32_t terminal_tunnelWrite(const char *_pcData, uint16_t _u16Size)
+{
+    TickType_t tStart = xTaskGetTickCount();
+
+    while(protocolTunnelWrite(MESSAGE_CHANNEL_TERMINAL, _pcData, _u16Size) == QUELL_ERROR)
+    {
+        if((xTaskGetTickCount() - tStart) >= pdMS_TO_TICKS(_TERMINAL_TUNNEL_WAIT_MS))
+        {
+            return QUELL_ERROR;
+        }
+        vTaskDelay(1);
+    }
+
+    return QUELL_OK;
+}
+
+/* One command line to the unit the tunnel leads to */
+static int32_t terminal_remoteSend(const char *_pcLine)
+{
+    char acLine[_TERMINAL_LINE_SIZE + 1];
+    int iLength = snprintf(acLine, sizeof(acLine), "%s\n", _pcLine);
+
+    if(iLength <= 0 || iLength >= (int)sizeof(acLine))
+    {
+        return QUELL_ERROR;
+    }
+
+    return terminal_tunnelWrite(acLine, (uint16_t)iLength);
+}
+
+static int32_t terminal_remote(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    char acLine[_TERMINAL_LINE_SIZE];
+    size_t tLength = 0;
+
+    if(_u8Argc < 2 || protocolTunnelOpen((uint8_t)strtoul(_ppcArgv[1], NULL, 10)) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+    bRemoteClient = true;
+
+    if(_u8Argc < 3)
+    {
+        bRemoteSession = true;
+        ESP_LOGI("terminal", "Session on unit %s, \"exit\" to leave", _ppcArgv[1]);
+        return QUELL_OK;
+    }
+
+    /* The arguments were split at the spaces, they go back together */
+    acLine[0] = 0;
+    for(uint16_t u16Arg = 2; u16Arg < _u8Argc && tLength < sizeof(acLine); u16Arg++)
+    {
+        tLength += snprintf(&acLine[tLength], sizeof(acLine) - tLength, (u16Arg > 2) ? " %s" : "%s", _ppcArgv[u16Arg]);
+    }
+
+    return (tLength < sizeof(acLine)) ? terminal_remoteSend(acLine) : QUELL_ERROR;
+}
+
+static int32_t terminal_channel(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 2)
+    {
+        protocolPrintChannels();
+        return QUELL_OK;
+    }
+
+    if(_u8Argc < 4 || strcmp(_ppcArgv[1], "cap") != 0 || (strcmp(_ppcArgv[2], "terminal") != 0 && strcmp(_ppcArgv[2], "log") != 0))
+    {
+        return QUELL_ERROR;
+    }
+
+    return protocolSetTunnelCap((strcmp(_ppcArgv[2], "terminal") == 0) ? MESSAGE_CHANNEL_TERMINAL : MESSAGE_CHANNEL_LOG, strtoul(_ppcArgv[3], NULL, 10));
+}
+
+static int32_t terminal_imu(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    orientation_filter_t eFilter;
+    bool bFixed = true;
+
+    if(_u8Argc < 2)
+    {
+        imuPrintStats();
+        return QUELL_OK;
+    }
+
+    if(strcmp(_ppcArgv[1], "window") == 0)
+    {
+        static const char *apcFills[REORDER_FILL_COUNT] = {"flag", "hold", "interpolate"};
+        uint8_t u8Fill = IMU_FILL;
+
+        if(_u8Argc < 4)
+        {
+            return QUELL_ERROR;
+        }
+        if(_u8Argc > 4)
+        {
+            for(u8Fill = 0; u8Fill < REORDER_FILL_COUNT && strcmp(_ppcArgv[4], apcFills[u8Fill]) != 0; u8Fill++);
+        }
+
+        return imuConfigureWindow((uint8_t)strtoul(_ppcArgv[2], NULL, 10), strtoul(_ppcArgv[3], NULL, 10), (reorder_fill_t)u8Fill);
+    }
+
+    if(strcmp(_ppcArgv[1], "madgwick") == 0)
+    {
+        eFilter = ORIENTATION_MADGWICK;
+    }
+    else if(strcmp(_ppcArgv[1], "complementary") == 0)
+    {
+        eFilter = ORIENTATION_COMPLEMENTARY;
+    }
+    else
+    {
+        return QUELL_ERROR;
+    }
+
+    if(_u8Argc > 2 && strcmp(_ppcArgv[2], "float") != 0 && strcmp(_ppcArgv[2], "fixed") != 0)
+    {
+        return QUELL_ERROR;
+    }
+    if(_u8Argc > 2)
+    {
+        bFixed = (strcmp(_ppcArgv[2], "fixed") == 0);
+    }
+
+    /* Gain 0 (or none) is the default of the filter */
+    return imuConfigure(eFilter, bFixed, (_u8Argc > 3) ? strtof(_ppcArgv[3], NULL) : 0.0f);
+}
+
+static int32_t terminal_decimate(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    static const char *apcTypes[DECIMATOR_TYPE_COUNT] = {"off", "fir", "cic"};
+    uint8_t u8Type;
+
+    if(_u8Argc < 2)
+    {
+        imuStream_printStats();
+        return QUELL_OK;
+    }
+
+    if(_u8Argc < 3)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(u8Type = 0; u8Type < DECIMATOR_TYPE_COUNT && strcmp(_ppcArgv[2], apcTypes[u8Type]) != 0; u8Type++);
+    if(u8Type == DECIMATOR_TYPE_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* fir and cic default to factor 2 */
+    return imuStream_configure((uint8_t)strtoul(_ppcArgv[1], NULL, 10), (decimator_type_t)u8Type,
+                               (_u8Argc > 3) ? (uint8_t)strtoul(_ppcArgv[3], NULL, 10) : ((u8Type == DECIMATOR_OFF) ? 1 : 2));
+}
+
+static int32_t terminal_imugen(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+    if(_u8Argc < 3)
+    {
+        return QUELL_ERROR;
+    }
+
+    return imuStream_testSource((uint8_t)strtoul(_ppcArgv[1], NULL, 10), (strcmp(_ppcArgv[2], "off") == 0) ? 0 : strtoul(_ppcArgv[2], NULL, 10));
+}
+
+static int32_t terminal_top(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
+{
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+    static TaskStatus_t asTaskStatus[_TERMINAL_TOP_MAX_TASKS];
+    uint32_t u32TotalRunTime;
+    UBaseType_t uxTasks;
+
+    /* Snapshot of all the tasks (the table is static to keep it out of the terminal stack) */
+    uxTasks = uxTaskGetSystemState(asTaskStatus, _TERMINAL_TOP_MAX_TASKS, &u32TotalRunTime);
+
+    /* The run time counter runs on every core, so the share is of a single core since boot */
+    u32TotalRunTime /= 100UL;
+    if(uxTasks == 0 || u32TotalRunTime == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Same as help, the list is longer than the terminal FIFO Tx */
+    ESP_LOGI("terminal", "%-16s %4s %4s %6s %10s", "task", "core", "prio", "cpu%", "stack free");
+    for(UBaseType_t uxIndex = 0; uxIndex < uxTasks; uxIndex++)
+    {
+        ESP_LOGI("terminal", "%-16s %4d %4u %5u%% %10u",
+                 asTaskStatus[uxIndex].pcTaskName,
+                 (xTaskGetAffinity(asTaskStatus[uxIndex].xHandle) == tskNO_AFFINITY) ? -1 : (int)xTaskGetAffinity(asTaskStatus[uxIndex].xHandle),
+                 (unsigned)asTaskStatus[uxIndex].uxCurrentPriority,
+                 (unsigned)(asTaskStatus[uxIndex].ulRunTimeCounter / u32TotalRunTime),
+                 (unsigned)asTaskStatus[uxIndex].usStackHighWaterMark);
+    }
+
+    return QUELL_OK;
+#else
+    ESP_LOGI("terminal", "top needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+    return QUELL_ERROR;
+#endif
+}
+
 static int32_t  terminal_sendMarco(uint16_t _u8Argc, char **_ppcArgv, void* _internalArgs)
 {
-    char acPacketBuffer[32];
     char* pcMarco = "marco";
 
-            
-    /* Make the packet and send for the protocol task to send trought uart */
-    if(makePacket((uint8_t*)acPacketBuffer, sizeof(acPacketBuffer), (uint8_t*)pcMarco, strlen(pcMarco)) == QUELL_OK)
+    /* Inject the message for the protocol task to frame and send trought uart */
+    if(protocolInjectMessage((uint8_t*)pcMarco, strlen(pcMarco)) == QUELL_OK)
     {
         if(_internalArgs != NULL)
         {
@@ -59,7 +569,7 @@ static int32_t  terminal_sendMarco(uint16_t _u8Argc, char **_ppcArgv, void* _int
 
             FIFO_printf(psFIFOTx, "Msg Tx: %s\n", pcMarco); //To match and ackownledge like the rest of the debug
         }
-        return (protocolInjectData(acPacketBuffer, PACKE_SIZE(strlen(pcMarco))));
+        return QUELL_OK;
     }
 
     //ESP_LOGI("terminal", "MARCOOOO");
@@ -162,9 +672,130 @@ int32_t processCommand(char* _pcCommand, void* _internalArgs)
 	return QUELL_ERROR;
 }
 
+/* Terminal stream consumer, prints what the bus has for it at the terminal pace (and loses what it can not keep up with) */
+void terminal_processBus(void)
+{
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    char acLine[(_TERMINAL_BUS_PRINT_BYTES * 2) + 1];
+
+    while(bTerminalBusOn == true && sampleBus_peek(&sTerminalBus, &pu8Message, &u16Size) == QUELL_OK)
+    {
+        uint16_t u16Index;
+        for(u16Index = 0; u16Index < u16Size && u16Index < _TERMINAL_BUS_PRINT_BYTES; u16Index++)
+        {
+            sprintf(&acLine[u16Index * 2], "%02x", pu8Message[u16Index]);
+        }
+        acLine[u16Index * 2] = 0;
+
+        if(sampleBus_release(&sTerminalBus) == QUELL_OK)
+        {
+            ESP_LOGI("terminal", "bus %u %s", u16Size, acLine);
+        }
+    }
+}
+
+/* A command received through the terminal tunnel: what it prints (logs and terminal FIFO) goes back the same way */
+static void terminal_runRemoteCommand(char *_pcCommand)
+{
+    static char acTxBuffer[_TERMINAL_TUNNEL_TX_SIZE];
+    fifo_t sFIFOTx;
+    char acChunk[48];
+    uint16_t u16Length;
+    uint32_t u32Cut;
+    int32_t i32Result;
+
+    FIFO_init(&sFIFOTx, acTxBuffer, sizeof(acTxBuffer));
+    protocolTunnelCapture(true);
+    i32Result = processCommand(_pcCommand, (void*)&sFIFOTx);
+    u32Cut = protocolTunnelCapture(false);
+
+    /* Once a line found no room in time the tunnel is not waited for again, only the outcome is tried */
+    do
+    {
+        for(u16Length = 0; u32Cut == 0 && u16Length < sizeof(acChunk) && FIFO_get(&sFIFOTx, &acChunk[u16Length]) == true; u16Length++);
+    }while(u16Length > 0 && terminal_tunnelWrite(acChunk, u16Length) == QUELL_OK);
+
+    if(u32Cut > 0)
+    {
+        ESP_LOGW("terminal", "remote command <%.16s>: %u lines cut, the tunnel had no room", _pcCommand, u32Cut);
+        u16Length = snprintf(acChunk, sizeof(acChunk), "%s <%.16s> %u lines cut\r\n", (i32Result == QUELL_OK) ? "Executed" : "Failed", _pcCommand, u32Cut);
+    }
+    else
+    {
+        u16Length = snprintf(acChunk, sizeof(acChunk), "%s <%.16s>\r\n", (i32Result == QUELL_OK) ? "Executed" : "Failed", _pcCommand);
+    }
+    terminal_tunnelWrite(acChunk, (u16Length < sizeof(acChunk)) ? u16Length : sizeof(acChunk) - 1);
+}
+
+/* Prints a line of a unit (a remote command or its log), without its line ending */
+static void terminal_printTunnelLine(uint8_t _u8Channel, uint8_t _u8Source, terminal_tunnel_line_t *_psLine)
+{
+    while(_psLine->u16Length > 0 && (_psLine->acLine[_psLine->u16Length - 1] == '\r' || _psLine->acLine[_psLine->u16Length - 1] == '\n'))
+    {
+        _psLine->u16Length--;
+    }
+    _psLine->acLine[_psLine->u16Length] = 0;
+
+    if(_u8Channel == MESSAGE_CHANNEL_TERMINAL)
+    {
+        ESP_LOGI("terminal", "unit %u> %s", _u8Source, _psLine->acLine);
+    }
+    else
+    {
+        ESP_LOGI("terminal", "unit %u log: %s", _u8Source, _psLine->acLine);
+    }
+    _psLine->u16Length = 0;
+}
+
+/* Tunnels of the protocol link: commands for this unit are run, lines of the others are printed */
+void terminal_processTunnels(void)
+{
+    char acData[MESSAGE_CHANNEL_DATA_MAX_COUNT];
+    uint16_t u16Size;
+    uint8_t u8Source;
+
+    for(uint8_t u8Channel = 0; u8Channel < CHANNEL_TUNNELS; u8Channel++)
+    {
+        while(protocolTunnelRead(u8Channel, acData, sizeof(acData), &u16Size, &u8Source) == QUELL_OK)
+        {
+            for(uint16_t u16Index = 0; u16Index < u16Size; u16Index++)
+            {
+                if(u8Channel == MESSAGE_CHANNEL_TERMINAL && bRemoteClient == false)
+                {
+                    /* The peer is whoever sent the last command, so the answer goes back to it */
+                    if(acData[u16Index] == '\r' || acData[u16Index] == '\n')
+                    {
+                        acRemoteCommand[u16RemoteCommandIndex] = 0;
+                        if(u16RemoteCommandIndex > 0)
+                        {
+                            terminal_runRemoteCommand(acRemoteCommand);
+                        }
+                        u16RemoteCommandIndex = 0;
+                    }
+                    else if(u16RemoteCommandIndex < sizeof(acRemoteCommand) - 1)
+                    {
+                        acRemoteCommand[u16RemoteCommandIndex++] = acData[u16Index];
+                    }
+                }
+                else if(u8Source < _TERMINAL_TUNNEL_SOURCES)
+                {
+                    terminal_tunnel_line_t *psLine = &asTunnelLines[u8Channel][u8Source];
+
+                    psLine->acLine[psLine->u16Length++] = acData[u16Index];
+                    if(acData[u16Index] == '\n' || psLine->u16Length >= sizeof(psLine->acLine) - 1)
+                    {
+                        terminal_printTunnelLine(u8Channel, u8Source, psLine);
+                    }
+                }
+            }
+        }
+    }
+}
+
 int32_t processTerminal(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, char* _pcTAG)
 {
-    static char acCommandBuffer[64];
+    static char acCommandBuffer[_TERMINAL_LINE_SIZE];
     static uint16_t u16CommandBufferIndex = 0;
     char cData;
 
@@ -182,6 +813,19 @@ int32_t processTerminal(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, char* _pcTAG)
             
             u16CommandBufferIndex = 0;
             //ESP_LOGI(_pcTAG, "<%s>", acCommandBuffer);
+
+            /* While a remote session is open every line goes to the unit, "exit" ends it */
+            if(bRemoteSession == true && acCommandBuffer[0] != 0)
+            {
+                if(strcmp(acCommandBuffer, "exit") == 0)
+                {
+                    bRemoteSession = false;
+                    FIFO_printf(_psFIFOTx, "Executed <%s>\r\n", acCommandBuffer);
+                    return QUELL_OK;
+                }
+                return terminal_remoteSend(acCommandBuffer);
+            }
+
             if(processCommand(acCommandBuffer, (void*)_psFIFOTx) == QUELL_OK)
             {
                 FIFO_printf(_psFIFOTx, "Executed <%s>\r\n", acCommandBuffer);
@@ -4,6 +4,8 @@
 #include <string.h>
 #include "FIFO.h"
 
+void terminal_processBus(void);
+void terminal_processTunnels(void);
 int32_t processTerminal(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, char* _pcTAG);
 
 #endif /* _TERMINAL_H_ */
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "terminalStream.h"
+#include "protocolTask.h"
+#include "protocol.h"
+#include "messages.h"
+#include "FIFOUart.h"
+#include "quell.h"
+
+#define TERMINAL_STREAM_FIFO_SIZE (2048UL)
+#define TERMINAL_STREAM_MAX_PAYLOAD (256UL)
+#define TERMINAL_STREAM_STATS_PERIOD_MS (1000UL)
+#define TERMINAL_STREAM_SETTLE_MS (100UL)  //Time for the host to follow the baud rate change
+#define TERMINAL_STREAM_DRAIN_MS (100UL)
+#define TERMINAL_STREAM_MIN_BAUD_RATE (9600UL)
+#define TERMINAL_STREAM_MAX_BAUD_RATE (5000000UL)
+
+/* The biggest stream message always fits the stream FIFO */
+_Static_assert(PACKE_SIZE(MESSAGE_STREAM_HEADER_SIZE + TERMINAL_STREAM_MAX_PAYLOAD) < TERMINAL_STREAM_FIFO_SIZE, "TERMINAL_STREAM_FIFO_SIZE too small for a stream message");
+
+typedef enum
+{
+    TERMINAL_STREAM_IDLE = 0,
+    TERMINAL_STREAM_STARTING,   //Requested by the command, switches once its answer went out
+    TERMINAL_STREAM_ACTIVE
+}terminal_stream_state_t;
+
+static terminal_stream_state_t eStreamState = TERMINAL_STREAM_IDLE;
+static uint32_t u32StreamSources;
+static uint32_t u32StreamBaudRate;
+static fifo_t sStreamFIFO;
+static char *pcStreamFIFOBuffer = NULL;
+static sample_bus_subscriber_t sStreamBus;
+static vprintf_like_t fpStreamPreviousLog = NULL;
+static uint16_t u16StreamSequence;
+static uint8_t u8StreamStopMatched;
+static uint32_t u32StreamLastStatsMs;
+
+/* Statistics */
+static uint32_t u32StreamSent;
+static uint32_t u32StreamLost;
+static volatile uint32_t u32StreamLogsMuted;
+
+/* Console of the log lines while streaming (protocolSetLogConsole): they still go through the tunnels, here they are only counted (UART0 carries nothing but packets) */
+static int terminalStream_log(const char *_pcFormat, va_list _tArgs)
+{
+    u32StreamLogsMuted++;
+    return 0;
+}
+
+/* Frames one stream message into the stream FIFO, a full FIFO loses it (the sequence still moves, so the host sees the gap) */
+static int32_t terminalStream_send(uint8_t _u8Type, const uint8_t *_pu8Payload, uint16_t _u16PayloadSize)
+{
+    uint8_t au8Header[MESSAGE_STREAM_HEADER_SIZE];
+    message_stream_header_t sHeader;
+    protocol_fragment_t asFragments[2];
+
+    sHeader.u8Type = _u8Type;
+    sHeader.u16Sequence = u16StreamSequence++;
+    sHeader.u32Timestamp = (uint32_t)esp_timer_get_time();
+
+    asFragments[0].pu8Data = au8Header;
+    messages_encodeStreamHeader(&sHeader, au8Header, sizeof(au8Header), &asFragments[0].u16Size);
+    asFragments[1].pu8Data = _pu8Payload;
+    asFragments[1].u16Size = _u16PayloadSize;
+
+    if(sendMessageFragments(&sStreamFIFO, asFragments, (_u16PayloadSize > 0) ? 2 : 1) == QUELL_ERROR)
+    {
+        u32StreamLost++;
+        return QUELL_ERROR;
+    }
+
+    u32StreamSent++;
+    return QUELL_OK;
+}
+
+static int32_t terminalStream_sendStats(uint8_t _u8Type)
+{
+    uint8_t au8Stats[MESSAGE_STREAM_STATS_SIZE];
+    message_stream_stats_t sStats;
+    uint16_t u16Size;
+
+    sStats.u32Sent = u32StreamSent;
+    sStats.u32Lost = u32StreamLost;
+    sStats.u32BusDropped = sStreamBus.u32Dropped;
+    sStats.u32LogsMuted = u32StreamLogsMuted;
+    messages_encodeStreamStats(&sStats, au8Stats, sizeof(au8Stats), &u16Size);
+
+    return terminalStream_send(_u8Type, au8Stats, u16Size);
+}
+
+int32_t terminalStream_request(uint32_t _u32Sources, uint32_t _u32BaudRate)
+{
+    if(eStreamState != TERMINAL_STREAM_IDLE || _u32Sources == 0 ||
+       _u32BaudRate < TERMINAL_STREAM_MIN_BAUD_RATE || _u32BaudRate > TERMINAL_STREAM_MAX_BAUD_RATE)
+    {
+        return QUELL_ERROR;
+    }
+
+    u32StreamSources = _u32Sources;
+    u32StreamBaudRate = _u32BaudRate;
+    eStreamState = TERMINAL_STREAM_STARTING;
+
+    return QUELL_OK;
+}
+
+static void terminalStream_start(uint32_t _u32UartNumber, fifo_t *_psFIFORx, fifo_t *_psFIFOTx, const char* _pcTAG)
+{
+    pcStreamFIFOBuffer = (char*) malloc(TERMINAL_STREAM_FIFO_SIZE);
+    if(FIFO_init(&sStreamFIFO, pcStreamFIFOBuffer, TERMINAL_STREAM_FIFO_SIZE) == false ||
+       ((u32StreamSources & TERMINAL_STREAM_SOURCE_BUS) != 0 && protocolSubscribe(&sStreamBus) == QUELL_ERROR))
+    {
+        free(pcStreamFIFOBuffer);
+        pcStreamFIFOBuffer = NULL;
+        FIFO_printf(_psFIFOTx, "stream error\n");
+        eStreamState = TERMINAL_STREAM_IDLE;
+        return;
+    }
+    if((u32StreamSources & TERMINAL_STREAM_SOURCE_BUS) == 0)
+    {
+        memset(&sStreamBus, 0, sizeof(sStreamBus));
+    }
+
+    /* The answer of the command still goes out in text, at the old baud rate */
+    FIFO_printf(_psFIFOTx, "stream on %u\n", u32StreamBaudRate);
+    while(uartSendBytes(_u32UartNumber, _psFIFOTx, _pcTAG) == QUELL_OK);
+    uart_wait_tx_done(_u32UartNumber, pdMS_TO_TICKS(TERMINAL_STREAM_DRAIN_MS));
+
+    fpStreamPreviousLog = protocolSetLogConsole(terminalStream_log);
+    uart_set_baudrate(_u32UartNumber, u32StreamBaudRate);
+    vTaskDelay(pdMS_TO_TICKS(TERMINAL_STREAM_SETTLE_MS));
+    FIFO_clean(_psFIFORx);
+
+    u16StreamSequence = 0;
+    u8StreamStopMatched = 0;
+    u32StreamSent = 0;
+    u32StreamLost = 0;
+    u32StreamLogsMuted = 0;
+    u32StreamLastStatsMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    eStreamState = TERMINAL_STREAM_ACTIVE;
+}
+
+static void terminalStream_stop(uint32_t _u32UartNumber, fifo_t *_psFIFOTx, const char* _pcTAG)
+{
+    /* Last counters, then everything queued goes out before the baud rate changes back */
+    terminalStream_sendStats(TERMINAL_STREAM_TYPE_END);
+    while(uartSendBytes(_u32UartNumber, &sStreamFIFO, _pcTAG) == QUELL_OK);
+    uart_wait_tx_done(_u32UartNumber, pdMS_TO_TICKS(TERMINAL_STREAM_DRAIN_MS));
+
+    uart_set_baudrate(_u32UartNumber, TERMINAL_STREAM_TEXT_BAUD_RATE);
+    protocolSetLogConsole(fpStreamPreviousLog);
+    free(pcStreamFIFOBuffer);
+    pcStreamFIFOBuffer = NULL;
+    eStreamState = TERMINAL_STREAM_IDLE;
+
+    FIFO_printf(_psFIFOTx, "stream off sent:%u lost:%u\n", u32StreamSent, u32StreamLost);
+}
+
+/* Returns true while the terminal belongs to the stream (text commands are not processed) */
+bool terminalStream_process(uint32_t _u32UartNumber, fifo_t *_psFIFORx, fifo_t *_psFIFOTx, const char* _pcTAG)
+{
+    uint8_t au8Payload[TERMINAL_STREAM_MAX_PAYLOAD];
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    char cData;
+
+    if(eStreamState == TERMINAL_STREAM_IDLE)
+    {
+        return false;
+    }
+
+    if(eStreamState == TERMINAL_STREAM_STARTING)
+    {
+        terminalStream_start(_u32UartNumber, _psFIFORx, _psFIFOTx, _pcTAG);
+        return (eStreamState == TERMINAL_STREAM_ACTIVE);
+    }
+
+    /* The host only sends the stop sequence, anything else is ignored */
+    while(FIFO_get(_psFIFORx, &cData) == true)
+    {
+        if(cData == TERMINAL_STREAM_STOP[u8StreamStopMatched])
+        {
+            u8StreamStopMatched++;
+        }
+        else
+        {
+            u8StreamStopMatched = (cData == TERMINAL_STREAM_STOP[0]) ? 1 : 0;
+        }
+
+        if(u8StreamStopMatched == strlen(TERMINAL_STREAM_STOP))
+        {
+            terminalStream_stop(_u32UartNumber, _psFIFOTx, _pcTAG);
+            return true;
+        }
+    }
+
+    /* Bus messages are copied out before release says they were intact, a torn one is never framed */
+    while((u32StreamSources & TERMINAL_STREAM_SOURCE_BUS) != 0 && sampleBus_peek(&sStreamBus, &pu8Message, &u16Size) == QUELL_OK)
+    {
+        u16Size = (u16Size > sizeof(au8Payload)) ? sizeof(au8Payload) : u16Size;
+        memcpy(au8Payload, pu8Message, u16Size);
+        if(sampleBus_release(&sStreamBus) == QUELL_OK)
+        {
+            terminalStream_send(TERMINAL_STREAM_TYPE_BUS, au8Payload, u16Size);
+        }
+    }
+
+    uint32_t u32NowMs = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if((u32StreamSources & TERMINAL_STREAM_SOURCE_STATS) != 0 && u32NowMs - u32StreamLastStatsMs >= TERMINAL_STREAM_STATS_PERIOD_MS)
+    {
+        u32StreamLastStatsMs = u32NowMs;
+        terminalStream_sendStats(TERMINAL_STREAM_TYPE_STATS);
+    }
+
+    /* Paced by the uart, uart_write_bytes waits when its ring buffer is full */
+    while(uartSendBytes(_u32UartNumber, &sStreamFIFO, _pcTAG) == QUELL_OK);
+
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef _TERMINAL_STREAM_H_
+#define _TERMINAL_STREAM_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "FIFO.h"
+
+/*
+    TERMINAL BINARY STREAM
+
+    "stream <bus|stats|all> [baud]" answers "stream on <baud>" in text, then UART0 switches to the baud
+    rate and carries only packets (same framing as the protocol link: SOH, size, SOT, message, EOT,
+    CRC16), the logs are muted on it meanwhile (they still go through the log and terminal tunnels of the
+    protocol task, only their console copy is dropped). Receiving "+++" sends the end message and goes back to text
+    mode at 115200.
+
+    Every stream message is a stream_header (type, sequence, timestamp) followed by its payload: the bus
+    message, or a stream_stats for the stats and end messages (both in messages.schema).
+*/
+
+#define TERMINAL_STREAM_TYPE_BUS (0x01)
+#define TERMINAL_STREAM_TYPE_STATS (0x02)
+#define TERMINAL_STREAM_TYPE_END (0x7F)
+
+#define TERMINAL_STREAM_SOURCE_BUS (0x01)
+#define TERMINAL_STREAM_SOURCE_STATS (0x02)
+
+#define TERMINAL_STREAM_STOP "+++"
+#define TERMINAL_STREAM_TEXT_BAUD_RATE (115200UL)
+
+int32_t terminalStream_request(uint32_t _u32Sources, uint32_t _u32BaudRate);
+bool terminalStream_process(uint32_t _u32UartNumber, fifo_t *_psFIFORx, fifo_t *_psFIFOTx, const char* _pcTAG);
+
+#endif /* _TERMINAL_STREAM_H_ */
@@ -10,6 +10,8 @@
 #include "quell.h"
 #include "FIFOUart.h"
 #include "terminal.h"
+#include "taskConfig.h"
+#include "terminalStream.h"
 
 
 #define TERMINAL_UART_NUM UART_NUM_0
@@ -36,13 +38,30 @@ static void terminal_task(void *pvParameters)
 
     for(;;) 
     {
-        /* Transfer received bytes from uart to FIFO Rx */
-        uartReceiveBytes(TERMINAL_UART_NUM, uart_queue_rx, &sFIFORx, TAG);
+        /* Transfer received bytes from uart to FIFO Rx (blocks on the uart event queue) */
+        uartReceiveBytes(TERMINAL_UART_NUM, uart_queue_rx, &sFIFORx, TASK_POLL_TICKS, TAG);
+
+        /* In binary stream mode the uart carries only stream packets, until the stop sequence */
+        if(terminalStream_process(TERMINAL_UART_NUM, &sFIFORx, &sFIFOTx, TAG) == true)
+        {
+            continue;
+        }
+
         /* Transfer received bytes from FIFO Rx to uart*/
-        uartSendBytes(TERMINAL_UART_NUM, &sFIFOTx, TAG);
+        while(uartSendBytes(TERMINAL_UART_NUM, &sFIFOTx, TAG) == QUELL_OK);
+
+        /* Process Terminal (every byte received, not one per pass, now that the task sleeps between passes) */
+        size_t tFIFOCount;
+        while(FIFO_count(&sFIFORx, &tFIFOCount) == true && tFIFOCount > 0)
+        {
+            processTerminal(&sFIFORx, &sFIFOTx, TAG);
+        }
+
+        /* Messages received on the protocol link, when "bus on" */
+        terminal_processBus();
 
-        /* Process Terminal */
-        processTerminal(&sFIFORx, &sFIFOTx, TAG);
+        /* Remote commands for this unit, and what the units answer or log */
+        terminal_processTunnels();
 
     }
     free(pu8FIFORxBuffer);
@@ -67,8 +86,8 @@ void terminalTaskInit(void)
         .source_clk = UART_SCLK_APB,
     };
 
-    //Install UART driver, and get the queue.
-    uart_driver_install(TERMINAL_UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 20, &uart_queue_rx, 0);
+    //Install UART driver, and get the queue. ISR in IRAM, as the protocol uarts (flashLog.h)
+    uart_driver_install(TERMINAL_UART_NUM, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 20, &uart_queue_rx, ESP_INTR_FLAG_IRAM);
     uart_param_config(TERMINAL_UART_NUM, &uart_config);
 
     //Set UART log level
@@ -76,6 +95,6 @@ void terminalTaskInit(void)
     //Set UART pins (using UART0 default pins ie no changes.)
     uart_set_pin(TERMINAL_UART_NUM, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
 
-    //Create Protocol task
-    xTaskCreate(terminal_task, "terminal_task", 4096, NULL, 0, NULL);
+    //Create Terminal task
+    xTaskCreatePinnedToCore(terminal_task, "terminal_task", TERMINAL_TASK_STACK_SIZE, NULL, TERMINAL_TASK_PRIORITY, NULL, TERMINAL_TASK_CORE);
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "capture.h"
+#include "quell.h"
+
+int32_t capture_init(capture_t *_psCapture, uint8_t *_pu8Buffer, size_t _tSize)
+{
+    if(_psCapture == NULL || _pu8Buffer == NULL || _tSize < CAPTURE_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psCapture->pu8Buffer = _pu8Buffer;
+    _psCapture->tSize = _tSize;
+    _psCapture->u32Dropped = 0;
+
+    /* File header */
+    memcpy(_pu8Buffer, CAPTURE_MAGIC, 4);
+    _pu8Buffer[4] = CAPTURE_VERSION;
+    _pu8Buffer[5] = _pu8Buffer[6] = _pu8Buffer[7] = 0;
+    _psCapture->tUsed = CAPTURE_HEADER_SIZE;
+
+    return QUELL_OK;
+}
+
+int32_t capture_append(capture_t *_psCapture, uint32_t _u32Timestamp, uint8_t _u8Link, bool _bTx, const uint8_t *_pu8Data, uint16_t _u16Length)
+{
+    uint8_t *pu8Record;
+
+    if(_psCapture == NULL || _psCapture->pu8Buffer == NULL || _pu8Data == NULL || _u16Length == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Append only, once full the capture keeps the beginning and counts what was lost */
+    if(_psCapture->tUsed + CAPTURE_RECORD_HEADER_SIZE + _u16Length > _psCapture->tSize)
+    {
+        _psCapture->u32Dropped += _u16Length;
+        return QUELL_ERROR;
+    }
+
+    pu8Record = &_psCapture->pu8Buffer[_psCapture->tUsed];
+    pu8Record[0] = (_u32Timestamp >> 24) & 0xFF;
+    pu8Record[1] = (_u32Timestamp >> 16) & 0xFF;
+    pu8Record[2] = (_u32Timestamp >> 8) & 0xFF;
+    pu8Record[3] = _u32Timestamp & 0xFF;
+    pu8Record[4] = (_u8Link & CAPTURE_LINK_MASK) | ((_bTx == true) ? CAPTURE_DIRECTION_TX : 0);
+    pu8Record[5] = (_u16Length >> 8) & 0xFF;
+    pu8Record[6] = _u16Length & 0xFF;
+    memcpy(&pu8Record[CAPTURE_RECORD_HEADER_SIZE], _pu8Data, _u16Length);
+
+    _psCapture->tUsed += CAPTURE_RECORD_HEADER_SIZE + _u16Length;
+
+    return QUELL_OK;
+}
+
+int32_t capture_checkHeader(const uint8_t *_pu8Capture, size_t _tSize)
+{
+    if(_pu8Capture == NULL || _tSize < CAPTURE_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(memcmp(_pu8Capture, CAPTURE_MAGIC, 4) != 0 || _pu8Capture[4] != CAPTURE_VERSION)
+    {
+        return QUELL_ERROR;
+    }
+
+    return QUELL_OK;
+}
+
+/* Walks the records without copying, start with *_ptOffset = 0 */
+int32_t capture_nextRecord(const uint8_t *_pu8Capture, size_t _tSize, size_t *_ptOffset, capture_record_t *_psRecord)
+{
+    const uint8_t *pu8Record;
+
+    if(_pu8Capture == NULL || _ptOffset == NULL || _psRecord == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    if(*_ptOffset < CAPTURE_HEADER_SIZE)
+    {
+        *_ptOffset = CAPTURE_HEADER_SIZE;
+    }
+
+    /* A capture cut short (power loss, partial dump) ends at its last whole record */
+    if(*_ptOffset + CAPTURE_RECORD_HEADER_SIZE > _tSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    pu8Record = &_pu8Capture[*_ptOffset];
+    _psRecord->u32Timestamp = ((uint32_t)pu8Record[0] << 24) | ((uint32_t)pu8Record[1] << 16) | ((uint32_t)pu8Record[2] << 8) | (uint32_t)pu8Record[3];
+    _psRecord->u8Link = pu8Record[4] & CAPTURE_LINK_MASK;
+    _psRecord->bTx = (pu8Record[4] & CAPTURE_DIRECTION_TX) != 0;
+    _psRecord->u16Length = ((uint16_t)pu8Record[5] << 8) | (uint16_t)pu8Record[6];
+    _psRecord->pu8Data = &pu8Record[CAPTURE_RECORD_HEADER_SIZE];
+
+    if(*_ptOffset + CAPTURE_RECORD_HEADER_SIZE + _psRecord->u16Length > _tSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_ptOffset += CAPTURE_RECORD_HEADER_SIZE + _psRecord->u16Length;
+
+    return QUELL_OK;
+}
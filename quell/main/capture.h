@@ -0,0 +1,55 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    LINK CAPTURE FORMAT (Big Endian, append only)
+
+    FILE HEADER:
+    ITEM:                   LENGTH:             DESCRIPTION:                    CONST VALUE:
+    Magic                   u8[4]               File type                       "QCAP"
+    Version                 u8                  Format version                  0x01
+    Reserved                u8[3]               Zero                            0x00
+
+    RECORD (repeated until the end of the file):
+    ITEM:                   LENGTH:             DESCRIPTION:                    CONST VALUE:
+    Timestamp               u32                 Microseconds since boot (wraps) NO
+    Link/Direction          u8                  Bit 7: TX, bits 0-6: link (uart) NO
+    Length                  u16                 Number of data bytes            NO
+    Data                    Variable            Bytes as seen on the wire       NO
+*/
+
+#define CAPTURE_MAGIC "QCAP"
+#define CAPTURE_VERSION (0x01)
+#define CAPTURE_HEADER_SIZE (8)
+#define CAPTURE_RECORD_HEADER_SIZE (7)
+#define CAPTURE_DIRECTION_TX (0x80)
+#define CAPTURE_LINK_MASK (0x7F)
+
+typedef struct
+{
+    uint8_t *pu8Buffer;
+    size_t tSize;
+    size_t tUsed;
+    uint32_t u32Dropped;    //Bytes that did not fit anymore
+}capture_t;
+
+typedef struct
+{
+    uint32_t u32Timestamp;
+    uint8_t u8Link;
+    bool bTx;
+    uint16_t u16Length;
+    const uint8_t *pu8Data;
+}capture_record_t;
+
+int32_t capture_init(capture_t *_psCapture, uint8_t *_pu8Buffer, size_t _tSize);
+int32_t capture_append(capture_t *_psCapture, uint32_t _u32Timestamp, uint8_t _u8Link, bool _bTx, const uint8_t *_pu8Data, uint16_t _u16Length);
+int32_t capture_checkHeader(const uint8_t *_pu8Capture, size_t _tSize);
+int32_t capture_nextRecord(const uint8_t *_pu8Capture, size_t _tSize, size_t *_ptOffset, capture_record_t *_psRecord);
+
+#endif /* _CAPTURE_H_ */
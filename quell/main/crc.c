@@ -7,7 +7,7 @@
 *  One of the many CRC16 CCITT (XMODEM) implementations
 *  Tested in https://crccalc.com/
 */
-static const uint16_t ccitt_hash[] = {
+const uint16_t ccitt_hash[] = {
     0x0000,0x1021,0x2042,0x3063,0x4084,0x50a5,0x60c6,0x70e7,
     0x8108,0x9129,0xa14a,0xb16b,0xc18c,0xd1ad,0xe1ce,0xf1ef,
     0x1231,0x0210,0x3273,0x2252,0x52b5,0x4294,0x72f7,0x62d6,
@@ -51,4 +51,19 @@ uint16_t calculateCRC16CCITT(char *ptr, int16_t count)
     	crc = (crc << 8) ^ ccitt_hash[((crc >> 8) ^ *(ptr++)) & 0x00FF];
     }
     return crc;
-}
\ No newline at end of file
+}
+
+/* CRC-8 (polynomial 0x07, init 0), bitwise: only used on a few header bytes */
+uint8_t calculateCRC8(const uint8_t *ptr, int16_t count)
+{
+    uint8_t crc = 0;
+    while (count-- > 0)
+    {
+        crc ^= *(ptr++);
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
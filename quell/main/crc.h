@@ -1,6 +1,17 @@
 #ifndef _CRC_H_
 #define _CRC_H_
 
+#include <stdint.h>
+
+extern const uint16_t ccitt_hash[];
+
 uint16_t calculateCRC16CCITT(char *ptr, int16_t count);
+uint8_t calculateCRC8(const uint8_t *ptr, int16_t count);
+
+/* One byte step of calculateCRC16CCITT, to compute the CRC while data is being copied (start with 0) */
+static inline uint16_t updateCRC16CCITT(uint16_t crc, char data)
+{
+    return (crc << 8) ^ ccitt_hash[((crc >> 8) ^ data) & 0x00FF];
+}
 
 #endif /* _CRC_H_ */
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "decimator.h"
+#include "quell.h"
+
+/* -6 dB point of the FIR in output sample rates, with 12 taps per phase the Hamming transition ends at the output Nyquist */
+#define DECIMATOR_FIR_CUTOFF (0.34f)
+
+static uint8_t decimatorCommon(uint8_t _u8A, uint8_t _u8B)
+{
+    while(_u8B != 0)
+    {
+        uint8_t u8Rest = _u8A % _u8B;
+
+        _u8A = _u8B;
+        _u8B = u8Rest;
+    }
+
+    return _u8A;
+}
+
+/* The taps are designed at u8Up x the input rate, branch b takes taps b, b + u8Up, b + 2 x u8Up... */
+static int32_t decimatorDesignFIR(decimator_t *_psDecimator)
+{
+    float afTaps[DECIMATOR_MAX_TAPS];
+    uint16_t u16Length = (uint16_t)_psDecimator->u8Factor * DECIMATOR_TAPS_PER_PHASE;
+    uint8_t u8Up = _psDecimator->u8Up;
+    float fCutoff = DECIMATOR_FIR_CUTOFF / _psDecimator->u8Factor;
+    float fCentre = (u16Length - 1) / 2.0f;
+
+    for(uint16_t u16Tap = 0; u16Tap < u16Length; u16Tap++)
+    {
+        float fT = u16Tap - fCentre;
+        float fSinc = (fT == 0.0f) ? 2.0f * fCutoff : sinf(2.0f * (float)M_PI * fCutoff * fT) / ((float)M_PI * fT);
+        float fWindow = 0.54f - (0.46f * cosf(2.0f * (float)M_PI * u16Tap / (u16Length - 1)));
+
+        afTaps[u16Tap] = fSinc * fWindow;
+    }
+
+    for(uint8_t u8Branch = 0; u8Branch < u8Up; u8Branch++)
+    {
+        int16_t *pi16Branch = &_psDecimator->ai16Coefficients[u8Branch * _psDecimator->u16Taps];
+        uint16_t u16Centre = ((u16Length / 2) - u8Branch + (u8Up / 2)) / u8Up;
+        float fSum = 0.0f;
+        int32_t i32Sum = 0;
+        int32_t i32AbsSum = 0;
+
+        for(uint16_t u16Tap = 0; u16Tap < _psDecimator->u16Taps; u16Tap++)
+        {
+            uint16_t u16Prototype = u8Branch + (u8Up * u16Tap);
+
+            fSum += (u16Prototype < u16Length) ? afTaps[u16Prototype] : 0.0f;
+        }
+
+        /* Unity gain at DC after the rounding: what is left over goes to the tap nearest the centre */
+        for(uint16_t u16Tap = 0; u16Tap < _psDecimator->u16Taps; u16Tap++)
+        {
+            uint16_t u16Prototype = u8Branch + (u8Up * u16Tap);
+
+            pi16Branch[u16Tap] = (u16Prototype < u16Length) ? (int16_t)lroundf(32768.0f * afTaps[u16Prototype] / fSum) : 0;
+            i32Sum += pi16Branch[u16Tap];
+        }
+        u16Centre = (u16Centre < _psDecimator->u16Taps) ? u16Centre : _psDecimator->u16Taps - 1;
+        pi16Branch[u16Centre] += (int16_t)(32768 - i32Sum);
+
+        /* |output| <= 32768 x sum |taps| must fit the int32 accumulator */
+        for(uint16_t u16Tap = 0; u16Tap < _psDecimator->u16Taps; u16Tap++)
+        {
+            i32AbsSum += (pi16Branch[u16Tap] < 0) ? -pi16Branch[u16Tap] : pi16Branch[u16Tap];
+        }
+        if(i32AbsSum >= 65536)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+int32_t decimator_init(decimator_t *_psDecimator, decimator_type_t _eType, uint8_t _u8Factor, uint8_t _u8Channels)
+{
+    return decimator_initRational(_psDecimator, _eType, 1, _u8Factor, _u8Channels);
+}
+
+/* Output rate _u8Up / _u8Factor of the input rate, above 1 only with a FIR */
+int32_t decimator_initRational(decimator_t *_psDecimator, decimator_type_t _eType, uint8_t _u8Up, uint8_t _u8Factor, uint8_t _u8Channels)
+{
+    uint32_t u32Gain = 1;
+    uint8_t u8Common;
+
+    if(_psDecimator == NULL || _eType >= DECIMATOR_TYPE_COUNT || _u8Up == 0 || _u8Up > _u8Factor || _u8Factor > DECIMATOR_MAX_FACTOR ||
+       _u8Channels == 0 || _u8Channels > DECIMATOR_MAX_CHANNELS)
+    {
+        return QUELL_ERROR;
+    }
+    u8Common = decimatorCommon(_u8Factor, _u8Up);
+    _u8Up /= u8Common;
+    _u8Factor /= u8Common;
+    if((_eType == DECIMATOR_OFF && _u8Factor != 1) || (_eType == DECIMATOR_CIC && _u8Up != 1))
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psDecimator, 0, sizeof(decimator_t));
+    _psDecimator->eType = (_u8Factor == 1) ? DECIMATOR_OFF : _eType;
+    _psDecimator->u8Factor = _u8Factor;
+    _psDecimator->u8Up = _u8Up;
+    _psDecimator->u8Channels = _u8Channels;
+    _psDecimator->u8Phase = _u8Factor - _u8Up;
+
+    if(_psDecimator->eType == DECIMATOR_FIR)
+    {
+        _psDecimator->u16Taps = (((uint16_t)_u8Factor * DECIMATOR_TAPS_PER_PHASE) + _u8Up - 1) / _u8Up;
+        _psDecimator->u16Index = _psDecimator->u16Taps - 1;
+        return decimatorDesignFIR(_psDecimator);
+    }
+
+    if(_psDecimator->eType == DECIMATOR_CIC)
+    {
+        for(uint8_t u8Stage = 0; u8Stage < DECIMATOR_CIC_ORDER; u8Stage++)
+        {
+            u32Gain *= _u8Factor;
+        }
+        _psDecimator->u32Scale = (uint32_t)(((1ULL << 32) + (u32Gain / 2)) / u32Gain);
+    }
+
+    return QUELL_OK;
+}
+
+static void decimatorFIR(decimator_t *_psDecimator, const int16_t *_pi16Input, int16_t *_pi16Output, bool _bOutput)
+{
+    uint16_t u16Index = _psDecimator->u16Index;
+    const int16_t *pi16Coefficients = &_psDecimator->ai16Coefficients[_psDecimator->u8Offset * _psDecimator->u16Taps];
+
+    for(uint8_t u8Channel = 0; u8Channel < _psDecimator->u8Channels; u8Channel++)
+    {
+        int16_t *pi16History = _psDecimator->aai16History[u8Channel];
+
+        pi16History[u16Index] = _pi16Input[u8Channel];
+        pi16History[u16Index + _psDecimator->u16Taps] = _pi16Input[u8Channel];
+
+        if(_bOutput == true)
+        {
+            const int16_t *pi16Window = &pi16History[u16Index];
+            int32_t i32Accumulator = 1L << 14;
+
+            for(uint16_t u16Tap = 0; u16Tap < _psDecimator->u16Taps; u16Tap++)
+            {
+                i32Accumulator += (int32_t)pi16Coefficients[u16Tap] * pi16Window[u16Tap];
+            }
+            i32Accumulator >>= 15;
+            _pi16Output[u8Channel] = (int16_t)((i32Accumulator > INT16_MAX) ? INT16_MAX : (i32Accumulator < INT16_MIN) ? INT16_MIN : i32Accumulator);
+        }
+    }
+
+    _psDecimator->u16Index = (u16Index == 0) ? _psDecimator->u16Taps - 1 : u16Index - 1;
+}
+
+static void decimatorCIC(decimator_t *_psDecimator, const int16_t *_pi16Input, int16_t *_pi16Output, bool _bOutput)
+{
+    for(uint8_t u8Channel = 0; u8Channel < _psDecimator->u8Channels; u8Channel++)
+    {
+        uint32_t *pu32Integrator = _psDecimator->aau32Integrator[u8Channel];
+        uint32_t *pu32Comb = _psDecimator->aau32Comb[u8Channel];
+        uint32_t u32Value = (uint32_t)(int32_t)_pi16Input[u8Channel];
+
+        for(uint8_t u8Stage = 0; u8Stage < DECIMATOR_CIC_ORDER; u8Stage++)
+        {
+            pu32Integrator[u8Stage] += u32Value;
+            u32Value = pu32Integrator[u8Stage];
+        }
+
+        if(_bOutput == true)
+        {
+            for(uint8_t u8Stage = 0; u8Stage < DECIMATOR_CIC_ORDER; u8Stage++)
+            {
+                uint32_t u32Previous = pu32Comb[u8Stage];
+                pu32Comb[u8Stage] = u32Value;
+                u32Value -= u32Previous;
+            }
+
+            /* Exact sum of the inputs times the gain factor^order, the scale takes the gain out */
+            _pi16Output[u8Channel] = (int16_t)((((int64_t)(int32_t)u32Value * _psDecimator->u32Scale) + (1LL << 31)) >> 32);
+        }
+    }
+}
+
+/* A freshly initialised filter picks up a running stream: the inputs _psPrevious (NULL for none) holds, or _pi16Input, the last one */
+int32_t decimator_prime(decimator_t *_psDecimator, const decimator_t *_psPrevious, const int16_t *_pi16Input)
+{
+    int16_t ai16Output[DECIMATOR_MAX_CHANNELS];
+    uint16_t u16Known = 0;
+
+    if(_psDecimator == NULL || _pi16Input == NULL || (_psPrevious != NULL && _psPrevious->u8Channels != _psDecimator->u8Channels))
+    {
+        return QUELL_ERROR;
+    }
+
+    if(_psDecimator->eType == DECIMATOR_FIR)
+    {
+        if(_psPrevious != NULL && _psPrevious->eType == DECIMATOR_FIR)
+        {
+            u16Known = (_psPrevious->u16Taps < _psDecimator->u16Taps) ? _psPrevious->u16Taps : _psDecimator->u16Taps;
+        }
+
+        /* Newest first, the window of either starts right after its write index */
+        for(uint8_t u8Channel = 0; u8Channel < _psDecimator->u8Channels; u8Channel++)
+        {
+            int16_t *pi16History = _psDecimator->aai16History[u8Channel];
+            int16_t i16Value = _pi16Input[u8Channel];
+
+            for(uint16_t u16Age = 0; u16Age < _psDecimator->u16Taps; u16Age++)
+            {
+                uint16_t u16Index = (_psDecimator->u16Index + 1 + u16Age) % _psDecimator->u16Taps;
+
+                i16Value = (u16Age < u16Known) ? _psPrevious->aai16History[u8Channel][_psPrevious->u16Index + 1 + u16Age] : i16Value;
+                pi16History[u16Index] = i16Value;
+                pi16History[u16Index + _psDecimator->u16Taps] = i16Value;
+            }
+        }
+    }
+    else if(_psDecimator->eType == DECIMATOR_CIC)
+    {
+        /* As long as the filter spans, with the combs updated where its outputs would have been, then from the start of a phase again */
+        for(uint16_t u16Input = 0; u16Input < (uint16_t)DECIMATOR_CIC_ORDER * _psDecimator->u8Factor; u16Input++)
+        {
+            decimatorCIC(_psDecimator, _pi16Input, ai16Output, (u16Input % _psDecimator->u8Factor) == (_psDecimator->u8Factor - 1));
+        }
+    }
+
+    return QUELL_OK;
+}
+
+/* True when the input completed an output sample (written to _pi16Output) */
+bool decimator_process(decimator_t *_psDecimator, const int16_t *_pi16Input, int16_t *_pi16Output)
+{
+    bool bOutput;
+
+    if(_psDecimator->eType == DECIMATOR_OFF)
+    {
+        memcpy(_pi16Output, _pi16Input, _psDecimator->u8Channels * sizeof(int16_t));
+        return true;
+    }
+
+    /* An output falls on every u8Factor-th upsampled step, this input completes it when it is less than u8Up steps ahead */
+    bOutput = (_psDecimator->u8Phase < _psDecimator->u8Up);
+    if(bOutput == true)
+    {
+        _psDecimator->u8Offset = _psDecimator->u8Phase;
+        _psDecimator->u8Phase += _psDecimator->u8Factor;
+    }
+    _psDecimator->u8Phase -= _psDecimator->u8Up;
+
+    if(_psDecimator->eType == DECIMATOR_FIR)
+    {
+        decimatorFIR(_psDecimator, _pi16Input, _pi16Output, bOutput);
+    }
+    else
+    {
+        decimatorCIC(_psDecimator, _pi16Input, _pi16Output, bOutput);
+    }
+
+    return bOutput;
+}
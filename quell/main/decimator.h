@@ -0,0 +1,79 @@
+#ifndef _DECIMATOR_H_
+#define _DECIMATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    DECIMATOR
+
+    Anti-alias filter and integer downsampler for a few channels sampled together (an IMU sample is
+    6 channels), int16 in and out, fixed point only on the sample path. The FIR also resamples by a
+    fraction (decimator_initRational): up by u8Up, filtered, down by u8Factor, so the output rate is
+    u8Up / u8Factor of the input rate.
+
+    TYPE:                   COST PER INPUT:                 RESPONSE:
+    Off                     copy                            Factor 1, every sample goes through
+    FIR                     12 MACs per channel             Windowed sinc (Hamming) designed by init, Q15 taps.
+                                                            Flat to 0.2 x output rate, -50 dB from the output
+                                                            Nyquist on, so nothing above it folds back
+    CIC                     3 adds per channel              Third order cascaded integrator-comb: no multiplies,
+                                                            nulls at the multiples of the output rate but a droop
+                                                            of -1.3 to -1.7 dB at 0.2 x output rate and -9 to
+                                                            -12 dB at its Nyquist
+
+    The FIR has DECIMATOR_TAPS_PER_PHASE x factor taps and only the outputs that are kept get computed,
+    the cost of a polyphase filter. Resampling by a fraction, the taps are designed at u8Up times the
+    input rate and split in u8Up branches of u16Taps each: an output takes the branch of where it falls
+    between two inputs (u8Offset, in u8Up-ths of an input period after the input that completed it), the
+    zeros the upsampling put in between are never multiplied. Every branch has unity gain at DC. Both
+    delay the signal: (taps - 1) / 2 input samples for the FIR ((taps - 1) / (2 x u8Up) resampling),
+    3 x (factor - 1) / 2 for the CIC.
+
+    A filter replacing another one on a running stream (decimator_prime) takes over the inputs the FIR
+    before it still holds, older ones repeat the oldest of them (or the sample given, after a CIC or no
+    filter), so its first outputs do not ramp up from zero. A CIC settles on the sample given.
+*/
+
+#define DECIMATOR_MAX_CHANNELS (6)
+#define DECIMATOR_MAX_FACTOR (16)
+#define DECIMATOR_TAPS_PER_PHASE (12)
+#define DECIMATOR_MAX_TAPS (DECIMATOR_MAX_FACTOR * DECIMATOR_TAPS_PER_PHASE)
+#define DECIMATOR_MAX_COEFFICIENTS (DECIMATOR_MAX_TAPS + DECIMATOR_MAX_FACTOR)  //Branches padded to the same length
+#define DECIMATOR_CIC_ORDER (3)
+
+typedef enum
+{
+    DECIMATOR_OFF = 0,
+    DECIMATOR_FIR,
+    DECIMATOR_CIC,
+    DECIMATOR_TYPE_COUNT
+}decimator_type_t;
+
+typedef struct
+{
+    decimator_type_t eType;
+    uint8_t u8Factor;
+    uint8_t u8Up;                   //FIR only, 1 for an integer decimation
+    uint8_t u8Channels;
+    uint8_t u8Phase;                //Upsampled steps from the input coming to the next output
+    uint8_t u8Offset;               //Of the last output, after the input that completed it
+
+    /* FIR: every input is written twice (u16Index and u16Index + u16Taps), so the newest u16Taps samples are always contiguous */
+    uint16_t u16Taps;               //Per branch
+    uint16_t u16Index;
+    int16_t ai16Coefficients[DECIMATOR_MAX_COEFFICIENTS];  //Q15, u8Up branches of u16Taps, each sums to 1.0
+    int16_t aai16History[DECIMATOR_MAX_CHANNELS][2 * DECIMATOR_MAX_TAPS];
+
+    /* CIC: wraps modulo 2^32 on purpose, the combs take the wrap back out */
+    uint32_t aau32Integrator[DECIMATOR_MAX_CHANNELS][DECIMATOR_CIC_ORDER];
+    uint32_t aau32Comb[DECIMATOR_MAX_CHANNELS][DECIMATOR_CIC_ORDER];
+    uint32_t u32Scale;              //2^32 / factor^order
+}decimator_t;
+
+int32_t decimator_init(decimator_t *_psDecimator, decimator_type_t _eType, uint8_t _u8Factor, uint8_t _u8Channels);
+int32_t decimator_initRational(decimator_t *_psDecimator, decimator_type_t _eType, uint8_t _u8Up, uint8_t _u8Factor, uint8_t _u8Channels);
+int32_t decimator_prime(decimator_t *_psDecimator, const decimator_t *_psPrevious, const int16_t *_pi16Input);
+bool decimator_process(decimator_t *_psDecimator, const int16_t *_pi16Input, int16_t *_pi16Output);
+
+#endif /* _DECIMATOR_H_ */
@@ -0,0 +1,408 @@
+#include <string.h>
+#include "fec.h"
+#include "quell.h"
+
+/*
+    Reed-Solomon over GF(2^8) (polynomial 0x11D, first consecutive root alpha^0), shortened to the
+    block size, with FEC_PARITY_SIZE parity bytes. Multiplications go through the log/antilog tables
+    built by fec_init. Codeword byte 0 is the highest degree coefficient.
+*/
+
+#define FEC_GF_POLYNOMIAL (0x11D)
+
+static uint8_t au8GFExp[512];
+static uint8_t au8GFLog[256];
+static uint8_t au8Generator[FEC_PARITY_SIZE + 1];
+static bool bFECInitialized = false;
+
+/* SECDED(16,11): bit 0 is the overall parity, bits 1, 2, 4 and 8 the Hamming parity, the rest the data */
+static const uint8_t au8SECDEDDataPosition[11] = {3, 5, 6, 7, 9, 10, 11, 12, 13, 14, 15};
+
+static inline uint8_t fec_gfMultiply(uint8_t _u8A, uint8_t _u8B)
+{
+    if(_u8A == 0 || _u8B == 0)
+    {
+        return 0;
+    }
+    return au8GFExp[au8GFLog[_u8A] + au8GFLog[_u8B]];
+}
+
+static inline uint8_t fec_gfDivide(uint8_t _u8A, uint8_t _u8B)
+{
+    if(_u8A == 0 || _u8B == 0)
+    {
+        return 0;
+    }
+    return au8GFExp[au8GFLog[_u8A] + 255 - au8GFLog[_u8B]];
+}
+
+/* Evaluates a polynomial stored lowest degree first */
+static uint8_t fec_polyEvaluate(const uint8_t *_pu8Poly, uint16_t _u16Length, uint8_t _u8X)
+{
+    uint8_t u8Result = 0;
+
+    for(int32_t i32Index = _u16Length - 1; i32Index >= 0; i32Index--)
+    {
+        u8Result = fec_gfMultiply(u8Result, _u8X) ^ _pu8Poly[i32Index];
+    }
+
+    return u8Result;
+}
+
+void fec_init(void)
+{
+    uint16_t u16Value = 1;
+
+    if(bFECInitialized == true)
+    {
+        return;
+    }
+
+    /* Antilog table doubled, so products never need a modulo 255 */
+    for(uint16_t u16Index = 0; u16Index < 255; u16Index++)
+    {
+        au8GFExp[u16Index] = (uint8_t)u16Value;
+        au8GFLog[u16Value] = (uint8_t)u16Index;
+        u16Value <<= 1;
+        if(u16Value & 0x100)
+        {
+            u16Value ^= FEC_GF_POLYNOMIAL;
+        }
+    }
+    for(uint16_t u16Index = 255; u16Index < sizeof(au8GFExp); u16Index++)
+    {
+        au8GFExp[u16Index] = au8GFExp[u16Index - 255];
+    }
+
+    /* Generator (x - a^0)(x - a^1)...(x - a^(n-1)), highest degree first */
+    memset(au8Generator, 0, sizeof(au8Generator));
+    au8Generator[0] = 1;
+    for(uint16_t u16Root = 0; u16Root < FEC_PARITY_SIZE; u16Root++)
+    {
+        for(int32_t i32Index = u16Root + 1; i32Index > 0; i32Index--)
+        {
+            au8Generator[i32Index] ^= fec_gfMultiply(au8Generator[i32Index - 1], au8GFExp[u16Root]);
+        }
+    }
+
+    bFECInitialized = true;
+}
+
+uint16_t fec_encodeSECDED(uint16_t _u16Value)
+{
+    uint16_t u16Code = 0;
+    uint8_t u8Syndrome = 0;
+
+    for(uint8_t u8Bit = 0; u8Bit < sizeof(au8SECDEDDataPosition); u8Bit++)
+    {
+        if(_u16Value & (1U << u8Bit))
+        {
+            u16Code |= 1U << au8SECDEDDataPosition[u8Bit];
+            u8Syndrome ^= au8SECDEDDataPosition[u8Bit];
+        }
+    }
+
+    /* The Hamming parity bits sit at the powers of two, so the syndrome bits are exactly them */
+    u16Code |= ((uint16_t)(u8Syndrome & 0x01) << 1) | ((uint16_t)(u8Syndrome & 0x02) << 1) | ((uint16_t)(u8Syndrome & 0x04) << 2) | ((uint16_t)(u8Syndrome & 0x08) << 5);
+
+    /* Overall parity */
+    if(__builtin_parity(u16Code))
+    {
+        u16Code |= 0x0001;
+    }
+
+    return u16Code;
+}
+
+int32_t fec_decodeSECDED(uint16_t _u16Code, uint16_t *_pu16Value, bool *_pbCorrected)
+{
+    uint8_t u8Syndrome = 0;
+    uint16_t u16Value = 0;
+
+    if(_pu16Value == NULL || _pbCorrected == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint8_t u8Position = 1; u8Position < 16; u8Position++)
+    {
+        if(_u16Code & (1U << u8Position))
+        {
+            u8Syndrome ^= u8Position;
+        }
+    }
+
+    *_pbCorrected = false;
+    if(__builtin_parity(_u16Code))
+    {
+        /* Single error, the syndrome points at it (0 is the overall parity bit itself) */
+        _u16Code ^= 1U << u8Syndrome;
+        *_pbCorrected = true;
+    }
+    else if(u8Syndrome != 0)
+    {
+        /* Double error, detected only */
+        return QUELL_ERROR;
+    }
+
+    for(uint8_t u8Bit = 0; u8Bit < sizeof(au8SECDEDDataPosition); u8Bit++)
+    {
+        if(_u16Code & (1U << au8SECDEDDataPosition[u8Bit]))
+        {
+            u16Value |= 1U << u8Bit;
+        }
+    }
+
+    *_pu16Value = u16Value;
+    return QUELL_OK;
+}
+
+void fec_encodeRS(const uint8_t *_pu8Data, uint16_t _u16Size, uint8_t *_pu8Parity)
+{
+    uint8_t u8Feedback;
+
+    memset(_pu8Parity, 0, FEC_PARITY_SIZE);
+
+    /* Division by the generator as a shift register, the remainder is the parity */
+    for(uint16_t u16Index = 0; u16Index < _u16Size; u16Index++)
+    {
+        u8Feedback = _pu8Data[u16Index] ^ _pu8Parity[0];
+        for(uint16_t u16Parity = 0; u16Parity < FEC_PARITY_SIZE - 1; u16Parity++)
+        {
+            _pu8Parity[u16Parity] = _pu8Parity[u16Parity + 1] ^ fec_gfMultiply(u8Feedback, au8Generator[u16Parity + 1]);
+        }
+        _pu8Parity[FEC_PARITY_SIZE - 1] = fec_gfMultiply(u8Feedback, au8Generator[FEC_PARITY_SIZE]);
+    }
+}
+
+/* Corrects a block (data followed by its parity, _u16Size bytes in total) in place */
+int32_t fec_decodeRS(uint8_t *_pu8Block, uint16_t _u16Size, uint16_t *_pu16Corrected)
+{
+    uint8_t au8Syndrome[FEC_PARITY_SIZE];
+    uint8_t au8Locator[FEC_PARITY_SIZE + 1];
+    uint8_t au8Previous[FEC_PARITY_SIZE + 1];
+    uint8_t au8Temporary[FEC_PARITY_SIZE + 1];
+    uint8_t au8Evaluator[FEC_PARITY_SIZE];
+    uint8_t au8Derivative[FEC_PARITY_SIZE];
+    uint16_t au16Position[FEC_PARITY_SIZE / 2];
+    uint8_t u8PreviousDiscrepancy = 1;
+    uint16_t u16Errors = 0;
+    uint16_t u16Shift = 1;
+    uint16_t u16Found = 0;
+    bool bClean = true;
+
+    if(_pu8Block == NULL || _pu16Corrected == NULL || _u16Size <= FEC_PARITY_SIZE || _u16Size > 255)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16Corrected = 0;
+
+    /* Syndromes: the received polynomial at every root of the generator */
+    for(uint16_t u16Root = 0; u16Root < FEC_PARITY_SIZE; u16Root++)
+    {
+        uint8_t u8Value = 0;
+        for(uint16_t u16Index = 0; u16Index < _u16Size; u16Index++)
+        {
+            u8Value = fec_gfMultiply(u8Value, au8GFExp[u16Root]) ^ _pu8Block[u16Index];
+        }
+        au8Syndrome[u16Root] = u8Value;
+        bClean = bClean && (u8Value == 0);
+    }
+
+    if(bClean == true)
+    {
+        return QUELL_OK;
+    }
+
+    /* Berlekamp-Massey for the error locator (lowest degree first) */
+    memset(au8Locator, 0, sizeof(au8Locator));
+    memset(au8Previous, 0, sizeof(au8Previous));
+    au8Locator[0] = au8Previous[0] = 1;
+    for(uint16_t u16Step = 0; u16Step < FEC_PARITY_SIZE; u16Step++)
+    {
+        uint8_t u8Discrepancy = au8Syndrome[u16Step];
+        for(uint16_t u16Index = 1; u16Index <= u16Errors; u16Index++)
+        {
+            u8Discrepancy ^= fec_gfMultiply(au8Locator[u16Index], au8Syndrome[u16Step - u16Index]);
+        }
+
+        if(u8Discrepancy == 0)
+        {
+            u16Shift++;
+            continue;
+        }
+
+        memcpy(au8Temporary, au8Locator, sizeof(au8Locator));
+        uint8_t u8Scale = fec_gfDivide(u8Discrepancy, u8PreviousDiscrepancy);
+        for(uint16_t u16Index = 0; u16Index + u16Shift <= FEC_PARITY_SIZE; u16Index++)
+        {
+            au8Locator[u16Index + u16Shift] ^= fec_gfMultiply(u8Scale, au8Previous[u16Index]);
+        }
+
+        if(2 * u16Errors <= u16Step)
+        {
+            u16Errors = u16Step + 1 - u16Errors;
+            memcpy(au8Previous, au8Temporary, sizeof(au8Previous));
+            u8PreviousDiscrepancy = u8Discrepancy;
+            u16Shift = 1;
+        }
+        else
+        {
+            u16Shift++;
+        }
+    }
+
+    if(u16Errors > FEC_PARITY_SIZE / 2)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Chien search: byte i is wrong when the locator is zero at a^-(size - 1 - i) */
+    for(uint16_t u16Index = 0; u16Index < _u16Size; u16Index++)
+    {
+        uint8_t u8InverseLocation = au8GFExp[255 - (_u16Size - 1 - u16Index)];
+        if(fec_polyEvaluate(au8Locator, u16Errors + 1, u8InverseLocation) == 0)
+        {
+            if(u16Found >= u16Errors)
+            {
+                return QUELL_ERROR;
+            }
+            au16Position[u16Found++] = u16Index;
+        }
+    }
+
+    /* Every root has to be inside the block, otherwise there were more errors than can be fixed */
+    if(u16Found != u16Errors)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Forney: evaluator = syndrome * locator mod x^parity, magnitude = X * evaluator(X^-1) / locator'(X^-1) */
+    memset(au8Evaluator, 0, sizeof(au8Evaluator));
+    for(uint16_t u16Index = 0; u16Index < FEC_PARITY_SIZE; u16Index++)
+    {
+        for(uint16_t u16Term = 0; u16Term <= u16Index && u16Term <= u16Errors; u16Term++)
+        {
+            au8Evaluator[u16Index] ^= fec_gfMultiply(au8Syndrome[u16Index - u16Term], au8Locator[u16Term]);
+        }
+    }
+    memset(au8Derivative, 0, sizeof(au8Derivative));
+    for(uint16_t u16Index = 1; u16Index <= u16Errors; u16Index += 2)
+    {
+        au8Derivative[u16Index - 1] = au8Locator[u16Index];
+    }
+
+    for(uint16_t u16Index = 0; u16Index < u16Found; u16Index++)
+    {
+        uint16_t u16Power = _u16Size - 1 - au16Position[u16Index];
+        uint8_t u8Location = au8GFExp[u16Power];
+        uint8_t u8InverseLocation = au8GFExp[255 - u16Power];
+        uint8_t u8Denominator = fec_polyEvaluate(au8Derivative, u16Errors, u8InverseLocation);
+
+        if(u8Denominator == 0)
+        {
+            return QUELL_ERROR;
+        }
+
+        _pu8Block[au16Position[u16Index]] ^= fec_gfMultiply(u8Location, fec_gfDivide(fec_polyEvaluate(au8Evaluator, FEC_PARITY_SIZE, u8InverseLocation), u8Denominator));
+    }
+
+    *_pu16Corrected = u16Found;
+    return QUELL_OK;
+}
+
+/* Biggest packet whose FEC frame fits in _u16EncodedSize bytes */
+uint16_t fec_getMaxPacketSize(uint16_t _u16EncodedSize)
+{
+    uint16_t u16Payload;
+    uint16_t u16Remainder;
+    uint16_t u16PacketSize;
+
+    if(_u16EncodedSize <= FEC_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    u16Payload = _u16EncodedSize - FEC_HEADER_SIZE;
+    u16Remainder = u16Payload % (FEC_BLOCK_SIZE + FEC_PARITY_SIZE);
+    u16PacketSize = (u16Payload / (FEC_BLOCK_SIZE + FEC_PARITY_SIZE)) * FEC_BLOCK_SIZE;
+    if(u16Remainder > FEC_PARITY_SIZE)
+    {
+        u16PacketSize += u16Remainder - FEC_PARITY_SIZE;
+    }
+
+    return (u16PacketSize > FEC_MAX_PACKET_SIZE) ? FEC_MAX_PACKET_SIZE : u16PacketSize;
+}
+
+int32_t fec_encodeFrame(const uint8_t *_pu8Packet, uint16_t _u16PacketSize, uint8_t *_pu8Frame, uint16_t _u16FrameBufferSize, uint16_t *_pu16FrameSize)
+{
+    uint16_t u16SizeCode;
+    uint16_t u16Offset = FEC_HEADER_SIZE;
+
+    if(_pu8Packet == NULL || _pu8Frame == NULL || _pu16FrameSize == NULL || _u16PacketSize == 0 ||
+       _u16PacketSize > FEC_MAX_PACKET_SIZE || FEC_ENCODED_SIZE(_u16PacketSize) > _u16FrameBufferSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16SizeCode = fec_encodeSECDED(_u16PacketSize);
+    _pu8Frame[0] = FEC_SOF;
+    _pu8Frame[1] = (u16SizeCode >> 8) & 0xFF;
+    _pu8Frame[2] = u16SizeCode & 0xFF;
+
+    for(uint16_t u16Block = 0; u16Block < _u16PacketSize; u16Block += FEC_BLOCK_SIZE)
+    {
+        uint16_t u16BlockSize = (_u16PacketSize - u16Block < FEC_BLOCK_SIZE) ? _u16PacketSize - u16Block : FEC_BLOCK_SIZE;
+
+        memcpy(&_pu8Frame[u16Offset], &_pu8Packet[u16Block], u16BlockSize);
+        fec_encodeRS(&_pu8Packet[u16Block], u16BlockSize, &_pu8Frame[u16Offset + u16BlockSize]);
+        u16Offset += u16BlockSize + FEC_PARITY_SIZE;
+    }
+
+    *_pu16FrameSize = u16Offset;
+    return QUELL_OK;
+}
+
+/* Repairs the frame in place and leaves the packet at the start of _pu8Frame */
+int32_t fec_decodeFrame(uint8_t *_pu8Frame, uint16_t _u16FrameSize, uint16_t *_pu16PacketSize, uint16_t *_pu16Corrected)
+{
+    uint16_t u16PacketSize;
+    uint16_t u16Corrected;
+    uint16_t u16Offset = FEC_HEADER_SIZE;
+    uint16_t u16PacketOffset = 0;
+    bool bSizeCorrected;
+
+    if(_pu8Frame == NULL || _pu16PacketSize == NULL || _pu16Corrected == NULL || _u16FrameSize <= FEC_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pu16Corrected = 0;
+
+    if(fec_decodeSECDED(((uint16_t)_pu8Frame[1] << 8) | (uint16_t)_pu8Frame[2], &u16PacketSize, &bSizeCorrected) == QUELL_ERROR ||
+       u16PacketSize == 0 || FEC_ENCODED_SIZE(u16PacketSize) != _u16FrameSize)
+    {
+        return QUELL_ERROR;
+    }
+    *_pu16Corrected += (bSizeCorrected == true) ? 1 : 0;
+
+    while(u16PacketOffset < u16PacketSize)
+    {
+        uint16_t u16BlockSize = (u16PacketSize - u16PacketOffset < FEC_BLOCK_SIZE) ? u16PacketSize - u16PacketOffset : FEC_BLOCK_SIZE;
+
+        if(fec_decodeRS(&_pu8Frame[u16Offset], u16BlockSize + FEC_PARITY_SIZE, &u16Corrected) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        *_pu16Corrected += u16Corrected;
+
+        /* Drop the header and parity, packing the packet to the start of the buffer */
+        memmove(&_pu8Frame[u16PacketOffset], &_pu8Frame[u16Offset], u16BlockSize);
+        u16Offset += u16BlockSize + FEC_PARITY_SIZE;
+        u16PacketOffset += u16BlockSize;
+    }
+
+    *_pu16PacketSize = u16PacketSize;
+    return QUELL_OK;
+}
@@ -0,0 +1,41 @@
+#ifndef _FEC_H_
+#define _FEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+    FEC FRAME DESCRIPTION (Big Endian)
+
+    FRAME ITEM:             LENGTH:             DESCRIPTION:                    CONST VALUE:
+    SYN                     u8                  Start of FEC frame              0x16
+    Packet Size             u16                 SECDED(16,11) of the size       NO
+    Block                   Variable            Up to 32 bytes of the packet    NO
+    Parity                  u8[4]               Reed-Solomon of the block       NO
+    (Block and Parity repeat until the whole packet is covered)
+
+    The packet inside is a regular packet (SOH ... CRC16), so after the repair it still goes through
+    verifyPacket. Each block corrects up to 2 wrong bytes, the size corrects 1 bit and detects 2.
+*/
+
+#define FEC_SOF (0x16)
+#define FEC_HEADER_SIZE (3)
+#define FEC_BLOCK_SIZE (32)
+#define FEC_PARITY_SIZE (4)
+#define FEC_MAX_PACKET_SIZE (2047) //11 bits of the SECDED size
+#define FEC_ENCODED_SIZE(packet_length) (FEC_HEADER_SIZE + (packet_length) + ((((packet_length) + FEC_BLOCK_SIZE - 1) / FEC_BLOCK_SIZE) * FEC_PARITY_SIZE))
+
+void fec_init(void);
+
+uint16_t fec_encodeSECDED(uint16_t _u16Value);
+int32_t fec_decodeSECDED(uint16_t _u16Code, uint16_t *_pu16Value, bool *_pbCorrected);
+
+void fec_encodeRS(const uint8_t *_pu8Data, uint16_t _u16Size, uint8_t *_pu8Parity);
+int32_t fec_decodeRS(uint8_t *_pu8Block, uint16_t _u16Size, uint16_t *_pu16Corrected);
+
+uint16_t fec_getMaxPacketSize(uint16_t _u16EncodedSize);
+int32_t fec_encodeFrame(const uint8_t *_pu8Packet, uint16_t _u16PacketSize, uint8_t *_pu8Frame, uint16_t _u16FrameBufferSize, uint16_t *_pu16FrameSize);
+int32_t fec_decodeFrame(uint8_t *_pu8Frame, uint16_t _u16FrameSize, uint16_t *_pu16PacketSize, uint16_t *_pu16Corrected);
+
+#endif /* _FEC_H_ */
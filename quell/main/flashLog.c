@@ -0,0 +1,432 @@
+#include "esp_log.h"
+#include "flashLog.h"
+#include "crc.h"
+#include "quell.h"
+
+/* Of the header up to the CRC and of the records, the erased rest of the page is not in it */
+static uint16_t flashLogCRC(const uint8_t *_pu8Page, uint16_t _u16Length)
+{
+    uint16_t u16CRC = 0;
+
+    for(uint16_t u16Index = 0; u16Index < MESSAGE_LOG_PAGE_OFFSET_CRC; u16Index++)
+    {
+        u16CRC = updateCRC16CCITT(u16CRC, (char)_pu8Page[u16Index]);
+    }
+    for(uint16_t u16Index = 0; u16Index < _u16Length; u16Index++)
+    {
+        u16CRC = updateCRC16CCITT(u16CRC, (char)_pu8Page[MESSAGE_LOG_PAGE_SIZE + u16Index]);
+    }
+
+    return u16CRC;
+}
+
+static flash_log_page_state_t flashLogCheckPage(const uint8_t *_pu8Page, message_log_page_t *_psHeader)
+{
+    uint16_t u16Index;
+
+    for(u16Index = 0; u16Index < FLASH_LOG_PAGE_SIZE && _pu8Page[u16Index] == 0xFF; u16Index++);
+    if(u16Index == FLASH_LOG_PAGE_SIZE)
+    {
+        return FLASH_LOG_PAGE_ERASED;
+    }
+
+    if(messages_decodeLogPage(_psHeader, _pu8Page, MESSAGE_LOG_PAGE_SIZE) == QUELL_ERROR || _psHeader->u16Length > FLASH_LOG_PAGE_DATA ||
+       flashLogCRC(_pu8Page, _psHeader->u16Length) != _psHeader->u16Crc)
+    {
+        return FLASH_LOG_PAGE_TORN;
+    }
+
+    return FLASH_LOG_PAGE_VALID;
+}
+
+static int32_t flashLogRead(const flash_log_t *_psLog, uint32_t _u32Slot, uint8_t *_pu8Page)
+{
+    return _psLog->psDevice->fpRead(_psLog->psDevice->pvContext, _u32Slot * FLASH_LOG_PAGE_SIZE, _pu8Page, FLASH_LOG_PAGE_SIZE);
+}
+
+/* Erases a sector for the writer, its wear is one more than any page of it says (as the sector written when none is left, a lap behind) */
+static int32_t flashLogErase(flash_log_t *_psLog, uint32_t _u32Sector, uint32_t *_pu32Wear)
+{
+    message_log_page_t sHeader;
+    uint32_t u32Wear = (_psLog->u32Wear > 0) ? _psLog->u32Wear - 1 : 0;
+    uint32_t u32Start;
+    uint32_t u32Elapsed;
+
+    for(uint32_t u32Page = 0; u32Page < FLASH_LOG_SECTOR_PAGES; u32Page++)
+    {
+        if(flashLogRead(_psLog, (_u32Sector * FLASH_LOG_SECTOR_PAGES) + u32Page, _psLog->au8Scratch) == QUELL_OK &&
+           flashLogCheckPage(_psLog->au8Scratch, &sHeader) == FLASH_LOG_PAGE_VALID)
+        {
+            u32Wear = sHeader.u32Wear;
+            break;
+        }
+    }
+
+    u32Start = _psLog->fpNowUs();
+    if(_psLog->psDevice->fpErase(_psLog->psDevice->pvContext, _u32Sector * FLASH_LOG_SECTOR_SIZE, FLASH_LOG_SECTOR_SIZE) == QUELL_ERROR)
+    {
+        _psLog->u32Errors++;
+        return QUELL_ERROR;
+    }
+    u32Elapsed = _psLog->fpNowUs() - u32Start;
+    _psLog->u32MaxEraseUs = (u32Elapsed > _psLog->u32MaxEraseUs) ? u32Elapsed : _psLog->u32MaxEraseUs;
+    _psLog->u32Erases++;
+
+    *_pu32Wear = u32Wear + 1;
+    _psLog->u32MaxWear = (*_pu32Wear > _psLog->u32MaxWear) ? *_pu32Wear : _psLog->u32MaxWear;
+
+    return QUELL_OK;
+}
+
+/* Appending task: hands the page being filled over to the writer */
+static void flashLogClose(flash_log_t *_psLog, bool _bEarly)
+{
+    _psLog->u32Flushes += (_bEarly == true) ? 1 : 0;
+    _psLog->u8In++;
+}
+
+/* Writer: a closed page into the next page of the ring */
+static void flashLogWritePage(flash_log_t *_psLog, flash_log_buffer_t *_psBuffer)
+{
+    message_log_page_t sHeader = {.u32Sequence = _psLog->u32Sequence, .u32Wear = _psLog->u32Wear, .u16Length = _psBuffer->u16Used};
+    uint16_t u16Size;
+    uint32_t u32Start;
+    uint32_t u32Elapsed;
+
+    messages_encodeLogPage(&sHeader, _psBuffer->au8Page, MESSAGE_LOG_PAGE_SIZE, &u16Size);
+    sHeader.u16Crc = flashLogCRC(_psBuffer->au8Page, _psBuffer->u16Used);
+    messages_encodeLogPage(&sHeader, _psBuffer->au8Page, MESSAGE_LOG_PAGE_SIZE, &u16Size);
+    memset(&_psBuffer->au8Page[MESSAGE_LOG_PAGE_SIZE + _psBuffer->u16Used], 0xFF, FLASH_LOG_PAGE_DATA - _psBuffer->u16Used);
+
+    u32Start = _psLog->fpNowUs();
+    if(_psLog->psDevice->fpWrite(_psLog->psDevice->pvContext, _psLog->u32Slot * FLASH_LOG_PAGE_SIZE, _psBuffer->au8Page, FLASH_LOG_PAGE_SIZE) == QUELL_ERROR)
+    {
+        _psLog->u32Errors++;
+    }
+    else
+    {
+        u32Elapsed = _psLog->fpNowUs() - u32Start;
+        _psLog->u32MaxWriteUs = (u32Elapsed > _psLog->u32MaxWriteUs) ? u32Elapsed : _psLog->u32MaxWriteUs;
+        _psLog->u32PagesWritten++;
+    }
+
+    /* A page that failed may be half programmed, it is not written again either */
+    _psLog->u32Sequence++;
+    _psLog->u32Slot = (_psLog->u32Slot + 1) % _psLog->u32Pages;
+    if((_psLog->u32Slot % FLASH_LOG_SECTOR_PAGES) == 0)
+    {
+        _psLog->bSectorReady = _psLog->bNextReady;
+        _psLog->u32Wear = _psLog->u32NextWear;
+        _psLog->bNextReady = false;
+    }
+}
+
+
+
+int32_t flashLog_mount(flash_log_t *_psLog, const flash_log_device_t *_psDevice, flash_log_clock_t _fpNowUs)
+{
+    message_log_page_t sHeader;
+    uint32_t u32Sectors;
+    uint32_t u32Head = 0;
+    uint32_t u32Newest = 0;
+    uint32_t u32Next;
+    bool bFound = false;
+
+    if(_psLog == NULL || _psDevice == NULL || _fpNowUs == NULL || _psDevice->fpRead == NULL || _psDevice->fpWrite == NULL ||
+       _psDevice->fpErase == NULL || (_psDevice->u32Size % FLASH_LOG_SECTOR_SIZE) != 0 ||
+       _psDevice->u32Size < FLASH_LOG_MIN_SECTORS * FLASH_LOG_SECTOR_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psLog, 0, sizeof(flash_log_t));
+    _psLog->psDevice = _psDevice;
+    _psLog->fpNowUs = _fpNowUs;
+    _psLog->u32Pages = _psDevice->u32Size / FLASH_LOG_PAGE_SIZE;
+    _psLog->u32MinWear = UINT32_MAX;
+    u32Sectors = _psLog->u32Pages / FLASH_LOG_SECTOR_PAGES;
+
+    /* The newest valid page, wherever the writer was when the power went */
+    for(uint32_t u32Slot = 0; u32Slot < _psLog->u32Pages; u32Slot++)
+    {
+        if(flashLogRead(_psLog, u32Slot, _psLog->au8Scratch) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        switch(flashLogCheckPage(_psLog->au8Scratch, &sHeader))
+        {
+            case FLASH_LOG_PAGE_VALID:
+                _psLog->u32ValidPages++;
+                _psLog->u32MinWear = (sHeader.u32Wear < _psLog->u32MinWear) ? sHeader.u32Wear : _psLog->u32MinWear;
+                _psLog->u32MaxWear = (sHeader.u32Wear > _psLog->u32MaxWear) ? sHeader.u32Wear : _psLog->u32MaxWear;
+                if(bFound == false || sHeader.u32Sequence > u32Newest)
+                {
+                    bFound = true;
+                    u32Newest = sHeader.u32Sequence;
+                    u32Head = u32Slot;
+                    _psLog->u32Wear = sHeader.u32Wear;
+                }
+                break;
+            case FLASH_LOG_PAGE_TORN:
+                _psLog->u32TornPages++;
+                break;
+            default:
+                break;
+        }
+    }
+    _psLog->u32MinWear = (bFound == true) ? _psLog->u32MinWear : 0;
+
+    if(bFound == false)
+    {
+        _psLog->u32Slot = 0;
+        _psLog->u32Sequence = 0;
+        _psLog->bEnabled = true;
+        return QUELL_OK;
+    }
+
+    /* The next erased page of the sector of the newest (the one after it may be cut short), otherwise a new sector */
+    _psLog->u32Sequence = u32Newest + 1;
+    _psLog->u32Slot = (((u32Head / FLASH_LOG_SECTOR_PAGES) + 1) % u32Sectors) * FLASH_LOG_SECTOR_PAGES;
+    for(uint32_t u32Slot = u32Head + 1; (u32Slot % FLASH_LOG_SECTOR_PAGES) != 0; u32Slot++)
+    {
+        if(flashLogRead(_psLog, u32Slot, _psLog->au8Scratch) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        if(flashLogCheckPage(_psLog->au8Scratch, &sHeader) == FLASH_LOG_PAGE_ERASED)
+        {
+            _psLog->u32Slot = u32Slot;
+            _psLog->bSectorReady = true;
+            break;
+        }
+    }
+
+    /* Erased ahead before the restart: not again, its wear went with its pages */
+    _psLog->bNextReady = (_psLog->bSectorReady == true);
+    _psLog->u32NextWear = _psLog->u32Wear;
+    u32Next = (((_psLog->u32Slot / FLASH_LOG_SECTOR_PAGES) + 1) % u32Sectors) * FLASH_LOG_SECTOR_PAGES;
+    for(uint32_t u32Page = 0; u32Page < FLASH_LOG_SECTOR_PAGES && _psLog->bNextReady == true; u32Page++)
+    {
+        if(flashLogRead(_psLog, u32Next + u32Page, _psLog->au8Scratch) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psLog->bNextReady = (flashLogCheckPage(_psLog->au8Scratch, &sHeader) == FLASH_LOG_PAGE_ERASED);
+    }
+
+    _psLog->bEnabled = true;
+    return QUELL_OK;
+}
+
+void flashLog_enable(flash_log_t *_psLog, bool _bEnable)
+{
+    if(_psLog != NULL)
+    {
+        _psLog->bEnabled = _bEnable;
+    }
+}
+
+/* Appending task */
+int32_t flashLog_append(flash_log_t *_psLog, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    flash_log_buffer_t *psBuffer;
+
+    if(_psLog == NULL || _psLog->psDevice == NULL || _pu8Message == NULL || _u16Size == 0 || _u16Size > FLASH_LOG_MAX_RECORD)
+    {
+        return QUELL_ERROR;
+    }
+    if(_psLog->bEnabled == false)
+    {
+        return QUELL_OK;
+    }
+
+    psBuffer = &_psLog->asBuffers[_psLog->u8In % FLASH_LOG_BUFFERS];
+    if((uint8_t)(_psLog->u8In - _psLog->u8Out) < FLASH_LOG_BUFFERS && psBuffer->u16Used + 1 + _u16Size > FLASH_LOG_PAGE_DATA)
+    {
+        flashLogClose(_psLog, false);
+        psBuffer = &_psLog->asBuffers[_psLog->u8In % FLASH_LOG_BUFFERS];
+    }
+
+    /* Every page is with the writer (it is erasing) */
+    if((uint8_t)(_psLog->u8In - _psLog->u8Out) >= FLASH_LOG_BUFFERS)
+    {
+        _psLog->u32Dropped++;
+        return QUELL_ERROR;
+    }
+
+    if(psBuffer->u16Used == 0)
+    {
+        psBuffer->u32OpenedUs = _psLog->fpNowUs();
+    }
+    psBuffer->au8Page[MESSAGE_LOG_PAGE_SIZE + psBuffer->u16Used] = (uint8_t)_u16Size;
+    memcpy(&psBuffer->au8Page[MESSAGE_LOG_PAGE_SIZE + psBuffer->u16Used + 1], _pu8Message, _u16Size);
+    psBuffer->u16Used += 1 + _u16Size;
+    _psLog->u32Records++;
+    _psLog->u32RecordBytes += _u16Size;
+
+    return QUELL_OK;
+}
+
+/* Appending task, often: true when the page being filled went to the writer, its first record waited FLASH_LOG_FLUSH_US */
+bool flashLog_tick(flash_log_t *_psLog)
+{
+    flash_log_buffer_t *psBuffer;
+
+    if(_psLog == NULL || _psLog->psDevice == NULL || (uint8_t)(_psLog->u8In - _psLog->u8Out) >= FLASH_LOG_BUFFERS)
+    {
+        return false;
+    }
+
+    psBuffer = &_psLog->asBuffers[_psLog->u8In % FLASH_LOG_BUFFERS];
+    if(psBuffer->u16Used == 0 || _psLog->fpNowUs() - psBuffer->u32OpenedUs < FLASH_LOG_FLUSH_US)
+    {
+        return false;
+    }
+    flashLogClose(_psLog, true);
+
+    return true;
+}
+
+/* Appending task: true when the page being filled went to the writer, whatever its age */
+bool flashLog_flush(flash_log_t *_psLog)
+{
+    if(_psLog == NULL || _psLog->psDevice == NULL || (uint8_t)(_psLog->u8In - _psLog->u8Out) >= FLASH_LOG_BUFFERS ||
+       _psLog->asBuffers[_psLog->u8In % FLASH_LOG_BUFFERS].u16Used == 0)
+    {
+        return false;
+    }
+    flashLogClose(_psLog, true);
+
+    return true;
+}
+
+/* Writer: the pages handed over, then the next sector erased ahead. Blocks as long as the flash takes */
+int32_t flashLog_run(flash_log_t *_psLog)
+{
+    uint32_t u32Sectors;
+    uint32_t u32Sector;
+
+    if(_psLog == NULL || _psLog->psDevice == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    u32Sectors = _psLog->u32Pages / FLASH_LOG_SECTOR_PAGES;
+
+    while(_psLog->u8Out != _psLog->u8In)
+    {
+        flash_log_buffer_t *psBuffer = &_psLog->asBuffers[_psLog->u8Out % FLASH_LOG_BUFFERS];
+
+        if(_psLog->bSectorReady == false)
+        {
+            if(flashLogErase(_psLog, _psLog->u32Slot / FLASH_LOG_SECTOR_PAGES, &_psLog->u32Wear) == QUELL_ERROR)
+            {
+                return QUELL_ERROR;
+            }
+            _psLog->bSectorReady = true;
+        }
+
+        flashLogWritePage(_psLog, psBuffer);
+        psBuffer->u16Used = 0;
+        _psLog->u8Out++;
+    }
+
+    /* So a full page never waits for an erase */
+    u32Sector = ((_psLog->u32Slot / FLASH_LOG_SECTOR_PAGES) + 1) % u32Sectors;
+    if(_psLog->bSectorReady == true && _psLog->bNextReady == false)
+    {
+        if(flashLogErase(_psLog, u32Sector, &_psLog->u32NextWear) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psLog->bNextReady = true;
+    }
+
+    return QUELL_OK;
+}
+
+/* Any task: the records of the last _u32Pages pages before the writer, oldest first (flashLog_next) */
+int32_t flashLog_seek(const flash_log_t *_psLog, flash_log_cursor_t *_psCursor, uint32_t _u32Pages)
+{
+    if(_psLog == NULL || _psLog->psDevice == NULL || _psCursor == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psCursor->u32Left = (_u32Pages > _psLog->u32Pages) ? _psLog->u32Pages : _u32Pages;
+    _psCursor->u32Newest = _psLog->u32Sequence;
+    _psCursor->u32Slot = (_psLog->u32Slot + _psLog->u32Pages - _psCursor->u32Left) % _psLog->u32Pages;
+    _psCursor->bStarted = false;
+    _psCursor->u32Sequence = 0;
+    _psCursor->u16Offset = 0;
+    _psCursor->u16End = 0;
+    _psCursor->u32Skipped = 0;
+
+    return QUELL_OK;
+}
+
+/* The next record, in place in the cursor (valid until the next call), QUELL_ERROR after the last one */
+int32_t flashLog_next(const flash_log_t *_psLog, flash_log_cursor_t *_psCursor, const uint8_t **_ppu8Message, uint16_t *_pu16Size)
+{
+    message_log_page_t sHeader;
+    flash_log_page_state_t eState;
+
+    if(_psLog == NULL || _psLog->psDevice == NULL || _psCursor == NULL || _ppu8Message == NULL || _pu16Size == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(;;)
+    {
+        if(_psCursor->u16Offset < _psCursor->u16End)
+        {
+            uint16_t u16Size = _psCursor->au8Page[_psCursor->u16Offset];
+
+            /* Only a page that passed its CRC gets here, so only a bug would not add up */
+            if(u16Size == 0 || _psCursor->u16Offset + 1 + u16Size > _psCursor->u16End)
+            {
+                _psCursor->u16Offset = _psCursor->u16End;
+                continue;
+            }
+            *_ppu8Message = &_psCursor->au8Page[_psCursor->u16Offset + 1];
+            *_pu16Size = u16Size;
+            _psCursor->u16Offset += 1 + u16Size;
+            return QUELL_OK;
+        }
+
+        if(_psCursor->u32Left == 0)
+        {
+            return QUELL_ERROR;
+        }
+        _psCursor->u32Left--;
+        if(flashLogRead(_psLog, _psCursor->u32Slot, _psCursor->au8Page) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psCursor->u32Slot = (_psCursor->u32Slot + 1) % _psLog->u32Pages;
+
+        /* Erased ahead, cut short, or written over since the seek (the writer went round) */
+        eState = flashLogCheckPage(_psCursor->au8Page, &sHeader);
+        if(eState != FLASH_LOG_PAGE_VALID || sHeader.u32Sequence >= _psCursor->u32Newest ||
+           (_psCursor->bStarted == true && sHeader.u32Sequence <= _psCursor->u32Sequence))
+        {
+            _psCursor->u32Skipped += (eState != FLASH_LOG_PAGE_ERASED) ? 1 : 0;
+            continue;
+        }
+        _psCursor->bStarted = true;
+        _psCursor->u32Sequence = sHeader.u32Sequence;
+        _psCursor->u16Offset = MESSAGE_LOG_PAGE_SIZE;
+        _psCursor->u16End = MESSAGE_LOG_PAGE_SIZE + sHeader.u16Length;
+    }
+}
+
+void flashLog_print(const flash_log_t *_psLog, const char *_pcTAG)
+{
+    uint32_t u32Amplification = (_psLog->u32RecordBytes > 0) ? (uint32_t)(((uint64_t)_psLog->u32PagesWritten * FLASH_LOG_PAGE_SIZE * 100) / _psLog->u32RecordBytes) : 0;
+
+    ESP_LOGI(_pcTAG, "flashlog %s %u pages, next page:%u sequence:%u (found %u pages, %u torn) wear:%u..%u erases",
+             (_psLog->bEnabled == true) ? "on" : "off", _psLog->u32Pages, _psLog->u32Slot, _psLog->u32Sequence,
+             _psLog->u32ValidPages, _psLog->u32TornPages, _psLog->u32MinWear, _psLog->u32MaxWear);
+    ESP_LOGI(_pcTAG, "flashlog records:%u bytes:%u dropped:%u pages:%u (flushed early:%u) erases:%u errors:%u write amplification:%u.%02u max write:%uus erase:%uus",
+             _psLog->u32Records, _psLog->u32RecordBytes, _psLog->u32Dropped, _psLog->u32PagesWritten, _psLog->u32Flushes,
+             _psLog->u32Erases, _psLog->u32Errors, u32Amplification / 100, u32Amplification % 100, _psLog->u32MaxWriteUs, _psLog->u32MaxEraseUs);
+}
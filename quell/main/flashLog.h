@@ -0,0 +1,148 @@
+#ifndef _FLASH_LOG_H_
+#define _FLASH_LOG_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    FLASH LOG (ring of records on a flash partition)
+
+    Records are binary messages (messages.h), appended one after the other into a page buffer in RAM. A
+    page goes to the flash in one write of FLASH_LOG_PAGE_SIZE bytes when the next record does not fit
+    anymore, or FLASH_LOG_FLUSH_US after its first record (the most a power loss costs). The partition is
+    a ring of sectors written in order, the writer erases the sector after the one it writes into ahead of
+    time, so the oldest sector of records goes first and every sector is erased once per lap: the wear is
+    spread evenly over the partition by construction. The erase count of a sector is in every page of it.
+
+    PAGE (Big Endian, programmed once between two erases of its sector):
+    ITEM:                   LENGTH:             DESCRIPTION:                            CONST VALUE:
+    Header                  u8[12]              log_page message: sequence, wear,       NO
+                                                length of the records, CRC16
+    Records                 Variable            Size u8 then the message, repeated      NO
+    Erased                  Variable            Up to the end of the page               0xFF
+
+    Flash bits only go from 1 to 0 between erases, so a page cut short by a power loss (or a sector whose
+    erase was) fails its CRC and is skipped, and it is never written again before its sector is erased.
+    flashLog_mount reads the whole partition once: the valid page with the highest sequence is the newest,
+    the writer goes on at the next erased page of its sector (or the next sector) with the next sequence.
+    Nothing else is kept anywhere, there is no table to update and so nothing to lose in a power cut.
+
+    The records of a page are appended by one task (flashLog_append, flashLog_tick) while another one
+    writes and erases (flashLog_run, it blocks for as long as the flash does): FLASH_LOG_BUFFERS pages are
+    handed over through asBuffers, a record finding none free is dropped and counted. Reading
+    (flashLog_seek, flashLog_next) goes to the flash, from any task.
+
+    On the ESP32 a write or an erase stops the flash cache of both cores, for up to a few hundred ms for a
+    sector erase: no task runs and only the interrupts in IRAM are served. The uart drivers are installed
+    with ESP_INTR_FLAG_IRAM (CONFIG_UART_ISR_IN_IRAM, logTask.c does not build without it), so their ISR
+    keeps moving the 128 byte hardware FIFO into the driver Rx buffer. That buffer (UART_BUF_SIZE x 2) is
+    larger than the FIFO Rx the peer gets credit for, so it holds all a peer may send meanwhile, at any
+    link speed, and the link loses nothing to the flash log; it only waits.
+*/
+
+#define FLASH_LOG_PAGE_SIZE (256UL)             //Program unit of the flash
+#define FLASH_LOG_SECTOR_SIZE (4096UL)          //Erase unit
+#define FLASH_LOG_SECTOR_PAGES (FLASH_LOG_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE)
+#define FLASH_LOG_MIN_SECTORS (3)               //The one written, the one erased ahead and some records
+#define FLASH_LOG_PAGE_DATA (FLASH_LOG_PAGE_SIZE - MESSAGE_LOG_PAGE_SIZE)
+#define FLASH_LOG_MAX_RECORD (FLASH_LOG_PAGE_DATA - 1)      //Message bytes
+#define FLASH_LOG_BUFFERS (4)                   //Pages between the two tasks, a power of two
+#ifndef FLASH_LOG_FLUSH_US
+#define FLASH_LOG_FLUSH_US (1000000UL)
+#endif
+
+_Static_assert(MESSAGE_LOG_WINDOW_MAX_SIZE <= FLASH_LOG_MAX_RECORD, "a log window does not fit a flash log page");
+
+typedef uint32_t (*flash_log_clock_t)(void);    //Microseconds, wrapping
+
+/* Offsets from the start of the partition, QUELL_OK or QUELL_ERROR */
+typedef struct
+{
+    int32_t (*fpRead)(void *_pvContext, uint32_t _u32Offset, void *_pvData, uint32_t _u32Size);
+    int32_t (*fpWrite)(void *_pvContext, uint32_t _u32Offset, const void *_pvData, uint32_t _u32Size);
+    int32_t (*fpErase)(void *_pvContext, uint32_t _u32Offset, uint32_t _u32Size);     //Whole sectors
+    void *pvContext;
+    uint32_t u32Size;               //Bytes, whole sectors
+}flash_log_device_t;
+
+typedef enum
+{
+    FLASH_LOG_PAGE_VALID = 0,
+    FLASH_LOG_PAGE_ERASED,
+    FLASH_LOG_PAGE_TORN             //Neither: cut short, or garbage
+}flash_log_page_state_t;
+
+typedef struct
+{
+    uint8_t au8Page[FLASH_LOG_PAGE_SIZE];   //Header room, then the records
+    uint16_t u16Used;               //Record bytes, set back to 0 by the writer
+    uint32_t u32OpenedUs;           //First record in
+}flash_log_buffer_t;
+
+typedef struct
+{
+    const flash_log_device_t *psDevice;
+    flash_log_clock_t fpNowUs;
+    uint32_t u32Pages;              //Of the partition
+    volatile bool bEnabled;         //Terminal: off, records are neither appended nor counted as dropped
+
+    /* Appending task fills asBuffers[u8In % FLASH_LOG_BUFFERS], the writer empties them up to u8In */
+    flash_log_buffer_t asBuffers[FLASH_LOG_BUFFERS];
+    volatile uint8_t u8In;
+    volatile uint8_t u8Out;
+
+    /* Writer */
+    volatile uint32_t u32Slot;      //Next page to write, read by the readers
+    volatile uint32_t u32Sequence;  //Of that page
+    bool bSectorReady;              //The sector of u32Slot is erased, with u32Wear erases
+    uint32_t u32Wear;
+    bool bNextReady;                //The sector after it as well
+    uint32_t u32NextWear;
+    uint8_t au8Scratch[FLASH_LOG_PAGE_SIZE];
+
+    /* Found by flashLog_mount */
+    uint32_t u32ValidPages;
+    uint32_t u32TornPages;
+    uint32_t u32MinWear;
+    uint32_t u32MaxWear;            //Kept up to date by the writer
+
+    /* Statistics */
+    uint32_t u32Records;
+    uint32_t u32RecordBytes;        //Message bytes of the records appended
+    uint32_t u32Dropped;            //Records no page buffer was free for
+    uint32_t u32Flushes;            //Pages written before they were full
+    uint32_t u32PagesWritten;
+    uint32_t u32Erases;
+    uint32_t u32Errors;             //The device failed a read, write or erase
+    uint32_t u32MaxWriteUs;
+    uint32_t u32MaxEraseUs;
+}flash_log_t;
+
+/* Reads the pages before the writer at the time of flashLog_seek, oldest first */
+typedef struct
+{
+    uint32_t u32Slot;               //Next page to read
+    uint32_t u32Left;               //Pages
+    uint32_t u32Newest;             //Sequence of the first page written after the seek
+    bool bStarted;
+    uint32_t u32Sequence;           //Of the page being read
+    uint16_t u16Offset;             //Next record in au8Page
+    uint16_t u16End;
+    uint32_t u32Skipped;            //Pages torn or out of order
+    uint8_t au8Page[FLASH_LOG_PAGE_SIZE];
+}flash_log_cursor_t;
+
+int32_t flashLog_mount(flash_log_t *_psLog, const flash_log_device_t *_psDevice, flash_log_clock_t _fpNowUs);
+void flashLog_enable(flash_log_t *_psLog, bool _bEnable);
+int32_t flashLog_append(flash_log_t *_psLog, const uint8_t *_pu8Message, uint16_t _u16Size);
+bool flashLog_tick(flash_log_t *_psLog);
+bool flashLog_flush(flash_log_t *_psLog);
+int32_t flashLog_run(flash_log_t *_psLog);
+int32_t flashLog_seek(const flash_log_t *_psLog, flash_log_cursor_t *_psCursor, uint32_t _u32Pages);
+int32_t flashLog_next(const flash_log_t *_psLog, flash_log_cursor_t *_psCursor, const uint8_t **_ppu8Message, uint16_t *_pu16Size);
+void flashLog_print(const flash_log_t *_psLog, const char *_pcTAG);
+
+#endif /* _FLASH_LOG_H_ */
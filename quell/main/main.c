@@ -1,6 +1,8 @@
 #include "esp_log.h"
 #include "protocolTask.h"
 #include "terminalTask.h"
+#include "imuTask.h"
+#include "logTask.h"
 
 static const char *TAG = "main";
 
@@ -13,6 +15,12 @@ void createTasks(void)
 
     /* Create Protocol task */
     protocolTaskInit();
+
+    /* Create flash log task (mounts the log before the imu task appends to it) */
+    logTaskInit();
+
+    /* Create IMU task (subscribes to the sample bus of the protocol task) */
+    imuTaskInit();
 }
 
 void app_main(void)
@@ -0,0 +1,528 @@
+/* Generated by tools/msggen/msggen.py from messages.schema, do not edit */
+#include <string.h>
+#include "messages.h"
+#include "quell.h"
+
+static inline void messages_putU16(uint8_t *_pu8Buffer, uint16_t _u16Value)
+{
+    _pu8Buffer[0] = (_u16Value >> 8) & 0xFF;
+    _pu8Buffer[1] = _u16Value & 0xFF;
+}
+
+static inline uint16_t messages_getU16(const uint8_t *_pu8Buffer)
+{
+    return ((uint16_t)_pu8Buffer[0] << 8) | (uint16_t)_pu8Buffer[1];
+}
+
+static inline void messages_putU32(uint8_t *_pu8Buffer, uint32_t _u32Value)
+{
+    _pu8Buffer[0] = (_u32Value >> 24) & 0xFF;
+    _pu8Buffer[1] = (_u32Value >> 16) & 0xFF;
+    _pu8Buffer[2] = (_u32Value >> 8) & 0xFF;
+    _pu8Buffer[3] = _u32Value & 0xFF;
+}
+
+static inline uint32_t messages_getU32(const uint8_t *_pu8Buffer)
+{
+    return ((uint32_t)_pu8Buffer[0] << 24) | ((uint32_t)_pu8Buffer[1] << 16) | ((uint32_t)_pu8Buffer[2] << 8) | (uint32_t)_pu8Buffer[3];
+}
+
+int32_t messages_encodeCredit(const message_credit_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_CREDIT_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_CREDIT_ID;
+    _pu8Buffer[MESSAGE_CREDIT_OFFSET_FLAGS] = _psMessage->u8Flags;
+    messages_putU32(&_pu8Buffer[MESSAGE_CREDIT_OFFSET_CONSUMED], _psMessage->u32Consumed);
+    messages_putU16(&_pu8Buffer[MESSAGE_CREDIT_OFFSET_WINDOW], _psMessage->u16Window);
+
+    *_pu16Size = MESSAGE_CREDIT_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeCredit(message_credit_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_CREDIT_SIZE ||
+       _pu8Message[0] != MESSAGE_CREDIT_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u8Flags = _pu8Message[MESSAGE_CREDIT_OFFSET_FLAGS];
+    _psMessage->u32Consumed = messages_getU32(&_pu8Message[MESSAGE_CREDIT_OFFSET_CONSUMED]);
+    _psMessage->u16Window = messages_getU16(&_pu8Message[MESSAGE_CREDIT_OFFSET_WINDOW]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeTdma(const message_tdma_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16OwnersCount > MESSAGE_TDMA_OWNERS_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_TDMA_SIZE + _psMessage->u16OwnersCount;
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_TDMA_ID;
+    messages_putU16(&_pu8Buffer[MESSAGE_TDMA_OFFSET_CYCLE], _psMessage->u16Cycle);
+    messages_putU16(&_pu8Buffer[MESSAGE_TDMA_OFFSET_SLOT], _psMessage->u16Slot);
+    messages_putU16(&_pu8Buffer[MESSAGE_TDMA_OFFSET_GUARD], _psMessage->u16Guard);
+    memcpy(&_pu8Buffer[MESSAGE_TDMA_OFFSET_OWNERS], _psMessage->au8Owners, _psMessage->u16OwnersCount);
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeTdma(message_tdma_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_TDMA_SIZE || _u16Size > MESSAGE_TDMA_MAX_SIZE ||
+       _pu8Message[0] != MESSAGE_TDMA_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16OwnersCount = (_u16Size - MESSAGE_TDMA_SIZE) / 1;
+    _psMessage->u16Cycle = messages_getU16(&_pu8Message[MESSAGE_TDMA_OFFSET_CYCLE]);
+    _psMessage->u16Slot = messages_getU16(&_pu8Message[MESSAGE_TDMA_OFFSET_SLOT]);
+    _psMessage->u16Guard = messages_getU16(&_pu8Message[MESSAGE_TDMA_OFFSET_GUARD]);
+    memcpy(_psMessage->au8Owners, &_pu8Message[MESSAGE_TDMA_OFFSET_OWNERS], _psMessage->u16OwnersCount);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeBench(const message_bench_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16PayloadCount > MESSAGE_BENCH_PAYLOAD_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_BENCH_SIZE + _psMessage->u16PayloadCount;
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_BENCH_ID;
+    _pu8Buffer[MESSAGE_BENCH_OFFSET_KIND] = _psMessage->u8Kind;
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_OFFSET_SEQUENCE], _psMessage->u32Sequence);
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_OFFSET_TIMESTAMP], _psMessage->u32Timestamp);
+    memcpy(&_pu8Buffer[MESSAGE_BENCH_OFFSET_PAYLOAD], _psMessage->au8Payload, _psMessage->u16PayloadCount);
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeBench(message_bench_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_BENCH_SIZE || _u16Size > MESSAGE_BENCH_MAX_SIZE ||
+       _pu8Message[0] != MESSAGE_BENCH_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16PayloadCount = (_u16Size - MESSAGE_BENCH_SIZE) / 1;
+    _psMessage->u8Kind = _pu8Message[MESSAGE_BENCH_OFFSET_KIND];
+    _psMessage->u32Sequence = messages_getU32(&_pu8Message[MESSAGE_BENCH_OFFSET_SEQUENCE]);
+    _psMessage->u32Timestamp = messages_getU32(&_pu8Message[MESSAGE_BENCH_OFFSET_TIMESTAMP]);
+    memcpy(_psMessage->au8Payload, &_pu8Message[MESSAGE_BENCH_OFFSET_PAYLOAD], _psMessage->u16PayloadCount);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeBenchReport(const message_bench_report_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_BENCH_REPORT_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_BENCH_REPORT_ID;
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_REPORT_OFFSET_RECEIVED], _psMessage->u32Received);
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_REPORT_OFFSET_LOST], _psMessage->u32Lost);
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_REPORT_OFFSET_ERRORS], _psMessage->u32Errors);
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_REPORT_OFFSET_BYTES], _psMessage->u32Bytes);
+    messages_putU32(&_pu8Buffer[MESSAGE_BENCH_REPORT_OFFSET_ELAPSED], _psMessage->u32Elapsed);
+
+    *_pu16Size = MESSAGE_BENCH_REPORT_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeBenchReport(message_bench_report_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_BENCH_REPORT_SIZE ||
+       _pu8Message[0] != MESSAGE_BENCH_REPORT_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u32Received = messages_getU32(&_pu8Message[MESSAGE_BENCH_REPORT_OFFSET_RECEIVED]);
+    _psMessage->u32Lost = messages_getU32(&_pu8Message[MESSAGE_BENCH_REPORT_OFFSET_LOST]);
+    _psMessage->u32Errors = messages_getU32(&_pu8Message[MESSAGE_BENCH_REPORT_OFFSET_ERRORS]);
+    _psMessage->u32Bytes = messages_getU32(&_pu8Message[MESSAGE_BENCH_REPORT_OFFSET_BYTES]);
+    _psMessage->u32Elapsed = messages_getU32(&_pu8Message[MESSAGE_BENCH_REPORT_OFFSET_ELAPSED]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeSpeed(const message_speed_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16PayloadCount > MESSAGE_SPEED_PAYLOAD_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_SPEED_SIZE + _psMessage->u16PayloadCount;
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_SPEED_ID;
+    _pu8Buffer[MESSAGE_SPEED_OFFSET_KIND] = _psMessage->u8Kind;
+    _pu8Buffer[MESSAGE_SPEED_OFFSET_FLAGS] = _psMessage->u8Flags;
+    messages_putU32(&_pu8Buffer[MESSAGE_SPEED_OFFSET_BAUD], _psMessage->u32Baud);
+    messages_putU16(&_pu8Buffer[MESSAGE_SPEED_OFFSET_ID], _psMessage->u16Id);
+    messages_putU16(&_pu8Buffer[MESSAGE_SPEED_OFFSET_COUNT], _psMessage->u16Count);
+    memcpy(&_pu8Buffer[MESSAGE_SPEED_OFFSET_PAYLOAD], _psMessage->au8Payload, _psMessage->u16PayloadCount);
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeSpeed(message_speed_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_SPEED_SIZE || _u16Size > MESSAGE_SPEED_MAX_SIZE ||
+       _pu8Message[0] != MESSAGE_SPEED_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16PayloadCount = (_u16Size - MESSAGE_SPEED_SIZE) / 1;
+    _psMessage->u8Kind = _pu8Message[MESSAGE_SPEED_OFFSET_KIND];
+    _psMessage->u8Flags = _pu8Message[MESSAGE_SPEED_OFFSET_FLAGS];
+    _psMessage->u32Baud = messages_getU32(&_pu8Message[MESSAGE_SPEED_OFFSET_BAUD]);
+    _psMessage->u16Id = messages_getU16(&_pu8Message[MESSAGE_SPEED_OFFSET_ID]);
+    _psMessage->u16Count = messages_getU16(&_pu8Message[MESSAGE_SPEED_OFFSET_COUNT]);
+    memcpy(_psMessage->au8Payload, &_pu8Message[MESSAGE_SPEED_OFFSET_PAYLOAD], _psMessage->u16PayloadCount);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeQuench(const message_quench_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_QUENCH_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_QUENCH_ID;
+    messages_putU32(&_pu8Buffer[MESSAGE_QUENCH_OFFSET_DROPPED], _psMessage->u32Dropped);
+
+    *_pu16Size = MESSAGE_QUENCH_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeQuench(message_quench_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_QUENCH_SIZE ||
+       _pu8Message[0] != MESSAGE_QUENCH_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u32Dropped = messages_getU32(&_pu8Message[MESSAGE_QUENCH_OFFSET_DROPPED]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeChannel(const message_channel_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16DataCount > MESSAGE_CHANNEL_DATA_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_CHANNEL_SIZE + _psMessage->u16DataCount;
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_CHANNEL_ID;
+    _pu8Buffer[MESSAGE_CHANNEL_OFFSET_CHANNEL] = _psMessage->u8Channel;
+    _pu8Buffer[MESSAGE_CHANNEL_OFFSET_SEQUENCE] = _psMessage->u8Sequence;
+    memcpy(&_pu8Buffer[MESSAGE_CHANNEL_OFFSET_DATA], _psMessage->au8Data, _psMessage->u16DataCount);
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeChannel(message_channel_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_CHANNEL_SIZE || _u16Size > MESSAGE_CHANNEL_MAX_SIZE ||
+       _pu8Message[0] != MESSAGE_CHANNEL_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16DataCount = (_u16Size - MESSAGE_CHANNEL_SIZE) / 1;
+    _psMessage->u8Channel = _pu8Message[MESSAGE_CHANNEL_OFFSET_CHANNEL];
+    _psMessage->u8Sequence = _pu8Message[MESSAGE_CHANNEL_OFFSET_SEQUENCE];
+    memcpy(_psMessage->au8Data, &_pu8Message[MESSAGE_CHANNEL_OFFSET_DATA], _psMessage->u16DataCount);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeStreamHeader(const message_stream_header_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_STREAM_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[MESSAGE_STREAM_HEADER_OFFSET_TYPE] = _psMessage->u8Type;
+    messages_putU16(&_pu8Buffer[MESSAGE_STREAM_HEADER_OFFSET_SEQUENCE], _psMessage->u16Sequence);
+    messages_putU32(&_pu8Buffer[MESSAGE_STREAM_HEADER_OFFSET_TIMESTAMP], _psMessage->u32Timestamp);
+
+    *_pu16Size = MESSAGE_STREAM_HEADER_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeStreamHeader(message_stream_header_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_STREAM_HEADER_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u8Type = _pu8Message[MESSAGE_STREAM_HEADER_OFFSET_TYPE];
+    _psMessage->u16Sequence = messages_getU16(&_pu8Message[MESSAGE_STREAM_HEADER_OFFSET_SEQUENCE]);
+    _psMessage->u32Timestamp = messages_getU32(&_pu8Message[MESSAGE_STREAM_HEADER_OFFSET_TIMESTAMP]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeStreamStats(const message_stream_stats_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_STREAM_STATS_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    messages_putU32(&_pu8Buffer[MESSAGE_STREAM_STATS_OFFSET_SENT], _psMessage->u32Sent);
+    messages_putU32(&_pu8Buffer[MESSAGE_STREAM_STATS_OFFSET_LOST], _psMessage->u32Lost);
+    messages_putU32(&_pu8Buffer[MESSAGE_STREAM_STATS_OFFSET_BUS_DROPPED], _psMessage->u32BusDropped);
+    messages_putU32(&_pu8Buffer[MESSAGE_STREAM_STATS_OFFSET_LOGS_MUTED], _psMessage->u32LogsMuted);
+
+    *_pu16Size = MESSAGE_STREAM_STATS_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeStreamStats(message_stream_stats_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_STREAM_STATS_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u32Sent = messages_getU32(&_pu8Message[MESSAGE_STREAM_STATS_OFFSET_SENT]);
+    _psMessage->u32Lost = messages_getU32(&_pu8Message[MESSAGE_STREAM_STATS_OFFSET_LOST]);
+    _psMessage->u32BusDropped = messages_getU32(&_pu8Message[MESSAGE_STREAM_STATS_OFFSET_BUS_DROPPED]);
+    _psMessage->u32LogsMuted = messages_getU32(&_pu8Message[MESSAGE_STREAM_STATS_OFFSET_LOGS_MUTED]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeImu(const message_imu_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16SamplesCount > MESSAGE_IMU_SAMPLES_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_IMU_SIZE + (_psMessage->u16SamplesCount * 2);
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_IMU_ID;
+    _pu8Buffer[MESSAGE_IMU_OFFSET_UNIT] = _psMessage->u8Unit;
+    messages_putU32(&_pu8Buffer[MESSAGE_IMU_OFFSET_TIMESTAMP], _psMessage->u32Timestamp);
+    messages_putU16(&_pu8Buffer[MESSAGE_IMU_OFFSET_PERIOD], _psMessage->u16Period);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16SamplesCount; u16Index++)
+    {
+        messages_putU16(&_pu8Buffer[MESSAGE_IMU_OFFSET_SAMPLES + (u16Index * 2)], (uint16_t)_psMessage->ai16Samples[u16Index]);
+    }
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeImu(message_imu_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_IMU_SIZE || _u16Size > MESSAGE_IMU_MAX_SIZE || ((_u16Size - MESSAGE_IMU_SIZE) % 2) != 0 ||
+       _pu8Message[0] != MESSAGE_IMU_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16SamplesCount = (_u16Size - MESSAGE_IMU_SIZE) / 2;
+    _psMessage->u8Unit = _pu8Message[MESSAGE_IMU_OFFSET_UNIT];
+    _psMessage->u32Timestamp = messages_getU32(&_pu8Message[MESSAGE_IMU_OFFSET_TIMESTAMP]);
+    _psMessage->u16Period = messages_getU16(&_pu8Message[MESSAGE_IMU_OFFSET_PERIOD]);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16SamplesCount; u16Index++)
+    {
+        _psMessage->ai16Samples[u16Index] = (int16_t)messages_getU16(&_pu8Message[MESSAGE_IMU_OFFSET_SAMPLES + (u16Index * 2)]);
+    }
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeLogPage(const message_log_page_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < MESSAGE_LOG_PAGE_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    messages_putU32(&_pu8Buffer[MESSAGE_LOG_PAGE_OFFSET_SEQUENCE], _psMessage->u32Sequence);
+    messages_putU32(&_pu8Buffer[MESSAGE_LOG_PAGE_OFFSET_WEAR], _psMessage->u32Wear);
+    messages_putU16(&_pu8Buffer[MESSAGE_LOG_PAGE_OFFSET_LENGTH], _psMessage->u16Length);
+    messages_putU16(&_pu8Buffer[MESSAGE_LOG_PAGE_OFFSET_CRC], _psMessage->u16Crc);
+
+    *_pu16Size = MESSAGE_LOG_PAGE_SIZE;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeLogPage(message_log_page_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size != MESSAGE_LOG_PAGE_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u32Sequence = messages_getU32(&_pu8Message[MESSAGE_LOG_PAGE_OFFSET_SEQUENCE]);
+    _psMessage->u32Wear = messages_getU32(&_pu8Message[MESSAGE_LOG_PAGE_OFFSET_WEAR]);
+    _psMessage->u16Length = messages_getU16(&_pu8Message[MESSAGE_LOG_PAGE_OFFSET_LENGTH]);
+    _psMessage->u16Crc = messages_getU16(&_pu8Message[MESSAGE_LOG_PAGE_OFFSET_CRC]);
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeLogWindow(const message_log_window_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16SamplesCount > MESSAGE_LOG_WINDOW_SAMPLES_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_LOG_WINDOW_SIZE + (_psMessage->u16SamplesCount * 2);
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_LOG_WINDOW_ID;
+    _pu8Buffer[MESSAGE_LOG_WINDOW_OFFSET_UNIT] = _psMessage->u8Unit;
+    messages_putU32(&_pu8Buffer[MESSAGE_LOG_WINDOW_OFFSET_TIMESTAMP], _psMessage->u32Timestamp);
+    messages_putU16(&_pu8Buffer[MESSAGE_LOG_WINDOW_OFFSET_PERIOD], _psMessage->u16Period);
+    messages_putU16(&_pu8Buffer[MESSAGE_LOG_WINDOW_OFFSET_FILLED], _psMessage->u16Filled);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16SamplesCount; u16Index++)
+    {
+        messages_putU16(&_pu8Buffer[MESSAGE_LOG_WINDOW_OFFSET_SAMPLES + (u16Index * 2)], (uint16_t)_psMessage->ai16Samples[u16Index]);
+    }
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeLogWindow(message_log_window_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_LOG_WINDOW_SIZE || _u16Size > MESSAGE_LOG_WINDOW_MAX_SIZE || ((_u16Size - MESSAGE_LOG_WINDOW_SIZE) % 2) != 0 ||
+       _pu8Message[0] != MESSAGE_LOG_WINDOW_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16SamplesCount = (_u16Size - MESSAGE_LOG_WINDOW_SIZE) / 2;
+    _psMessage->u8Unit = _pu8Message[MESSAGE_LOG_WINDOW_OFFSET_UNIT];
+    _psMessage->u32Timestamp = messages_getU32(&_pu8Message[MESSAGE_LOG_WINDOW_OFFSET_TIMESTAMP]);
+    _psMessage->u16Period = messages_getU16(&_pu8Message[MESSAGE_LOG_WINDOW_OFFSET_PERIOD]);
+    _psMessage->u16Filled = messages_getU16(&_pu8Message[MESSAGE_LOG_WINDOW_OFFSET_FILLED]);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16SamplesCount; u16Index++)
+    {
+        _psMessage->ai16Samples[u16Index] = (int16_t)messages_getU16(&_pu8Message[MESSAGE_LOG_WINDOW_OFFSET_SAMPLES + (u16Index * 2)]);
+    }
+
+    return QUELL_OK;
+}
+
+int32_t messages_encodeLogResult(const message_log_result_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)
+{
+    uint16_t u16Size;
+
+    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->u16ValuesCount > MESSAGE_LOG_RESULT_VALUES_MAX_COUNT)
+    {
+        return QUELL_ERROR;
+    }
+
+    u16Size = MESSAGE_LOG_RESULT_SIZE + (_psMessage->u16ValuesCount * 2);
+    if(_u16BufferSize < u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    _pu8Buffer[0] = MESSAGE_LOG_RESULT_ID;
+    _pu8Buffer[MESSAGE_LOG_RESULT_OFFSET_UNIT] = _psMessage->u8Unit;
+    _pu8Buffer[MESSAGE_LOG_RESULT_OFFSET_KIND] = _psMessage->u8Kind;
+    messages_putU32(&_pu8Buffer[MESSAGE_LOG_RESULT_OFFSET_TIMESTAMP], _psMessage->u32Timestamp);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16ValuesCount; u16Index++)
+    {
+        messages_putU16(&_pu8Buffer[MESSAGE_LOG_RESULT_OFFSET_VALUES + (u16Index * 2)], (uint16_t)_psMessage->ai16Values[u16Index]);
+    }
+
+    *_pu16Size = u16Size;
+    return QUELL_OK;
+}
+
+int32_t messages_decodeLogResult(message_log_result_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    if(_psMessage == NULL || _pu8Message == NULL || _u16Size < MESSAGE_LOG_RESULT_SIZE || _u16Size > MESSAGE_LOG_RESULT_MAX_SIZE || ((_u16Size - MESSAGE_LOG_RESULT_SIZE) % 2) != 0 ||
+       _pu8Message[0] != MESSAGE_LOG_RESULT_ID)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psMessage->u16ValuesCount = (_u16Size - MESSAGE_LOG_RESULT_SIZE) / 2;
+    _psMessage->u8Unit = _pu8Message[MESSAGE_LOG_RESULT_OFFSET_UNIT];
+    _psMessage->u8Kind = _pu8Message[MESSAGE_LOG_RESULT_OFFSET_KIND];
+    _psMessage->u32Timestamp = messages_getU32(&_pu8Message[MESSAGE_LOG_RESULT_OFFSET_TIMESTAMP]);
+    for(uint16_t u16Index = 0; u16Index < _psMessage->u16ValuesCount; u16Index++)
+    {
+        _psMessage->ai16Values[u16Index] = (int16_t)messages_getU16(&_pu8Message[MESSAGE_LOG_RESULT_OFFSET_VALUES + (u16Index * 2)]);
+    }
+
+    return QUELL_OK;
+}
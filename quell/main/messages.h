@@ -0,0 +1,450 @@
+/* Generated by tools/msggen/msggen.py from messages.schema, do not edit */
+#ifndef _MESSAGES_H_
+#define _MESSAGES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MESSAGES_MAX_SIZE (244UL)
+
+/*
+    Flow control credit, 0x11 is ASCII DC1 (XON), never the first byte of a text message
+
+    CREDIT MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x11
+    Flags                   u8                  1
+    Consumed                u32                 2           Bytes received by the peer (credit packets excluded)
+    Window                  u16                 6           Free space after consumed
+*/
+#define MESSAGE_CREDIT_ID (0x11)
+#define MESSAGE_CREDIT_FLAG_RESET (0x01) //Sender of the credit just started, counters restart from zero
+#define MESSAGE_CREDIT_SIZE (8UL)
+#define MESSAGE_CREDIT_MAX_SIZE (8UL)
+#define MESSAGE_CREDIT_OFFSET_FLAGS (1)
+#define MESSAGE_CREDIT_OFFSET_CONSUMED (2)
+#define MESSAGE_CREDIT_OFFSET_WINDOW (6)
+
+typedef struct
+{
+    uint8_t u8Flags;
+    uint32_t u32Consumed; //Bytes received by the peer (credit packets excluded)
+    uint16_t u16Window;   //Free space after consumed
+}message_credit_t;
+
+_Static_assert(MESSAGE_CREDIT_MAX_SIZE <= MESSAGES_MAX_SIZE, "credit message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Multi-drop bus beacon, broadcast by the master at the start of every cycle (0x12 is ASCII DC2)
+
+    TDMA MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x12
+    Cycle                   u16                 1           Cycle counter, a gap is a beacon lost
+    Slot                    u16                 3           Microseconds per slot
+    Guard                   u16                 5           Microseconds at the end of every slot nobody transmits in
+    Owners                  u8[0..8]            7           Address owning each slot, slot 0 (the beacon) is always the master's
+*/
+#define MESSAGE_TDMA_ID (0x12)
+#define MESSAGE_TDMA_MAX_SLOTS (8)
+#define MESSAGE_TDMA_SIZE (7UL) //Without the variable array
+#define MESSAGE_TDMA_MAX_SIZE (15UL)
+#define MESSAGE_TDMA_OFFSET_CYCLE (1)
+#define MESSAGE_TDMA_OFFSET_SLOT (3)
+#define MESSAGE_TDMA_OFFSET_GUARD (5)
+#define MESSAGE_TDMA_OFFSET_OWNERS (7)
+#define MESSAGE_TDMA_OWNERS_MAX_COUNT (8)
+
+typedef struct
+{
+    uint16_t u16Cycle;       //Cycle counter, a gap is a beacon lost
+    uint16_t u16Slot;        //Microseconds per slot
+    uint16_t u16Guard;       //Microseconds at the end of every slot nobody transmits in
+    uint8_t au8Owners[8];    //Address owning each slot, slot 0 (the beacon) is always the master's
+    uint16_t u16OwnersCount; //Items in au8Owners
+}message_tdma_t;
+
+_Static_assert(MESSAGE_TDMA_MAX_SIZE <= MESSAGES_MAX_SIZE, "tdma message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Link bench probe, terminal "bench" and "load" (0x13 is ASCII DC3)
+
+    BENCH MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x13
+    Kind                    u8                  1
+    Sequence                u32                 2
+    Timestamp               u32                 6           Microseconds of the sender (wraps), echoed by the pong
+    Payload                 u8[0..234]          10          Filler up to the size chosen
+*/
+#define MESSAGE_BENCH_ID (0x13)
+#define MESSAGE_BENCH_KIND_PING (0) //Answered with a pong of the same size
+#define MESSAGE_BENCH_KIND_PONG (1)
+#define MESSAGE_BENCH_KIND_LOAD (2) //Counted by the receiver
+#define MESSAGE_BENCH_KIND_LOAD_END (3) //Sequence is the load frames sent, answered with a bench_report
+#define MESSAGE_BENCH_SIZE (10UL) //Without the variable array
+#define MESSAGE_BENCH_MAX_SIZE (244UL)
+#define MESSAGE_BENCH_OFFSET_KIND (1)
+#define MESSAGE_BENCH_OFFSET_SEQUENCE (2)
+#define MESSAGE_BENCH_OFFSET_TIMESTAMP (6)
+#define MESSAGE_BENCH_OFFSET_PAYLOAD (10)
+#define MESSAGE_BENCH_PAYLOAD_MAX_COUNT (234)
+
+typedef struct
+{
+    uint8_t u8Kind;
+    uint32_t u32Sequence;
+    uint32_t u32Timestamp;    //Microseconds of the sender (wraps), echoed by the pong
+    uint8_t au8Payload[234];  //Filler up to the size chosen
+    uint16_t u16PayloadCount; //Items in au8Payload
+}message_bench_t;
+
+_Static_assert(MESSAGE_BENCH_MAX_SIZE <= MESSAGES_MAX_SIZE, "bench message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Receiving side of a load run (0x14 is ASCII DC4)
+
+    BENCH REPORT MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x14
+    Received                u32                 1
+    Lost                    u32                 5           Sequence gaps
+    Errors                  u32                 9           Packets of the link dropped meanwhile (CRC, framing)
+    Bytes                   u32                 13          Of the load messages received
+    Elapsed                 u32                 17          Microseconds from the first to the last load frame
+*/
+#define MESSAGE_BENCH_REPORT_ID (0x14)
+#define MESSAGE_BENCH_REPORT_SIZE (21UL)
+#define MESSAGE_BENCH_REPORT_MAX_SIZE (21UL)
+#define MESSAGE_BENCH_REPORT_OFFSET_RECEIVED (1)
+#define MESSAGE_BENCH_REPORT_OFFSET_LOST (5)
+#define MESSAGE_BENCH_REPORT_OFFSET_ERRORS (9)
+#define MESSAGE_BENCH_REPORT_OFFSET_BYTES (13)
+#define MESSAGE_BENCH_REPORT_OFFSET_ELAPSED (17)
+
+typedef struct
+{
+    uint32_t u32Received;
+    uint32_t u32Lost;     //Sequence gaps
+    uint32_t u32Errors;   //Packets of the link dropped meanwhile (CRC, framing)
+    uint32_t u32Bytes;    //Of the load messages received
+    uint32_t u32Elapsed;  //Microseconds from the first to the last load frame
+}message_bench_report_t;
+
+_Static_assert(MESSAGE_BENCH_REPORT_MAX_SIZE <= MESSAGES_MAX_SIZE, "bench_report message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Link speed negotiation, sent by the io task between frames (0x15 is ASCII NAK)
+
+    SPEED MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x15
+    Kind                    u8                  1
+    Flags                   u8                  2
+    Baud                    u32                 3
+    Id                      u16                 7
+    Count                   u16                 9
+    Payload                 u8[0..53]           11          Probe filler, 64 byte probes
+*/
+#define MESSAGE_SPEED_ID (0x15)
+#define MESSAGE_SPEED_KIND_PROPOSE (0) //Step up to baud, id names the negotiation (the higher one wins when both units propose)
+#define MESSAGE_SPEED_KIND_ACCEPT (1)
+#define MESSAGE_SPEED_KIND_REJECT (2) //Baud above what this unit allows, 0: busy with another link, ask again later
+#define MESSAGE_SPEED_KIND_PROBE (3) //At the new baud, count is the probe number
+#define MESSAGE_SPEED_KIND_REPORT (4) //Count is the probes received
+#define MESSAGE_SPEED_KIND_KEEPALIVE (5) //Above the base rate, so silence means the link broke
+#define MESSAGE_SPEED_KIND_DOWN (6) //Errors rose: both units go to baud
+#define MESSAGE_SPEED_FLAG_HAVE_REPORT (0x01) //Report: the report of the peer arrived
+#define MESSAGE_SPEED_SIZE (11UL) //Without the variable array
+#define MESSAGE_SPEED_MAX_SIZE (64UL)
+#define MESSAGE_SPEED_OFFSET_KIND (1)
+#define MESSAGE_SPEED_OFFSET_FLAGS (2)
+#define MESSAGE_SPEED_OFFSET_BAUD (3)
+#define MESSAGE_SPEED_OFFSET_ID (7)
+#define MESSAGE_SPEED_OFFSET_COUNT (9)
+#define MESSAGE_SPEED_OFFSET_PAYLOAD (11)
+#define MESSAGE_SPEED_PAYLOAD_MAX_COUNT (53)
+
+typedef struct
+{
+    uint8_t u8Kind;
+    uint8_t u8Flags;
+    uint32_t u32Baud;
+    uint16_t u16Id;
+    uint16_t u16Count;
+    uint8_t au8Payload[53];   //Probe filler, 64 byte probes
+    uint16_t u16PayloadCount; //Items in au8Payload
+}message_speed_t;
+
+_Static_assert(MESSAGE_SPEED_MAX_SIZE <= MESSAGES_MAX_SIZE, "speed message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Chain: a router forwarded frames of the destination into a lane backing up, or dropped them (0x16 is ASCII SYN)
+
+    QUENCH MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x16
+    Dropped                 u32                 1           Frames the router dropped so far, of every source
+*/
+#define MESSAGE_QUENCH_ID (0x16)
+#define MESSAGE_QUENCH_SIZE (5UL)
+#define MESSAGE_QUENCH_MAX_SIZE (5UL)
+#define MESSAGE_QUENCH_OFFSET_DROPPED (1)
+
+typedef struct
+{
+    uint32_t u32Dropped; //Frames the router dropped so far, of every source
+}message_quench_t;
+
+_Static_assert(MESSAGE_QUENCH_MAX_SIZE <= MESSAGES_MAX_SIZE, "quench message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Bytes of a tunnel, a logical channel of the link (channel.h; 0x17 is ASCII ETB)
+
+    CHANNEL MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x17
+    Channel                 u8                  1
+    Sequence                u8                  2           Per channel and sender, a gap is a message lost
+    Data                    u8[0..48]           3
+*/
+#define MESSAGE_CHANNEL_ID (0x17)
+#define MESSAGE_CHANNEL_TERMINAL (0) //Command lines to a unit and what they printed back
+#define MESSAGE_CHANNEL_LOG (1) //Log lines of a unit, to the master
+#define MESSAGE_CHANNEL_SIZE (3UL) //Without the variable array
+#define MESSAGE_CHANNEL_MAX_SIZE (51UL)
+#define MESSAGE_CHANNEL_OFFSET_CHANNEL (1)
+#define MESSAGE_CHANNEL_OFFSET_SEQUENCE (2)
+#define MESSAGE_CHANNEL_OFFSET_DATA (3)
+#define MESSAGE_CHANNEL_DATA_MAX_COUNT (48)
+
+typedef struct
+{
+    uint8_t u8Channel;
+    uint8_t u8Sequence;    //Per channel and sender, a gap is a message lost
+    uint8_t au8Data[48];
+    uint16_t u16DataCount; //Items in au8Data
+}message_channel_t;
+
+_Static_assert(MESSAGE_CHANNEL_MAX_SIZE <= MESSAGES_MAX_SIZE, "channel message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Terminal binary stream, in front of every stream message payload
+
+    STREAM HEADER MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    Type                    u8                  0           TERMINAL_STREAM_TYPE_xxx
+    Sequence                u16                 1           Per message, a gap is a message lost
+    Timestamp               u32                 3           Microseconds since boot (wraps)
+*/
+#define MESSAGE_STREAM_HEADER_SIZE (7UL)
+#define MESSAGE_STREAM_HEADER_MAX_SIZE (7UL)
+#define MESSAGE_STREAM_HEADER_OFFSET_TYPE (0)
+#define MESSAGE_STREAM_HEADER_OFFSET_SEQUENCE (1)
+#define MESSAGE_STREAM_HEADER_OFFSET_TIMESTAMP (3)
+
+typedef struct
+{
+    uint8_t u8Type;        //TERMINAL_STREAM_TYPE_xxx
+    uint16_t u16Sequence;  //Per message, a gap is a message lost
+    uint32_t u32Timestamp; //Microseconds since boot (wraps)
+}message_stream_header_t;
+
+_Static_assert(MESSAGE_STREAM_HEADER_MAX_SIZE <= MESSAGES_MAX_SIZE, "stream_header message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Terminal binary stream statistics (stats and end messages)
+
+    STREAM STATS MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    Sent                    u32                 0
+    Lost                    u32                 4
+    Bus Dropped             u32                 8
+    Logs Muted              u32                 12
+*/
+#define MESSAGE_STREAM_STATS_SIZE (16UL)
+#define MESSAGE_STREAM_STATS_MAX_SIZE (16UL)
+#define MESSAGE_STREAM_STATS_OFFSET_SENT (0)
+#define MESSAGE_STREAM_STATS_OFFSET_LOST (4)
+#define MESSAGE_STREAM_STATS_OFFSET_BUS_DROPPED (8)
+#define MESSAGE_STREAM_STATS_OFFSET_LOGS_MUTED (12)
+
+typedef struct
+{
+    uint32_t u32Sent;
+    uint32_t u32Lost;
+    uint32_t u32BusDropped;
+    uint32_t u32LogsMuted;
+}message_stream_stats_t;
+
+_Static_assert(MESSAGE_STREAM_STATS_MAX_SIZE <= MESSAGES_MAX_SIZE, "stream_stats message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    IMU samples of one unit, oldest first (0x20 is a space, never the first byte of a text message)
+
+    IMU MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x20
+    Unit                    u8                  1
+    Timestamp               u32                 2           Microseconds since boot of the first sample (wraps)
+    Period                  u16                 6           Microseconds between samples
+    Samples                 i16[0..24]          8           Up to 4 samples of MESSAGE_IMU_AXES values
+*/
+#define MESSAGE_IMU_ID (0x20)
+#define MESSAGE_IMU_UNITS (3) //0 chest, 1 left hand, 2 right hand
+#define MESSAGE_IMU_AXES (6) //Values per sample: accel x, y, z then gyro x, y, z
+#define MESSAGE_IMU_ACCEL_LSB_PER_G (4096) //+-8 g full scale
+#define MESSAGE_IMU_GYRO_LSB_PER_KDPS (16400) //+-2000 dps full scale (16.4 LSB per dps)
+#define MESSAGE_IMU_SIZE (8UL) //Without the variable array
+#define MESSAGE_IMU_MAX_SIZE (56UL)
+#define MESSAGE_IMU_OFFSET_UNIT (1)
+#define MESSAGE_IMU_OFFSET_TIMESTAMP (2)
+#define MESSAGE_IMU_OFFSET_PERIOD (6)
+#define MESSAGE_IMU_OFFSET_SAMPLES (8)
+#define MESSAGE_IMU_SAMPLES_MAX_COUNT (24)
+
+typedef struct
+{
+    uint8_t u8Unit;
+    uint32_t u32Timestamp;    //Microseconds since boot of the first sample (wraps)
+    uint16_t u16Period;       //Microseconds between samples
+    int16_t ai16Samples[24];  //Up to 4 samples of MESSAGE_IMU_AXES values
+    uint16_t u16SamplesCount; //Items in ai16Samples
+}message_imu_t;
+
+_Static_assert(MESSAGE_IMU_MAX_SIZE <= MESSAGES_MAX_SIZE, "imu message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Flash log page header, the records of the page follow it (flashLog.h)
+
+    LOG PAGE MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    Sequence                u32                 0           Page number since the log was made
+    Wear                    u32                 4           Erases of the sector of the page
+    Length                  u16                 8           Bytes of records after the header
+    Crc                     u16                 10          CRC16-CCITT of the header up to here and the records
+*/
+#define MESSAGE_LOG_PAGE_SIZE (12UL)
+#define MESSAGE_LOG_PAGE_MAX_SIZE (12UL)
+#define MESSAGE_LOG_PAGE_OFFSET_SEQUENCE (0)
+#define MESSAGE_LOG_PAGE_OFFSET_WEAR (4)
+#define MESSAGE_LOG_PAGE_OFFSET_LENGTH (8)
+#define MESSAGE_LOG_PAGE_OFFSET_CRC (10)
+
+typedef struct
+{
+    uint32_t u32Sequence; //Page number since the log was made
+    uint32_t u32Wear;     //Erases of the sector of the page
+    uint16_t u16Length;   //Bytes of records after the header
+    uint16_t u16Crc;      //CRC16-CCITT of the header up to here and the records
+}message_log_page_t;
+
+_Static_assert(MESSAGE_LOG_PAGE_MAX_SIZE <= MESSAGES_MAX_SIZE, "log_page message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Flash log record (never on a link): a reorder window of one unit, longer windows take several
+
+    LOG WINDOW MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x30
+    Unit                    u8                  1
+    Timestamp               u32                 2           Microseconds since boot of the first sample (wraps)
+    Period                  u16                 6           Microseconds between samples
+    Filled                  u16                 8           Bit n: sample n was missing and got filled (reorder.h)
+    Samples                 i16[0..96]          10          Up to 16 samples of MESSAGE_IMU_AXES values
+*/
+#define MESSAGE_LOG_WINDOW_ID (0x30)
+#define MESSAGE_LOG_WINDOW_SIZE (10UL) //Without the variable array
+#define MESSAGE_LOG_WINDOW_MAX_SIZE (202UL)
+#define MESSAGE_LOG_WINDOW_OFFSET_UNIT (1)
+#define MESSAGE_LOG_WINDOW_OFFSET_TIMESTAMP (2)
+#define MESSAGE_LOG_WINDOW_OFFSET_PERIOD (6)
+#define MESSAGE_LOG_WINDOW_OFFSET_FILLED (8)
+#define MESSAGE_LOG_WINDOW_OFFSET_SAMPLES (10)
+#define MESSAGE_LOG_WINDOW_SAMPLES_MAX_COUNT (96)
+
+typedef struct
+{
+    uint8_t u8Unit;
+    uint32_t u32Timestamp;    //Microseconds since boot of the first sample (wraps)
+    uint16_t u16Period;       //Microseconds between samples
+    uint16_t u16Filled;       //Bit n: sample n was missing and got filled (reorder.h)
+    int16_t ai16Samples[96];  //Up to 16 samples of MESSAGE_IMU_AXES values
+    uint16_t u16SamplesCount; //Items in ai16Samples
+}message_log_window_t;
+
+_Static_assert(MESSAGE_LOG_WINDOW_MAX_SIZE <= MESSAGES_MAX_SIZE, "log_window message bigger than MESSAGES_MAX_SIZE");
+
+/*
+    Flash log record (never on a link): what the imu task made of the window before
+
+    LOG RESULT MESSAGE (Big Endian)
+
+    MESSAGE ITEM:           LENGTH:             OFFSET:     DESCRIPTION:
+    ID                      u8                  0           0x31
+    Unit                    u8                  1
+    Kind                    u8                  2
+    Timestamp               u32                 3           Microseconds since boot of the last sample of the window (wraps)
+    Values                  i16[0..8]           7
+*/
+#define MESSAGE_LOG_RESULT_ID (0x31)
+#define MESSAGE_LOG_RESULT_KIND_ORIENTATION (0) //Quaternion w, x, y, z after the last sample, Q14
+#define MESSAGE_LOG_RESULT_SIZE (7UL) //Without the variable array
+#define MESSAGE_LOG_RESULT_MAX_SIZE (23UL)
+#define MESSAGE_LOG_RESULT_OFFSET_UNIT (1)
+#define MESSAGE_LOG_RESULT_OFFSET_KIND (2)
+#define MESSAGE_LOG_RESULT_OFFSET_TIMESTAMP (3)
+#define MESSAGE_LOG_RESULT_OFFSET_VALUES (7)
+#define MESSAGE_LOG_RESULT_VALUES_MAX_COUNT (8)
+
+typedef struct
+{
+    uint8_t u8Unit;
+    uint8_t u8Kind;
+    uint32_t u32Timestamp;   //Microseconds since boot of the last sample of the window (wraps)
+    int16_t ai16Values[8];
+    uint16_t u16ValuesCount; //Items in ai16Values
+}message_log_result_t;
+
+_Static_assert(MESSAGE_LOG_RESULT_MAX_SIZE <= MESSAGES_MAX_SIZE, "log_result message bigger than MESSAGES_MAX_SIZE");
+
+int32_t messages_encodeCredit(const message_credit_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeCredit(message_credit_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeTdma(const message_tdma_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeTdma(message_tdma_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeBench(const message_bench_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeBench(message_bench_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeBenchReport(const message_bench_report_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeBenchReport(message_bench_report_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeSpeed(const message_speed_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeSpeed(message_speed_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeQuench(const message_quench_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeQuench(message_quench_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeChannel(const message_channel_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeChannel(message_channel_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeStreamHeader(const message_stream_header_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeStreamHeader(message_stream_header_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeStreamStats(const message_stream_stats_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeStreamStats(message_stream_stats_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeImu(const message_imu_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeImu(message_imu_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeLogPage(const message_log_page_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeLogPage(message_log_page_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeLogWindow(const message_log_window_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeLogWindow(message_log_window_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+int32_t messages_encodeLogResult(const message_log_result_t *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);
+int32_t messages_decodeLogResult(message_log_result_t *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);
+
+#endif /* _MESSAGES_H_ */
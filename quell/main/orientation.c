@@ -0,0 +1,299 @@
+#include <stddef.h>
+#include <math.h>
+#include "orientation.h"
+#include "quell.h"
+
+/*
+    Per sample, with h the gyro rate times half the period (rotation over the sample, halved):
+    q += q x (0, h), plus the correction towards gravity, then q is normalised again.
+
+    Madgwick: the gradient of the gravity error is (up to a factor 2 that the normalisation removes)
+        t0 = 2 q0 P + q2 ax - q1 ay             P = q1 q1 + q2 q2
+        t1 = 2 q1 K - q3 ax - q0 ay             K = q0 q0 + q3 q3 - 1 + 2 P + az
+        t2 = 2 q2 K + q0 ax - q3 ay
+        t3 = 2 q3 P - q1 ax - q2 ay
+    and the step is -beta x period x t / |t|.
+    Complementary: e = a x v, v the gravity seen from the current q, goes into the rate: h += kp x period / 2 x e.
+
+    Fixed point: the quaternion and every unit vector in Q30, the products in 64 bits. Vectors are
+    normalised with 1/sqrt from a 24 entry table and two Newton steps (2.9% -> 1.3e-3 -> 2.5e-6).
+*/
+
+#define ORIENTATION_Q45_SHIFT (45)
+#define ORIENTATION_NEWTON_STEPS (2)
+
+/* 1/sqrt(x) for x in [8/32, 32/32) by steps of 1/32, best constant over each step, Q30 */
+static const int32_t ai32InvSqrtSeed[24] = {0x7C3B6670, 0x7580675C, 0x6FC25EDE, 0x6AC8DD5A, 0x666BA585, 0x628D2560,
+                                            0x5F171432, 0x5BF84A24, 0x5923539A, 0x568D7926, 0x542E127C, 0x51FE0AF2,
+                                            0x4FF787A6, 0x4E15A4EC, 0x4C54443A, 0x4AAFE5F4, 0x49258BE3, 0x47B2A221,
+                                            0x4654ECD6, 0x450A79AD, 0x43D1941B, 0x42A8BBD9, 0x418E9D1F, 0x40820A39};
+
+static int32_t orientationScales(orientation_filter_t _eFilter, float _fGain, float _fGyroLsbPerDps, uint32_t _u32PeriodUs, double *_pdHalfGyroDt, double *_pdGainDt)
+{
+    double dPeriod = (double)_u32PeriodUs / 1000000.0;
+
+    if(_eFilter >= ORIENTATION_FILTER_COUNT || _fGain < 0.0f || _fGyroLsbPerDps <= 0.0f || _u32PeriodUs == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    *_pdHalfGyroDt = 0.5 * dPeriod * (M_PI / 180.0) / _fGyroLsbPerDps;
+    *_pdGainDt = (_eFilter == ORIENTATION_MADGWICK) ? _fGain * dPeriod : 0.5 * _fGain * dPeriod;
+
+    return QUELL_OK;
+}
+
+int32_t orientation_initFloat(orientation_float_t *_psFilter, orientation_filter_t _eFilter, float _fGain, float _fGyroLsbPerDps, uint32_t _u32PeriodUs)
+{
+    double dHalfGyroDt;
+    double dGainDt;
+
+    if(_psFilter == NULL || orientationScales(_eFilter, _fGain, _fGyroLsbPerDps, _u32PeriodUs, &dHalfGyroDt, &dGainDt) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psFilter->eFilter = _eFilter;
+    _psFilter->fHalfGyroDt = (float)dHalfGyroDt;
+    _psFilter->fGainDt = (float)dGainDt;
+    _psFilter->afQuaternion[0] = 1.0f;
+    _psFilter->afQuaternion[1] = 0.0f;
+    _psFilter->afQuaternion[2] = 0.0f;
+    _psFilter->afQuaternion[3] = 0.0f;
+
+    return QUELL_OK;
+}
+
+void orientation_updateFloat(orientation_float_t *_psFilter, const int16_t *_pi16Accel, const int16_t *_pi16Gyro)
+{
+    float fQ0 = _psFilter->afQuaternion[0];
+    float fQ1 = _psFilter->afQuaternion[1];
+    float fQ2 = _psFilter->afQuaternion[2];
+    float fQ3 = _psFilter->afQuaternion[3];
+    float fHx = _pi16Gyro[0] * _psFilter->fHalfGyroDt;
+    float fHy = _pi16Gyro[1] * _psFilter->fHalfGyroDt;
+    float fHz = _pi16Gyro[2] * _psFilter->fHalfGyroDt;
+    float fAx = _pi16Accel[0];
+    float fAy = _pi16Accel[1];
+    float fAz = _pi16Accel[2];
+    float fNorm = (fAx * fAx) + (fAy * fAy) + (fAz * fAz);
+    bool bAccel = (fNorm > 0.0f);   //Free fall or no accelerometer: gyro only
+    float fD0;
+    float fD1;
+    float fD2;
+    float fD3;
+
+    if(bAccel == true)
+    {
+        fNorm = 1.0f / sqrtf(fNorm);
+        fAx *= fNorm;
+        fAy *= fNorm;
+        fAz *= fNorm;
+    }
+
+    if(bAccel == true && _psFilter->eFilter == ORIENTATION_COMPLEMENTARY)
+    {
+        float fVx = 2.0f * ((fQ1 * fQ3) - (fQ0 * fQ2));
+        float fVy = 2.0f * ((fQ0 * fQ1) + (fQ2 * fQ3));
+        float fVz = (fQ0 * fQ0) - (fQ1 * fQ1) - (fQ2 * fQ2) + (fQ3 * fQ3);
+
+        fHx += _psFilter->fGainDt * ((fAy * fVz) - (fAz * fVy));
+        fHy += _psFilter->fGainDt * ((fAz * fVx) - (fAx * fVz));
+        fHz += _psFilter->fGainDt * ((fAx * fVy) - (fAy * fVx));
+    }
+
+    fD0 = - (fQ1 * fHx) - (fQ2 * fHy) - (fQ3 * fHz);
+    fD1 = (fQ0 * fHx) + (fQ2 * fHz) - (fQ3 * fHy);
+    fD2 = (fQ0 * fHy) - (fQ1 * fHz) + (fQ3 * fHx);
+    fD3 = (fQ0 * fHz) + (fQ1 * fHy) - (fQ2 * fHx);
+
+    if(bAccel == true && _psFilter->eFilter == ORIENTATION_MADGWICK)
+    {
+        float fP = (fQ1 * fQ1) + (fQ2 * fQ2);
+        float fK = (fQ0 * fQ0) + (fQ3 * fQ3) - 1.0f + (2.0f * fP) + fAz;
+        float fT0 = (2.0f * fQ0 * fP) + (fQ2 * fAx) - (fQ1 * fAy);
+        float fT1 = (2.0f * fQ1 * fK) - (fQ3 * fAx) - (fQ0 * fAy);
+        float fT2 = (2.0f * fQ2 * fK) + (fQ0 * fAx) - (fQ3 * fAy);
+        float fT3 = (2.0f * fQ3 * fP) - (fQ1 * fAx) - (fQ2 * fAy);
+
+        fNorm = (fT0 * fT0) + (fT1 * fT1) + (fT2 * fT2) + (fT3 * fT3);
+        if(fNorm > 0.0f)
+        {
+            fNorm = _psFilter->fGainDt / sqrtf(fNorm);
+            fD0 -= fT0 * fNorm;
+            fD1 -= fT1 * fNorm;
+            fD2 -= fT2 * fNorm;
+            fD3 -= fT3 * fNorm;
+        }
+    }
+
+    fQ0 += fD0;
+    fQ1 += fD1;
+    fQ2 += fD2;
+    fQ3 += fD3;
+    fNorm = 1.0f / sqrtf((fQ0 * fQ0) + (fQ1 * fQ1) + (fQ2 * fQ2) + (fQ3 * fQ3));
+    _psFilter->afQuaternion[0] = fQ0 * fNorm;
+    _psFilter->afQuaternion[1] = fQ1 * fNorm;
+    _psFilter->afQuaternion[2] = fQ2 * fNorm;
+    _psFilter->afQuaternion[3] = fQ3 * fNorm;
+}
+
+/* 1/sqrt(x) for x in [0.25, 1), both in Q30 */
+static int64_t orientationInvSqrt(int64_t _i64X)
+{
+    int64_t i64Y = ai32InvSqrtSeed[(_i64X >> 25) - 8];
+
+    for(uint8_t u8Step = 0; u8Step < ORIENTATION_NEWTON_STEPS; u8Step++)
+    {
+        int64_t i64Y2 = (i64Y * i64Y) >> 30;
+        i64Y = (i64Y * ((3LL << 30) - ((_i64X * i64Y2) >> 30))) >> 31;
+    }
+
+    return i64Y;
+}
+
+/* Vector of any scale to unit length in Q30, false for a zero vector */
+static bool orientationNormalize(int64_t *_pi64Vector, uint8_t _u8Count)
+{
+    uint64_t u64Max = 0;
+    int64_t i64Norm = 0;
+    int32_t i32Shift;
+    int64_t i64Inverse;
+
+    for(uint8_t u8Index = 0; u8Index < _u8Count; u8Index++)
+    {
+        uint64_t u64Abs = (_pi64Vector[u8Index] < 0) ? -(uint64_t)_pi64Vector[u8Index] : (uint64_t)_pi64Vector[u8Index];
+        u64Max = (u64Abs > u64Max) ? u64Abs : u64Max;
+    }
+    if(u64Max == 0)
+    {
+        return false;
+    }
+
+    /* Biggest component to [2^28, 2^29), so the sum of squares is in [2^56, 2^60) */
+    i32Shift = 28 - (63 - __builtin_clzll(u64Max));
+    for(uint8_t u8Index = 0; u8Index < _u8Count; u8Index++)
+    {
+        _pi64Vector[u8Index] = (i32Shift >= 0) ? _pi64Vector[u8Index] * (1LL << i32Shift) : _pi64Vector[u8Index] >> -i32Shift;
+        i64Norm += _pi64Vector[u8Index] * _pi64Vector[u8Index];
+    }
+
+    /* Sum of squares to [0.25, 1) in Q30: 1/sqrt of it is 2^30 / |v| (shift 30) or 2^29 / |v| (shift 29) */
+    if(i64Norm >= (1LL << 58))
+    {
+        i64Inverse = orientationInvSqrt(i64Norm >> 30);
+        i32Shift = 30;
+    }
+    else
+    {
+        i64Inverse = orientationInvSqrt(i64Norm >> 28);
+        i32Shift = 29;
+    }
+
+    for(uint8_t u8Index = 0; u8Index < _u8Count; u8Index++)
+    {
+        _pi64Vector[u8Index] = (_pi64Vector[u8Index] * i64Inverse) >> i32Shift;
+    }
+
+    return true;
+}
+
+int32_t orientation_initFixed(orientation_fixed_t *_psFilter, orientation_filter_t _eFilter, float _fGain, float _fGyroLsbPerDps, uint32_t _u32PeriodUs)
+{
+    double dHalfGyroDt;
+    double dGainDt;
+
+    if(_psFilter == NULL || orientationScales(_eFilter, _fGain, _fGyroLsbPerDps, _u32PeriodUs, &dHalfGyroDt, &dGainDt) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Half a radian per LSB, or a gain step of 1, is far past anything usable */
+    dHalfGyroDt = round(ldexp(dHalfGyroDt, ORIENTATION_Q45_SHIFT));
+    dGainDt = round(ldexp(dGainDt, 30));
+    if(dHalfGyroDt >= INT32_MAX || dGainDt >= INT32_MAX)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psFilter->eFilter = _eFilter;
+    _psFilter->i32HalfGyroDt = (int32_t)dHalfGyroDt;
+    _psFilter->i32GainDt = (int32_t)dGainDt;
+    _psFilter->ai32Quaternion[0] = ORIENTATION_Q30;
+    _psFilter->ai32Quaternion[1] = 0;
+    _psFilter->ai32Quaternion[2] = 0;
+    _psFilter->ai32Quaternion[3] = 0;
+
+    return QUELL_OK;
+}
+
+void orientation_updateFixed(orientation_fixed_t *_psFilter, const int16_t *_pi16Accel, const int16_t *_pi16Gyro)
+{
+    int64_t i64Q0 = _psFilter->ai32Quaternion[0];
+    int64_t i64Q1 = _psFilter->ai32Quaternion[1];
+    int64_t i64Q2 = _psFilter->ai32Quaternion[2];
+    int64_t i64Q3 = _psFilter->ai32Quaternion[3];
+    int64_t i64Hx = (_pi16Gyro[0] * (int64_t)_psFilter->i32HalfGyroDt) >> (ORIENTATION_Q45_SHIFT - 30);
+    int64_t i64Hy = (_pi16Gyro[1] * (int64_t)_psFilter->i32HalfGyroDt) >> (ORIENTATION_Q45_SHIFT - 30);
+    int64_t i64Hz = (_pi16Gyro[2] * (int64_t)_psFilter->i32HalfGyroDt) >> (ORIENTATION_Q45_SHIFT - 30);
+    int64_t ai64Accel[3] = {_pi16Accel[0], _pi16Accel[1], _pi16Accel[2]};
+    bool bAccel = orientationNormalize(ai64Accel, 3);
+    int64_t ai64Step[4];
+
+    if(bAccel == true && _psFilter->eFilter == ORIENTATION_COMPLEMENTARY)
+    {
+        int64_t i64Vx = ((i64Q1 * i64Q3) - (i64Q0 * i64Q2)) >> 29;
+        int64_t i64Vy = ((i64Q0 * i64Q1) + (i64Q2 * i64Q3)) >> 29;
+        int64_t i64Vz = ((i64Q0 * i64Q0) - (i64Q1 * i64Q1) - (i64Q2 * i64Q2) + (i64Q3 * i64Q3)) >> 30;
+
+        i64Hx += ((((ai64Accel[1] * i64Vz) - (ai64Accel[2] * i64Vy)) >> 30) * _psFilter->i32GainDt) >> 30;
+        i64Hy += ((((ai64Accel[2] * i64Vx) - (ai64Accel[0] * i64Vz)) >> 30) * _psFilter->i32GainDt) >> 30;
+        i64Hz += ((((ai64Accel[0] * i64Vy) - (ai64Accel[1] * i64Vx)) >> 30) * _psFilter->i32GainDt) >> 30;
+    }
+
+    ai64Step[0] = (- (i64Q1 * i64Hx) - (i64Q2 * i64Hy) - (i64Q3 * i64Hz)) >> 30;
+    ai64Step[1] = ((i64Q0 * i64Hx) + (i64Q2 * i64Hz) - (i64Q3 * i64Hy)) >> 30;
+    ai64Step[2] = ((i64Q0 * i64Hy) - (i64Q1 * i64Hz) + (i64Q3 * i64Hx)) >> 30;
+    ai64Step[3] = ((i64Q0 * i64Hz) + (i64Q1 * i64Hy) - (i64Q2 * i64Hx)) >> 30;
+
+    if(bAccel == true && _psFilter->eFilter == ORIENTATION_MADGWICK)
+    {
+        /* K reaches 4, so the 2 q K products are shifted by 29 on their own instead of summed in Q61 */
+        int64_t i64P = ((i64Q1 * i64Q1) + (i64Q2 * i64Q2)) >> 30;
+        int64_t i64K = (((i64Q0 * i64Q0) + (i64Q3 * i64Q3)) >> 30) - ORIENTATION_Q30 + (2 * i64P) + ai64Accel[2];
+        int64_t ai64Gradient[4];
+
+        ai64Gradient[0] = ((i64Q0 * i64P) >> 29) + (((i64Q2 * ai64Accel[0]) - (i64Q1 * ai64Accel[1])) >> 30);
+        ai64Gradient[1] = ((i64Q1 * i64K) >> 29) - (((i64Q3 * ai64Accel[0]) + (i64Q0 * ai64Accel[1])) >> 30);
+        ai64Gradient[2] = ((i64Q2 * i64K) >> 29) + (((i64Q0 * ai64Accel[0]) - (i64Q3 * ai64Accel[1])) >> 30);
+        ai64Gradient[3] = ((i64Q3 * i64P) >> 29) - (((i64Q1 * ai64Accel[0]) + (i64Q2 * ai64Accel[1])) >> 30);
+
+        if(orientationNormalize(ai64Gradient, 4) == true)
+        {
+            for(uint8_t u8Index = 0; u8Index < 4; u8Index++)
+            {
+                ai64Step[u8Index] -= (ai64Gradient[u8Index] * _psFilter->i32GainDt) >> 30;
+            }
+        }
+    }
+
+    ai64Step[0] += i64Q0;
+    ai64Step[1] += i64Q1;
+    ai64Step[2] += i64Q2;
+    ai64Step[3] += i64Q3;
+    if(orientationNormalize(ai64Step, 4) == true)
+    {
+        for(uint8_t u8Index = 0; u8Index < 4; u8Index++)
+        {
+            _psFilter->ai32Quaternion[u8Index] = (int32_t)ai64Step[u8Index];
+        }
+    }
+}
+
+void orientation_getFixed(const orientation_fixed_t *_psFilter, float *_pfQuaternion)
+{
+    for(uint8_t u8Index = 0; u8Index < 4; u8Index++)
+    {
+        _pfQuaternion[u8Index] = (float)_psFilter->ai32Quaternion[u8Index] / (float)ORIENTATION_Q30;
+    }
+}
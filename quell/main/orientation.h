@@ -0,0 +1,59 @@
+#ifndef _ORIENTATION_H_
+#define _ORIENTATION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    ORIENTATION FILTERS
+
+    Sensor fusion of one IMU (accelerometer and gyroscope, no magnetometer), updated once per sample.
+    The quaternion (w, x, y, z) turns the unit frame into the earth frame (z up), so the tilt comes from
+    the accelerometer and the heading only from the gyroscope (it drifts).
+
+    FILTER:                 GAIN:               DESCRIPTION:
+    Madgwick                beta (rad/s)        Gyro integration plus a gradient descent step towards gravity
+    Complementary           kp (1/s)            Gyro integration plus kp x (measured x estimated gravity),
+                                                Mahony without the integral term, about half the work
+
+    Both come in float (reference, uses the FPU) and fixed point (Q30 quaternion, 64 bit products, no
+    divisions and no square roots) with the same inputs: raw IMU values as they arrive in the imu message
+    (messages.h), the gyro scale and the sample period given once at init. The float and fixed
+    variants of the same filter follow each other to a few 1e-5 rad (tools/orientation/orientationBench.c).
+*/
+
+#define ORIENTATION_Q30 (1L << 30)
+#define ORIENTATION_MADGWICK_BETA (0.1f)
+#define ORIENTATION_COMPLEMENTARY_KP (1.0f)
+
+typedef enum
+{
+    ORIENTATION_MADGWICK = 0,
+    ORIENTATION_COMPLEMENTARY,
+    ORIENTATION_FILTER_COUNT
+}orientation_filter_t;
+
+typedef struct
+{
+    orientation_filter_t eFilter;
+    float afQuaternion[4];          //w, x, y, z
+    float fHalfGyroDt;              //Half the rotation (rad) of one gyro LSB over a sample period
+    float fGainDt;                  //Madgwick beta x period, complementary kp x period / 2
+}orientation_float_t;
+
+typedef struct
+{
+    orientation_filter_t eFilter;
+    int32_t ai32Quaternion[4];      //w, x, y, z in Q30
+    int32_t i32HalfGyroDt;          //Same as the float one in Q45
+    int32_t i32GainDt;              //Same as the float one in Q30
+}orientation_fixed_t;
+
+int32_t orientation_initFloat(orientation_float_t *_psFilter, orientation_filter_t _eFilter, float _fGain, float _fGyroLsbPerDps, uint32_t _u32PeriodUs);
+void orientation_updateFloat(orientation_float_t *_psFilter, const int16_t *_pi16Accel, const int16_t *_pi16Gyro);
+
+int32_t orientation_initFixed(orientation_fixed_t *_psFilter, orientation_filter_t _eFilter, float _fGain, float _fGyroLsbPerDps, uint32_t _u32PeriodUs);
+void orientation_updateFixed(orientation_fixed_t *_psFilter, const int16_t *_pi16Accel, const int16_t *_pi16Gyro);
+void orientation_getFixed(const orientation_fixed_t *_psFilter, float *_pfQuaternion);
+
+#endif /* _ORIENTATION_H_ */
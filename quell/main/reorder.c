@@ -0,0 +1,253 @@
+#include <stddef.h>
+#include <string.h>
+#include "reorder.h"
+#include "quell.h"
+
+#define REORDER_MASK (REORDER_SLOTS - 1)
+
+_Static_assert((REORDER_SLOTS & REORDER_MASK) == 0 && REORDER_SLOTS >= 2 * REORDER_MAX_WINDOW, "REORDER_SLOTS must be a power of two of at least 2 windows");
+_Static_assert(REORDER_MAX_WINDOW <= 32, "the gap mask has 32 bits");
+
+static void reorderRestart(reorder_t *_psReorder, uint32_t _u32Timestamp, uint16_t _u16Period)
+{
+    for(uint16_t u16Slot = 0; u16Slot < REORDER_SLOTS; u16Slot++)
+    {
+        _psReorder->u32Dropped += (_psReorder->abPresent[u16Slot] == true) ? 1 : 0;
+    }
+    _psReorder->u32Restarts += (_psReorder->bStarted == true) ? 1 : 0;
+
+    memset(_psReorder->abPresent, 0, sizeof(_psReorder->abPresent));
+    _psReorder->bStarted = true;
+    _psReorder->u16Period = _u16Period;
+    _psReorder->u16Next = 0;
+    _psReorder->u32NextTimestamp = _u32Timestamp;
+    _psReorder->u32NewestTimestamp = _u32Timestamp;
+}
+
+int32_t reorder_init(reorder_t *_psReorder, uint8_t _u8Window, uint32_t _u32WatermarkUs, reorder_fill_t _eFill, reorder_clock_t _fpNowUs)
+{
+    if(_psReorder == NULL || _u8Window == 0 || _u8Window > REORDER_MAX_WINDOW || _u32WatermarkUs > INT32_MAX ||
+       _eFill >= REORDER_FILL_COUNT || _fpNowUs == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    memset(_psReorder, 0, sizeof(reorder_t));
+    _psReorder->u8Window = _u8Window;
+    _psReorder->u32WatermarkUs = _u32WatermarkUs;
+    _psReorder->eFill = _eFill;
+    _psReorder->fpNowUs = _fpNowUs;
+
+    return QUELL_OK;
+}
+
+/* _u16Count samples of REORDER_CHANNELS values, _u16Period apart from _u32Timestamp on */
+int32_t reorder_push(reorder_t *_psReorder, uint32_t _u32Timestamp, uint16_t _u16Period, const int16_t *_pi16Samples, uint16_t _u16Count)
+{
+    uint32_t u32Now;
+
+    if(_psReorder == NULL || _u16Period == 0 || (_pi16Samples == NULL && _u16Count > 0))
+    {
+        return QUELL_ERROR;
+    }
+    u32Now = _psReorder->fpNowUs();
+
+    for(uint16_t u16Sample = 0; u16Sample < _u16Count; u16Sample++)
+    {
+        uint32_t u32Timestamp = _u32Timestamp + ((uint32_t)u16Sample * _u16Period);
+        int32_t i32Offset;
+        int32_t i32Index;
+        uint16_t u16Slot;
+
+        if(_psReorder->bStarted == false || _u16Period != _psReorder->u16Period)
+        {
+            reorderRestart(_psReorder, u32Timestamp, _u16Period);
+        }
+
+        /* Periods from the oldest pending window, rounded (the timestamps of a unit jitter a little) */
+        i32Offset = (int32_t)(u32Timestamp - _psReorder->u32NextTimestamp);
+        i32Index = (i32Offset >= 0) ? (i32Offset + (_u16Period / 2)) / _u16Period : -((-i32Offset + (_u16Period / 2)) / _u16Period);
+
+        if(i32Index < 0)
+        {
+            _psReorder->u32Late++;
+            continue;
+        }
+        if(i32Index >= REORDER_SLOTS)
+        {
+            reorderRestart(_psReorder, u32Timestamp, _u16Period);
+            i32Index = 0;
+        }
+
+        u16Slot = (_psReorder->u16Next + (uint16_t)i32Index) & REORDER_MASK;
+        if(_psReorder->abPresent[u16Slot] == true)
+        {
+            _psReorder->u32Duplicates++;
+            continue;
+        }
+
+        memcpy(_psReorder->aai16Slots[u16Slot], &_pi16Samples[u16Sample * REORDER_CHANNELS], sizeof(_psReorder->aai16Slots[u16Slot]));
+        _psReorder->abPresent[u16Slot] = true;
+        _psReorder->au32ArrivalUs[u16Slot] = u32Now;
+        _psReorder->u32LastArrivalUs = u32Now;
+        _psReorder->u32Samples++;
+
+        if((int32_t)(u32Timestamp - _psReorder->u32NewestTimestamp) < 0)
+        {
+            _psReorder->u32Reordered++;
+        }
+        else
+        {
+            _psReorder->u32NewestTimestamp = u32Timestamp;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+static void reorderFill(reorder_t *_psReorder, reorder_window_t *_psWindow, uint8_t _u8Index)
+{
+    int16_t *pi16Out = _psWindow->aai16Samples[_u8Index];
+    const int16_t *pi16Before = NULL;
+    const int16_t *pi16After = NULL;
+    uint8_t u8Before = 0;
+    uint8_t u8After = 0;
+
+    if(_psReorder->eFill == REORDER_FILL_FLAG)
+    {
+        memset(pi16Out, 0, REORDER_CHANNELS * sizeof(int16_t));
+        return;
+    }
+
+    /* The window is filled in order, so the sample before is already there (or the end of the last window) */
+    if(_u8Index > 0)
+    {
+        pi16Before = _psWindow->aai16Samples[_u8Index - 1];
+        u8Before = 1;
+    }
+    else if(_psReorder->bHaveLast == true)
+    {
+        pi16Before = _psReorder->ai16Last;
+        u8Before = 1;
+    }
+
+    if(_psReorder->eFill == REORDER_FILL_INTERPOLATE || pi16Before == NULL)
+    {
+        for(uint8_t u8Index = _u8Index + 1; u8Index < _psReorder->u8Window && pi16After == NULL; u8Index++)
+        {
+            uint16_t u16Slot = (_psReorder->u16Next + u8Index) & REORDER_MASK;
+            if(_psReorder->abPresent[u16Slot] == true)
+            {
+                pi16After = _psReorder->aai16Slots[u16Slot];
+                u8After = u8Index - _u8Index;
+            }
+        }
+    }
+
+    for(uint8_t u8Channel = 0; u8Channel < REORDER_CHANNELS; u8Channel++)
+    {
+        if(pi16Before != NULL && pi16After != NULL)
+        {
+            int32_t i32Step = ((int32_t)pi16After[u8Channel] - pi16Before[u8Channel]) * u8Before;
+            pi16Out[u8Channel] = (int16_t)(pi16Before[u8Channel] + (i32Step / (int32_t)(u8Before + u8After)));
+        }
+        else if(pi16Before != NULL)
+        {
+            pi16Out[u8Channel] = pi16Before[u8Channel];
+        }
+        else
+        {
+            pi16Out[u8Channel] = (pi16After != NULL) ? pi16After[u8Channel] : 0;
+        }
+    }
+}
+
+/* The oldest pending window, when it is complete or its watermark passed */
+int32_t reorder_pop(reorder_t *_psReorder, reorder_window_t *_psWindow)
+{
+    uint32_t u32Now;
+    uint32_t u32WindowEnd;
+    uint32_t u32Deadline;
+    uint32_t u32FirstArrival = 0;
+    uint32_t u32OldestArrival = 0;
+    uint8_t u8Present = 0;
+    bool bPending = false;
+
+    if(_psReorder == NULL || _psWindow == NULL || _psReorder->bStarted == false)
+    {
+        return QUELL_ERROR;
+    }
+    u32Now = _psReorder->fpNowUs();
+    u32WindowEnd = _psReorder->u32NextTimestamp + ((uint32_t)(_psReorder->u8Window - 1) * _psReorder->u16Period);
+
+    for(uint8_t u8Index = 0; u8Index < _psReorder->u8Window; u8Index++)
+    {
+        uint16_t u16Slot = (_psReorder->u16Next + u8Index) & REORDER_MASK;
+        if(_psReorder->abPresent[u16Slot] == true)
+        {
+            /* Oldest arrival, relative to now so the clock may wrap */
+            u32FirstArrival = (u8Present == 0 || (u32Now - _psReorder->au32ArrivalUs[u16Slot]) > (u32Now - u32FirstArrival)) ?
+                              _psReorder->au32ArrivalUs[u16Slot] : u32FirstArrival;
+            u8Present++;
+        }
+    }
+
+    /* The windows after this one wait for it, so the oldest of all the samples pending sets the deadline */
+    for(uint16_t u16Index = 0; u16Index < REORDER_SLOTS; u16Index++)
+    {
+        uint16_t u16Slot = (_psReorder->u16Next + u16Index) & REORDER_MASK;
+        if(_psReorder->abPresent[u16Slot] == true)
+        {
+            u32OldestArrival = (bPending == false || (u32Now - _psReorder->au32ArrivalUs[u16Slot]) > (u32Now - u32OldestArrival)) ?
+                               _psReorder->au32ArrivalUs[u16Slot] : u32OldestArrival;
+            bPending = true;
+        }
+    }
+
+    /* Complete, or past its watermark, or (the unit went quiet) the span and the watermark went by since the oldest
+       sample pending arrived; an empty window with nothing after it waits */
+    u32Deadline = ((uint32_t)_psReorder->u8Window * _psReorder->u16Period) + _psReorder->u32WatermarkUs;
+    if(u8Present < _psReorder->u8Window &&
+       (int32_t)(_psReorder->u32NewestTimestamp - u32WindowEnd) < (int32_t)_psReorder->u32WatermarkUs &&
+       (bPending == false || (u32Now - u32OldestArrival) < u32Deadline))
+    {
+        return QUELL_ERROR;
+    }
+
+    _psWindow->u32Timestamp = _psReorder->u32NextTimestamp;
+    _psWindow->u16Period = _psReorder->u16Period;
+    _psWindow->u8Length = _psReorder->u8Window;
+    _psWindow->u32GapMask = 0;
+    _psWindow->u32WaitUs = (u8Present > 0) ? u32Now - u32FirstArrival : 0;
+
+    for(uint8_t u8Index = 0; u8Index < _psReorder->u8Window; u8Index++)
+    {
+        uint16_t u16Slot = (_psReorder->u16Next + u8Index) & REORDER_MASK;
+
+        if(_psReorder->abPresent[u16Slot] == true)
+        {
+            memcpy(_psWindow->aai16Samples[u8Index], _psReorder->aai16Slots[u16Slot], sizeof(_psWindow->aai16Samples[u8Index]));
+        }
+        else
+        {
+            reorderFill(_psReorder, _psWindow, u8Index);
+            _psWindow->u32GapMask |= 1UL << u8Index;
+        }
+    }
+
+    for(uint8_t u8Index = 0; u8Index < _psReorder->u8Window; u8Index++)
+    {
+        _psReorder->abPresent[(_psReorder->u16Next + u8Index) & REORDER_MASK] = false;
+    }
+    memcpy(_psReorder->ai16Last, _psWindow->aai16Samples[_psReorder->u8Window - 1], sizeof(_psReorder->ai16Last));
+    _psReorder->bHaveLast = true;
+    _psReorder->u16Next = (_psReorder->u16Next + _psReorder->u8Window) & REORDER_MASK;
+    _psReorder->u32NextTimestamp += (uint32_t)_psReorder->u8Window * _psReorder->u16Period;
+
+    _psReorder->u32Windows++;
+    _psReorder->u32Gaps += _psReorder->u8Window - u8Present;
+    _psReorder->u64WaitUs += _psWindow->u32WaitUs;
+    _psReorder->u32MaxWaitUs = (_psWindow->u32WaitUs > _psReorder->u32MaxWaitUs) ? _psWindow->u32WaitUs : _psReorder->u32MaxWaitUs;
+
+    return QUELL_OK;
+}
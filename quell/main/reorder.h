@@ -0,0 +1,95 @@
+#ifndef _REORDER_H_
+#define _REORDER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    REORDER (jitter) BUFFER
+
+    Samples of one unit put back in timestamp order and handed out a window (a fixed number of
+    consecutive sample periods) at a time. Every sample goes to the slot of its timestamp, so a batch
+    that overtook an earlier one, or a duplicate, lands where it belongs; the buffer does not trust the
+    order things arrive in.
+
+    A window goes out as soon as all of it is there. Otherwise it waits for the watermark: until the
+    unit sent a sample at least watermark microseconds (of its own timestamps) past the end of the window,
+    or, when the unit went quiet, until the span of the window plus the watermark went by on the local
+    clock since the oldest sample pending arrived (of this window or of the ones after it, which can not
+    go out before it). Whatever is still missing then is a gap, filled as
+    configured and flagged in the window, and a sample of it arriving later is late and dropped. A window
+    therefore never waits more than its span plus the watermark, whatever is lost, and a link whose
+    delay varies by less than the watermark loses nothing to lateness.
+
+    FILL:                   MISSING SAMPLES:
+    Flag                    Zero
+    Hold                    Repeat the sample before
+    Interpolate             Straight line between the samples around the gap (hold at the end of a window)
+
+    A new period restarts the buffer (what was pending is dropped), and so does a sample more than
+    REORDER_SLOTS periods ahead of the oldest pending window (the unit restarted or was gone for long).
+*/
+
+#define REORDER_CHANNELS (6)
+#define REORDER_MAX_WINDOW (32)
+#define REORDER_SLOTS (128)             //Power of two, at least 2 windows
+
+typedef uint32_t (*reorder_clock_t)(void);  //Microseconds, wrapping
+
+typedef enum
+{
+    REORDER_FILL_FLAG = 0,
+    REORDER_FILL_HOLD,
+    REORDER_FILL_INTERPOLATE,
+    REORDER_FILL_COUNT
+}reorder_fill_t;
+
+typedef struct
+{
+    uint32_t u32Timestamp;          //Of the first sample
+    uint16_t u16Period;
+    uint8_t u8Length;
+    uint32_t u32GapMask;            //Bit n: sample n was missing and got filled
+    uint32_t u32WaitUs;             //From the first of its samples arriving to the window going out
+    int16_t aai16Samples[REORDER_MAX_WINDOW][REORDER_CHANNELS];
+}reorder_window_t;
+
+typedef struct
+{
+    /* Configuration */
+    uint8_t u8Window;               //Samples per window
+    uint32_t u32WatermarkUs;
+    reorder_fill_t eFill;
+    reorder_clock_t fpNowUs;
+
+    /* Pending samples, the slot of the first sample of the oldest pending window is u16Next */
+    bool bStarted;
+    uint16_t u16Period;
+    uint16_t u16Next;
+    uint32_t u32NextTimestamp;
+    uint32_t u32NewestTimestamp;
+    uint32_t u32LastArrivalUs;
+    bool abPresent[REORDER_SLOTS];
+    uint32_t au32ArrivalUs[REORDER_SLOTS];
+    int16_t aai16Slots[REORDER_SLOTS][REORDER_CHANNELS];
+    bool bHaveLast;
+    int16_t ai16Last[REORDER_CHANNELS];     //Last sample handed out, for the fill
+
+    /* Statistics */
+    uint32_t u32Samples;            //Taken into a slot
+    uint32_t u32Reordered;          //Of those, older than one already taken
+    uint32_t u32Duplicates;
+    uint32_t u32Late;               //Their window had gone out already
+    uint32_t u32Dropped;            //Pending when the buffer restarted
+    uint32_t u32Restarts;
+    uint32_t u32Windows;
+    uint32_t u32Gaps;               //Samples filled
+    uint64_t u64WaitUs;
+    uint32_t u32MaxWaitUs;
+}reorder_t;
+
+int32_t reorder_init(reorder_t *_psReorder, uint8_t _u8Window, uint32_t _u32WatermarkUs, reorder_fill_t _eFill, reorder_clock_t _fpNowUs);
+int32_t reorder_push(reorder_t *_psReorder, uint32_t _u32Timestamp, uint16_t _u16Period, const int16_t *_pi16Samples, uint16_t _u16Count);
+int32_t reorder_pop(reorder_t *_psReorder, reorder_window_t *_psWindow);
+
+#endif /* _REORDER_H_ */
@@ -0,0 +1,150 @@
+#include "sampleBus.h"
+#include "quell.h"
+
+int32_t sampleBus_init(sample_bus_t *_psBus, uint8_t *_pu8Buffer, size_t _tBufferSize, uint16_t _u16SlotSize)
+{
+    uint32_t u32SlotCount = 1;
+
+    if(_psBus == NULL || _pu8Buffer == NULL || _u16SlotSize == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* As many slots as fit, rounded down to a power of two so the cursors wrap with a mask */
+    while(SAMPLE_BUS_BUFFER_SIZE(_u16SlotSize, u32SlotCount * 2) <= _tBufferSize)
+    {
+        u32SlotCount *= 2;
+    }
+    if(SAMPLE_BUS_BUFFER_SIZE(_u16SlotSize, u32SlotCount) > _tBufferSize || u32SlotCount < 2)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psBus->pu8Slots = _pu8Buffer;
+    _psBus->pu16Size = (uint16_t*)&_pu8Buffer[SAMPLE_BUS_SLOT_STRIDE(_u16SlotSize) * u32SlotCount];
+    _psBus->u16SlotSize = _u16SlotSize;
+    _psBus->u32SlotCount = u32SlotCount;
+    _psBus->u32Mask = u32SlotCount - 1;
+    _psBus->u32Head = 0;
+
+    return QUELL_OK;
+}
+
+/* Slot for the next message, the producer fills it in place and then publishes it */
+uint8_t* sampleBus_claim(sample_bus_t *_psBus)
+{
+    if(_psBus == NULL)
+    {
+        return NULL;
+    }
+
+    /* The head that made this slot stale must be seen before any byte written into it, that is what release checks */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return &_psBus->pu8Slots[(_psBus->u32Head & _psBus->u32Mask) * SAMPLE_BUS_SLOT_STRIDE(_psBus->u16SlotSize)];
+}
+
+void sampleBus_publish(sample_bus_t *_psBus, uint16_t _u16Size)
+{
+    if(_psBus == NULL || _u16Size > _psBus->u16SlotSize)
+    {
+        return;
+    }
+
+    _psBus->pu16Size[_psBus->u32Head & _psBus->u32Mask] = _u16Size;
+    __atomic_store_n(&_psBus->u32Head, _psBus->u32Head + 1, __ATOMIC_RELEASE);
+}
+
+int32_t sampleBus_write(sample_bus_t *_psBus, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    uint8_t *pu8Slot;
+
+    if(_psBus == NULL || _pu8Message == NULL || _u16Size > _psBus->u16SlotSize)
+    {
+        return QUELL_ERROR;
+    }
+
+    pu8Slot = sampleBus_claim(_psBus);
+    memcpy(pu8Slot, _pu8Message, _u16Size);
+    sampleBus_publish(_psBus, _u16Size);
+
+    return QUELL_OK;
+}
+
+/* New subscribers start with the next message published */
+int32_t sampleBus_subscribe(sample_bus_t *_psBus, sample_bus_subscriber_t *_psSubscriber)
+{
+    if(_psBus == NULL || _psSubscriber == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psSubscriber->psBus = _psBus;
+    _psSubscriber->u32Cursor = __atomic_load_n(&_psBus->u32Head, __ATOMIC_ACQUIRE);
+    _psSubscriber->u32Received = 0;
+    _psSubscriber->u32Dropped = 0;
+
+    return QUELL_OK;
+}
+
+/* Points at the oldest unread message, valid until release (which says if it was still intact) */
+int32_t sampleBus_peek(sample_bus_subscriber_t *_psSubscriber, const uint8_t **_ppu8Message, uint16_t *_pu16Size)
+{
+    sample_bus_t *psBus;
+    uint32_t u32Head;
+
+    if(_psSubscriber == NULL || _psSubscriber->psBus == NULL || _ppu8Message == NULL || _pu16Size == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    psBus = _psSubscriber->psBus;
+    u32Head = __atomic_load_n(&psBus->u32Head, __ATOMIC_ACQUIRE);
+    if(u32Head == _psSubscriber->u32Cursor)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Lapped: the slot of sequence head is being rewritten, so the oldest intact one is head - count + 1 */
+    if(u32Head - _psSubscriber->u32Cursor >= psBus->u32SlotCount)
+    {
+        _psSubscriber->u32Dropped += (u32Head - _psSubscriber->u32Cursor) - (psBus->u32SlotCount - 1);
+        _psSubscriber->u32Cursor = u32Head - (psBus->u32SlotCount - 1);
+    }
+
+    *_ppu8Message = &psBus->pu8Slots[(_psSubscriber->u32Cursor & psBus->u32Mask) * SAMPLE_BUS_SLOT_STRIDE(psBus->u16SlotSize)];
+    *_pu16Size = psBus->pu16Size[_psSubscriber->u32Cursor & psBus->u32Mask];
+    if(*_pu16Size > psBus->u16SlotSize)
+    {
+        *_pu16Size = psBus->u16SlotSize;
+    }
+
+    return QUELL_OK;
+}
+
+/* QUELL_ERROR means the producer came round to the slot while it was read, whatever was read is garbage */
+int32_t sampleBus_release(sample_bus_subscriber_t *_psSubscriber)
+{
+    uint32_t u32Head;
+
+    if(_psSubscriber == NULL || _psSubscriber->psBus == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Reads of the slot are done before the head is looked at again */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    u32Head = __atomic_load_n(&_psSubscriber->psBus->u32Head, __ATOMIC_RELAXED);
+
+    if(u32Head - _psSubscriber->u32Cursor >= _psSubscriber->psBus->u32SlotCount)
+    {
+        _psSubscriber->u32Dropped++;
+        _psSubscriber->u32Cursor++;
+        return QUELL_ERROR;
+    }
+
+    _psSubscriber->u32Received++;
+    _psSubscriber->u32Cursor++;
+
+    return QUELL_OK;
+}
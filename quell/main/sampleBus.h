@@ -0,0 +1,52 @@
+#ifndef _SAMPLE_BUS_H_
+#define _SAMPLE_BUS_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    SAMPLE BUS
+
+    Single producer, many consumers broadcast ring. The producer writes every message straight into a
+    slot (claim, fill, publish) and never waits for anyone. Each subscriber has its own cursor and reads
+    the slot in place (peek, use, release). A subscriber that falls more than a ring behind skips to the
+    oldest message still there, and release tells it when the slot it was reading got overwritten in the
+    meantime; both cases are counted in u32Dropped. No locks, no copies and nothing the producer does
+    depends on how many subscribers there are.
+*/
+
+typedef struct
+{
+    uint8_t *pu8Slots;
+    uint16_t *pu16Size;         //Size of the message in every slot
+    uint16_t u16SlotSize;       //Biggest message a slot holds
+    uint32_t u32SlotCount;      //Power of two
+    uint32_t u32Mask;
+    volatile uint32_t u32Head;  //Sequence of the next message, everything before it is published
+}sample_bus_t;
+
+typedef struct
+{
+    sample_bus_t *psBus;
+    uint32_t u32Cursor;         //Sequence of the next message to read
+
+    /* Statistics */
+    uint32_t u32Received;
+    uint32_t u32Dropped;        //Messages lost for being too slow
+}sample_bus_subscriber_t;
+
+#define SAMPLE_BUS_SLOT_STRIDE(slot_size) (((slot_size) + 3) & ~3U)
+#define SAMPLE_BUS_BUFFER_SIZE(slot_size, slot_count) ((SAMPLE_BUS_SLOT_STRIDE(slot_size) + sizeof(uint16_t)) * (slot_count))
+
+int32_t sampleBus_init(sample_bus_t *_psBus, uint8_t *_pu8Buffer, size_t _tBufferSize, uint16_t _u16SlotSize);
+uint8_t* sampleBus_claim(sample_bus_t *_psBus);
+void sampleBus_publish(sample_bus_t *_psBus, uint16_t _u16Size);
+int32_t sampleBus_write(sample_bus_t *_psBus, const uint8_t *_pu8Message, uint16_t _u16Size);
+
+int32_t sampleBus_subscribe(sample_bus_t *_psBus, sample_bus_subscriber_t *_psSubscriber);
+int32_t sampleBus_peek(sample_bus_subscriber_t *_psSubscriber, const uint8_t **_ppu8Message, uint16_t *_pu16Size);
+int32_t sampleBus_release(sample_bus_subscriber_t *_psSubscriber);
+
+#endif /* _SAMPLE_BUS_H_ */
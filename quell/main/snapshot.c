@@ -0,0 +1,114 @@
+#include "snapshot.h"
+#include "quell.h"
+
+/* _pvBuffers holds 2 structures of _u16Size bytes */
+int32_t snapshot_init(snapshot_t *_psSnapshot, void *_pvBuffers, uint16_t _u16Size)
+{
+    if(_psSnapshot == NULL || _pvBuffers == NULL || _u16Size == 0)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psSnapshot->apu8Buffers[0] = (uint8_t*)_pvBuffers;
+    _psSnapshot->apu8Buffers[1] = &((uint8_t*)_pvBuffers)[_u16Size];
+    _psSnapshot->u16Size = _u16Size;
+    _psSnapshot->au32Sequence[0] = 0;
+    _psSnapshot->au32Sequence[1] = 0;
+    _psSnapshot->u32Published = 0;
+
+    return QUELL_OK;
+}
+
+/* Buffer for the next structure, the writer fills it in place (all of it) and then publishes it */
+void* snapshot_claim(snapshot_t *_psSnapshot)
+{
+    uint32_t u32Buffer;
+
+    if(_psSnapshot == NULL)
+    {
+        return NULL;
+    }
+
+    /* Odd before any byte of the buffer changes, a reader still in it from two structures ago sees it at the end */
+    u32Buffer = _psSnapshot->u32Published & 1;
+    __atomic_store_n(&_psSnapshot->au32Sequence[u32Buffer], _psSnapshot->au32Sequence[u32Buffer] | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    return _psSnapshot->apu8Buffers[u32Buffer];
+}
+
+void snapshot_publish(snapshot_t *_psSnapshot)
+{
+    uint32_t u32Buffer;
+
+    if(_psSnapshot == NULL)
+    {
+        return;
+    }
+
+    u32Buffer = _psSnapshot->u32Published & 1;
+    __atomic_store_n(&_psSnapshot->au32Sequence[u32Buffer], _psSnapshot->au32Sequence[u32Buffer] + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&_psSnapshot->u32Published, _psSnapshot->u32Published + 1, __ATOMIC_RELEASE);
+}
+
+int32_t snapshot_write(snapshot_t *_psSnapshot, const void *_pvData)
+{
+    void *pvBuffer;
+
+    if(_psSnapshot == NULL || _pvData == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    pvBuffer = snapshot_claim(_psSnapshot);
+    memcpy(pvBuffer, _pvData, _psSnapshot->u16Size);
+    snapshot_publish(_psSnapshot);
+
+    return QUELL_OK;
+}
+
+/* Copies the first _u16Size bytes of the newest structure, QUELL_ERROR when none was published yet (or the writer kept overtaking) */
+int32_t snapshot_read(const snapshot_t *_psSnapshot, void *_pvData, uint16_t _u16Size, uint32_t *_pu32Retries)
+{
+    uint32_t u32Published;
+    uint32_t u32Buffer;
+    uint32_t u32Before;
+    uint32_t u32After;
+
+    if(_psSnapshot == NULL || _pvData == NULL || _u16Size > _psSnapshot->u16Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint32_t u32Try = 0; u32Try <= SNAPSHOT_MAX_RETRIES; u32Try++)
+    {
+        if(_pu32Retries != NULL && u32Try > 0)
+        {
+            (*_pu32Retries)++;
+        }
+
+        u32Published = __atomic_load_n(&_psSnapshot->u32Published, __ATOMIC_ACQUIRE);
+        if(u32Published == 0)
+        {
+            return QUELL_ERROR;
+        }
+        u32Buffer = (u32Published - 1) & 1;
+        u32Before = __atomic_load_n(&_psSnapshot->au32Sequence[u32Buffer], __ATOMIC_ACQUIRE);
+        if((u32Before & 1) != 0)
+        {
+            continue;
+        }
+
+        memcpy(_pvData, _psSnapshot->apu8Buffers[u32Buffer], _u16Size);
+
+        /* The copy is done before the sequence is looked at again */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        u32After = __atomic_load_n(&_psSnapshot->au32Sequence[u32Buffer], __ATOMIC_RELAXED);
+        if(u32After == u32Before)
+        {
+            return QUELL_OK;
+        }
+    }
+
+    return QUELL_ERROR;
+}
@@ -0,0 +1,39 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+    SNAPSHOT (seqlock over two buffers)
+
+    One writer publishes a whole structure at a time (claim, fill, publish) for readers on any task or
+    core, without a lock on either side. The writer fills the buffer the readers are not pointed at and
+    then points them at it, so it never waits. Each buffer has a sequence number, odd while the writer is
+    in it: a reader copies the published buffer and takes the copy if the sequence number was even and
+    the same before and after. A reader only retries when the writer came round to its buffer during the
+    copy, that is after publishing twice, and then it gets the newer structure. It gives up after
+    SNAPSHOT_MAX_RETRIES (a writer publishing faster than a copy, not expected of the windows).
+
+    Readers may copy a prefix of the structure only (its newest part first, say), consistent all the same.
+*/
+
+#define SNAPSHOT_MAX_RETRIES (16)
+
+typedef struct
+{
+    uint8_t *apu8Buffers[2];
+    uint16_t u16Size;
+    volatile uint32_t au32Sequence[2];  //Of every buffer, odd while written
+    volatile uint32_t u32Published;     //Structures published, the newest is in apu8Buffers[(u32Published - 1) & 1]
+}snapshot_t;
+
+int32_t snapshot_init(snapshot_t *_psSnapshot, void *_pvBuffers, uint16_t _u16Size);
+void* snapshot_claim(snapshot_t *_psSnapshot);
+void snapshot_publish(snapshot_t *_psSnapshot);
+int32_t snapshot_write(snapshot_t *_psSnapshot, const void *_pvData);
+int32_t snapshot_read(const snapshot_t *_psSnapshot, void *_pvData, uint16_t _u16Size, uint32_t *_pu32Retries);
+
+#endif /* _SNAPSHOT_H_ */
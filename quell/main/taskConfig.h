@@ -0,0 +1,77 @@
+#ifndef _TASK_CONFIG_H_
+#define _TASK_CONFIG_H_
+
+#include "freertos/FreeRTOS.h"
+
+/*
+    TASK TOPOLOGY
+
+    TASK:                   CORE:               PRIORITY:       DESCRIPTION:
+    protocol_io_task        PRO (0)             High            UART1 Rx/Tx servicing, never parses
+    protocol_task           APP (1)             Medium          Packet parsing, acknowledgement
+    imu_task                APP (1)             Medium-Low      Orientation filters of the received IMU samples
+    log_task                APP (1)             Low             Flash log writes and erases (blocks on the flash)
+    terminal_task           APP (1)             Low             Debug terminal on UART0
+
+    Every task blocks (uart event queue or task notification), so the idle tasks still run and
+    the task watchdog is kept happy even with priorities above tskIDLE_PRIORITY.
+    Any value can be overridden from the compiler command line (-DPROTOCOL_IO_TASK_CORE=1, ...).
+    Use tskNO_AFFINITY as the core to let the scheduler pick.
+*/
+
+#ifndef PROTOCOL_IO_TASK_CORE
+#define PROTOCOL_IO_TASK_CORE (0)
+#endif
+#ifndef PROTOCOL_IO_TASK_PRIORITY
+#define PROTOCOL_IO_TASK_PRIORITY (10)
+#endif
+#ifndef PROTOCOL_IO_TASK_STACK_SIZE
+#define PROTOCOL_IO_TASK_STACK_SIZE (3072)
+#endif
+
+#ifndef PROTOCOL_TASK_CORE
+#define PROTOCOL_TASK_CORE (1)
+#endif
+#ifndef PROTOCOL_TASK_PRIORITY
+#define PROTOCOL_TASK_PRIORITY (5)
+#endif
+#ifndef PROTOCOL_TASK_STACK_SIZE
+#define PROTOCOL_TASK_STACK_SIZE (4096)
+#endif
+
+#ifndef IMU_TASK_CORE
+#define IMU_TASK_CORE (1)
+#endif
+#ifndef IMU_TASK_PRIORITY
+#define IMU_TASK_PRIORITY (3)
+#endif
+#ifndef IMU_TASK_STACK_SIZE
+#define IMU_TASK_STACK_SIZE (3072)
+#endif
+
+#ifndef LOG_TASK_CORE
+#define LOG_TASK_CORE (1)
+#endif
+#ifndef LOG_TASK_PRIORITY
+#define LOG_TASK_PRIORITY (2)
+#endif
+#ifndef LOG_TASK_STACK_SIZE
+#define LOG_TASK_STACK_SIZE (3072)
+#endif
+
+#ifndef TERMINAL_TASK_CORE
+#define TERMINAL_TASK_CORE (1)
+#endif
+#ifndef TERMINAL_TASK_PRIORITY
+#define TERMINAL_TASK_PRIORITY (1)
+#endif
+#ifndef TERMINAL_TASK_STACK_SIZE
+#define TERMINAL_TASK_STACK_SIZE (4096)
+#endif
+
+/* Maximum time a task sleeps waiting for uart events or notifications before polling again */
+#ifndef TASK_POLL_TICKS
+#define TASK_POLL_TICKS (1)
+#endif
+
+#endif /* _TASK_CONFIG_H_ */
@@ -0,0 +1,228 @@
+/*
+    SAMPLE BUS BENCHMARK (host tool)
+
+    One producer thread publishes IMU sized messages on the sample bus (main/sampleBus.c) while 0 to N
+    consumer threads read them, each at its own pace. Reports the producer cost per message (thread CPU
+    time, so it does not depend on how the threads share the cores), and for the consumers the messages
+    received, dropped, and any message accepted by release with torn content (must be 0). The producer
+    publishes in batches (a sensor read) and yields between them, only the batches are timed.
+
+    Build (from quell/tools/bus):
+    gcc -O2 -Wall -pthread -I../../main -o busBench busBench.c ../../main/sampleBus.c
+
+    Usage:
+    busBench [-n messages] [-c max consumers] [-s slots] [-b batch] [-d consumer delay ns]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "quell.h"
+#include "sampleBus.h"
+
+#define BENCH_MESSAGE_WORDS (8)     //32 bytes, one IMU sample batch
+#define BENCH_MAX_CONSUMERS (16)
+
+typedef struct
+{
+    sample_bus_subscriber_t sSubscriber;
+    pthread_t tThread;
+    uint32_t u32DelayNs;
+    uint64_t u64Torn;
+    uint64_t u64OutOfOrder;
+}bench_consumer_t;
+
+static volatile int iProducerDone;
+static uint32_t u32Messages = 2000000;
+static uint32_t u32Batch = 64;
+
+static uint64_t benchNs(clockid_t _tClock)
+{
+    struct timespec sTime;
+    clock_gettime(_tClock, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+static void benchSpin(uint32_t _u32Ns)
+{
+    uint64_t u64End = benchNs(CLOCK_MONOTONIC) + _u32Ns;
+    while(benchNs(CLOCK_MONOTONIC) < u64End);
+}
+
+static void* benchConsumer(void *_pvArgument)
+{
+    bench_consumer_t *psConsumer = (bench_consumer_t*)_pvArgument;
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    uint32_t au32Copy[BENCH_MESSAGE_WORDS];
+    uint32_t u32Last = 0;
+    int iFirst = 1;
+
+    for(;;)
+    {
+        if(sampleBus_peek(&psConsumer->sSubscriber, &pu8Message, &u16Size) == QUELL_ERROR)
+        {
+            if(iProducerDone)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        /* Use the message in place (here: copy it out, as a consumer doing real work would read it) */
+        memcpy(au32Copy, pu8Message, sizeof(au32Copy));
+        if(psConsumer->u32DelayNs > 0)
+        {
+            benchSpin(psConsumer->u32DelayNs);
+        }
+
+        if(sampleBus_release(&psConsumer->sSubscriber) == QUELL_ERROR)
+        {
+            continue;
+        }
+
+        /* Every word carries the sequence, a release that let a half written slot through shows here */
+        for(int iWord = 1; iWord < BENCH_MESSAGE_WORDS; iWord++)
+        {
+            if(au32Copy[iWord] != au32Copy[0])
+            {
+                psConsumer->u64Torn++;
+                break;
+            }
+        }
+        if(!iFirst && au32Copy[0] <= u32Last)
+        {
+            psConsumer->u64OutOfOrder++;
+        }
+        u32Last = au32Copy[0];
+        iFirst = 0;
+    }
+
+    return NULL;
+}
+
+static void benchRun(uint8_t *_pu8Buffer, size_t _tBufferSize, int _iConsumers, uint32_t _u32DelayNs)
+{
+    sample_bus_t sBus;
+    bench_consumer_t asConsumer[BENCH_MAX_CONSUMERS];
+    uint64_t u64CPUStart;
+    uint64_t u64CPU;
+    uint64_t u64WallStart;
+    uint64_t u64Wall;
+    uint64_t u64Received = 0;
+    uint64_t u64Dropped = 0;
+    uint64_t u64Torn = 0;
+    uint64_t u64OutOfOrder = 0;
+
+    sampleBus_init(&sBus, _pu8Buffer, _tBufferSize, BENCH_MESSAGE_WORDS * sizeof(uint32_t));
+    iProducerDone = 0;
+
+    memset(asConsumer, 0, sizeof(asConsumer));
+    for(int iConsumer = 0; iConsumer < _iConsumers; iConsumer++)
+    {
+        /* Every other consumer is a slow one */
+        asConsumer[iConsumer].u32DelayNs = (iConsumer % 2) ? _u32DelayNs : 0;
+        sampleBus_subscribe(&sBus, &asConsumer[iConsumer].sSubscriber);
+        pthread_create(&asConsumer[iConsumer].tThread, NULL, benchConsumer, &asConsumer[iConsumer]);
+    }
+
+    u64CPU = 0;
+    u64WallStart = benchNs(CLOCK_MONOTONIC);
+    for(uint32_t u32Sequence = 1; u32Sequence <= u32Messages; )
+    {
+        u64CPUStart = benchNs(CLOCK_THREAD_CPUTIME_ID);
+        for(uint32_t u32Index = 0; u32Index < u32Batch && u32Sequence <= u32Messages; u32Index++, u32Sequence++)
+        {
+            uint32_t *pu32Slot = (uint32_t*)sampleBus_claim(&sBus);
+            for(int iWord = 0; iWord < BENCH_MESSAGE_WORDS; iWord++)
+            {
+                pu32Slot[iWord] = u32Sequence;
+            }
+            sampleBus_publish(&sBus, BENCH_MESSAGE_WORDS * sizeof(uint32_t));
+        }
+        u64CPU += benchNs(CLOCK_THREAD_CPUTIME_ID) - u64CPUStart;
+
+        /* Next sensor read */
+        sched_yield();
+    }
+    u64Wall = benchNs(CLOCK_MONOTONIC) - u64WallStart;
+    iProducerDone = 1;
+
+    for(int iConsumer = 0; iConsumer < _iConsumers; iConsumer++)
+    {
+        pthread_join(asConsumer[iConsumer].tThread, NULL);
+        u64Received += asConsumer[iConsumer].sSubscriber.u32Received;
+        u64Dropped += asConsumer[iConsumer].sSubscriber.u32Dropped;
+        u64Torn += asConsumer[iConsumer].u64Torn;
+        u64OutOfOrder += asConsumer[iConsumer].u64OutOfOrder;
+    }
+
+    printf("%-10d %-14.2f %-14.2f %-14.1f %-14.1f %-8llu %llu\n", _iConsumers,
+           (double)u64CPU / u32Messages, (double)u64Wall / u32Messages,
+           (_iConsumers > 0) ? (100.0 * u64Received) / ((double)u32Messages * _iConsumers) : 0.0,
+           (_iConsumers > 0) ? (100.0 * u64Dropped) / ((double)u32Messages * _iConsumers) : 0.0,
+           (unsigned long long)u64Torn, (unsigned long long)u64OutOfOrder);
+}
+
+int main(int argc, char **argv)
+{
+    int iMaxConsumers = 8;
+    uint32_t u32Slots = 256;
+    uint32_t u32DelayNs = 200;
+    uint8_t *pu8Buffer;
+    size_t tBufferSize;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "n:c:s:b:d:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'n':
+                u32Messages = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                iMaxConsumers = atoi(optarg);
+                break;
+            case 's':
+                u32Slots = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                u32Batch = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                u32DelayNs = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n messages] [-c max consumers] [-s slots] [-b batch] [-d consumer delay ns]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(iMaxConsumers < 0 || iMaxConsumers > BENCH_MAX_CONSUMERS || u32Messages == 0 || u32Batch == 0)
+    {
+        fprintf(stderr, "consumers 0..%d, messages and batch > 0\n", BENCH_MAX_CONSUMERS);
+        return 1;
+    }
+
+    tBufferSize = SAMPLE_BUS_BUFFER_SIZE(BENCH_MESSAGE_WORDS * sizeof(uint32_t), u32Slots);
+    pu8Buffer = aligned_alloc(64, (tBufferSize + 63) & ~(size_t)63);
+    if(pu8Buffer == NULL)
+    {
+        return 1;
+    }
+
+    printf("%u messages of %zu bytes in batches of %u, %u slots, slow consumers spend %u ns per message, %ld cpus\n",
+           u32Messages, BENCH_MESSAGE_WORDS * sizeof(uint32_t), u32Batch, u32Slots, u32DelayNs, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-10s %-14s %-14s %-14s %-14s %-8s %s\n", "consumers", "producer cpu", "producer wall", "received %", "dropped %", "torn", "reordered");
+    for(int iConsumers = 0; iConsumers <= iMaxConsumers; iConsumers = (iConsumers == 0) ? 1 : iConsumers * 2)
+    {
+        benchRun(pu8Buffer, tBufferSize, iConsumers, u32DelayNs);
+    }
+
+    free(pu8Buffer);
+    return 0;
+}
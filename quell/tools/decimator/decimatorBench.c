@@ -0,0 +1,402 @@
+/*
+    DECIMATOR BENCHMARK AND FREQUENCY RESPONSE TESTS (host tool)
+
+    For every decimator type (main/decimator.c) and factor, and for the FIR resampling by a fraction
+    (the rates the congestion control steps through, congestion.h):
+    - cost per input sample of the 6 IMU channels (ns and, on x86, TSC cycles);
+    - frequency response of the fixed point filter, measured by driving two channels with a cosine and a
+      sine of the same frequency (the magnitude of the output pair is the gain, whatever frequency it
+      folds to), swept from DC to the input Nyquist.
+    - a filter replacing another on a running stream (decimator_prime, the swaps of the congestion
+      control): on a slow cosine its outputs have to be those of the same filter run all along, when the
+      one before was a FIR holding at least as many inputs, and a constant has to come out unchanged from
+      the first output whatever came before.
+    The measured response has to follow the designed one (the Q15 taps for the FIR, the sinc^3 of the
+    CIC) and meet the limits below; any failure makes the exit status 1.
+
+    Build (from quell/tools/decimator):
+    gcc -O2 -Wall -I../host -I../../main -o decimatorBench decimatorBench.c ../../main/decimator.c -lm
+
+    Usage:
+    decimatorBench [-f factor] [-v]     (-f only that factor, -v print every frequency)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+#include "quell.h"
+#include "decimator.h"
+
+#define BENCH_CHANNELS (6)
+#define BENCH_TIMING_INPUTS (2000000UL)
+#define BENCH_FREQUENCIES (400)         //Sweep points from DC to the input Nyquist
+#define BENCH_OUTPUTS (512)             //Measured outputs per frequency, after the filter settled
+#define BENCH_AMPLITUDE (16000.0)
+#define BENCH_SWAP_INPUTS (2048)        //Through the filter replaced, a multiple of every factor
+#define BENCH_SWAP_OUTPUTS (64)         //Compared after the swap
+#define BENCH_SWAP_FREQUENCY (0.005)    //Input sample rates, in the passband of every filter
+
+/* Limits, frequencies in output sample rates */
+#define BENCH_MATCH_DB (0.05)           //Measured against designed, plus BENCH_MATCH_LSB of output rounding
+#define BENCH_MATCH_LSB (1.0)
+#define BENCH_FIR_PASSBAND (0.2)
+#define BENCH_FIR_RIPPLE_DB (0.1)
+#define BENCH_FIR_STOPBAND_DB (-50.0)   //From the output Nyquist on
+#define BENCH_CIC_NULL_DB (-60.0)       //Designed gain this low (around the multiples of the output rate) must be measured below BENCH_CIC_NULL_MEASURED_DB
+#define BENCH_CIC_NULL_MEASURED_DB (-50.0)
+
+static const uint8_t au8Factors[] = {2, 4, 8, 16};
+static const uint8_t aau8Fractions[][2] = {{3, 4}, {5, 8}, {13, 16}, {15, 16}};    //Up, factor
+static const char *apcTypeName[DECIMATOR_TYPE_COUNT] = {"off", "fir", "cic"};
+static const uint8_t aau8Swaps[][6] = {    //Type, up and factor replaced, then of the replacement
+    {DECIMATOR_FIR, 1, 16, DECIMATOR_FIR, 13, 16}, {DECIMATOR_FIR, 5, 8, DECIMATOR_FIR, 3, 4}, {DECIMATOR_FIR, 1, 4, DECIMATOR_FIR, 1, 2},
+    {DECIMATOR_FIR, 15, 16, DECIMATOR_FIR, 13, 16}, {DECIMATOR_FIR, 1, 2, DECIMATOR_FIR, 1, 4}, {DECIMATOR_OFF, 1, 1, DECIMATOR_FIR, 15, 16},
+    {DECIMATOR_FIR, 1, 2, DECIMATOR_CIC, 1, 4}, {DECIMATOR_CIC, 1, 4, DECIMATOR_FIR, 1, 2}};
+
+static uint64_t benchNowNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+/* Gain the filter was designed for, at _dFrequency input sample rates (resampling, the outputs take the branches in turn: their average) */
+static double benchDesigned(const decimator_t *_psDecimator, double _dFrequency)
+{
+    if(_psDecimator->eType == DECIMATOR_FIR)
+    {
+        double dGain = 0.0;
+
+        for(uint8_t u8Branch = 0; u8Branch < _psDecimator->u8Up; u8Branch++)
+        {
+            const int16_t *pi16Branch = &_psDecimator->ai16Coefficients[u8Branch * _psDecimator->u16Taps];
+            double dReal = 0.0;
+            double dImaginary = 0.0;
+
+            for(uint16_t u16Tap = 0; u16Tap < _psDecimator->u16Taps; u16Tap++)
+            {
+                dReal += pi16Branch[u16Tap] * cos(2.0 * M_PI * _dFrequency * u16Tap) / 32768.0;
+                dImaginary -= pi16Branch[u16Tap] * sin(2.0 * M_PI * _dFrequency * u16Tap) / 32768.0;
+            }
+            dGain += sqrt((dReal * dReal) + (dImaginary * dImaginary));
+        }
+        return dGain / _psDecimator->u8Up;
+    }
+
+    if(_dFrequency == 0.0)
+    {
+        return 1.0;
+    }
+    return pow(fabs(sin(M_PI * _dFrequency * _psDecimator->u8Factor) / (_psDecimator->u8Factor * sin(M_PI * _dFrequency))), DECIMATOR_CIC_ORDER);
+}
+
+static double benchMeasure(decimator_t *_psDecimator, decimator_type_t _eType, uint8_t _u8Up, uint8_t _u8Factor, double _dFrequency)
+{
+    uint32_t u32Settle = (DECIMATOR_TAPS_PER_PHASE + DECIMATOR_CIC_ORDER + 2);
+    int16_t ai16Input[BENCH_CHANNELS] = {0};
+    int16_t ai16Output[BENCH_CHANNELS];
+    double dSum = 0.0;
+    uint32_t u32Outputs = 0;
+
+    decimator_initRational(_psDecimator, _eType, _u8Up, _u8Factor, BENCH_CHANNELS);
+    for(uint64_t u64Input = 0; u32Outputs < u32Settle + BENCH_OUTPUTS; u64Input++)
+    {
+        double dPhase = 2.0 * M_PI * fmod(_dFrequency * u64Input, 1.0);
+
+        ai16Input[0] = (int16_t)lround(BENCH_AMPLITUDE * cos(dPhase));
+        ai16Input[1] = (int16_t)lround(BENCH_AMPLITUDE * sin(dPhase));
+        if(decimator_process(_psDecimator, ai16Input, ai16Output) == true)
+        {
+            if(u32Outputs >= u32Settle)
+            {
+                dSum += sqrt(((double)ai16Output[0] * ai16Output[0]) + ((double)ai16Output[1] * ai16Output[1]));
+            }
+            u32Outputs++;
+        }
+    }
+
+    return dSum / BENCH_OUTPUTS / BENCH_AMPLITUDE;
+}
+
+/* x<factor>, or up/factor resampling */
+static const char* benchRatio(uint8_t _u8Up, uint8_t _u8Factor)
+{
+    static char acRatio[8];
+
+    if(_u8Up == 1)
+    {
+        snprintf(acRatio, sizeof(acRatio), "x%u", _u8Factor);
+    }
+    else
+    {
+        snprintf(acRatio, sizeof(acRatio), "%u/%u", _u8Up, _u8Factor);
+    }
+    return acRatio;
+}
+
+static double benchDb(double _dGain)
+{
+    return 20.0 * log10((_dGain > 1e-9) ? _dGain : 1e-9);
+}
+
+static uint32_t benchResponse(decimator_type_t _eType, uint8_t _u8Up, uint8_t _u8Factor, bool _bVerbose)
+{
+    static decimator_t sDecimator;
+    double dDown = (double)_u8Factor / _u8Up;
+    uint32_t u32Failures = 0;
+    double dWorstMatch = 0.0;
+    double dRippleMax = -1e9;
+    double dRippleMin = 1e9;
+    double dStopband = -1e9;
+    double dAtEdge = 0.0;
+    double dAtNyquist = 0.0;
+
+    for(uint32_t u32Point = 0; u32Point <= BENCH_FREQUENCIES; u32Point++)
+    {
+        double dFrequency = 0.5 * u32Point / BENCH_FREQUENCIES;     //Input sample rates
+        double dOutputRates = dFrequency * dDown;
+        double dGain = benchMeasure(&sDecimator, _eType, _u8Up, _u8Factor, dFrequency);
+        double dDesignedGain = benchDesigned(&sDecimator, dFrequency);
+        double dMeasured = benchDb(dGain);
+        double dDesigned = benchDb(dDesignedGain);
+        bool bFail = false;
+
+        /* Small outputs are mostly rounding, so the tolerance is relative plus an absolute LSB */
+        if(fabs(dGain - dDesignedGain) > (dDesignedGain * (pow(10.0, BENCH_MATCH_DB / 20.0) - 1.0)) + (BENCH_MATCH_LSB / BENCH_AMPLITUDE))
+        {
+            bFail = true;
+        }
+        if(dDesigned > -40.0)
+        {
+            dWorstMatch = fmax(dWorstMatch, fabs(dMeasured - dDesigned));
+        }
+
+        if(_eType == DECIMATOR_FIR && dOutputRates <= BENCH_FIR_PASSBAND)
+        {
+            dRippleMax = fmax(dRippleMax, dMeasured);
+            dRippleMin = fmin(dRippleMin, dMeasured);
+            bFail |= (fabs(dMeasured) > BENCH_FIR_RIPPLE_DB);
+        }
+        if(_eType == DECIMATOR_FIR && dOutputRates >= 0.5)
+        {
+            dStopband = fmax(dStopband, dMeasured);
+            bFail |= (dMeasured > BENCH_FIR_STOPBAND_DB);
+        }
+        if(_eType == DECIMATOR_CIC && dDesigned < BENCH_CIC_NULL_DB)
+        {
+            bFail |= (dMeasured > BENCH_CIC_NULL_MEASURED_DB);
+        }
+
+        if(fabs(dOutputRates - BENCH_FIR_PASSBAND) < (0.25 / BENCH_FREQUENCIES * dDown))
+        {
+            dAtEdge = dMeasured;
+        }
+        if(fabs(dOutputRates - 0.5) < (0.25 / BENCH_FREQUENCIES * dDown))
+        {
+            dAtNyquist = dMeasured;
+        }
+
+        if(_bVerbose == true || bFail == true)
+        {
+            printf("    %s f=%.4f fs (%.3f out) measured %8.3f dB designed %8.3f dB\n", (bFail == true) ? "FAIL" : "    ", dFrequency, dOutputRates, dMeasured, dDesigned);
+        }
+        u32Failures += (bFail == true) ? 1 : 0;
+    }
+
+    printf("  %s %-5s %3u taps  match %.4f dB (above -40 dB)  0.2 out %7.2f dB  Nyquist out %7.2f dB", apcTypeName[_eType], benchRatio(_u8Up, _u8Factor),
+           sDecimator.u8Up * sDecimator.u16Taps, dWorstMatch, dAtEdge, dAtNyquist);
+    if(_eType == DECIMATOR_FIR)
+    {
+        printf("  ripple %+.3f/%+.3f dB  stopband %.1f dB", dRippleMin, dRippleMax, dStopband);
+    }
+    printf("  %s\n", (u32Failures == 0) ? "PASS" : "FAIL");
+
+    return u32Failures;
+}
+
+/* Largest difference after the swap, against the replacement run all along on the cosine (_bConstant false) or against the constant */
+static int32_t benchSwapRun(const uint8_t *_pu8Swap, bool _bConstant, bool *_pbCarried)
+{
+    static decimator_t sFrom;
+    static decimator_t sTo;
+    static decimator_t sReference;
+    int16_t ai16Input[BENCH_CHANNELS] = {0};
+    int16_t ai16Output[BENCH_CHANNELS];
+    int16_t ai16Reference[BENCH_CHANNELS];
+    int32_t i32Worst = 0;
+    uint32_t u32Outputs = 0;
+
+    decimator_initRational(&sFrom, (decimator_type_t)_pu8Swap[0], _pu8Swap[1], _pu8Swap[2], BENCH_CHANNELS);
+    decimator_initRational(&sTo, (decimator_type_t)_pu8Swap[3], _pu8Swap[4], _pu8Swap[5], BENCH_CHANNELS);
+    decimator_initRational(&sReference, (decimator_type_t)_pu8Swap[3], _pu8Swap[4], _pu8Swap[5], BENCH_CHANNELS);
+    *_pbCarried = (sFrom.eType == DECIMATOR_FIR && sTo.eType == DECIMATOR_FIR && sFrom.u16Taps >= sTo.u16Taps);
+
+    for(uint32_t u32Input = 0; u32Outputs < BENCH_SWAP_OUTPUTS; u32Input++)
+    {
+        for(uint8_t u8Channel = 0; u8Channel < BENCH_CHANNELS; u8Channel++)
+        {
+            ai16Input[u8Channel] = (int16_t)((_bConstant == true) ? BENCH_AMPLITUDE :
+                                             lround(BENCH_AMPLITUDE * cos((2.0 * M_PI * BENCH_SWAP_FREQUENCY * u32Input) + u8Channel)));
+        }
+
+        /* Both run in step from the swap on: it falls where the reference starts a phase again */
+        if(u32Input < BENCH_SWAP_INPUTS)
+        {
+            decimator_process(&sFrom, ai16Input, ai16Output);
+            decimator_process(&sReference, ai16Input, ai16Reference);
+            continue;
+        }
+        if(u32Input == BENCH_SWAP_INPUTS)
+        {
+            decimator_prime(&sTo, &sFrom, ai16Input);
+        }
+        decimator_process(&sReference, ai16Input, ai16Reference);
+        if(decimator_process(&sTo, ai16Input, ai16Output) == true)
+        {
+            for(uint8_t u8Channel = 0; u8Channel < BENCH_CHANNELS; u8Channel++)
+            {
+                int32_t i32Error = abs((int32_t)ai16Output[u8Channel] - ((_bConstant == true) ? (int32_t)BENCH_AMPLITUDE : ai16Reference[u8Channel]));
+
+                i32Worst = (i32Error > i32Worst) ? i32Error : i32Worst;
+            }
+            u32Outputs++;
+        }
+    }
+
+    return i32Worst;
+}
+
+static uint32_t benchSwap(const uint8_t *_pu8Swap)
+{
+    bool bCarried;
+    int32_t i32Cosine = benchSwapRun(_pu8Swap, false, &bCarried);
+    int32_t i32Constant = benchSwapRun(_pu8Swap, true, &bCarried);
+    bool bPass = (i32Constant <= 1 && (bCarried == false || i32Cosine == 0));
+
+    printf("  %s %-5s -> ", apcTypeName[_pu8Swap[0]], benchRatio(_pu8Swap[1], _pu8Swap[2]));
+    printf("%s %-5s  cosine %5d LSB off the reference%s  constant %d LSB off  %s\n", apcTypeName[_pu8Swap[3]], benchRatio(_pu8Swap[4], _pu8Swap[5]),
+           i32Cosine, (bCarried == true) ? " (carried)" : "          ", i32Constant, (bPass == true) ? "ok" : "FAIL");
+
+    return (bPass == true) ? 0 : 1;
+}
+
+static void benchTiming(decimator_type_t _eType, uint8_t _u8Up, uint8_t _u8Factor)
+{
+    static decimator_t sDecimator;
+    static int16_t ai16Input[4096][BENCH_CHANNELS];
+    int16_t ai16Output[BENCH_CHANNELS];
+    volatile int32_t i32Sink = 0;
+    uint64_t u64Start;
+    uint64_t u64Cycles;
+    uint64_t u64Ns;
+
+    for(uint32_t u32Index = 0; u32Index < 4096; u32Index++)
+    {
+        for(uint8_t u8Channel = 0; u8Channel < BENCH_CHANNELS; u8Channel++)
+        {
+            ai16Input[u32Index][u8Channel] = (int16_t)(random() - 0x40000000L);
+        }
+    }
+
+    decimator_initRational(&sDecimator, _eType, _u8Up, _u8Factor, BENCH_CHANNELS);
+    u64Start = benchNowNs();
+    u64Cycles = BENCH_CYCLES();
+    for(uint32_t u32Input = 0; u32Input < BENCH_TIMING_INPUTS; u32Input++)
+    {
+        if(decimator_process(&sDecimator, ai16Input[u32Input % 4096], ai16Output) == true)
+        {
+            i32Sink += ai16Output[0];
+        }
+    }
+    u64Cycles = BENCH_CYCLES() - u64Cycles;
+    u64Ns = benchNowNs() - u64Start;
+
+    printf("  %s %-5s %7.1f ns/input %8.1f cycles/input (tsc) %6.1f cycles/channel\n", apcTypeName[_eType], benchRatio(_u8Up, _u8Factor),
+           (double)u64Ns / BENCH_TIMING_INPUTS, (double)u64Cycles / BENCH_TIMING_INPUTS, (double)u64Cycles / BENCH_TIMING_INPUTS / BENCH_CHANNELS);
+    (void)i32Sink;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t u8OnlyFactor = 0;
+    bool bVerbose = false;
+    uint32_t u32Failures = 0;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "f:v")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'f':
+                u8OnlyFactor = (uint8_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                bVerbose = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f factor] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("cost per input sample (%u channels)\n", BENCH_CHANNELS);
+    benchTiming(DECIMATOR_OFF, 1, 1);
+    for(decimator_type_t eType = DECIMATOR_FIR; eType < DECIMATOR_TYPE_COUNT; eType++)
+    {
+        for(uint8_t u8Index = 0; u8Index < sizeof(au8Factors); u8Index++)
+        {
+            if(u8OnlyFactor == 0 || u8OnlyFactor == au8Factors[u8Index])
+            {
+                benchTiming(eType, 1, au8Factors[u8Index]);
+            }
+        }
+    }
+    for(uint8_t u8Index = 0; u8Index < sizeof(aau8Fractions) / sizeof(aau8Fractions[0]); u8Index++)
+    {
+        if(u8OnlyFactor == 0 || u8OnlyFactor == aau8Fractions[u8Index][1])
+        {
+            benchTiming(DECIMATOR_FIR, aau8Fractions[u8Index][0], aau8Fractions[u8Index][1]);
+        }
+    }
+
+    printf("frequency response (%u points from DC to the input Nyquist)\n", BENCH_FREQUENCIES + 1);
+    for(decimator_type_t eType = DECIMATOR_FIR; eType < DECIMATOR_TYPE_COUNT; eType++)
+    {
+        for(uint8_t u8Index = 0; u8Index < sizeof(au8Factors); u8Index++)
+        {
+            if(u8OnlyFactor == 0 || u8OnlyFactor == au8Factors[u8Index])
+            {
+                u32Failures += benchResponse(eType, 1, au8Factors[u8Index], bVerbose);
+            }
+        }
+    }
+    for(uint8_t u8Index = 0; u8Index < sizeof(aau8Fractions) / sizeof(aau8Fractions[0]); u8Index++)
+    {
+        if(u8OnlyFactor == 0 || u8OnlyFactor == aau8Fractions[u8Index][1])
+        {
+            u32Failures += benchResponse(DECIMATOR_FIR, aau8Fractions[u8Index][0], aau8Fractions[u8Index][1], bVerbose);
+        }
+    }
+
+    printf("filter swaps (%u inputs through the first, %u outputs of the second compared)\n", BENCH_SWAP_INPUTS, BENCH_SWAP_OUTPUTS);
+    for(uint8_t u8Index = 0; u8Index < sizeof(aau8Swaps) / sizeof(aau8Swaps[0]); u8Index++)
+    {
+        if(u8OnlyFactor == 0 || u8OnlyFactor == aau8Swaps[u8Index][5])
+        {
+            u32Failures += benchSwap(aau8Swaps[u8Index]);
+        }
+    }
+
+    printf("%s\n", (u32Failures == 0) ? "all tests passed" : "FAILED");
+
+    return (u32Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/*
+    FEC BENCHMARK (host tool)
+
+    Measures the cost of the link FEC (main/fec.c) and the frame loss it saves: every frame goes through
+    a binary symmetric channel at a given bit error rate, once as a plain packet (CRC16 only, any error
+    loses the frame) and once as a FEC frame (repaired before the CRC16 check).
+
+    Build (from quell/tools/fec):
+    gcc -O2 -Wall -I../host -I../../main -I../../main/ProtocolTask -o fecBench fecBench.c \
+        ../../main/fec.c ../../main/FIFO.c ../../main/crc.c ../../main/ProtocolTask/protocol.c ../../main/ProtocolTask/flowControl.c ../../main/ProtocolTask/tdma.c ../../main/ProtocolTask/router.c ../../main/ProtocolTask/linkBench.c ../../main/ProtocolTask/linkSpeed.c ../../main/ProtocolTask/channel.c ../../main/sampleBus.c ../../main/messages.c -lm
+
+    Usage:
+    fecBench [-m message bytes] [-n frames per bit error rate] [-s seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "quell.h"
+#include "fec.h"
+#include "protocol.h"
+
+#define BENCH_TIMING_ROUNDS (200000UL)
+
+static const double adBitErrorRate[] = {1e-6, 1e-5, 1e-4, 3e-4, 1e-3, 3e-3, 1e-2};
+
+typedef struct
+{
+    uint64_t u64Lost;           //Frames not delivered
+    uint64_t u64Undetected;     //Frames delivered with wrong content
+    uint64_t u64Corrupted;      //Frames that had at least one bit flipped
+}bench_result_t;
+
+static uint64_t benchNowNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+/* Uniform in (0, 1] */
+static double benchRandom(void)
+{
+    return ((double)(((uint64_t)random() << 31) | (uint64_t)random()) + 1.0) / 4611686018427387904.0;
+}
+
+/* Flips every bit with probability _dBER, jumping straight to the next error (geometric gaps) */
+static bool benchChannel(uint8_t *_pu8Data, uint16_t _u16Size, double _dBER)
+{
+    double dGap = log(benchRandom()) / log(1.0 - _dBER);
+    uint32_t u32Bits = (uint32_t)_u16Size * 8;
+    bool bCorrupted = false;
+
+    for(double dBit = floor(dGap); dBit < u32Bits; dBit += 1.0 + floor(log(benchRandom()) / log(1.0 - _dBER)))
+    {
+        uint32_t u32Bit = (uint32_t)dBit;
+        _pu8Data[u32Bit / 8] ^= 1U << (u32Bit % 8);
+        bCorrupted = true;
+    }
+
+    return bCorrupted;
+}
+
+static void benchTiming(const uint8_t *_pu8Packet, uint16_t _u16PacketSize)
+{
+    uint8_t au8Frame[FEC_ENCODED_SIZE(FEC_MAX_PACKET_SIZE)];
+    uint8_t au8Work[FEC_ENCODED_SIZE(FEC_MAX_PACKET_SIZE)];
+    uint16_t u16FrameSize = 0;
+    uint16_t u16PacketSize;
+    uint16_t u16Corrected;
+    uint64_t u64Start;
+    uint64_t u64Encode;
+    uint64_t u64Decode;
+    uint64_t u64Repair;
+    uint64_t u64CRC;
+    volatile uint32_t u32Sink = 0;
+
+    u64Start = benchNowNs();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        fec_encodeFrame(_pu8Packet, _u16PacketSize, au8Frame, sizeof(au8Frame), &u16FrameSize);
+        u32Sink += au8Frame[u32Round % u16FrameSize];
+    }
+    u64Encode = benchNowNs() - u64Start;
+
+    /* Clean frames only cost the syndromes */
+    u64Start = benchNowNs();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        memcpy(au8Work, au8Frame, u16FrameSize);
+        fec_decodeFrame(au8Work, u16FrameSize, &u16PacketSize, &u16Corrected);
+        u32Sink += au8Work[0];
+    }
+    u64Decode = benchNowNs() - u64Start;
+
+    /* Worst case that still repairs: two wrong bytes in every block */
+    u64Start = benchNowNs();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        memcpy(au8Work, au8Frame, u16FrameSize);
+        for(uint16_t u16Offset = FEC_HEADER_SIZE; u16Offset + 1 < u16FrameSize; u16Offset += FEC_BLOCK_SIZE + FEC_PARITY_SIZE)
+        {
+            au8Work[u16Offset] ^= 0x5A;
+            au8Work[u16Offset + 1] ^= 0xA5;
+        }
+        fec_decodeFrame(au8Work, u16FrameSize, &u16PacketSize, &u16Corrected);
+        u32Sink += au8Work[0];
+    }
+    u64Repair = benchNowNs() - u64Start;
+
+    /* Reference: what the CRC16-only receiver already spends */
+    u64Start = benchNowNs();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        memcpy(au8Work, _pu8Packet, _u16PacketSize);
+        u32Sink += (uint32_t)verifyPacket(au8Work, _u16PacketSize);
+    }
+    u64CRC = benchNowNs() - u64Start;
+
+    printf("packet %u bytes, frame %u bytes (+%.1f%%)\n", _u16PacketSize, u16FrameSize, (100.0 * (u16FrameSize - _u16PacketSize)) / _u16PacketSize);
+    printf("  encode          %7.1f ns/frame %6.2f ns/byte\n", (double)u64Encode / BENCH_TIMING_ROUNDS, (double)u64Encode / BENCH_TIMING_ROUNDS / _u16PacketSize);
+    printf("  decode clean    %7.1f ns/frame %6.2f ns/byte\n", (double)u64Decode / BENCH_TIMING_ROUNDS, (double)u64Decode / BENCH_TIMING_ROUNDS / _u16PacketSize);
+    printf("  decode 2 err/bl %7.1f ns/frame %6.2f ns/byte\n", (double)u64Repair / BENCH_TIMING_ROUNDS, (double)u64Repair / BENCH_TIMING_ROUNDS / _u16PacketSize);
+    printf("  crc16 verify    %7.1f ns/frame %6.2f ns/byte\n", (double)u64CRC / BENCH_TIMING_ROUNDS, (double)u64CRC / BENCH_TIMING_ROUNDS / _u16PacketSize);
+    (void)u32Sink;
+}
+
+static void benchLoss(const uint8_t *_pu8Packet, uint16_t _u16PacketSize, uint32_t _u32Frames)
+{
+    uint8_t au8Frame[FEC_ENCODED_SIZE(FEC_MAX_PACKET_SIZE)];
+    uint8_t au8Work[FEC_ENCODED_SIZE(FEC_MAX_PACKET_SIZE)];
+    uint16_t u16FrameSize = 0;
+    uint16_t u16PacketSize;
+    uint16_t u16Corrected;
+
+    fec_encodeFrame(_pu8Packet, _u16PacketSize, au8Frame, sizeof(au8Frame), &u16FrameSize);
+
+    printf("\n%-8s %-12s %-12s %-12s %-12s %s\n", "BER", "crc loss", "crc undet", "fec loss", "fec undet", "gain");
+    for(size_t tRate = 0; tRate < sizeof(adBitErrorRate) / sizeof(adBitErrorRate[0]); tRate++)
+    {
+        bench_result_t sPlain = {0};
+        bench_result_t sFEC = {0};
+
+        for(uint32_t u32Frame = 0; u32Frame < _u32Frames; u32Frame++)
+        {
+            /* CRC16 only */
+            memcpy(au8Work, _pu8Packet, _u16PacketSize);
+            sPlain.u64Corrupted += benchChannel(au8Work, _u16PacketSize, adBitErrorRate[tRate]);
+            if(verifyPacket(au8Work, _u16PacketSize) == QUELL_ERROR)
+            {
+                sPlain.u64Lost++;
+            }
+            else if(memcmp(au8Work, _pu8Packet, _u16PacketSize) != 0)
+            {
+                sPlain.u64Undetected++;
+            }
+
+            /* FEC, then the same CRC16 check */
+            memcpy(au8Work, au8Frame, u16FrameSize);
+            sFEC.u64Corrupted += benchChannel(au8Work, u16FrameSize, adBitErrorRate[tRate]);
+            if(au8Work[0] != FEC_SOF ||
+               fec_decodeFrame(au8Work, u16FrameSize, &u16PacketSize, &u16Corrected) == QUELL_ERROR ||
+               u16PacketSize != _u16PacketSize || verifyPacket(au8Work, u16PacketSize) == QUELL_ERROR)
+            {
+                sFEC.u64Lost++;
+            }
+            else if(memcmp(au8Work, _pu8Packet, _u16PacketSize) != 0)
+            {
+                sFEC.u64Undetected++;
+            }
+        }
+
+        printf("%-8.0e %-12.3e %-12llu %-12.3e %-12llu %s%.0fx\n", adBitErrorRate[tRate],
+               (double)sPlain.u64Lost / _u32Frames, (unsigned long long)sPlain.u64Undetected,
+               (double)sFEC.u64Lost / _u32Frames, (unsigned long long)sFEC.u64Undetected,
+               (sFEC.u64Lost == 0) ? ">" : "",
+               (double)sPlain.u64Lost / ((sFEC.u64Lost > 0) ? sFEC.u64Lost : 1));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t u16MessageSize = 40;
+    uint32_t u32Frames = 200000;
+    unsigned int uiSeed = 1;
+    uint8_t au8Message[FEC_MAX_PACKET_SIZE];
+    uint8_t au8Packet[FEC_MAX_PACKET_SIZE];
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "m:n:s:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'm':
+                u16MessageSize = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                u32Frames = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                uiSeed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-m message bytes] [-n frames] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(u16MessageSize == 0 || PACKE_SIZE(u16MessageSize) > FEC_MAX_PACKET_SIZE || u32Frames == 0)
+    {
+        fprintf(stderr, "message size 1..%u, frames > 0\n", FEC_MAX_PACKET_SIZE - MINIMUM_PACKET_SIZE);
+        return 1;
+    }
+
+    srandom(uiSeed);
+    fec_init();
+
+    /* IMU-like payload */
+    for(uint16_t u16Index = 0; u16Index < u16MessageSize; u16Index++)
+    {
+        au8Message[u16Index] = (uint8_t)random();
+    }
+    makePacket(au8Packet, sizeof(au8Packet), au8Message, u16MessageSize);
+
+    benchTiming(au8Packet, PACKE_SIZE(u16MessageSize));
+    benchLoss(au8Packet, PACKE_SIZE(u16MessageSize), u32Frames);
+
+    return 0;
+}
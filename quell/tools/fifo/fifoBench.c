@@ -0,0 +1,280 @@
+/*
+    FIFO STRESS TEST (host tool)
+
+    A writer thread and a reader thread on two cores share one FIFO (main/FIFO.c) without a lock, as the
+    io and processing tasks of a link do, for -t milliseconds per FIFO size. The writer puts a known byte
+    sequence, byte by byte (FIFO_put) or in bursts published at once (FIFO_poke, FIFO_commit) within
+    FIFO_free. The reader takes it byte by byte (FIFO_get) and looks ahead (FIFO_peak) within FIFO_count.
+
+    Reports per FIFO size: the bytes through and the rate, the peeks, and the bytes out of sequence, the
+    peeks that got another byte than the one at their place and the counts or free spaces out of range.
+    Any of them, or nothing going through, makes the exit status 1. A byte read before it was written (an
+    index published ahead of the buffer, or a stale index) shows as out of sequence when the threads run
+    at the same time; on a single cpu they only interleave where the writer is preempted, so run the
+    thread sanitizer build too, it reports any access the acquire and release of the indices do not order.
+
+    Build (from quell/tools/fifo), and with the thread sanitizer:
+    gcc -O2 -Wall -pthread -I../host -I../../main -o fifoBench fifoBench.c ../../main/FIFO.c
+    gcc -O1 -g -fsanitize=thread -Wall -pthread -I../host -I../../main -o fifoBenchTsan fifoBench.c ../../main/FIFO.c
+
+    Usage:
+    fifoBench [-t milliseconds] [-s FIFO size]     (-s only that size)
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "FIFO.h"
+
+#define BENCH_SEQUENCE (251)            //Byte n is n modulo it, prime so it never lines up with the FIFO size
+#define BENCH_MAX_BURST (64)            //Bytes poked then committed at once
+#define BENCH_MAX_SIZE (65536)
+
+typedef struct
+{
+    fifo_t sFIFO;
+    int iDone;                      //Both flags atomic, so the thread sanitizer only looks at the FIFO
+    int iReaderReady;
+
+    /* Writer */
+    uint64_t u64Written;
+    uint64_t u64Bursts;
+    uint64_t u64BadFree;
+
+    /* Reader */
+    uint64_t u64Read;
+    uint64_t u64Peeks;
+    uint64_t u64Wrong;
+    uint64_t u64WrongPeeks;
+    uint64_t u64BadCount;
+}bench_run_t;
+
+static const size_t atSizes[] = {4, 129, 512, 4096};
+static uint32_t u32Milliseconds = 1000;
+
+static uint64_t benchNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+static void benchPin(int _iCpu)
+{
+    cpu_set_t sSet;
+    long lCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(lCpus < 2)
+    {
+        return;
+    }
+    CPU_ZERO(&sSet);
+    CPU_SET(_iCpu % lCpus, &sSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(sSet), &sSet);
+}
+
+static void* benchReader(void *_pvArgument)
+{
+    bench_run_t *psRun = (bench_run_t*)_pvArgument;
+    unsigned int uSeed = 2;
+    size_t tCount;
+    size_t tPosition;
+    char cData;
+
+    benchPin(1);
+    __atomic_store_n(&psRun->iReaderReady, 1, __ATOMIC_RELEASE);
+
+    /* Once the writer is done, whatever it published is taken too */
+    for(;;)
+    {
+        if(FIFO_count(&psRun->sFIFO, &tCount) == false || tCount >= psRun->sFIFO.size)
+        {
+            psRun->u64BadCount++;
+            continue;
+        }
+        if(tCount == 0)
+        {
+            if(__atomic_load_n(&psRun->iDone, __ATOMIC_ACQUIRE) != 0 && FIFO_count(&psRun->sFIFO, &tCount) == true && tCount == 0)
+            {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        if((rand_r(&uSeed) % 4) == 0)
+        {
+            tPosition = (size_t)rand_r(&uSeed) % tCount;
+            if(FIFO_peak(&psRun->sFIFO, tPosition, &cData) == true)
+            {
+                psRun->u64Peeks++;
+                psRun->u64WrongPeeks += ((uint8_t)cData != (psRun->u64Read + tPosition) % BENCH_SEQUENCE) ? 1 : 0;
+            }
+        }
+
+        while(FIFO_get(&psRun->sFIFO, &cData) == true)
+        {
+            if((uint8_t)cData != psRun->u64Read % BENCH_SEQUENCE)
+            {
+                psRun->u64Wrong++;
+            }
+            psRun->u64Read++;
+            if((rand_r(&uSeed) % 8) == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void benchWrite(bench_run_t *_psRun, unsigned int *_puSeed)
+{
+    size_t tFree;
+    size_t tBurst;
+
+    if(FIFO_free(&_psRun->sFIFO, &tFree) == false || tFree >= _psRun->sFIFO.size)
+    {
+        _psRun->u64BadFree++;
+        return;
+    }
+    if(tFree == 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    if((rand_r(_puSeed) % 2) == 0)
+    {
+        if(FIFO_put(&_psRun->sFIFO, (char)(_psRun->u64Written % BENCH_SEQUENCE)) == true)
+        {
+            _psRun->u64Written++;
+        }
+        return;
+    }
+
+    /* What FIFO_free said stays free, only the reader runs meanwhile */
+    tBurst = 1 + ((size_t)rand_r(_puSeed) % BENCH_MAX_BURST);
+    tBurst = (tBurst > tFree) ? tFree : tBurst;
+    for(size_t tIndex = 0; tIndex < tBurst; tIndex++)
+    {
+        FIFO_poke(&_psRun->sFIFO, tIndex, (char)((_psRun->u64Written + tIndex) % BENCH_SEQUENCE));
+    }
+    if(FIFO_commit(&_psRun->sFIFO, tBurst) == true)
+    {
+        _psRun->u64Written += tBurst;
+        _psRun->u64Bursts++;
+    }
+    else
+    {
+        _psRun->u64BadFree++;
+    }
+}
+
+static uint32_t benchRun(size_t _tSize)
+{
+    static char acBuffer[BENCH_MAX_SIZE];
+    bench_run_t sRun;
+    pthread_t tReader;
+    unsigned int uSeed = 1;
+    uint64_t u64Start;
+    uint64_t u64End;
+    double dSeconds;
+    uint32_t u32Failures = 0;
+
+    memset(&sRun, 0, sizeof(sRun));
+    FIFO_init(&sRun.sFIFO, acBuffer, _tSize);
+
+    pthread_create(&tReader, NULL, benchReader, &sRun);
+    while(__atomic_load_n(&sRun.iReaderReady, __ATOMIC_ACQUIRE) == 0)
+    {
+        sched_yield();
+    }
+
+    benchPin(0);
+    u64Start = benchNs();
+    u64End = u64Start + ((uint64_t)u32Milliseconds * 1000000ULL);
+    while(benchNs() < u64End)
+    {
+        for(uint32_t u32Step = 0; u32Step < 64; u32Step++)
+        {
+            benchWrite(&sRun, &uSeed);
+        }
+    }
+    __atomic_store_n(&sRun.iDone, 1, __ATOMIC_RELEASE);
+    pthread_join(tReader, NULL);
+    dSeconds = (benchNs() - u64Start) / 1e9;
+
+    printf("%-6zu %-12llu %-9.1f %-10llu %-10llu %-8llu %-12llu %llu\n", _tSize, (unsigned long long)sRun.u64Read,
+           sRun.u64Read / dSeconds / 1e6, (unsigned long long)sRun.u64Bursts, (unsigned long long)sRun.u64Peeks,
+           (unsigned long long)sRun.u64Wrong, (unsigned long long)sRun.u64WrongPeeks,
+           (unsigned long long)(sRun.u64BadCount + sRun.u64BadFree));
+
+    if(sRun.u64Wrong > 0 || sRun.u64WrongPeeks > 0 || sRun.u64BadCount > 0 || sRun.u64BadFree > 0)
+    {
+        printf("    FAIL %llu bytes and %llu peeks out of sequence, %llu counts and %llu free spaces out of range\n",
+               (unsigned long long)sRun.u64Wrong, (unsigned long long)sRun.u64WrongPeeks,
+               (unsigned long long)sRun.u64BadCount, (unsigned long long)sRun.u64BadFree);
+        u32Failures++;
+    }
+    if(sRun.u64Read == 0 || sRun.u64Read != sRun.u64Written)
+    {
+        printf("    FAIL %llu bytes written, %llu read\n", (unsigned long long)sRun.u64Written, (unsigned long long)sRun.u64Read);
+        u32Failures++;
+    }
+
+    return u32Failures;
+}
+
+int main(int argc, char **argv)
+{
+    size_t tOnlySize = 0;
+    uint32_t u32Failures = 0;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "t:s:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 't':
+                u32Milliseconds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                tOnlySize = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t milliseconds] [-s FIFO size]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(u32Milliseconds == 0 || (tOnlySize != 0 && (tOnlySize < 2 || tOnlySize > BENCH_MAX_SIZE)))
+    {
+        fprintf(stderr, "time > 0, FIFO size 2..%u\n", BENCH_MAX_SIZE);
+        return 1;
+    }
+
+    printf("%u ms per FIFO size, %ld cpus\n", u32Milliseconds, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-6s %-12s %-9s %-10s %-10s %-8s %-12s %s\n", "size", "bytes", "MB/s", "bursts", "peeks", "wrong", "wrong peeks", "bad counts");
+    if(tOnlySize != 0)
+    {
+        u32Failures += benchRun(tOnlySize);
+    }
+    else
+    {
+        for(uint8_t u8Index = 0; u8Index < sizeof(atSizes) / sizeof(atSizes[0]); u8Index++)
+        {
+            u32Failures += benchRun(atSizes[u8Index]);
+        }
+    }
+
+    printf("%s\n", (u32Failures == 0) ? "all tests passed" : "FAILED");
+
+    return (u32Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,677 @@
+/*
+    FLASH LOG BENCHMARK (host tool)
+
+    The flash log of the chest unit (main/flashLog.c) on a file standing in for the partition, with the
+    rules of a NOR flash: a write only clears bits (a write that would set one is counted, must be 0) and
+    an erase sets a whole sector back to 0xFF. The imu task is played by a producer appending what it
+    logs, the records of a reorder window (log_window) and the orientation after it (log_result) of every
+    unit, on a 1 ms tick; the log task by a writer that is busy for as long as a real flash would be
+    (BENCH_PROGRAM_US a page, BENCH_ERASE_US a sector), the producer going on meanwhile. The timestamp of
+    every record is its number, and its content follows from it.
+
+    -p cuts the power that many times at random: one of the next writes or erases stops part way (a page programmed
+    up to a random byte, a sector erased up to a random byte), the RAM is lost and the log is mounted again
+    from the file. After every mount, and at the end, the whole log is read back and checked: every record
+    intact and in order, none missing but those dropped (no page buffer free) or lost with the power (not
+    written yet when it went), and none written before a cut missing after it.
+
+    Reports the write amplification (flash bytes programmed and erased per record byte), how busy the
+    flash is, the host time per record and per page, the erases of every sector (least and most worn, as
+    counted by the file and as the log says) and for every cut what the mount found. Any failure makes the
+    exit status 1.
+
+    Build (from quell/tools/flashlog):
+    gcc -O2 -Wall -I../host -I../../main -o flashLogBench flashLogBench.c ../../main/flashLog.c ../../main/messages.c ../../main/crc.c
+
+    Usage:
+    flashLogBench [-f file] [-k partition kB] [-t seconds] [-n window] [-r sample Hz] [-p power cuts] [-s seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "quell.h"
+#include "flashLog.h"
+#include "messages.h"
+
+#define BENCH_UNITS (MESSAGE_IMU_UNITS)
+#define BENCH_TICK_US (1000ULL)
+#define BENCH_PROGRAM_US (700ULL)           //Page program, typical of the SPI NOR flash of the ESP32 modules
+#define BENCH_ERASE_US (45000ULL)           //4 kB sector erase, typical
+#define BENCH_READ_BYTES_PER_US (10ULL)     //40 MHz DIO
+#define BENCH_MAX_CUTS (64)
+#define BENCH_MAX_WINDOW (MESSAGE_LOG_WINDOW_SAMPLES_MAX_COUNT / MESSAGE_IMU_AXES)
+
+typedef struct
+{
+    int iFile;
+    uint32_t u32Size;
+    uint32_t *pu32Erases;               //Per sector
+    uint64_t u64Programmed;             //Bytes
+    uint64_t u64Erased;
+    uint64_t u64Read;
+    uint32_t u32Violations;             //Writes that needed a bit set
+    bool bArmed;                        //A write or erase is cut short
+    uint32_t u32ArmedOps;               //After that many others
+    bool bDead;                         //Power gone, until the mount
+    char cCutIn;                        //'w' or 'e'
+    uint64_t u64OpUs;                   //Modelled time of the operations of the current writer run
+}bench_device_t;
+
+typedef struct
+{
+    uint64_t u64AtUs;
+    char cIn;
+    uint32_t u32DurableEnd;             //Records before it were on the flash
+    uint32_t u32FirstAfter;             //First record after the mount
+    uint32_t u32Found;
+    uint32_t u32Torn;
+    uint32_t u32Slot;
+    uint32_t u32Sequence;
+    uint64_t u64MountRead;
+}bench_cut_t;
+
+static const char *pcFile = "flashlog.bin";
+static uint32_t u32SizeKB = 960;
+static uint32_t u32Seconds = 600;
+static uint8_t u8Window = 8;
+static uint32_t u32SampleHz = 100;
+static uint32_t u32Cuts = 0;
+static uint32_t u32Seed = 1;
+static uint32_t u32Random;
+
+static bench_device_t sBench;
+static flash_log_device_t sDevice;
+static flash_log_t sLog;
+static flash_log_cursor_t sCursor;
+static uint64_t u64NowUs;
+
+/* Records: number n is dropped when abDropped[n] */
+static uint32_t u32Counter;
+static uint8_t *pu8Dropped;
+static uint32_t u32DroppedSize;
+static uint32_t u32DurableEnd;
+static bench_cut_t asCuts[BENCH_MAX_CUTS];
+static uint32_t u32CutsDone;
+
+static uint32_t benchRandom(void)
+{
+    u32Random ^= u32Random << 13;
+    u32Random ^= u32Random >> 17;
+    u32Random ^= u32Random << 5;
+    return u32Random;
+}
+
+static uint64_t benchNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+/* The writer sees the flash time go by while it works */
+static uint32_t benchNowUs(void)
+{
+    return (uint32_t)(u64NowUs + sBench.u64OpUs);
+}
+
+static int16_t benchValue(uint32_t _u32Record, uint16_t _u16Index)
+{
+    return (int16_t)((_u32Record * 2654435761UL) >> 16) + (int16_t)(_u16Index * 977);
+}
+
+/* The record number of a log_window or log_result, QUELL_ERROR when its content does not follow from it */
+static int32_t benchCheckRecord(const uint8_t *_pu8Message, uint16_t _u16Size, uint32_t *_pu32Record)
+{
+    static message_log_window_t sWindow;
+    message_log_result_t sResult;
+    const int16_t *pi16Values;
+    uint16_t u16Count;
+
+    if(messages_decodeLogWindow(&sWindow, _pu8Message, _u16Size) == QUELL_OK)
+    {
+        *_pu32Record = sWindow.u32Timestamp;
+        pi16Values = sWindow.ai16Samples;
+        u16Count = sWindow.u16SamplesCount;
+    }
+    else if(messages_decodeLogResult(&sResult, _pu8Message, _u16Size) == QUELL_OK)
+    {
+        *_pu32Record = sResult.u32Timestamp;
+        pi16Values = sResult.ai16Values;
+        u16Count = sResult.u16ValuesCount;
+    }
+    else
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+    {
+        if(pi16Values[u16Index] != benchValue(*_pu32Record, u16Index))
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+/* Whether the power goes during this write or erase */
+static bool benchCut(bench_device_t *_psBench)
+{
+    if(_psBench->bArmed == false)
+    {
+        return false;
+    }
+    if(_psBench->u32ArmedOps > 0)
+    {
+        _psBench->u32ArmedOps--;
+        return false;
+    }
+    _psBench->bArmed = false;
+    _psBench->bDead = true;
+    return true;
+}
+
+static int32_t benchRead(void *_pvContext, uint32_t _u32Offset, void *_pvData, uint32_t _u32Size)
+{
+    bench_device_t *psBench = (bench_device_t*)_pvContext;
+
+    if(psBench->bDead == true || _u32Offset + _u32Size > psBench->u32Size || pread(psBench->iFile, _pvData, _u32Size, _u32Offset) != (ssize_t)_u32Size)
+    {
+        return QUELL_ERROR;
+    }
+    psBench->u64Read += _u32Size;
+    psBench->u64OpUs += _u32Size / BENCH_READ_BYTES_PER_US;
+
+    return QUELL_OK;
+}
+
+static int32_t benchWrite(void *_pvContext, uint32_t _u32Offset, const void *_pvData, uint32_t _u32Size)
+{
+    bench_device_t *psBench = (bench_device_t*)_pvContext;
+    const uint8_t *pu8Data = (const uint8_t*)_pvData;
+    uint8_t au8Flash[FLASH_LOG_PAGE_SIZE];
+    uint32_t u32Programmed = _u32Size;
+    uint32_t u32Record;
+    bool bCut;
+
+    if(psBench->bDead == true || _u32Size > FLASH_LOG_PAGE_SIZE || _u32Offset + _u32Size > psBench->u32Size ||
+       pread(psBench->iFile, au8Flash, _u32Size, _u32Offset) != (ssize_t)_u32Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Power cut: programmed up to a random byte, that one only partly */
+    bCut = benchCut(psBench);
+    if(bCut == true)
+    {
+        u32Programmed = benchRandom() % _u32Size;
+    }
+    for(uint32_t u32Index = 0; u32Index < _u32Size; u32Index++)
+    {
+        psBench->u32Violations += ((pu8Data[u32Index] & ~au8Flash[u32Index]) != 0) ? 1 : 0;
+        if(u32Index < u32Programmed)
+        {
+            au8Flash[u32Index] &= pu8Data[u32Index];
+        }
+        else if(u32Index == u32Programmed)
+        {
+            au8Flash[u32Index] &= pu8Data[u32Index] | (uint8_t)benchRandom();
+        }
+    }
+    if(pwrite(psBench->iFile, au8Flash, _u32Size, _u32Offset) != (ssize_t)_u32Size)
+    {
+        return QUELL_ERROR;
+    }
+    if(bCut == true)
+    {
+        psBench->cCutIn = 'w';
+        return QUELL_ERROR;
+    }
+    psBench->u64Programmed += _u32Size;
+    psBench->u64OpUs += BENCH_PROGRAM_US;
+
+    /* The records of a whole page are on the flash now */
+    for(uint16_t u16Offset = MESSAGE_LOG_PAGE_SIZE; u16Offset < _u32Size && pu8Data[u16Offset] != 0xFF; u16Offset += 1 + pu8Data[u16Offset])
+    {
+        if(benchCheckRecord(&pu8Data[u16Offset + 1], pu8Data[u16Offset], &u32Record) == QUELL_OK && u32Record + 1 > u32DurableEnd)
+        {
+            u32DurableEnd = u32Record + 1;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+static int32_t benchErase(void *_pvContext, uint32_t _u32Offset, uint32_t _u32Size)
+{
+    bench_device_t *psBench = (bench_device_t*)_pvContext;
+    uint8_t au8Erased[FLASH_LOG_SECTOR_SIZE];
+    uint32_t u32Erased = _u32Size;
+    bool bCut;
+
+    if(psBench->bDead == true || (_u32Offset % FLASH_LOG_SECTOR_SIZE) != 0 || _u32Size != FLASH_LOG_SECTOR_SIZE || _u32Offset + _u32Size > psBench->u32Size)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Power cut: erased up to a random byte, that one only partly, the rest of the sector as it was */
+    bCut = benchCut(psBench);
+    if(bCut == true)
+    {
+        u32Erased = benchRandom() % _u32Size;
+        if(pread(psBench->iFile, au8Erased, _u32Size, _u32Offset) != (ssize_t)_u32Size)
+        {
+            return QUELL_ERROR;
+        }
+        au8Erased[u32Erased] |= (uint8_t)benchRandom();
+    }
+    memset(au8Erased, 0xFF, u32Erased);
+    if(pwrite(psBench->iFile, au8Erased, _u32Size, _u32Offset) != (ssize_t)_u32Size)
+    {
+        return QUELL_ERROR;
+    }
+    if(bCut == true)
+    {
+        psBench->cCutIn = 'e';
+        return QUELL_ERROR;
+    }
+    psBench->u64Erased += _u32Size;
+    psBench->u64OpUs += BENCH_ERASE_US;
+    psBench->pu32Erases[_u32Offset / FLASH_LOG_SECTOR_SIZE]++;
+
+    return QUELL_OK;
+}
+
+static bool benchLost(uint32_t _u32Record)
+{
+    if(_u32Record < u32DroppedSize && pu8Dropped[_u32Record] != 0)
+    {
+        return true;
+    }
+    for(uint32_t u32Cut = 0; u32Cut < u32CutsDone; u32Cut++)
+    {
+        if(_u32Record >= asCuts[u32Cut].u32DurableEnd && _u32Record < asCuts[u32Cut].u32FirstAfter)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The whole log read back: intact, in order, nothing missing but what was dropped or lost in a cut, up to the last record on the flash */
+static uint32_t benchVerify(const char *_pcWhen)
+{
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    uint32_t u32Record;
+    uint32_t u32Last = 0;
+    uint32_t u32Records = 0;
+    uint32_t u32Missing = 0;
+    uint32_t u32Failures = 0;
+
+    flashLog_seek(&sLog, &sCursor, sLog.u32Pages);
+    while(flashLog_next(&sLog, &sCursor, &pu8Message, &u16Size) == QUELL_OK)
+    {
+        if(benchCheckRecord(pu8Message, u16Size, &u32Record) == QUELL_ERROR)
+        {
+            printf("    FAIL %s: record after %u is not one of ours\n", _pcWhen, u32Last);
+            u32Failures++;
+            continue;
+        }
+        if(u32Records > 0 && u32Record <= u32Last)
+        {
+            printf("    FAIL %s: record %u after %u\n", _pcWhen, u32Record, u32Last);
+            u32Failures++;
+            continue;
+        }
+        for(uint32_t u32Gap = u32Last + 1; u32Records > 0 && u32Gap < u32Record; u32Gap++)
+        {
+            if(benchLost(u32Gap) == false && u32Missing++ == 0)
+            {
+                printf("    FAIL %s: record %u missing\n", _pcWhen, u32Gap);
+            }
+        }
+        u32Last = u32Record;
+        u32Records++;
+    }
+
+    if(u32Missing > 0)
+    {
+        printf("    FAIL %s: %u records missing\n", _pcWhen, u32Missing);
+        u32Failures++;
+    }
+    if(u32DurableEnd > 0 && (u32Records == 0 || u32Last + 1 < u32DurableEnd))
+    {
+        printf("    FAIL %s: the last record read is %u, %u were on the flash\n", _pcWhen, u32Last, u32DurableEnd);
+        u32Failures++;
+    }
+
+    return u32Failures;
+}
+
+static int32_t benchAppend(uint8_t _u8Unit, bool _bResult)
+{
+    static message_log_window_t sWindow;
+    message_log_result_t sResult;
+    uint8_t au8Message[MESSAGE_LOG_WINDOW_MAX_SIZE];
+    uint16_t u16Size;
+    int32_t i32Result;
+
+    if(_bResult == false)
+    {
+        sWindow.u8Unit = _u8Unit;
+        sWindow.u32Timestamp = u32Counter;
+        sWindow.u16Period = (uint16_t)(1000000UL / u32SampleHz);
+        sWindow.u16Filled = 0;
+        sWindow.u16SamplesCount = u8Window * MESSAGE_IMU_AXES;
+        for(uint16_t u16Index = 0; u16Index < sWindow.u16SamplesCount; u16Index++)
+        {
+            sWindow.ai16Samples[u16Index] = benchValue(u32Counter, u16Index);
+        }
+        messages_encodeLogWindow(&sWindow, au8Message, sizeof(au8Message), &u16Size);
+    }
+    else
+    {
+        sResult.u8Unit = _u8Unit;
+        sResult.u8Kind = MESSAGE_LOG_RESULT_KIND_ORIENTATION;
+        sResult.u32Timestamp = u32Counter;
+        sResult.u16ValuesCount = 4;
+        for(uint16_t u16Index = 0; u16Index < sResult.u16ValuesCount; u16Index++)
+        {
+            sResult.ai16Values[u16Index] = benchValue(u32Counter, u16Index);
+        }
+        messages_encodeLogResult(&sResult, au8Message, sizeof(au8Message), &u16Size);
+    }
+
+    if(u32Counter >= u32DroppedSize)
+    {
+        u32DroppedSize = (u32DroppedSize == 0) ? 65536 : u32DroppedSize * 2;
+        pu8Dropped = realloc(pu8Dropped, u32DroppedSize);
+        memset(&pu8Dropped[u32DroppedSize / 2], 0, u32DroppedSize - (u32DroppedSize / 2));
+    }
+    i32Result = flashLog_append(&sLog, au8Message, u16Size);
+    pu8Dropped[u32Counter] = (i32Result == QUELL_ERROR) ? 1 : 0;
+    u32Counter++;
+
+    return i32Result;
+}
+
+static int32_t benchMount(uint64_t *_pu64Read)
+{
+    uint64_t u64Read = sBench.u64Read;
+    int32_t i32Result = flashLog_mount(&sLog, &sDevice, benchNowUs);
+
+    *_pu64Read = sBench.u64Read - u64Read;
+    sBench.u64OpUs = 0;
+    return i32Result;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t au64NextWindowUs[BENCH_UNITS];
+    uint64_t u64EndUs;
+    uint64_t u64WriterFreeUs = 0;
+    uint64_t u64BusyUs = 0;
+    uint64_t u64MaxRunUs = 0;
+    uint64_t u64AppendNs = 0;
+    uint64_t u64RunNs = 0;
+    uint64_t u64MountRead;
+    uint64_t au64CutAtUs[BENCH_MAX_CUTS];
+    uint32_t u32NextCut = 0;
+    uint32_t u32Records = 0;
+    uint32_t u32Pages = 0;
+    uint32_t u32Erases = 0;
+    uint64_t u64RecordBytes = 0;
+    uint32_t u32Dropped = 0;
+    uint32_t u32Failures = 0;
+    uint32_t u32MinErases = UINT32_MAX;
+    uint32_t u32MaxErases = 0;
+    uint32_t u32Sectors;
+    uint64_t u64WindowUs;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "f:k:t:n:r:p:s:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'f':
+                pcFile = optarg;
+                break;
+            case 'k':
+                u32SizeKB = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                u32Seconds = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                u8Window = (uint8_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                u32SampleHz = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                u32Cuts = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                u32Seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f file] [-k partition kB] [-t seconds] [-n window] [-r sample Hz] [-p power cuts] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if((u32SizeKB * 1024UL) % FLASH_LOG_SECTOR_SIZE != 0 || u32SizeKB * 1024UL < FLASH_LOG_MIN_SECTORS * FLASH_LOG_SECTOR_SIZE || u8Window == 0 ||
+       u8Window > BENCH_MAX_WINDOW || u32SampleHz < 16 || u32SampleHz > 10000 || u32Seconds < 3 || u32Cuts > BENCH_MAX_CUTS || u32Seed == 0)
+    {
+        fprintf(stderr, "partition in whole sectors of %u kB (at least %u), window 1..%u, 16..10000 Hz, at least 3 s, up to %u cuts, seed not 0\n",
+                (unsigned)(FLASH_LOG_SECTOR_SIZE / 1024), FLASH_LOG_MIN_SECTORS, BENCH_MAX_WINDOW, BENCH_MAX_CUTS);
+        return 1;
+    }
+    u32Random = u32Seed;
+
+    /* A new partition, erased */
+    sBench.u32Size = u32SizeKB * 1024UL;
+    u32Sectors = sBench.u32Size / FLASH_LOG_SECTOR_SIZE;
+    sBench.pu32Erases = calloc(u32Sectors, sizeof(uint32_t));
+    sBench.iFile = open(pcFile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(sBench.iFile < 0 || sBench.pu32Erases == NULL)
+    {
+        perror(pcFile);
+        return 1;
+    }
+    for(uint32_t u32Sector = 0; u32Sector < u32Sectors; u32Sector++)
+    {
+        uint8_t au8Erased[FLASH_LOG_SECTOR_SIZE];
+
+        memset(au8Erased, 0xFF, sizeof(au8Erased));
+        if(pwrite(sBench.iFile, au8Erased, sizeof(au8Erased), u32Sector * FLASH_LOG_SECTOR_SIZE) != (ssize_t)sizeof(au8Erased))
+        {
+            perror(pcFile);
+            return 1;
+        }
+    }
+    sDevice.fpRead = benchRead;
+    sDevice.fpWrite = benchWrite;
+    sDevice.fpErase = benchErase;
+    sDevice.pvContext = &sBench;
+    sDevice.u32Size = sBench.u32Size;
+
+    /* Cuts at random times, in order */
+    u64EndUs = (uint64_t)u32Seconds * 1000000ULL;
+    for(uint32_t u32Cut = 0; u32Cut < u32Cuts; u32Cut++)
+    {
+        uint64_t u64At = 1000000ULL + ((uint64_t)benchRandom() * (u64EndUs - 2000000ULL)) / UINT32_MAX;
+        uint32_t u32Index;
+
+        for(u32Index = u32Cut; u32Index > 0 && au64CutAtUs[u32Index - 1] > u64At; u32Index--)
+        {
+            au64CutAtUs[u32Index] = au64CutAtUs[u32Index - 1];
+        }
+        au64CutAtUs[u32Index] = u64At;
+    }
+
+    u64WindowUs = ((uint64_t)u8Window * 1000000ULL) / u32SampleHz;
+    printf("partition %u kB (%u sectors of %u pages), %u units, windows of %u samples at %u Hz (%u byte records), %u s, %u power cuts\n",
+           u32SizeKB, u32Sectors, (unsigned)FLASH_LOG_SECTOR_PAGES, BENCH_UNITS, u8Window, u32SampleHz,
+           (unsigned)(MESSAGE_LOG_WINDOW_SIZE + (u8Window * MESSAGE_IMU_AXES * 2)), u32Seconds, u32Cuts);
+
+    if(benchMount(&u64MountRead) == QUELL_ERROR)
+    {
+        printf("FAIL mount of the erased partition\n");
+        return 1;
+    }
+    for(uint8_t u8Unit = 0; u8Unit < BENCH_UNITS; u8Unit++)
+    {
+        au64NextWindowUs[u8Unit] = (u64WindowUs * u8Unit) / BENCH_UNITS;
+    }
+
+    for(u64NowUs = 0; u64NowUs < u64EndUs; u64NowUs += BENCH_TICK_US)
+    {
+        uint64_t u64Start = benchNs();
+
+        /* Producer (imu task): the windows due, then the age of the page */
+        for(uint8_t u8Unit = 0; u8Unit < BENCH_UNITS; u8Unit++)
+        {
+            while(au64NextWindowUs[u8Unit] <= u64NowUs)
+            {
+                benchAppend(u8Unit, false);
+                benchAppend(u8Unit, true);
+                au64NextWindowUs[u8Unit] += u64WindowUs;
+            }
+        }
+        flashLog_tick(&sLog);
+        u64AppendNs += benchNs() - u64Start;
+
+        if(u32NextCut < u32Cuts && au64CutAtUs[u32NextCut] <= u64NowUs)
+        {
+            sBench.bArmed = true;
+            sBench.u32ArmedOps = benchRandom() % (FLASH_LOG_SECTOR_PAGES + 1);
+            u32NextCut++;
+        }
+
+        /* Writer (log task), busy as long as the flash */
+        if(u64NowUs >= u64WriterFreeUs)
+        {
+            uint32_t u32Before = sLog.u32PagesWritten;
+
+            sBench.u64OpUs = 0;
+            u64Start = benchNs();
+            flashLog_run(&sLog);
+            if(sLog.u32PagesWritten > u32Before)
+            {
+                u64RunNs += benchNs() - u64Start;
+            }
+            u64WriterFreeUs = u64NowUs + sBench.u64OpUs;
+            u64BusyUs += sBench.u64OpUs;
+            u64MaxRunUs = (sBench.u64OpUs > u64MaxRunUs) ? sBench.u64OpUs : u64MaxRunUs;
+        }
+
+        /* Power back: whatever was in RAM is gone, the log is mounted again and read back */
+        if(sBench.bDead == true)
+        {
+            bench_cut_t *psCut = &asCuts[u32CutsDone];
+            char acWhen[32];
+
+            u32Records += sLog.u32Records;
+            u32Pages += sLog.u32PagesWritten;
+            u32Erases += sLog.u32Erases;
+            u64RecordBytes += sLog.u32RecordBytes;
+            u32Dropped += sLog.u32Dropped;
+
+            psCut->u64AtUs = u64NowUs;
+            psCut->cIn = sBench.cCutIn;
+            psCut->u32DurableEnd = u32DurableEnd;
+            psCut->u32FirstAfter = u32Counter;
+            u32CutsDone++;
+
+            sBench.bDead = false;
+            if(benchMount(&psCut->u64MountRead) == QUELL_ERROR)
+            {
+                printf("FAIL mount after the cut at %.3f s\n", u64NowUs / 1e6);
+                return 1;
+            }
+            psCut->u32Found = sLog.u32ValidPages;
+            psCut->u32Torn = sLog.u32TornPages;
+            psCut->u32Slot = sLog.u32Slot;
+            psCut->u32Sequence = sLog.u32Sequence;
+            snprintf(acWhen, sizeof(acWhen), "cut %u", u32CutsDone);
+            u32Failures += benchVerify(acWhen);
+            u64WriterFreeUs = u64NowUs;
+        }
+    }
+
+    /* What is still in RAM goes, then the last check */
+    flashLog_flush(&sLog);
+    sBench.u64OpUs = 0;
+    flashLog_run(&sLog);
+    u64BusyUs += sBench.u64OpUs;
+    u32Records += sLog.u32Records;
+    u32Pages += sLog.u32PagesWritten;
+    u32Erases += sLog.u32Erases;
+    u64RecordBytes += sLog.u32RecordBytes;
+    u32Dropped += sLog.u32Dropped;
+    u32DurableEnd = u32Counter;
+    while(u32DurableEnd > 0 && pu8Dropped[u32DurableEnd - 1] != 0)
+    {
+        u32DurableEnd--;
+    }
+    u32Failures += benchVerify("end");
+    if(benchMount(&u64MountRead) == QUELL_ERROR)
+    {
+        printf("FAIL mount at the end\n");
+        return 1;
+    }
+    u32Failures += benchVerify("end, mounted again");
+
+    for(uint32_t u32Sector = 0; u32Sector < u32Sectors; u32Sector++)
+    {
+        u32MinErases = (sBench.pu32Erases[u32Sector] < u32MinErases) ? sBench.pu32Erases[u32Sector] : u32MinErases;
+        u32MaxErases = (sBench.pu32Erases[u32Sector] > u32MaxErases) ? sBench.pu32Erases[u32Sector] : u32MaxErases;
+    }
+
+    printf("records %u (%llu bytes, %.0f/s) dropped %u, pages %u, erases %u\n", u32Records, (unsigned long long)u64RecordBytes,
+           u32Records / (double)u32Seconds, u32Dropped, u32Pages, u32Erases);
+    printf("write amplification: programmed %.2f, erased %.2f bytes per record byte\n",
+           (double)sBench.u64Programmed / u64RecordBytes, (double)sBench.u64Erased / u64RecordBytes);
+    printf("flash busy %.1f%% (%llu us a page, %llu us a sector erase), longest writer run %.1f ms\n",
+           (100.0 * u64BusyUs) / u64EndUs, (unsigned long long)BENCH_PROGRAM_US, (unsigned long long)BENCH_ERASE_US, u64MaxRunUs / 1000.0);
+    printf("host: %.0f ns per record appended, %.1f us per writer run that wrote\n",
+           (u32Records > 0) ? (double)u64AppendNs / u32Records : 0.0, (u32Pages > 0) ? u64RunNs / 1000.0 / u32Pages : 0.0);
+    printf("wear: erases per sector %u..%u (%.1f laps), the log says %u..%u\n", u32MinErases, u32MaxErases,
+           (double)u32Erases / u32Sectors, sLog.u32MinWear, sLog.u32MaxWear);
+    printf("mount: reads %llu kB (%.0f ms at %llu MB/s)\n", (unsigned long long)(u64MountRead / 1024),
+           u64MountRead / (double)BENCH_READ_BYTES_PER_US / 1000.0, (unsigned long long)BENCH_READ_BYTES_PER_US);
+    for(uint32_t u32Cut = 0; u32Cut < u32CutsDone; u32Cut++)
+    {
+        printf("cut %u at %8.3f s during %s: %u pages found (%u torn), records from %u on lost in RAM, going on at page %u sequence %u\n",
+               u32Cut + 1, asCuts[u32Cut].u64AtUs / 1e6, (asCuts[u32Cut].cIn == 'w') ? "a write" : "an erase", asCuts[u32Cut].u32Found,
+               asCuts[u32Cut].u32Torn, asCuts[u32Cut].u32DurableEnd, asCuts[u32Cut].u32Slot, asCuts[u32Cut].u32Sequence);
+    }
+
+    if(sBench.u32Violations > 0)
+    {
+        printf("    FAIL %u writes needed a bit set (a page written twice)\n", sBench.u32Violations);
+        u32Failures++;
+    }
+    if(u32Dropped > 0)
+    {
+        printf("    FAIL %u records dropped, the writer fell behind\n", u32Dropped);
+        u32Failures++;
+    }
+    if(u32MinErases > 0 && u32MaxErases - u32MinErases > 1 + u32CutsDone)
+    {
+        printf("    FAIL sectors erased %u..%u times\n", u32MinErases, u32MaxErases);
+        u32Failures++;
+    }
+
+    printf("%s\n", (u32Failures == 0) ? "all tests passed" : "FAILED");
+    close(sBench.iFile);
+
+    return (u32Failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,572 @@
+/*
+    GATEWAY (host daemon)
+
+    Speaks the QUELL protocol on one or more serial devices (or ptys) with the firmware code itself:
+    processIncomingCommunication parses, acknowledges and answers the link messages, the credit flow
+    control and the FEC negotiation run as on the board, and the Tx scheduler paces the packets. Every
+    received message is published in the shared memory of its link (gatewayShm.h), which any number of
+    local processes read in place with gatewayClient.c; the same clients hand messages to send. The
+    throughput of every link is kept in its shared memory and printed every -r seconds.
+
+    Build (from quell/tools/gateway):
+    gcc -O2 -Wall -I. -I../host -I../../main -I../../main/ProtocolTask -o gateway gateway.c gatewayClient.c \
+        ../../main/FIFO.c ../../main/crc.c ../../main/fec.c ../../main/sampleBus.c \
+        ../../main/ProtocolTask/protocol.c ../../main/ProtocolTask/flowControl.c ../../main/ProtocolTask/tdma.c ../../main/ProtocolTask/router.c ../../main/ProtocolTask/linkBench.c ../../main/ProtocolTask/linkSpeed.c ../../main/ProtocolTask/channel.c ../../main/ProtocolTask/txScheduler.c ../../main/messages.c
+
+    Usage:
+    gateway -d /dev/ttyUSB0 [-d /dev/ttyUSB1 ...] [-b baud] [-n name] [-s rx slots] [-t tx slots] [-r report seconds]
+    Link i is the shared memory object "/<name>.<i>" (default /quell.0, /quell.1, ...).
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "quell.h"
+#include "FIFO.h"
+#include "protocol.h"
+#include "flowControl.h"
+#include "txScheduler.h"
+#include "gatewayShm.h"
+
+#define GATEWAY_MAX_LINKS (8)
+#define GATEWAY_RX_FIFO_SIZE (512UL)        //Same as the firmware FIFO Rx, the first credit window of both ends is implied
+#define GATEWAY_RX_CREDIT_RESERVE (4 * PACKE_SIZE(MESSAGE_CREDIT_SIZE))
+#define GATEWAY_TX_CONTROL_SIZE (512UL)
+#define GATEWAY_TX_BULK_SIZE (4096UL)
+#define GATEWAY_TX_MAX_CONTROL_BURST (4)
+#define GATEWAY_RX_SLOT_SIZE (256UL)        //Every message the firmware sends fits with its terminator
+#define GATEWAY_WRITE_SIZE (1024UL)
+#define GATEWAY_READ_SIZE (512UL)
+#define GATEWAY_POLL_MS (1)                 //Also the latency of a client message when the links are quiet
+#define GATEWAY_TX_STALL_MS (1000UL)        //A reserved slot not published by then belongs to a dead client
+#define GATEWAY_REOPEN_MS (1000UL)
+
+typedef struct
+{
+    const char *pcDevice;
+    char acName[NAME_MAX];
+    int iFile;
+    uint64_t u64NextOpenMs;
+
+    gateway_shm_header_t *psHeader;
+    size_t tSegmentSize;
+    gateway_tx_slot_t *psTxSlots;
+    uint64_t u64TxStallSinceMs;
+
+    fifo_t sFIFORx;
+    char acFIFORx[GATEWAY_RX_FIFO_SIZE];
+    tx_scheduler_t sTxScheduler;
+    char acTxControl[GATEWAY_TX_CONTROL_SIZE];
+    char acTxBulk[GATEWAY_TX_BULK_SIZE];
+    protocol_link_t sLink;
+    sample_bus_t sBus;
+    uint32_t u32RxErrorsSeen;
+
+    /* Rates */
+    uint64_t u64LastRateMs;
+    gateway_link_stats_t sLastStats;
+}gateway_link_t;
+
+static volatile sig_atomic_t iStop = 0;
+static gateway_link_t asLinks[GATEWAY_MAX_LINKS];
+static uint32_t u32LinkCount = 0;
+
+static void gatewaySignal(int _iSignal)
+{
+    iStop = 1;
+}
+
+static uint64_t gatewayNowMs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000ULL) + (sTime.tv_nsec / 1000000ULL);
+}
+
+static speed_t gatewaySpeed(uint32_t _u32BaudRate)
+{
+    static const struct
+    {
+        uint32_t u32BaudRate;
+        speed_t tSpeed;
+    }asSpeeds[] = {{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+                   {230400, B230400}, {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+                   {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+                   {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000}};
+
+    for(size_t tIndex = 0; tIndex < sizeof(asSpeeds) / sizeof(asSpeeds[0]); tIndex++)
+    {
+        if(asSpeeds[tIndex].u32BaudRate == _u32BaudRate)
+        {
+            return asSpeeds[tIndex].tSpeed;
+        }
+    }
+
+    return B0;
+}
+
+/* Protocol state starts over with every (re)connection, the reset credit tells the peer */
+static int32_t gatewayLinkReset(gateway_link_t *_psLink)
+{
+    sample_bus_t *psBus = _psLink->sLink.psBus;
+
+    if(FIFO_init(&_psLink->sFIFORx, _psLink->acFIFORx, sizeof(_psLink->acFIFORx)) == false ||
+       txScheduler_init(&_psLink->sTxScheduler, _psLink->acTxControl, sizeof(_psLink->acTxControl),
+                        _psLink->acTxBulk, sizeof(_psLink->acTxBulk), GATEWAY_TX_MAX_CONTROL_BURST) == QUELL_ERROR ||
+       protocolLink_init(&_psLink->sLink, GATEWAY_RX_FIFO_SIZE, GATEWAY_RX_CREDIT_RESERVE) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psLink->sLink.psBus = psBus;
+    _psLink->u32RxErrorsSeen = 0;
+    return QUELL_OK;
+}
+
+static int32_t gatewayLinkOpenDevice(gateway_link_t *_psLink, uint32_t _u32BaudRate)
+{
+    struct termios sTermios;
+    int iFile;
+
+    /* Non blocking open (no carrier wait), blocking writes afterwards: the uart paces them */
+    iFile = open(_psLink->pcDevice, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(iFile < 0)
+    {
+        return QUELL_ERROR;
+    }
+    if(tcgetattr(iFile, &sTermios) != 0)
+    {
+        close(iFile);
+        return QUELL_ERROR;
+    }
+
+    cfmakeraw(&sTermios);
+    sTermios.c_cflag |= CLOCAL | CREAD;
+    sTermios.c_cc[VMIN] = 0;
+    sTermios.c_cc[VTIME] = 0;
+    cfsetispeed(&sTermios, gatewaySpeed(_u32BaudRate));
+    cfsetospeed(&sTermios, gatewaySpeed(_u32BaudRate));
+    if(tcsetattr(iFile, TCSANOW, &sTermios) != 0 || fcntl(iFile, F_SETFL, fcntl(iFile, F_GETFL) & ~O_NONBLOCK) != 0)
+    {
+        close(iFile);
+        return QUELL_ERROR;
+    }
+    tcflush(iFile, TCIOFLUSH);
+
+    if(gatewayLinkReset(_psLink) == QUELL_ERROR)
+    {
+        close(iFile);
+        return QUELL_ERROR;
+    }
+
+    _psLink->iFile = iFile;
+    _psLink->psHeader->sStats.bConnected = true;
+    return QUELL_OK;
+}
+
+static void gatewayLinkCloseDevice(gateway_link_t *_psLink, uint64_t _u64NowMs)
+{
+    if(_psLink->iFile >= 0)
+    {
+        close(_psLink->iFile);
+        _psLink->iFile = -1;
+        _psLink->psHeader->sStats.bConnected = false;
+        _psLink->psHeader->sStats.u32Reconnects++;
+        fprintf(stderr, "%s: disconnected\n", _psLink->pcDevice);
+    }
+    _psLink->u64NextOpenMs = _u64NowMs + GATEWAY_REOPEN_MS;
+}
+
+static int32_t gatewayLinkCreateSegment(gateway_link_t *_psLink, const char *_pcName, uint32_t _u32Index, uint32_t _u32BaudRate, uint32_t _u32RxSlots, uint32_t _u32TxSlots)
+{
+    gateway_shm_header_t *psHeader;
+    uint32_t u32RxOffset = GATEWAY_SHM_ROUND(sizeof(gateway_shm_header_t));
+    uint32_t u32RxSize = GATEWAY_SHM_ROUND(SAMPLE_BUS_BUFFER_SIZE(GATEWAY_RX_SLOT_SIZE, _u32RxSlots));
+    uint32_t u32TxOffset = u32RxOffset + u32RxSize;
+    uint32_t u32SegmentSize = GATEWAY_SHM_ROUND(u32TxOffset + _u32TxSlots * sizeof(gateway_tx_slot_t));
+    int iFile;
+
+    snprintf(_psLink->acName, sizeof(_psLink->acName), "/%s.%u", _pcName, _u32Index);
+
+    /* A segment left by a previous run is replaced, its clients keep the old one until they reopen */
+    shm_unlink(_psLink->acName);
+    iFile = shm_open(_psLink->acName, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if(iFile < 0)
+    {
+        return QUELL_ERROR;
+    }
+    if(ftruncate(iFile, u32SegmentSize) != 0)
+    {
+        close(iFile);
+        shm_unlink(_psLink->acName);
+        return QUELL_ERROR;
+    }
+    psHeader = mmap(NULL, u32SegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+    close(iFile);
+    if(psHeader == MAP_FAILED)
+    {
+        shm_unlink(_psLink->acName);
+        return QUELL_ERROR;
+    }
+
+    /* The messages are extracted straight into the shared slots */
+    if(sampleBus_init(&_psLink->sBus, (uint8_t*)psHeader + u32RxOffset, u32RxSize, GATEWAY_RX_SLOT_SIZE) == QUELL_ERROR)
+    {
+        munmap(psHeader, u32SegmentSize);
+        shm_unlink(_psLink->acName);
+        return QUELL_ERROR;
+    }
+
+    psHeader->u32Version = GATEWAY_SHM_VERSION;
+    psHeader->u32DaemonPid = getpid();
+    psHeader->u32BaudRate = _u32BaudRate;
+    snprintf(psHeader->acDevice, sizeof(psHeader->acDevice), "%s", _psLink->pcDevice);
+    psHeader->u32SegmentSize = u32SegmentSize;
+    psHeader->u32RxOffset = u32RxOffset;
+    psHeader->u32RxSize = u32RxSize;
+    psHeader->u16RxSlotSize = GATEWAY_RX_SLOT_SIZE;
+    psHeader->u32TxOffset = u32TxOffset;
+    psHeader->u32TxSlotCount = _u32TxSlots;
+    __atomic_store_n(&psHeader->u32Magic, GATEWAY_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    _psLink->psHeader = psHeader;
+    _psLink->tSegmentSize = u32SegmentSize;
+    _psLink->psTxSlots = (gateway_tx_slot_t*)((uint8_t*)psHeader + u32TxOffset);
+    _psLink->sLink.psBus = &_psLink->sBus;
+    _psLink->iFile = -1;
+
+    return QUELL_OK;
+}
+
+static void gatewayLinkReceive(gateway_link_t *_psLink)
+{
+    gateway_shm_header_t *psHeader = _psLink->psHeader;
+    uint8_t au8Read[GATEWAY_READ_SIZE];
+    uint32_t u32Head = _psLink->sBus.u32Head;
+    size_t tFree;
+    ssize_t tRead;
+
+    /* Never more than FIFO Rx takes, the peer keeps within our credit anyway */
+    FIFO_free(&_psLink->sFIFORx, &tFree);
+    if(tFree > 0)
+    {
+        tRead = read(_psLink->iFile, au8Read, (tFree < sizeof(au8Read)) ? tFree : sizeof(au8Read));
+        if(tRead == 0 || (tRead < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            gatewayLinkCloseDevice(_psLink, gatewayNowMs());
+            return;
+        }
+
+        for(ssize_t tIndex = 0; tIndex < tRead; tIndex++)
+        {
+            FIFO_put(&_psLink->sFIFORx, (char)au8Read[tIndex]);
+        }
+        if(tRead > 0)
+        {
+            flowControl_rxReceived(&_psLink->sLink.sFlowControl, tRead);
+            psHeader->sStats.u64RxBytes += tRead;
+        }
+    }
+
+    /* Acknowledgements and link answers go out on the control lane */
+    while(processIncomingCommunication(&_psLink->sFIFORx, txScheduler_getLane(&_psLink->sTxScheduler, TX_LANE_CONTROL), &_psLink->sLink, NULL) == QUELL_OK);
+    psHeader->sStats.u64RxErrors += _psLink->sLink.u32RxErrors - _psLink->u32RxErrorsSeen;
+    _psLink->u32RxErrorsSeen = _psLink->sLink.u32RxErrors;
+
+    if(_psLink->sBus.u32Head != u32Head)
+    {
+        psHeader->sStats.u64RxMessages += _psLink->sBus.u32Head - u32Head;
+
+        /* Mirror of the bus head: published before any slot is claimed again (sampleBus_claim fence) */
+        __atomic_store_n(&psHeader->u32RxHead, _psLink->sBus.u32Head, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&psHeader->u32RxWaiters, __ATOMIC_SEQ_CST) > 0)
+        {
+            syscall(SYS_futex, &psHeader->u32RxHead, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+        }
+    }
+}
+
+/* Client messages, in the order they were reserved, into the bulk lane */
+static void gatewayLinkTakeClientMessages(gateway_link_t *_psLink, uint64_t _u64NowMs)
+{
+    gateway_shm_header_t *psHeader = _psLink->psHeader;
+    uint32_t u32Tail = psHeader->u32TxTail;
+    gateway_tx_slot_t *psSlot;
+
+    while(u32Tail != __atomic_load_n(&psHeader->u32TxReserve, __ATOMIC_ACQUIRE))
+    {
+        psSlot = &_psLink->psTxSlots[u32Tail & (psHeader->u32TxSlotCount - 1)];
+        if(__atomic_load_n(&psSlot->u32Sequence, __ATOMIC_ACQUIRE) != u32Tail + 1)
+        {
+            /* Reserved, still being written; a client that died here would block everyone behind it */
+            if(_psLink->u64TxStallSinceMs == 0)
+            {
+                _psLink->u64TxStallSinceMs = _u64NowMs;
+            }
+            if(_u64NowMs - _psLink->u64TxStallSinceMs < GATEWAY_TX_STALL_MS)
+            {
+                break;
+            }
+            psHeader->sStats.u64TxAbandoned++;
+        }
+        else if(sendMessage(txScheduler_getLane(&_psLink->sTxScheduler, TX_LANE_BULK), psSlot->au8Message,
+                            (psSlot->u16Size > GATEWAY_MESSAGE_SIZE) ? GATEWAY_MESSAGE_SIZE : psSlot->u16Size) == QUELL_ERROR)
+        {
+            /* Lane full, the slot waits for the link */
+            break;
+        }
+        else
+        {
+            psHeader->sStats.u64TxMessages++;
+        }
+
+        _psLink->u64TxStallSinceMs = 0;
+        u32Tail++;
+        __atomic_store_n(&psHeader->u32TxTail, u32Tail, __ATOMIC_RELEASE);
+    }
+}
+
+/* Gathers packets (FEC encoded when negotiated) and the credit within the peer credit, one write for all of them */
+static void gatewayLinkTransmit(gateway_link_t *_psLink, uint64_t _u64NowMs)
+{
+    uint8_t au8Write[GATEWAY_WRITE_SIZE];
+    uint8_t au8Packet[PACKE_SIZE(GATEWAY_MESSAGE_SIZE)];
+    flow_control_t *psFlowControl = &_psLink->sLink.sFlowControl;
+    tx_scheduler_t *psScheduler = &_psLink->sTxScheduler;
+    uint16_t u16Written = 0;
+    uint16_t u16Count;
+    uint16_t u16FrameSize;
+
+    for(;;)
+    {
+        if(_psLink->sLink.bFECTx == true && psScheduler->u16FrameRemaining == 0)
+        {
+            /* Whole packets only, their frame is what the peer FIFO Rx holds and so what the credit pays for */
+            if(sizeof(au8Write) - u16Written < FEC_ENCODED_SIZE(sizeof(au8Packet)) ||
+               txScheduler_startFrame(psScheduler, fec_getMaxPacketSize(flowControl_getTxAllowance(psFlowControl))) == QUELL_ERROR ||
+               psScheduler->u16FrameRemaining > sizeof(au8Packet) ||
+               txScheduler_pop(psScheduler, 0, (char*)au8Packet, sizeof(au8Packet), &u16Count) == QUELL_ERROR ||
+               fec_encodeFrame(au8Packet, u16Count, &au8Write[u16Written], sizeof(au8Write) - u16Written, &u16FrameSize) == QUELL_ERROR)
+            {
+                break;
+            }
+            flowControl_txSent(psFlowControl, u16FrameSize);
+            u16Written += u16FrameSize;
+        }
+        else
+        {
+            if(u16Written == sizeof(au8Write) ||
+               txScheduler_pop(psScheduler, flowControl_getTxAllowance(psFlowControl), (char*)&au8Write[u16Written], sizeof(au8Write) - u16Written, &u16Count) == QUELL_ERROR)
+            {
+                break;
+            }
+            flowControl_txSent(psFlowControl, u16Count);
+            u16Written += u16Count;
+        }
+    }
+
+    /* Advertise our free FIFO Rx space, only between packets (credit packets are outside of the credit) */
+    if(psScheduler->u16FrameRemaining == 0 && sizeof(au8Write) - u16Written >= PACKE_SIZE(MESSAGE_CREDIT_SIZE) &&
+       flowControl_makeCredit(psFlowControl, &_psLink->sFIFORx, (uint32_t)_u64NowMs, &au8Write[u16Written], PACKE_SIZE(MESSAGE_CREDIT_SIZE), &u16Count) == QUELL_OK)
+    {
+        u16Written += u16Count;
+    }
+
+    if(u16Written > 0)
+    {
+        if(write(_psLink->iFile, au8Write, u16Written) != u16Written)
+        {
+            gatewayLinkCloseDevice(_psLink, _u64NowMs);
+            return;
+        }
+        _psLink->psHeader->sStats.u64TxBytes += u16Written;
+    }
+}
+
+static void gatewayRates(uint64_t _u64NowMs, uint32_t _u32ReportSeconds, uint64_t *_pu64LastReportMs)
+{
+    bool bReport = (_u32ReportSeconds > 0 && _u64NowMs - *_pu64LastReportMs >= _u32ReportSeconds * 1000ULL);
+
+    for(uint32_t u32Link = 0; u32Link < u32LinkCount; u32Link++)
+    {
+        gateway_link_t *psLink = &asLinks[u32Link];
+        gateway_link_stats_t *psStats = &psLink->psHeader->sStats;
+        uint64_t u64ElapsedMs = _u64NowMs - psLink->u64LastRateMs;
+
+        if(u64ElapsedMs >= 1000)
+        {
+            psStats->u32RxBytesPerSecond = ((psStats->u64RxBytes - psLink->sLastStats.u64RxBytes) * 1000) / u64ElapsedMs;
+            psStats->u32TxBytesPerSecond = ((psStats->u64TxBytes - psLink->sLastStats.u64TxBytes) * 1000) / u64ElapsedMs;
+            psStats->u32RxMessagesPerSecond = ((psStats->u64RxMessages - psLink->sLastStats.u64RxMessages) * 1000) / u64ElapsedMs;
+            psStats->u32TxMessagesPerSecond = ((psStats->u64TxMessages - psLink->sLastStats.u64TxMessages) * 1000) / u64ElapsedMs;
+            psLink->sLastStats = *psStats;
+            psLink->u64LastRateMs = _u64NowMs;
+        }
+
+        if(bReport == true)
+        {
+            fprintf(stderr, "%s %s: %s rx %u B/s %u msg/s tx %u B/s %u msg/s | rx msgs:%llu errors:%llu fec:%u/%u tx msgs:%llu abandoned:%llu credits:%u/%u\n",
+                    psLink->acName, psLink->pcDevice, (psStats->bConnected == true) ? "up" : "down",
+                    psStats->u32RxBytesPerSecond, psStats->u32RxMessagesPerSecond, psStats->u32TxBytesPerSecond, psStats->u32TxMessagesPerSecond,
+                    (unsigned long long)psStats->u64RxMessages, (unsigned long long)psStats->u64RxErrors,
+                    psLink->sLink.u32RxFECFrames, psLink->sLink.u32RxFECCorrected,
+                    (unsigned long long)psStats->u64TxMessages, (unsigned long long)psStats->u64TxAbandoned,
+                    psLink->sLink.sFlowControl.u32CreditsSent, psLink->sLink.sFlowControl.u32CreditsReceived);
+        }
+    }
+
+    if(bReport == true)
+    {
+        *_pu64LastReportMs = _u64NowMs;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *pcName = "quell";
+    uint32_t u32BaudRate = 115200;
+    uint32_t u32RxSlots = 4096;
+    uint32_t u32TxSlots = 64;
+    uint32_t u32ReportSeconds = 10;
+    uint64_t u64LastReportMs;
+    struct pollfd asPoll[GATEWAY_MAX_LINKS];
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "d:b:n:s:t:r:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'd':
+                if(u32LinkCount < GATEWAY_MAX_LINKS)
+                {
+                    asLinks[u32LinkCount++].pcDevice = optarg;
+                }
+                break;
+            case 'b':
+                u32BaudRate = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                pcName = optarg;
+                break;
+            case 's':
+                u32RxSlots = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                u32TxSlots = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                u32ReportSeconds = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                u32LinkCount = 0;
+                optind = argc;
+                break;
+        }
+    }
+
+    /* Both rings wrap with a mask */
+    if(u32LinkCount == 0 || gatewaySpeed(u32BaudRate) == B0 ||
+       u32RxSlots < 2 || (u32RxSlots & (u32RxSlots - 1)) != 0 || u32TxSlots < 2 || (u32TxSlots & (u32TxSlots - 1)) != 0)
+    {
+        fprintf(stderr, "usage: %s -d <device> [-d <device> ...] [-b baud] [-n name] [-s rx slots] [-t tx slots] [-r report seconds]\n"
+                        "slots are powers of two, at most %d devices\n", argv[0], GATEWAY_MAX_LINKS);
+        return 1;
+    }
+
+    fec_init();
+    for(uint32_t u32Link = 0; u32Link < u32LinkCount; u32Link++)
+    {
+        if(gatewayLinkCreateSegment(&asLinks[u32Link], pcName, u32Link, u32BaudRate, u32RxSlots, u32TxSlots) == QUELL_ERROR)
+        {
+            fprintf(stderr, "%s: shared memory /%s.%u: %s\n", asLinks[u32Link].pcDevice, pcName, u32Link, strerror(errno));
+            return 1;
+        }
+        fprintf(stderr, "%s -> %s (%u x %lu bytes)\n", asLinks[u32Link].pcDevice, asLinks[u32Link].acName, asLinks[u32Link].sBus.u32SlotCount, GATEWAY_RX_SLOT_SIZE);
+    }
+
+    signal(SIGINT, gatewaySignal);
+    signal(SIGTERM, gatewaySignal);
+    signal(SIGPIPE, SIG_IGN);
+    u64LastReportMs = gatewayNowMs();
+
+    while(iStop == 0)
+    {
+        uint64_t u64NowMs = gatewayNowMs();
+
+        for(uint32_t u32Link = 0; u32Link < u32LinkCount; u32Link++)
+        {
+            gateway_link_t *psLink = &asLinks[u32Link];
+
+            /* Unplugged boards come back by themselves */
+            if(psLink->iFile < 0 && u64NowMs >= psLink->u64NextOpenMs)
+            {
+                if(gatewayLinkOpenDevice(psLink, u32BaudRate) == QUELL_OK)
+                {
+                    fprintf(stderr, "%s: connected at %u\n", psLink->pcDevice, u32BaudRate);
+                }
+                else
+                {
+                    psLink->u64NextOpenMs = u64NowMs + GATEWAY_REOPEN_MS;
+                }
+            }
+
+            asPoll[u32Link].fd = psLink->iFile;
+            asPoll[u32Link].events = POLLIN;
+            asPoll[u32Link].revents = 0;
+        }
+
+        if(poll(asPoll, u32LinkCount, GATEWAY_POLL_MS) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        u64NowMs = gatewayNowMs();
+
+        for(uint32_t u32Link = 0; u32Link < u32LinkCount; u32Link++)
+        {
+            gateway_link_t *psLink = &asLinks[u32Link];
+
+            if(psLink->iFile < 0)
+            {
+                continue;
+            }
+            if((asPoll[u32Link].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+            {
+                gatewayLinkReceive(psLink);
+            }
+            if(psLink->iFile >= 0)
+            {
+                gatewayLinkTakeClientMessages(psLink, u64NowMs);
+                gatewayLinkTransmit(psLink, u64NowMs);
+            }
+        }
+
+        gatewayRates(u64NowMs, u32ReportSeconds, &u64LastReportMs);
+    }
+
+    /* Clients still mapping a segment keep it until they unmap, they just see no new messages */
+    for(uint32_t u32Link = 0; u32Link < u32LinkCount; u32Link++)
+    {
+        if(asLinks[u32Link].iFile >= 0)
+        {
+            close(asLinks[u32Link].iFile);
+        }
+        asLinks[u32Link].psHeader->sStats.bConnected = false;
+        munmap(asLinks[u32Link].psHeader, asLinks[u32Link].tSegmentSize);
+        shm_unlink(asLinks[u32Link].acName);
+    }
+
+    return 0;
+}
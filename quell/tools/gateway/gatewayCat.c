@@ -0,0 +1,193 @@
+/*
+    GATEWAY CAT (host tool)
+
+    Client of the gateway daemon: prints the messages received on a link (read in place from the shared
+    memory), sends messages to it and shows its throughput.
+
+    Build (from quell/tools/gateway):
+    gcc -O2 -Wall -I. -I../../main -o gatewayCat gatewayCat.c gatewayClient.c ../../main/sampleBus.c
+
+    Usage:
+    gatewayCat [-l /quell.0] [-x] [-q] [-c count] [-w message ...] [-n repeat] [-s]
+    -x hex dump, -q count only (no printing), -c stop after count messages, -w send (-n times, as fast
+    as the Tx slots take them), -s print the link statistics every second instead of the messages.
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include "quell.h"
+#include "gatewayClient.h"
+
+#define CAT_MAX_SENDS (16)
+#define CAT_SEND_RETRY_US (200)
+
+static volatile sig_atomic_t iStop = 0;
+
+static void catSignal(int _iSignal)
+{
+    iStop = 1;
+}
+
+static void catPrint(const uint8_t *_pu8Message, uint16_t _u16Size, bool _bHex)
+{
+    bool bText = (_bHex == false);
+
+    for(uint16_t u16Index = 0; u16Index < _u16Size && bText == true; u16Index++)
+    {
+        bText = (isprint(_pu8Message[u16Index]) != 0);
+    }
+
+    if(bText == true)
+    {
+        printf("%.*s\n", _u16Size, (const char*)_pu8Message);
+        return;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < _u16Size; u16Index++)
+    {
+        printf("%02X%s", _pu8Message[u16Index], (u16Index + 1 < _u16Size) ? " " : "\n");
+    }
+}
+
+static void catStats(gateway_client_t *_psClient)
+{
+    gateway_link_stats_t sStats;
+
+    while(iStop == 0)
+    {
+        sStats = _psClient->psHeader->sStats;
+        printf("%s %s: rx %u B/s %u msg/s tx %u B/s %u msg/s | rx msgs:%llu errors:%llu tx msgs:%llu abandoned:%llu reconnects:%u\n",
+               _psClient->psHeader->acDevice, (sStats.bConnected == true) ? "up" : "down",
+               sStats.u32RxBytesPerSecond, sStats.u32RxMessagesPerSecond, sStats.u32TxBytesPerSecond, sStats.u32TxMessagesPerSecond,
+               (unsigned long long)sStats.u64RxMessages, (unsigned long long)sStats.u64RxErrors,
+               (unsigned long long)sStats.u64TxMessages, (unsigned long long)sStats.u64TxAbandoned, sStats.u32Reconnects);
+        fflush(stdout);
+        sleep(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *pcLink = "/quell.0";
+    const char *apcSend[CAT_MAX_SENDS];
+    uint32_t u32Sends = 0;
+    uint32_t u32Repeat = 1;
+    uint64_t u64Count = 0;
+    uint64_t u64Received = 0;
+    bool bHex = false;
+    bool bQuiet = false;
+    bool bStats = false;
+    gateway_client_t sClient;
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "l:xqc:w:n:s")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'l':
+                pcLink = optarg;
+                break;
+            case 'x':
+                bHex = true;
+                break;
+            case 'q':
+                bQuiet = true;
+                break;
+            case 'c':
+                u64Count = strtoull(optarg, NULL, 0);
+                break;
+            case 'w':
+                if(u32Sends < CAT_MAX_SENDS)
+                {
+                    apcSend[u32Sends++] = optarg;
+                }
+                break;
+            case 'n':
+                u32Repeat = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                bStats = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-l /quell.0] [-x] [-q] [-c count] [-w message ...] [-n repeat] [-s]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(gatewayClient_open(&sClient, pcLink) == QUELL_ERROR)
+    {
+        fprintf(stderr, "%s: no gateway link\n", pcLink);
+        return 1;
+    }
+
+    signal(SIGINT, catSignal);
+    signal(SIGTERM, catSignal);
+
+    if(bStats == true)
+    {
+        catStats(&sClient);
+        gatewayClient_close(&sClient);
+        return 0;
+    }
+
+    /* Sending only: done once everything is in the Tx slots */
+    if(u32Sends > 0)
+    {
+        for(uint32_t u32Round = 0; u32Round < u32Repeat && iStop == 0; u32Round++)
+        {
+            for(uint32_t u32Send = 0; u32Send < u32Sends && iStop == 0; )
+            {
+                if(gatewayClient_send(&sClient, (const uint8_t*)apcSend[u32Send], strlen(apcSend[u32Send])) == QUELL_OK)
+                {
+                    u32Send++;
+                }
+                else
+                {
+                    usleep(CAT_SEND_RETRY_US);
+                }
+            }
+        }
+        if(u64Count == 0)
+        {
+            gatewayClient_close(&sClient);
+            return 0;
+        }
+    }
+
+    while(iStop == 0 && (u64Count == 0 || u64Received < u64Count))
+    {
+        if(gatewayClient_peek(&sClient, &pu8Message, &u16Size) == QUELL_ERROR)
+        {
+            gatewayClient_wait(&sClient, 100);
+            continue;
+        }
+
+        /* Printed from the shared slot, only kept if release says it was not overwritten meanwhile */
+        if(bQuiet == false)
+        {
+            catPrint(pu8Message, u16Size, bHex);
+        }
+        if(gatewayClient_release(&sClient) == QUELL_OK)
+        {
+            u64Received++;
+        }
+        else if(bQuiet == false)
+        {
+            printf("(overwritten while printed, discard the line above)\n");
+        }
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "%llu messages, %u dropped (too slow)\n", (unsigned long long)u64Received, sClient.sSubscriber.u32Dropped);
+    gatewayClient_close(&sClient);
+
+    return 0;
+}
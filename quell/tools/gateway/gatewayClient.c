@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "gatewayClient.h"
+#include "quell.h"
+
+int32_t gatewayClient_open(gateway_client_t *_psClient, const char *_pcName)
+{
+    struct stat sStat;
+    gateway_shm_header_t *psHeader;
+    int iFile;
+
+    if(_psClient == NULL || _pcName == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    memset(_psClient, 0, sizeof(gateway_client_t));
+
+    iFile = shm_open(_pcName, O_RDWR, 0);
+    if(iFile < 0)
+    {
+        return QUELL_ERROR;
+    }
+    if(fstat(iFile, &sStat) != 0 || (size_t)sStat.st_size < sizeof(gateway_shm_header_t))
+    {
+        close(iFile);
+        return QUELL_ERROR;
+    }
+
+    psHeader = mmap(NULL, sStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, iFile, 0);
+    close(iFile);
+    if(psHeader == MAP_FAILED)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* The daemon writes the magic last, a segment still being set up is refused */
+    if(__atomic_load_n(&psHeader->u32Magic, __ATOMIC_ACQUIRE) != GATEWAY_SHM_MAGIC ||
+       psHeader->u32Version != GATEWAY_SHM_VERSION || psHeader->u32SegmentSize != (uint32_t)sStat.st_size ||
+       psHeader->u32RxOffset + psHeader->u32RxSize > psHeader->u32SegmentSize ||
+       psHeader->u32TxOffset + (uint64_t)psHeader->u32TxSlotCount * sizeof(gateway_tx_slot_t) > psHeader->u32SegmentSize ||
+       psHeader->u32TxSlotCount == 0 || (psHeader->u32TxSlotCount & (psHeader->u32TxSlotCount - 1)) != 0 ||
+       sampleBus_init(&_psClient->sBus, (uint8_t*)psHeader + psHeader->u32RxOffset, psHeader->u32RxSize, psHeader->u16RxSlotSize) == QUELL_ERROR)
+    {
+        munmap(psHeader, sStat.st_size);
+        return QUELL_ERROR;
+    }
+
+    _psClient->psHeader = psHeader;
+    _psClient->tSize = sStat.st_size;
+    _psClient->psTxSlots = (gateway_tx_slot_t*)((uint8_t*)psHeader + psHeader->u32TxOffset);
+
+    /* Same buffer size, same slot count as the daemon bus; reading starts with the next message */
+    _psClient->sBus.u32Head = __atomic_load_n(&psHeader->u32RxHead, __ATOMIC_ACQUIRE);
+    return sampleBus_subscribe(&_psClient->sBus, &_psClient->sSubscriber);
+}
+
+void gatewayClient_close(gateway_client_t *_psClient)
+{
+    if(_psClient != NULL && _psClient->psHeader != NULL)
+    {
+        munmap(_psClient->psHeader, _psClient->tSize);
+        _psClient->psHeader = NULL;
+    }
+}
+
+/* Points at the oldest unread message inside the shared memory, valid until release */
+int32_t gatewayClient_peek(gateway_client_t *_psClient, const uint8_t **_ppu8Message, uint16_t *_pu16Size)
+{
+    if(_psClient == NULL || _psClient->psHeader == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    _psClient->sBus.u32Head = __atomic_load_n(&_psClient->psHeader->u32RxHead, __ATOMIC_ACQUIRE);
+    return sampleBus_peek(&_psClient->sSubscriber, _ppu8Message, _pu16Size);
+}
+
+/* QUELL_ERROR: the daemon overwrote the message while it was read, discard what was read */
+int32_t gatewayClient_release(gateway_client_t *_psClient)
+{
+    if(_psClient == NULL || _psClient->psHeader == NULL)
+    {
+        return QUELL_ERROR;
+    }
+
+    /* Reads of the slot are done before the head is looked at again */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    _psClient->sBus.u32Head = __atomic_load_n(&_psClient->psHeader->u32RxHead, __ATOMIC_RELAXED);
+    return sampleBus_release(&_psClient->sSubscriber);
+}
+
+/* Sleeps until a message is there to peek (QUELL_OK) or the timeout (QUELL_ERROR) */
+int32_t gatewayClient_wait(gateway_client_t *_psClient, uint32_t _u32TimeoutMs)
+{
+    struct timespec sTimeout = {.tv_sec = _u32TimeoutMs / 1000, .tv_nsec = (_u32TimeoutMs % 1000) * 1000000L};
+    gateway_shm_header_t *psHeader;
+    uint32_t u32Cursor;
+
+    if(_psClient == NULL || _psClient->psHeader == NULL)
+    {
+        return QUELL_ERROR;
+    }
+    psHeader = _psClient->psHeader;
+    u32Cursor = _psClient->sSubscriber.u32Cursor;
+
+    /* Counted before the head is checked, the daemon checks the other way round, so one of them sees the other */
+    __atomic_add_fetch(&psHeader->u32RxWaiters, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&psHeader->u32RxHead, __ATOMIC_SEQ_CST) == u32Cursor)
+    {
+        syscall(SYS_futex, &psHeader->u32RxHead, FUTEX_WAIT, u32Cursor, &sTimeout, NULL, 0);
+    }
+    __atomic_sub_fetch(&psHeader->u32RxWaiters, 1, __ATOMIC_SEQ_CST);
+
+    return (__atomic_load_n(&psHeader->u32RxHead, __ATOMIC_ACQUIRE) != u32Cursor) ? QUELL_OK : QUELL_ERROR;
+}
+
+/* QUELL_ERROR when the message is too big or all Tx slots wait for the daemon */
+int32_t gatewayClient_send(gateway_client_t *_psClient, const uint8_t *_pu8Message, uint16_t _u16Size)
+{
+    gateway_shm_header_t *psHeader;
+    gateway_tx_slot_t *psSlot;
+    uint32_t u32Reserve;
+
+    if(_psClient == NULL || _psClient->psHeader == NULL || _pu8Message == NULL || _u16Size == 0 || _u16Size > GATEWAY_MESSAGE_SIZE)
+    {
+        return QUELL_ERROR;
+    }
+    psHeader = _psClient->psHeader;
+
+    /* Reserve the next sequence, unless that would pass the daemon a whole ring */
+    u32Reserve = __atomic_load_n(&psHeader->u32TxReserve, __ATOMIC_ACQUIRE);
+    do
+    {
+        if(u32Reserve - __atomic_load_n(&psHeader->u32TxTail, __ATOMIC_ACQUIRE) >= psHeader->u32TxSlotCount)
+        {
+            return QUELL_ERROR;
+        }
+    }while(__atomic_compare_exchange_n(&psHeader->u32TxReserve, &u32Reserve, u32Reserve + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == false);
+
+    psSlot = &_psClient->psTxSlots[u32Reserve & (psHeader->u32TxSlotCount - 1)];
+    psSlot->u16Size = _u16Size;
+    memcpy(psSlot->au8Message, _pu8Message, _u16Size);
+    __atomic_store_n(&psSlot->u32Sequence, u32Reserve + 1, __ATOMIC_RELEASE);
+
+    return QUELL_OK;
+}
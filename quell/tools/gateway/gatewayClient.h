@@ -0,0 +1,35 @@
+#ifndef _GATEWAY_CLIENT_H_
+#define _GATEWAY_CLIENT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sampleBus.h"
+#include "gatewayShm.h"
+
+/*
+    GATEWAY CLIENT
+
+    Maps the shared memory of one gateway link (gatewayShm.h). Received messages are read in place with
+    peek/release, exactly as a sample bus subscriber (a slow client loses the oldest messages, never
+    slows the daemon or the other clients). Send hands a message to the daemon, which frames it to the
+    link.
+*/
+
+typedef struct
+{
+    gateway_shm_header_t *psHeader;
+    size_t tSize;
+    sample_bus_t sBus;                  //Over this process mapping, its head refreshed from the header
+    sample_bus_subscriber_t sSubscriber;
+    gateway_tx_slot_t *psTxSlots;
+}gateway_client_t;
+
+int32_t gatewayClient_open(gateway_client_t *_psClient, const char *_pcName);
+void gatewayClient_close(gateway_client_t *_psClient);
+int32_t gatewayClient_peek(gateway_client_t *_psClient, const uint8_t **_ppu8Message, uint16_t *_pu16Size);
+int32_t gatewayClient_release(gateway_client_t *_psClient);
+int32_t gatewayClient_wait(gateway_client_t *_psClient, uint32_t _u32TimeoutMs);
+int32_t gatewayClient_send(gateway_client_t *_psClient, const uint8_t *_pu8Message, uint16_t _u16Size);
+
+#endif /* _GATEWAY_CLIENT_H_ */
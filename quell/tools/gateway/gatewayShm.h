@@ -0,0 +1,86 @@
+#ifndef _GATEWAY_SHM_H_
+#define _GATEWAY_SHM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "messages.h"
+
+/*
+    GATEWAY SHARED MEMORY LAYOUT
+
+    One POSIX shared memory object per link ("/<name>.<link>", e.g. /quell.0), created by the gateway
+    daemon and mapped by any number of local clients.
+
+    SEGMENT ITEM:           LENGTH:                             DESCRIPTION:
+    Header                  sizeof(gateway_shm_header_t)        Layout, heads and link statistics
+    Rx bus                  SAMPLE_BUS_BUFFER_SIZE(slot, count) Sample bus slots and sizes (main/sampleBus.h)
+    Tx slots                u32TxSlotCount x gateway_tx_slot_t  Messages from the clients to the link
+
+    Rx: the daemon runs a sample bus over the Rx bus area (processIncomingCommunication extracts every
+    message straight into a slot) and mirrors its head into u32RxHead. A client builds the same bus over
+    its own mapping and reads the slots in place with the sample bus peek/release, refreshing the head
+    from u32RxHead. Clients that wait sleep on a futex on u32RxHead.
+
+    Tx: many clients, one daemon. A client reserves a sequence by moving u32TxReserve (never more than
+    u32TxSlotCount ahead of u32TxTail), fills the slot and publishes it by writing the sequence + 1 in
+    u32Sequence. The daemon takes the slots in order and moves u32TxTail.
+*/
+
+#define GATEWAY_SHM_MAGIC (0x51475731UL)    //"QGW1"
+#define GATEWAY_SHM_VERSION (1UL)
+#define GATEWAY_SHM_ALIGN (64UL)            //Cache line, the heads written by different processes never share one
+#define GATEWAY_MESSAGE_SIZE (MESSAGES_MAX_SIZE) //Biggest message the firmware takes (messages.schema)
+
+typedef struct
+{
+    uint64_t u64RxBytes;
+    uint64_t u64TxBytes;
+    uint64_t u64RxMessages;         //Published on the Rx bus
+    uint64_t u64RxErrors;           //Packets dropped by verifyPacket
+    uint64_t u64TxMessages;         //Client messages framed to the link
+    uint64_t u64TxAbandoned;        //Slots reserved by a client that never published them
+    uint32_t u32RxBytesPerSecond;   //Over the last second
+    uint32_t u32TxBytesPerSecond;
+    uint32_t u32RxMessagesPerSecond;
+    uint32_t u32TxMessagesPerSecond;
+    uint32_t u32Reconnects;
+    bool bConnected;
+}gateway_link_stats_t;
+
+typedef struct
+{
+    volatile uint32_t u32Sequence;  //Sequence + 1 once the message is complete
+    uint16_t u16Size;
+    uint8_t au8Message[GATEWAY_MESSAGE_SIZE];
+}gateway_tx_slot_t;
+
+typedef struct
+{
+    /* Layout, written once by the daemon before u32Magic */
+    volatile uint32_t u32Magic;
+    uint32_t u32Version;
+    uint32_t u32DaemonPid;
+    uint32_t u32BaudRate;
+    char acDevice[64];
+    uint32_t u32SegmentSize;
+    uint32_t u32RxOffset;
+    uint32_t u32RxSize;
+    uint16_t u16RxSlotSize;
+    uint32_t u32TxOffset;
+    uint32_t u32TxSlotCount;
+
+    /* Rx: daemon writes the head, waiting clients count themselves so the daemon only wakes when needed */
+    volatile uint32_t u32RxHead __attribute__((aligned(GATEWAY_SHM_ALIGN)));
+    volatile uint32_t u32RxWaiters __attribute__((aligned(GATEWAY_SHM_ALIGN)));
+
+    /* Tx: clients move the reserve, the daemon the tail */
+    volatile uint32_t u32TxReserve __attribute__((aligned(GATEWAY_SHM_ALIGN)));
+    volatile uint32_t u32TxTail __attribute__((aligned(GATEWAY_SHM_ALIGN)));
+
+    /* Written by the daemon only, clients read it as a snapshot that may be a little torn */
+    gateway_link_stats_t sStats __attribute__((aligned(GATEWAY_SHM_ALIGN)));
+}gateway_shm_header_t;
+
+#define GATEWAY_SHM_ROUND(size) (((size) + GATEWAY_SHM_ALIGN - 1) & ~(GATEWAY_SHM_ALIGN - 1))
+
+#endif /* _GATEWAY_SHM_H_ */
@@ -0,0 +1,1589 @@
+/*
+    LINK SIMULATOR (host tool)
+
+    Several units running the firmware link code (protocol.c, txScheduler.c, tdma.c, router.c) the way
+    protocol_io_task and protocol_task do, each on a 1 ms tick of its own clock (-d: every other node
+    runs that many ppm fast, the rest as many slow). The wire is modelled byte by byte at the baud rate.
+
+    Bus (default): all units on one simulated half-duplex bus with TDMA slots. A node starting a byte
+    while another one drives the bus is a collision, and both bytes reach the receivers garbled. -a
+    switches the slots off (everybody sends as soon as it has a frame) to show what the schedule prevents.
+
+    Chain (-c): units in a line (hand ... elbow - chest), full duplex point to point links with credits
+    between neighbours, frames for others cut through by the units in between (-w: store and forward
+    instead). The hop latency is measured on the wires: from the first byte of a frame arriving at a unit
+    to its first byte leaving on the next link, for the imu frames.
+
+    The master (address 0) sends "marco" to every node twice a second and counts the "polo" answers
+    (both on the control lanes),
+    every node streams imu messages to the master at -r messages per second (0: as many as its slots
+    take). Traffic stops half a second before the end so everything queued can arrive. Reports per node
+    the messages offered, delivered and their latency, the wire throughput against what its slots
+    guarantee (bus) or its hop latency (chain). Exit status 1 when a check fails (not with -a): any
+    collision or CRC error, a message or answer missing, a saturated bus node below 95% of its share, or
+    a cut through hop slower on average than a whole frame on the wire.
+
+    Link bench (linkBench.c, the code behind the terminal "bench" and "load"): -P pings the farthest
+    node that many times, -L streams bench messages to it at that rate (0: as fast as the link takes them)
+    until the drain, both with -z byte messages (IMU size by default); -q leaves the imu traffic out (the
+    marcos stay). The results are printed as the firmware prints them, and the control round trip of every
+    node (marco queued to polo back) under that bulk load. Exit status 1 as well when a pong is lost, the
+    receiver report is missing or does not match what was sent, or (chain) a control round trip took
+    longer than what the credits, the forward lane and a frame on the wire hold back on every hop.
+
+    Link speed (linkSpeed.c, chain only): -S lets every link step up to that baud rate. The wire corrupts
+    a byte with probability 1e-3 x (baud / knee)^6, -e sets the knee (0: no errors) and -E <s>:<knee> moves
+    it at that second (a cable going bad), bytes between units at different rates arrive garbled. Every
+    rate change is printed as it happens. The lanes are quiet while a step is negotiated, messages the
+    source could not queue meanwhile are not failures, nor are CRC errors, the hop latency (frames wait
+    for the quiet link) or frames a router dropped because the link behind a quiet one backed up. Exit
+    status 1 as well when the two ends of a link disagree at the end, or (without -e and -E) more
+    messages and answers are missing than the routers dropped.
+
+    Congestion control (congestion.c): -A gives every node an imu stream of 4 x -r samples per second,
+    resampled to the rate its controller picks from the health of its link toward the master, each
+    message carrying the batch congestion_getBatch allows at that rate. Routers quench the sources of
+    frames they drop or mark as the firmware does. Every rate change is printed, and per node the samples
+    offered and delivered against the full rate. A frame dropped by a router fails the run, and a node
+    whose average latency exceeds twice CONGESTION_MAX_DELAY_US fails (e.g. linkSim -c -n 5 -r 60 -A,
+    against the same run without -A).
+
+    Slow consumer (-K <bytes/s>[:<stall ms>], chain only): the processing of the farthest node takes at
+    most that many bytes a second out of its FIFO Rx, and none at all for the first stall ms of every
+    second, so the credits have to hold the sender back (e.g. linkSim -c -n 2 -q -L 0 -K 2000:800). The
+    run goes on after -t until what queued on the way could reach it. Prints what the consumer took while
+    the traffic ran against its rate. Exit status 1 as well when a byte did not fit a FIFO Rx anywhere,
+    credits included, a frame was dropped on the way (a router in between waits for the credit, up to
+    ROUTER_CREDIT_US) or, under -L 0, the consumer took less than its rate between the stalls. The hop
+    latency is not checked (the frames wait for the consumer, not for cut through); the other checks still
+    hold, so the traffic has to fit what the consumer takes.
+
+    Tunnels (-T, chain only, channel.c): every unit but the master keeps its log tunnel full, and the
+    master and the last unit hold a terminal session, both ways full, sent and read as protocol_task does.
+    The same run goes first without them. Prints per node the tunnel bytes delivered against their caps,
+    the messages lost and, for the imu, what the run without tunnels delivered. Exit status 1 as well when
+    a tunnel in use delivered nothing or more than its cap, more messages were lost than the routers
+    yielded (tunnel frames with no room on a busy link are thrown away, on purpose), the imu delivery
+    changed, the average latency of a node grew by more than a tunnel frame on the wire per hop or its
+    maximum by more than that and an imu frame (the frame of a unit further out, held back by a tunnel
+    frame, may then go first), or the data alone overloads the chain (e.g. linkSim -c -n 5 -r 25 -T).
+
+    Capture (-C <file>): every byte received and sent on every port, in the QCAP format of capture.h, as
+    the terminal "capture" records a uart. Timestamps are the simulation time, link n x ROUTER_MAX_PORTS
+    + port + 1 is port of node n (the master's link is 1, as its UART1), so "qcapReplay -l 3 <file>" runs
+    what node 1 received from the master through the parser.
+
+    Build (from quell/tools/linksim):
+    gcc -O2 -Wall -I../host -I../../main -I../../main/ProtocolTask -o linkSim linkSim.c \
+        ../../main/FIFO.c ../../main/capture.c ../../main/crc.c ../../main/fec.c ../../main/sampleBus.c ../../main/messages.c \
+        ../../main/ProtocolTask/protocol.c ../../main/ProtocolTask/flowControl.c ../../main/ProtocolTask/tdma.c ../../main/ProtocolTask/router.c ../../main/ProtocolTask/linkBench.c ../../main/ProtocolTask/linkSpeed.c ../../main/ProtocolTask/channel.c ../../main/ProtocolTask/congestion.c \
+        ../../main/ProtocolTask/txScheduler.c -lm
+
+    Usage:
+    linkSim [-n nodes] [-b baud] [-s slot us] [-g guard us] [-r messages/s] [-t seconds] [-d ppm] [-a] [-c [-w]]
+            [-P pings | -L messages/s] [-z bytes] [-q] [-S max baud] [-e knee baud] [-E seconds:knee baud] [-A]
+            [-K bytes/s[:stall ms]] [-T] [-C capture file]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "quell.h"
+#include "FIFO.h"
+#include "protocol.h"
+#include "txScheduler.h"
+#include "tdma.h"
+#include "router.h"
+#include "linkBench.h"
+#include "linkSpeed.h"
+#include "congestion.h"
+#include "channel.h"
+#include "capture.h"
+#include "messages.h"
+
+#define SIM_MAX_NODES (MESSAGE_TDMA_MAX_SLOTS)
+#define SIM_TICK_NS (1000000ULL)            //TASK_POLL_TICKS at 1000 Hz
+#define SIM_RX_FIFO_SIZE (512UL)            //As in protocolTask.c
+#define SIM_RX_CREDIT_RESERVE (4 * PACKE_SIZE(MESSAGE_CREDIT_SIZE))
+#define SIM_CONTROL_LANE_SIZE (128UL)
+#define SIM_BULK_LANE_SIZE (512UL)
+#define SIM_FORWARD_LANE_SIZE (512UL)
+#define SIM_TUNNEL_LANE_SIZE (256UL)
+#define SIM_MAX_CONTROL_BURST (4)
+#define SIM_UART_TX_SIZE (1024UL)           //Driver Tx buffer
+#define SIM_BUS_SLOT_SIZE (64UL)
+#define SIM_BUS_SLOT_COUNT (32UL)
+#define SIM_MARCO_PERIOD_US (500000ULL)
+#define SIM_MARCOS (8)                      //Marcos waiting for their polo at most
+#define SIM_DRAIN_US (500000ULL)           //No new traffic at the end
+#define SIM_IMU_PERIOD_US (10000U)          //100 Hz, 4 samples per message
+#define SIM_GARBLE (0xA5)
+#define SIM_KEY_SIZE (16)                   //Frame bytes that tell frames apart (imu: addresses and timestamp)
+#define SIM_PENDING_HOPS (32)
+#define SIM_CAPTURE_SIZE (64UL * 1024UL * 1024UL)
+#define SIM_CAPTURE_CHUNK (256)             //Bytes of a record at most, a record also ends where the wire went idle
+#define SIM_TERMINAL_TX_SIZE (512UL)        //Tunnel buffers, as in protocolTask.c
+#define SIM_TERMINAL_RX_SIZE (256UL)
+#define SIM_LOG_TX_SIZE (1024UL)
+#define SIM_LOG_RX_SIZE (512UL)
+#define SIM_TUNNEL_LINE (64)                //Bytes a line written to a tunnel
+
+/* Frames on one direction of a wire, told apart by their first bytes */
+typedef struct
+{
+    uint16_t u16Remaining;          //Bytes of the frame still to come, 0 between frames
+    uint16_t u16Length;
+    uint16_t u16Have;
+    uint8_t au8Key[SIM_KEY_SIZE];
+    uint64_t u64StartNs;
+}sim_tracker_t;
+
+/* Bytes of one direction of a port waiting to become a capture record */
+typedef struct
+{
+    uint8_t au8Data[SIM_CAPTURE_CHUNK];
+    uint16_t u16Length;
+    uint64_t u64StartNs;
+    uint64_t u64LastNs;
+}sim_chunk_t;
+
+typedef struct
+{
+    bool bUsed;
+    uint8_t au8Key[SIM_KEY_SIZE];
+    uint64_t u64ArrivedNs;
+}sim_pending_t;
+
+/* What -T compares with the run without tunnels */
+typedef struct
+{
+    uint32_t u32Offered;
+    uint32_t u32Delivered;
+    uint64_t u64LatencyUs;
+    uint32_t u32MaxLatencyUs;
+}sim_baseline_t;
+
+typedef struct sim_node_s sim_node_t;
+typedef struct sim_port_s sim_port_t;
+
+struct sim_port_s
+{
+    sim_node_t *psNode;
+    sim_port_t *psPeer;             //Other end of a chain link, NULL on the bus (everybody hears)
+
+    /* Firmware state, as in protocolTask.c */
+    fifo_t sFIFORx;
+    char acFIFORx[SIM_RX_FIFO_SIZE];
+    tx_scheduler_t sTxScheduler;
+    char acControl[SIM_CONTROL_LANE_SIZE];
+    char acBulk[SIM_BULK_LANE_SIZE];
+    char acForward[SIM_FORWARD_LANE_SIZE];
+    char acTunnel[SIM_TUNNEL_LANE_SIZE];
+    protocol_link_t sLink;
+    link_bench_t sBench;
+    link_speed_t sSpeed;
+
+    /* Uart Tx and the wire */
+    uint32_t u32Baud;
+    uint64_t u64ByteNs;
+    fifo_t sUartTx;
+    char acUartTx[SIM_UART_TX_SIZE];
+    bool bDriving;
+    bool bCollided;
+    char cByte;
+    uint64_t u64ByteEndNs;
+    uint32_t u32RxOverflows;
+    uint32_t u32TxBytes;
+    sim_tracker_t sRxTracker;
+    sim_tracker_t sTxTracker;
+    sim_chunk_t asCapture[2];       //Rx, Tx
+};
+
+struct sim_node_s
+{
+    uint8_t u8Address;
+    int32_t i32DriftPpm;
+    uint64_t u64NextTickNs;
+    sim_port_t asPorts[ROUTER_MAX_PORTS];
+    uint8_t u8Ports;
+
+    tdma_t sTdma;
+    router_t sRouter;
+    sample_bus_t sBus;
+    uint8_t au8Bus[SAMPLE_BUS_BUFFER_SIZE(SIM_BUS_SLOT_SIZE, SIM_BUS_SLOT_COUNT)];
+    sample_bus_subscriber_t sSubscriber;
+
+    /* Traffic (of this node, counted at the master) */
+    uint64_t u64NextMessageUs;
+    uint32_t u32Offered;
+    uint32_t u32SourceDrops;        //Bulk lane full
+    uint32_t u32Delivered;
+    uint64_t u64LatencyUs;
+    uint32_t u32MaxLatencyUs;
+    uint32_t u32Marcos;
+    uint32_t u32Polos;
+    uint64_t au64MarcoNs[SIM_MARCOS];   //When the marcos were queued, polo n closes the control round trip of marco n
+    uint64_t u64ControlNs;
+    uint64_t u64MaxControlNs;
+
+    /* Congestion control of the imu stream (-A) */
+    congestion_t sCongestion;
+    uint16_t u16QuenchPending;
+    uint32_t au32QuenchUs[ROUTER_MAX_ADDRESSES];
+    uint32_t u32SamplesOffered;
+    uint32_t u32SamplesDelivered;
+
+    /* Frames of others through this node (chain) */
+    sim_pending_t asPending[SIM_PENDING_HOPS];
+    uint32_t u32Hops;
+    uint64_t u64HopNs;
+    uint64_t u64MinHopNs;
+    uint64_t u64MaxHopNs;
+
+    /* Slow consumer (-K): bytes its processing may still take this tick, and took (in all, while the traffic ran) */
+    double dConsumerBudget;
+    uint64_t u64Consumed;
+    uint64_t u64ConsumedInTraffic;
+
+    /* Terminal and log tunnels (-T), as protocolTask.c runs them */
+    channel_mux_t sChannels;
+    char acTerminalTx[SIM_TERMINAL_TX_SIZE];
+    char acTerminalRx[SIM_TERMINAL_RX_SIZE];
+    char acLogTx[SIM_LOG_TX_SIZE];
+    char acLogRx[SIM_LOG_RX_SIZE];
+    uint32_t au32TunnelDelivered[CHANNEL_TUNNELS];     //Data bytes of this node read out at the peer
+};
+
+static sim_node_t asNodes[SIM_MAX_NODES];
+static sim_node_t *psCurrent;       //Node whose code is running, for the clock
+static uint8_t u8Nodes = 3;
+static uint32_t u32Baud = 115200;
+static uint64_t u64ByteNs;
+static uint64_t u64NowNs;
+static uint64_t u64EndNs;
+static uint64_t u64TrafficEndNs;       //Then no new traffic, everything queued has until u64EndNs to arrive
+static uint32_t u32Rate = 25;
+static bool bAloha = false;
+static bool bChain = false;
+static bool bStoreAndForward = false;
+static bool bQuiet = false;
+static bool bAdaptive = false;
+static uint32_t u32MaxBaud = 0;         //Link speed negotiation, 0 off
+static double dKneeBaud = 0;
+static double dKneeLaterBaud = 0;
+static uint64_t u64KneeChangeNs = UINT64_MAX;
+static uint32_t u32ConsumerRate = 0;    //Bytes a second the processing of the farthest node takes, 0 no limit
+static uint32_t u32ConsumerStallMs = 0;
+static bool bTunnels = false;
+static capture_t sCapture;
+static bool bCapture = false;
+static uint64_t u64Random;
+static uint64_t u64Collisions;
+static uint64_t u64BusyNs;
+
+/* Local clock of the node running, drifting from the simulation time */
+static uint32_t simNowUs(void)
+{
+    int64_t i64Drift = ((int64_t)u64NowNs * psCurrent->i32DriftPpm) / 1000000LL;
+    return (uint32_t)((u64NowNs + i64Drift) / 1000ULL);
+}
+
+/* xorshift64, the same run every time */
+static double simRandom(void)
+{
+    u64Random ^= u64Random << 13;
+    u64Random ^= u64Random >> 7;
+    u64Random ^= u64Random << 17;
+    return (u64Random >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* The cable: bytes get worse fast once the rate passes the knee */
+static bool simCorrupted(uint32_t _u32Baud)
+{
+    double dKnee = (u64NowNs >= u64KneeChangeNs) ? dKneeLaterBaud : dKneeBaud;
+
+    return dKnee > 0 && simRandom() < 1e-3 * pow(_u32Baud / dKnee, 6);
+}
+
+/* The capture record of a port and direction so far */
+static void simCaptureFlush(sim_port_t *_psPort, bool _bTx)
+{
+    sim_chunk_t *psChunk = &_psPort->asCapture[(_bTx == true) ? 1 : 0];
+    uint8_t u8Link = (uint8_t)((_psPort->psNode - asNodes) * ROUTER_MAX_PORTS + (_psPort - _psPort->psNode->asPorts) + 1);
+
+    if(psChunk->u16Length > 0)
+    {
+        capture_append(&sCapture, (uint32_t)(psChunk->u64StartNs / 1000ULL), u8Link, _bTx, psChunk->au8Data, psChunk->u16Length);
+        psChunk->u16Length = 0;
+    }
+}
+
+/* A byte on the wire of a port, a record holds the bytes back to back */
+static void simCaptureByte(sim_port_t *_psPort, bool _bTx, char _cByte)
+{
+    sim_chunk_t *psChunk = &_psPort->asCapture[(_bTx == true) ? 1 : 0];
+
+    if(bCapture == false)
+    {
+        return;
+    }
+    if(psChunk->u16Length == SIM_CAPTURE_CHUNK || (psChunk->u16Length > 0 && u64NowNs - psChunk->u64LastNs > 2 * _psPort->u64ByteNs))
+    {
+        simCaptureFlush(_psPort, _bTx);
+    }
+    if(psChunk->u16Length == 0)
+    {
+        psChunk->u64StartNs = u64NowNs;
+    }
+    psChunk->au8Data[psChunk->u16Length++] = (uint8_t)_cByte;
+    psChunk->u64LastNs = u64NowNs;
+}
+
+static uint64_t simTickNs(sim_node_t *_psNode)
+{
+    return (SIM_TICK_NS * 1000000ULL) / (uint64_t)(1000000LL + _psNode->i32DriftPpm);
+}
+
+static uint16_t simImuFrameSize(void)
+{
+    return ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_IMU_MAX_SIZE));
+}
+
+static int32_t simInitPort(sim_port_t *_psPort, sim_node_t *_psNode)
+{
+    _psPort->psNode = _psNode;
+
+    if(FIFO_init(&_psPort->sFIFORx, _psPort->acFIFORx, sizeof(_psPort->acFIFORx)) == false ||
+       FIFO_init(&_psPort->sUartTx, _psPort->acUartTx, sizeof(_psPort->acUartTx)) == false ||
+       txScheduler_init(&_psPort->sTxScheduler, _psPort->acControl, sizeof(_psPort->acControl), _psPort->acBulk, sizeof(_psPort->acBulk), SIM_MAX_CONTROL_BURST) == QUELL_ERROR ||
+       protocolLink_init(&_psPort->sLink, SIM_RX_FIFO_SIZE, SIM_RX_CREDIT_RESERVE) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+    _psPort->sLink.psBus = &_psNode->sBus;
+    linkBench_init(&_psPort->sBench, simNowUs);
+    _psPort->sLink.psBench = &_psPort->sBench;
+    _psPort->u32Baud = u32Baud;
+    _psPort->u64ByteNs = u64ByteNs;
+
+    if(u32MaxBaud > 0)
+    {
+        if(linkSpeed_init(&_psPort->sSpeed, u32MaxBaud, _psNode->u8Address, simNowUs) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        _psPort->sLink.psSpeed = &_psPort->sSpeed;
+    }
+
+    return QUELL_OK;
+}
+
+static int32_t simInitNode(sim_node_t *_psNode, uint8_t _u8Address, int32_t _i32DriftPpm)
+{
+    memset(_psNode, 0, sizeof(sim_node_t));
+    _psNode->u8Address = _u8Address;
+    _psNode->i32DriftPpm = _i32DriftPpm;
+    _psNode->u64NextTickNs = (uint64_t)_u8Address * 137000ULL;     //Ticks and traffic out of step
+    _psNode->u64NextMessageUs = (uint64_t)_u8Address * 3100ULL;
+    _psNode->u64MinHopNs = UINT64_MAX;
+    psCurrent = _psNode;
+    congestion_init(&_psNode->sCongestion, simNowUs);
+
+    /* On a chain the units at both ends have one neighbour */
+    _psNode->u8Ports = (bChain == true && _u8Address > 0 && _u8Address < u8Nodes - 1) ? 2 : 1;
+
+    if(sampleBus_init(&_psNode->sBus, _psNode->au8Bus, sizeof(_psNode->au8Bus), SIM_BUS_SLOT_SIZE) == QUELL_ERROR ||
+       sampleBus_subscribe(&_psNode->sBus, &_psNode->sSubscriber) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+
+    for(uint8_t u8Port = 0; u8Port < _psNode->u8Ports; u8Port++)
+    {
+        if(simInitPort(&_psNode->asPorts[u8Port], _psNode) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    if(bChain == false)
+    {
+        return (tdma_init(&_psNode->sTdma, _u8Address, u32Baud, simNowUs) == QUELL_ERROR ||
+                protocolLink_initBus(&_psNode->asPorts[0].sLink, _u8Address, &_psNode->sTdma) == QUELL_ERROR) ? QUELL_ERROR : QUELL_OK;
+    }
+
+    /* Port 0 leads to the chest, as in protocolTaskInit */
+    if(router_init(&_psNode->sRouter, _u8Address, 0, simNowUs) == QUELL_ERROR)
+    {
+        return QUELL_ERROR;
+    }
+    for(uint8_t u8Port = 0; u8Port < _psNode->u8Ports; u8Port++)
+    {
+        sim_port_t *psPort = &_psNode->asPorts[u8Port];
+
+        if(txScheduler_initForward(&psPort->sTxScheduler, psPort->acForward, sizeof(psPort->acForward), psPort->acTunnel, sizeof(psPort->acTunnel)) == QUELL_ERROR ||
+           protocolLink_initAddressed(&psPort->sLink, _u8Address) == QUELL_ERROR ||
+           router_attachPort(&_psNode->sRouter, u8Port, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_FORWARD), txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_TUNNEL),
+                             bStoreAndForward) == QUELL_ERROR ||
+           protocolLink_initRouted(&psPort->sLink, &_psNode->sRouter, u8Port) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+    }
+
+    /* The units send their terminal output and logs to the master, the master its terminal to the farthest unit */
+    if(bTunnels == true)
+    {
+        uint8_t u8Peer = (_u8Address == ADDRESS_MASTER) ? u8Nodes - 1 : ADDRESS_MASTER;
+
+        if(channel_init(&_psNode->sChannels, simNowUs) == QUELL_ERROR ||
+           channel_initTunnel(&_psNode->sChannels, MESSAGE_CHANNEL_TERMINAL, _psNode->acTerminalTx, SIM_TERMINAL_TX_SIZE, _psNode->acTerminalRx, SIM_TERMINAL_RX_SIZE, CHANNEL_TERMINAL_CAP) == QUELL_ERROR ||
+           channel_initTunnel(&_psNode->sChannels, MESSAGE_CHANNEL_LOG, _psNode->acLogTx, SIM_LOG_TX_SIZE, _psNode->acLogRx, SIM_LOG_RX_SIZE, CHANNEL_LOG_CAP) == QUELL_ERROR)
+        {
+            return QUELL_ERROR;
+        }
+        channel_setPeer(&_psNode->sChannels, MESSAGE_CHANNEL_TERMINAL, u8Peer);
+        channel_setPeer(&_psNode->sChannels, MESSAGE_CHANNEL_LOG, u8Peer);
+        for(uint8_t u8Port = 0; u8Port < _psNode->u8Ports; u8Port++)
+        {
+            _psNode->asPorts[u8Port].sLink.psChannels = &_psNode->sChannels;
+        }
+    }
+
+    return QUELL_OK;
+}
+
+/* Feeds one byte of a wire direction, true when the key of a frame is complete */
+static bool simTrack(sim_tracker_t *_psTracker, char _cByte, uint64_t _u64Ns)
+{
+    uint8_t u8Byte = (uint8_t)_cByte;
+
+    if(_psTracker->u16Remaining == 0)
+    {
+        /* A frame starts with its start byte, anything else is skipped (garbled) */
+        if(_psTracker->u16Have == 0 && u8Byte != SOA && u8Byte != SOH)
+        {
+            return false;
+        }
+        if(_psTracker->u16Have == 0)
+        {
+            _psTracker->u64StartNs = _u64Ns;
+            memset(_psTracker->au8Key, 0, sizeof(_psTracker->au8Key));
+        }
+        _psTracker->au8Key[_psTracker->u16Have++] = u8Byte;
+
+        /* The length is known once the packet size went by */
+        uint16_t u16SizeAt = (_psTracker->au8Key[0] == SOA) ? ADDRESS_HEADER_SIZE + 1 : 1;
+        if(_psTracker->u16Have < u16SizeAt + 2)
+        {
+            return false;
+        }
+        _psTracker->u16Length = ((uint16_t)_psTracker->au8Key[u16SizeAt] << 8) | _psTracker->au8Key[u16SizeAt + 1];
+        _psTracker->u16Length += (_psTracker->au8Key[0] == SOA) ? ADDRESS_HEADER_SIZE : 0;
+        if(_psTracker->u16Length <= _psTracker->u16Have)
+        {
+            _psTracker->u16Have = 0;
+            return false;
+        }
+        _psTracker->u16Remaining = _psTracker->u16Length - _psTracker->u16Have;
+        return false;
+    }
+
+    if(_psTracker->u16Have < SIM_KEY_SIZE)
+    {
+        _psTracker->au8Key[_psTracker->u16Have] = u8Byte;
+    }
+    _psTracker->u16Have++;
+    _psTracker->u16Remaining--;
+
+    if(_psTracker->u16Remaining == 0)
+    {
+        _psTracker->u16Have = 0;
+    }
+
+    return (_psTracker->u16Have == SIM_KEY_SIZE || (_psTracker->u16Remaining == 0 && _psTracker->u16Length < SIM_KEY_SIZE));
+}
+
+/* A frame for someone else arrived at _psNode: remember when, its first byte leaving again closes the hop */
+static void simHopIn(sim_node_t *_psNode, sim_tracker_t *_psTracker)
+{
+    if(_psTracker->au8Key[0] != SOA || _psTracker->au8Key[1] == _psNode->u8Address || _psTracker->au8Key[1] == ADDRESS_BROADCAST ||
+       _psTracker->u16Length != simImuFrameSize())
+    {
+        return;
+    }
+
+    for(uint16_t u16Index = 0; u16Index < SIM_PENDING_HOPS; u16Index++)
+    {
+        if(_psNode->asPending[u16Index].bUsed == false)
+        {
+            _psNode->asPending[u16Index].bUsed = true;
+            memcpy(_psNode->asPending[u16Index].au8Key, _psTracker->au8Key, SIM_KEY_SIZE);
+            _psNode->asPending[u16Index].u64ArrivedNs = _psTracker->u64StartNs;
+            return;
+        }
+    }
+}
+
+static void simHopOut(sim_node_t *_psNode, sim_tracker_t *_psTracker)
+{
+    for(uint16_t u16Index = 0; u16Index < SIM_PENDING_HOPS; u16Index++)
+    {
+        sim_pending_t *psPending = &_psNode->asPending[u16Index];
+
+        if(psPending->bUsed == true && memcmp(psPending->au8Key, _psTracker->au8Key, SIM_KEY_SIZE) == 0)
+        {
+            uint64_t u64Hop = _psTracker->u64StartNs - psPending->u64ArrivedNs;
+
+            _psNode->u32Hops++;
+            _psNode->u64HopNs += u64Hop;
+            _psNode->u64MinHopNs = (u64Hop < _psNode->u64MinHopNs) ? u64Hop : _psNode->u64MinHopNs;
+            _psNode->u64MaxHopNs = (u64Hop > _psNode->u64MaxHopNs) ? u64Hop : _psNode->u64MaxHopNs;
+            psPending->bUsed = false;
+            return;
+        }
+    }
+}
+
+/* Master: what the last packet of a link (from its u8ReplyAddress) published */
+static void simCollect(sim_node_t *_psMaster, protocol_link_t *_psLink)
+{
+    const uint8_t *pu8Message;
+    uint16_t u16Size;
+    message_imu_t sImu;
+
+    while(sampleBus_peek(&_psMaster->sSubscriber, &pu8Message, &u16Size) == QUELL_OK)
+    {
+        sim_node_t *psSource = (_psLink->u8ReplyAddress < u8Nodes) ? &asNodes[_psLink->u8ReplyAddress] : NULL;
+
+        if(psSource != NULL && messages_decodeImu(&sImu, pu8Message, u16Size) == QUELL_OK)
+        {
+            uint32_t u32Latency = (uint32_t)(u64NowNs / 1000ULL) - sImu.u32Timestamp;
+
+            psSource->u32Delivered++;
+            psSource->u32SamplesDelivered += sImu.u16SamplesCount / MESSAGE_IMU_AXES;
+            psSource->u64LatencyUs += u32Latency;
+            psSource->u32MaxLatencyUs = (u32Latency > psSource->u32MaxLatencyUs) ? u32Latency : psSource->u32MaxLatencyUs;
+        }
+        else if(psSource != NULL && u16Size == 4 && memcmp(pu8Message, "polo", 4) == 0)
+        {
+            uint64_t u64RoundTrip = u64NowNs - psSource->au64MarcoNs[psSource->u32Polos % SIM_MARCOS];
+
+            psSource->u32Polos++;
+            psSource->u64ControlNs += u64RoundTrip;
+            psSource->u64MaxControlNs = (u64RoundTrip > psSource->u64MaxControlNs) ? u64RoundTrip : psSource->u64MaxControlNs;
+        }
+        sampleBus_release(&_psMaster->sSubscriber);
+    }
+}
+
+/* The link toward _u8Destination, as protocolPortTo does */
+static sim_port_t* simPortTo(sim_node_t *_psNode, uint8_t _u8Destination)
+{
+    uint8_t u8Port = (bChain == true) ? router_getPort(&_psNode->sRouter, _u8Destination) : 0;
+
+    return &_psNode->asPorts[(u8Port < _psNode->u8Ports) ? u8Port : 0];
+}
+
+static void simGenerate(sim_node_t *_psNode)
+{
+    uint64_t u64SimUs = u64NowNs / 1000ULL;
+    uint8_t au8Message[MESSAGE_IMU_MAX_SIZE];
+    message_imu_t sImu;
+    uint16_t u16Size;
+    sim_port_t *psPort;
+
+    if(u64NowNs >= u64TrafficEndNs)
+    {
+        return;
+    }
+
+    /* Marcos go on the control lane (so do the polos), they probe it even without the regular traffic */
+    if(_psNode->u8Address == ADDRESS_MASTER)
+    {
+        while(_psNode->u64NextMessageUs <= u64SimUs)
+        {
+            for(uint8_t u8Node = 1; u8Node < u8Nodes; u8Node++)
+            {
+                psPort = simPortTo(_psNode, u8Node);
+                if(protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_CONTROL), u8Node, (uint8_t*)"marco", 5) == QUELL_OK)
+                {
+                    asNodes[u8Node].au64MarcoNs[asNodes[u8Node].u32Marcos % SIM_MARCOS] = u64NowNs;
+                    asNodes[u8Node].u32Marcos++;
+                }
+            }
+            _psNode->u64NextMessageUs += SIM_MARCO_PERIOD_US;
+        }
+        return;
+    }
+    if(bQuiet == true)
+    {
+        return;
+    }
+
+    memset(&sImu, 0, sizeof(sImu));
+    sImu.u8Unit = _psNode->u8Address;
+    sImu.u16Period = SIM_IMU_PERIOD_US;
+    sImu.u16SamplesCount = MESSAGE_IMU_SAMPLES_MAX_COUNT;
+    psPort = simPortTo(_psNode, ADDRESS_MASTER);
+
+    /* -A: the samples come at 4 x the message rate, divided as imuStream_adapt does, and batched as imuStream_push does */
+    if(bAdaptive == true && u32Rate > 0)
+    {
+        uint32_t u32PeriodUs = ((1000000UL / (4 * u32Rate)) * CONGESTION_RATE_STEPS) / _psNode->sCongestion.u8Rate;
+        uint8_t u8Batch = congestion_getBatch(u32PeriodUs);
+
+        sImu.u16Period = (uint16_t)u32PeriodUs;
+        sImu.u16SamplesCount = u8Batch * MESSAGE_IMU_AXES;
+        while(_psNode->u64NextMessageUs <= u64SimUs)
+        {
+            sImu.u32Timestamp = (uint32_t)u64SimUs;
+            if(messages_encodeImu(&sImu, au8Message, sizeof(au8Message), &u16Size) == QUELL_ERROR ||
+               protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK), ADDRESS_MASTER, au8Message, u16Size) == QUELL_ERROR)
+            {
+                _psNode->u32SourceDrops++;
+            }
+            _psNode->u32Offered++;
+            _psNode->u32SamplesOffered += u8Batch;
+            _psNode->u64NextMessageUs += (uint64_t)u8Batch * u32PeriodUs;
+        }
+        return;
+    }
+
+    /* At the rate, or whenever the lane has room */
+    while((u32Rate > 0 && _psNode->u64NextMessageUs <= u64SimUs) || u32Rate == 0)
+    {
+        sImu.u32Timestamp = (uint32_t)u64SimUs;
+        if(messages_encodeImu(&sImu, au8Message, sizeof(au8Message), &u16Size) == QUELL_ERROR ||
+           protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK), ADDRESS_MASTER, au8Message, u16Size) == QUELL_ERROR)
+        {
+            if(u32Rate == 0)
+            {
+                break;
+            }
+            _psNode->u32SourceDrops++;
+        }
+        _psNode->u32Offered++;
+        _psNode->u64NextMessageUs += (u32Rate > 0) ? 1000000ULL / u32Rate : 0;
+    }
+}
+
+/* Bench messages due onto the bulk lane, as protocolRunBench does */
+static void simBench(sim_port_t *_psPort)
+{
+    fifo_t *psFIFOBulk = txScheduler_getLane(&_psPort->sTxScheduler, TX_LANE_BULK);
+    uint8_t au8Message[LINK_BENCH_MAX_SIZE];
+    uint16_t u16Size;
+    uint8_t u8Destination;
+    size_t tFree;
+
+    while(FIFO_free(psFIFOBulk, &tFree) == true && tFree > ADDRESSED_SIZE(PACKE_SIZE(0)) &&
+          linkBench_makeMessage(&_psPort->sBench, tFree - ADDRESSED_SIZE(PACKE_SIZE(0)), au8Message, sizeof(au8Message), &u16Size, &u8Destination, _psPort->sLink.sFlowControl.u32TxLimit) == QUELL_OK)
+    {
+        protocolLink_send(&_psPort->sLink, psFIFOBulk, u8Destination, au8Message, u16Size);
+    }
+}
+
+/* -T: the units log all the time, the master holds a terminal session with the last one */
+static bool simTunnelRuns(uint8_t _u8Address, uint8_t _u8Channel)
+{
+    return (_u8Channel == MESSAGE_CHANNEL_LOG) ? _u8Address != ADDRESS_MASTER : (_u8Address == ADDRESS_MASTER || _u8Address == u8Nodes - 1);
+}
+
+/* -T: the tunnels kept full while the traffic runs, sent as protocolRunChannels does, and read out as a terminal would */
+static void simTunnels(sim_node_t *_psNode)
+{
+    uint8_t au8Message[MESSAGE_CHANNEL_MAX_SIZE];
+    char acLine[SIM_TUNNEL_LINE];
+    char acRead[MESSAGE_CHANNEL_DATA_MAX_COUNT];
+    uint16_t u16Size;
+    uint8_t u8Source;
+    size_t tFree;
+
+    if(bTunnels == false)
+    {
+        return;
+    }
+
+    memset(acLine, '.', sizeof(acLine));
+    for(uint8_t u8Channel = 0; u8Channel < CHANNEL_TUNNELS; u8Channel++)
+    {
+        uint8_t u8Peer = channel_getPeer(&_psNode->sChannels, u8Channel);
+        sim_port_t *psPort = simPortTo(_psNode, u8Peer);
+        fifo_t *psFIFOBulk = txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK);
+
+        while(u64NowNs < u64TrafficEndNs && simTunnelRuns(_psNode->u8Address, u8Channel) == true &&
+              channel_write(&_psNode->sChannels, u8Channel, acLine, sizeof(acLine)) == QUELL_OK);
+
+        if(txScheduler_isIdle(&psPort->sTxScheduler) == true && FIFO_free(psFIFOBulk, &tFree) == true && tFree > ADDRESSED_SIZE(PACKE_SIZE(0)) &&
+           channel_makeMessage(&_psNode->sChannels, u8Channel, tFree - ADDRESSED_SIZE(PACKE_SIZE(0)), au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+        {
+            protocolLink_send(&psPort->sLink, psFIFOBulk, u8Peer, au8Message, u16Size);
+        }
+
+        while(channel_read(&_psNode->sChannels, u8Channel, acRead, sizeof(acRead), &u16Size, &u8Source) == QUELL_OK)
+        {
+            asNodes[(u8Source < u8Nodes) ? u8Source : 0].au32TunnelDelivered[u8Channel] += u16Size;
+        }
+    }
+}
+
+/* protocol_io_task of one port: beacon, lanes within the allowance, credits */
+static void simIo(sim_port_t *_psPort)
+{
+    protocol_link_t *psLink = &_psPort->sLink;
+    uint8_t au8Buffer[ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE))];
+    uint16_t u16Count;
+    uint16_t u16Allowance;
+    uint32_t u32NewBaud;
+    bool bBusy = false;
+    size_t tFree;
+
+    /* Speed negotiation ahead of everything, between packets and within the peer credit, one link of a unit at a time */
+    for(uint8_t u8Port = 0; u8Port < _psPort->psNode->u8Ports; u8Port++)
+    {
+        if(&_psPort->psNode->asPorts[u8Port] != _psPort && linkSpeed_isQuiet(_psPort->psNode->asPorts[u8Port].sLink.psSpeed) == true)
+        {
+            bBusy = true;
+        }
+    }
+    linkSpeed_setUnitBusy(psLink->psSpeed, bBusy);
+    linkSpeed_run(psLink->psSpeed, psLink->u32RxPackets, psLink->u32RxErrors);
+    router_holdPort(psLink->psRouter, psLink->u8Port, linkSpeed_isQuiet(psLink->psSpeed));
+    router_creditPort(psLink->psRouter, psLink->u8Port, flowControl_getTxAllowance(&psLink->sFlowControl));
+    while(psLink->psSpeed != NULL && _psPort->sTxScheduler.u16FrameRemaining == 0 &&
+          flowControl_getTxAllowance(&psLink->sFlowControl) >= PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE) && FIFO_free(&_psPort->sUartTx, &tFree) == true &&
+          tFree >= PACKE_SIZE(MESSAGE_SPEED_MAX_SIZE) && linkSpeed_makePacket(psLink->psSpeed, au8Buffer, sizeof(au8Buffer), &u16Count) == QUELL_OK)
+    {
+        flowControl_txSent(&psLink->sFlowControl, u16Count);
+        for(uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+        {
+            FIFO_put(&_psPort->sUartTx, (char)au8Buffer[u16Index]);
+        }
+    }
+
+    if(psLink->psTdma != NULL && bAloha == false && FIFO_free(&_psPort->sUartTx, &tFree) == true && tFree >= ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_TDMA_MAX_SIZE)) &&
+       tdma_makeBeacon(psLink->psTdma, au8Buffer, sizeof(au8Buffer), &u16Count) == QUELL_OK)
+    {
+        for(uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+        {
+            FIFO_put(&_psPort->sUartTx, (char)au8Buffer[u16Index]);
+        }
+    }
+
+    for(;;)
+    {
+        if(psLink->psTdma != NULL)
+        {
+            u16Allowance = (bAloha == true) ? UINT16_MAX : tdma_getTxAllowance(psLink->psTdma);
+        }
+        else
+        {
+            u16Allowance = flowControl_getTxAllowance(&psLink->sFlowControl);
+        }
+
+        if(FIFO_free(&_psPort->sUartTx, &tFree) == false || tFree == 0 ||
+           (linkSpeed_isQuiet(psLink->psSpeed) == true && _psPort->sTxScheduler.u16FrameRemaining == 0) ||
+           txScheduler_pop(&_psPort->sTxScheduler, u16Allowance, (char*)au8Buffer, (tFree < sizeof(au8Buffer)) ? tFree : sizeof(au8Buffer), &u16Count) == QUELL_ERROR)
+        {
+            break;
+        }
+
+        for(uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+        {
+            FIFO_put(&_psPort->sUartTx, (char)au8Buffer[u16Index]);
+        }
+        if(psLink->psTdma != NULL)
+        {
+            tdma_txSent(psLink->psTdma, u16Count);
+        }
+        else
+        {
+            flowControl_txSent(&psLink->sFlowControl, u16Count);
+        }
+    }
+
+    if(psLink->psTdma == NULL && _psPort->sTxScheduler.u16FrameRemaining == 0 && linkSpeed_isSwitching(psLink->psSpeed) == false &&
+       FIFO_free(&_psPort->sUartTx, &tFree) == true &&
+       tFree >= PACKE_SIZE(MESSAGE_CREDIT_SIZE) &&
+       flowControl_makeCredit(&psLink->sFlowControl, &_psPort->sFIFORx, (uint32_t)(u64NowNs / 1000000ULL), au8Buffer, PACKE_SIZE(MESSAGE_CREDIT_SIZE), &u16Count) == QUELL_OK)
+    {
+        for(uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+        {
+            FIFO_put(&_psPort->sUartTx, (char)au8Buffer[u16Index]);
+        }
+    }
+
+    txScheduler_setIdle(&_psPort->sTxScheduler, _psPort->sTxScheduler.u16FrameRemaining == 0 && FIFO_count(&_psPort->sUartTx, &tFree) == true && tFree == 0 &&
+                        _psPort->bDriving == false);
+
+    /* A new baud rate once the uart drained, as protocol_io_task does */
+    if(linkSpeed_getSwitch(psLink->psSpeed, &u32NewBaud) == QUELL_OK && _psPort->sTxScheduler.u16FrameRemaining == 0 &&
+       FIFO_count(&_psPort->sUartTx, &tFree) == true && tFree == 0 && _psPort->bDriving == false)
+    {
+        printf("%8.3f s node %u port %u: %u -> %u baud\n", u64NowNs / 1e9, _psPort->psNode->u8Address,
+               (uint32_t)(_psPort - _psPort->psNode->asPorts), _psPort->u32Baud, u32NewBaud);
+        _psPort->u32Baud = u32NewBaud;
+        _psPort->u64ByteNs = 10000000000ULL / u32NewBaud;
+        linkSpeed_switched(psLink->psSpeed);
+    }
+}
+
+/* Quenches to the sources of the frames the router dropped or marked, as protocolSendQuenches does */
+static void simQuench(sim_node_t *_psNode)
+{
+    message_quench_t sQuench = {.u32Dropped = router_getDropped(&_psNode->sRouter)};
+    uint8_t au8Message[MESSAGE_QUENCH_SIZE];
+    uint16_t u16Size;
+    uint32_t u32Now = simNowUs();
+
+    if(bChain == false)
+    {
+        return;
+    }
+
+    _psNode->u16QuenchPending |= router_takeQuenchSources(&_psNode->sRouter);
+    for(uint8_t u8Address = 0; _psNode->u16QuenchPending != 0 && u8Address < ROUTER_MAX_ADDRESSES; u8Address++)
+    {
+        sim_port_t *psPort = simPortTo(_psNode, u8Address);
+
+        if((_psNode->u16QuenchPending & (1U << u8Address)) == 0 || u32Now - _psNode->au32QuenchUs[u8Address] < CONGESTION_PERIOD_US)
+        {
+            continue;
+        }
+        _psNode->u16QuenchPending &= (uint16_t)~(1U << u8Address);
+        _psNode->au32QuenchUs[u8Address] = u32Now;
+        if(messages_encodeQuench(&sQuench, au8Message, sizeof(au8Message), &u16Size) == QUELL_OK)
+        {
+            protocolLink_send(&psPort->sLink, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_CONTROL), u8Address, au8Message, u16Size);
+        }
+    }
+}
+
+/* The health of the link toward the master, as protocolRunCongestion hands it over (the lane full is the queue refusing) */
+static void simAdapt(sim_node_t *_psNode)
+{
+    sim_port_t *psPort = simPortTo(_psNode, ADDRESS_MASTER);
+    congestion_health_t sHealth;
+    size_t tQueued = 0;
+
+    if(bAdaptive == false)
+    {
+        return;
+    }
+    simQuench(_psNode);
+    if(_psNode->u8Address == ADDRESS_MASTER)
+    {
+        return;
+    }
+
+    sHealth.u32Refused = _psNode->u32SourceDrops;
+    sHealth.u32Quenches = psPort->sLink.u32RxQuenches;
+    sHealth.u32RxPackets = psPort->sLink.u32RxPackets;
+    sHealth.u32RxErrors = psPort->sLink.u32RxErrors;
+    sHealth.u32TxBytes = psPort->u32TxBytes;
+    FIFO_count(txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_BULK), &tQueued);
+    sHealth.u32Queued = (uint32_t)tQueued;
+    sHealth.bHeld = linkSpeed_isQuiet(psPort->sLink.psSpeed);
+
+    if(congestion_run(&_psNode->sCongestion, &sHealth) == true)
+    {
+        printf("%8.3f s node %u: imu rate %u/%u\n", u64NowNs / 1e9, _psNode->u8Address, _psNode->sCongestion.u8Rate, CONGESTION_RATE_STEPS);
+    }
+}
+
+/* The slow consumer (-K) stalled or out of bytes for this tick, as a protocol_task starved of cpu would be */
+static bool simConsumerHeld(sim_node_t *_psNode)
+{
+    if(u32ConsumerRate == 0 || _psNode != &asNodes[u8Nodes - 1])
+    {
+        return false;
+    }
+
+    return (u64NowNs % 1000000000ULL) < u32ConsumerStallMs * 1000000ULL || _psNode->dConsumerBudget <= 0;
+}
+
+/* One tick of a node: protocol_task (cut through, parse, answer), the application, then protocol_io_task of every port */
+static void simTick(sim_node_t *_psNode)
+{
+    psCurrent = _psNode;
+
+    /* A tick of the slow consumer's rate, no more than a FIFO saved up while stalled */
+    _psNode->dConsumerBudget += u32ConsumerRate * (SIM_TICK_NS / 1e9);
+    _psNode->dConsumerBudget = (_psNode->dConsumerBudget > SIM_RX_FIFO_SIZE) ? SIM_RX_FIFO_SIZE : _psNode->dConsumerBudget;
+
+    for(uint8_t u8Port = 0; u8Port < _psNode->u8Ports; u8Port++)
+    {
+        sim_port_t *psPort = &_psNode->asPorts[u8Port];
+        int32_t i32Result = QUELL_OK;
+        size_t tBefore;
+        size_t tAfter;
+
+        while(i32Result == QUELL_OK && simConsumerHeld(_psNode) == false)
+        {
+            FIFO_count(&psPort->sFIFORx, &tBefore);
+            i32Result = processIncomingCommunication(&psPort->sFIFORx, txScheduler_getLane(&psPort->sTxScheduler, TX_LANE_CONTROL), &psPort->sLink, NULL);
+            simCollect(_psNode, &psPort->sLink);
+            FIFO_count(&psPort->sFIFORx, &tAfter);
+            _psNode->dConsumerBudget -= (double)(tBefore - tAfter);
+            _psNode->u64Consumed += tBefore - tAfter;
+            _psNode->u64ConsumedInTraffic += (u64NowNs < u64TrafficEndNs) ? tBefore - tAfter : 0;
+        }
+        simBench(psPort);
+    }
+
+    simAdapt(_psNode);
+    simGenerate(_psNode);
+    simTunnels(_psNode);
+
+    for(uint8_t u8Port = 0; u8Port < _psNode->u8Ports; u8Port++)
+    {
+        simIo(&_psNode->asPorts[u8Port]);
+    }
+}
+
+/* The byte of _psPort ends: its chain peer receives it, or every other unit on the bus (half duplex, nobody hears itself) */
+static void simDeliver(sim_port_t *_psPort)
+{
+    bool bGarbled = _psPort->bCollided == true || simCorrupted(_psPort->u32Baud) == true;
+
+    for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+    {
+        sim_port_t *psRx = (_psPort->psPeer != NULL) ? _psPort->psPeer : &asNodes[u8Node].asPorts[0];
+        char cByte = (bGarbled == true || psRx->u32Baud != _psPort->u32Baud) ? (char)(_psPort->cByte ^ SIM_GARBLE) : _psPort->cByte;
+
+        if(psRx == _psPort)
+        {
+            continue;
+        }
+        simCaptureByte(psRx, false, cByte);
+        if(FIFO_put(&psRx->sFIFORx, cByte) == false)
+        {
+            psRx->u32RxOverflows++;
+        }
+        else if(psRx->sLink.psTdma == NULL)
+        {
+            flowControl_rxReceived(&psRx->sLink.sFlowControl, 1);
+        }
+        if(bChain == true && simTrack(&psRx->sRxTracker, cByte, u64NowNs) == true)
+        {
+            simHopIn(psRx->psNode, &psRx->sRxTracker);
+        }
+        if(_psPort->psPeer != NULL)
+        {
+            break;
+        }
+    }
+    _psPort->bDriving = false;
+    _psPort->bCollided = false;
+}
+
+static void simRun(void)
+{
+    while(u64NowNs < u64EndNs)
+    {
+        uint64_t u64NextNs = UINT64_MAX;
+        bool bBusy = false;
+
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                sim_port_t *psPort = &asNodes[u8Node].asPorts[u8Port];
+                if(psPort->bDriving == true && psPort->u64ByteEndNs <= u64NowNs)
+                {
+                    simDeliver(psPort);
+                }
+            }
+        }
+
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            if(asNodes[u8Node].u64NextTickNs <= u64NowNs)
+            {
+                simTick(&asNodes[u8Node]);
+                asNodes[u8Node].u64NextTickNs += simTickNs(&asNodes[u8Node]);
+            }
+        }
+
+        /* Idle uarts start their next byte, on the bus on top of anybody already driving it */
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                sim_port_t *psPort = &asNodes[u8Node].asPorts[u8Port];
+
+                if(psPort->bDriving == true || FIFO_get(&psPort->sUartTx, &psPort->cByte) == false)
+                {
+                    continue;
+                }
+
+                for(uint8_t u8Other = 0; u8Other < u8Nodes && psPort->psPeer == NULL; u8Other++)
+                {
+                    if(u8Other != u8Node && asNodes[u8Other].asPorts[0].bDriving == true)
+                    {
+                        asNodes[u8Other].asPorts[0].bCollided = true;
+                        psPort->bCollided = true;
+                    }
+                }
+                u64Collisions += (psPort->bCollided == true) ? 1 : 0;
+                psPort->bDriving = true;
+                psPort->u32TxBytes++;
+                psPort->u64ByteEndNs = u64NowNs + psPort->u64ByteNs;
+                simCaptureByte(psPort, true, psPort->cByte);
+
+                if(bChain == true && simTrack(&psPort->sTxTracker, psPort->cByte, u64NowNs) == true)
+                {
+                    simHopOut(&asNodes[u8Node], &psPort->sTxTracker);
+                }
+            }
+        }
+
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            u64NextNs = (asNodes[u8Node].u64NextTickNs < u64NextNs) ? asNodes[u8Node].u64NextTickNs : u64NextNs;
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                sim_port_t *psPort = &asNodes[u8Node].asPorts[u8Port];
+                if(psPort->bDriving == true)
+                {
+                    bBusy = true;
+                    u64NextNs = (psPort->u64ByteEndNs < u64NextNs) ? psPort->u64ByteEndNs : u64NextNs;
+                }
+            }
+        }
+
+        u64BusyNs += (bBusy == true) ? u64NextNs - u64NowNs : 0;
+        u64NowNs = u64NextNs;
+    }
+}
+
+/* A run from the start: the units, and the chain links or the bus schedule */
+static int32_t simStart(uint32_t _u32SlotUs, uint32_t _u32GuardUs, int32_t _i32DriftPpm)
+{
+    uint8_t au8Owners[SIM_MAX_NODES];
+
+    u64NowNs = 0;
+    u64Random = 0x9E3779B97F4A7C15ULL;
+    u64Collisions = 0;
+    u64BusyNs = 0;
+    for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+    {
+        au8Owners[u8Node] = u8Node;
+        if(simInitNode(&asNodes[u8Node], u8Node, (u8Node % 2 == 1) ? _i32DriftPpm : -_i32DriftPpm) == QUELL_ERROR)
+        {
+            fprintf(stderr, "node %u init failed\n", u8Node);
+            return QUELL_ERROR;
+        }
+    }
+
+    if(bChain == true)
+    {
+        /* Unit i leads to the chest through its port 0, which its upstream neighbour reaches through its last port */
+        for(uint8_t u8Node = 1; u8Node < u8Nodes; u8Node++)
+        {
+            sim_port_t *psUp = &asNodes[u8Node - 1].asPorts[asNodes[u8Node - 1].u8Ports - 1];
+            psUp->psPeer = &asNodes[u8Node].asPorts[0];
+            asNodes[u8Node].asPorts[0].psPeer = psUp;
+        }
+    }
+    else if(tdma_setSchedule(&asNodes[0].sTdma, au8Owners, u8Nodes, (uint16_t)_u32SlotUs, (uint16_t)_u32GuardUs) == QUELL_ERROR)
+    {
+        /* One slot per unit, the master's first (it holds the beacon) */
+        fprintf(stderr, "bad schedule\n");
+        return QUELL_ERROR;
+    }
+
+    return QUELL_OK;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t u32SlotUs = TDMA_DEFAULT_SLOT_US;
+    uint32_t u32GuardUs = TDMA_DEFAULT_GUARD_US;
+    uint32_t u32Seconds = 10;
+    int32_t i32DriftPpm = 50;
+    sim_baseline_t asBaseline[SIM_MAX_NODES];
+    double dSeconds;
+    double dCycleUs;
+    double dGuaranteed = 0;
+    double dFrameUs;
+    uint32_t u32RxErrors = 0;
+    uint32_t u32Missing = 0;
+    uint32_t u32RouterDrops = 0;
+    uint32_t u32Pings = 0;
+    int64_t i64LoadRate = -1;
+    uint16_t u16BenchSize = MESSAGE_IMU_MAX_SIZE;
+    link_bench_request_t sBenchRequest;
+    sim_port_t *psBenchPort = NULL;
+    uint64_t u64DrainUs = SIM_DRAIN_US;         //After the traffic, for what is queued to arrive
+    bool bFailed = false;
+    char *pcKnee;
+    uint32_t u32AllOverflows = 0;
+    const char *pcCaptureFile = NULL;
+    FILE *psCaptureFile;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "n:b:s:g:r:t:d:acwP:L:z:qS:e:E:AK:TC:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'n':
+                u8Nodes = (uint8_t)atoi(optarg);
+                break;
+            case 'b':
+                u32Baud = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                u32SlotUs = strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                u32GuardUs = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                u32Rate = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                u32Seconds = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                i32DriftPpm = atoi(optarg);
+                break;
+            case 'a':
+                bAloha = true;
+                break;
+            case 'c':
+                bChain = true;
+                break;
+            case 'w':
+                bStoreAndForward = true;
+                break;
+            case 'P':
+                u32Pings = strtoul(optarg, NULL, 0);
+                break;
+            case 'L':
+                i64LoadRate = strtoll(optarg, NULL, 0);
+                break;
+            case 'z':
+                u16BenchSize = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                bQuiet = true;
+                break;
+            case 'S':
+                u32MaxBaud = strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                dKneeBaud = atof(optarg);
+                dKneeLaterBaud = (u64KneeChangeNs == UINT64_MAX) ? dKneeBaud : dKneeLaterBaud;
+                break;
+            case 'A':
+                bAdaptive = true;
+                break;
+            case 'E':
+                pcKnee = strchr(optarg, ':');
+                if(pcKnee == NULL)
+                {
+                    fprintf(stderr, "-E <seconds>:<knee baud>\n");
+                    return 1;
+                }
+                u64KneeChangeNs = (uint64_t)(atof(optarg) * 1e9);
+                dKneeLaterBaud = atof(pcKnee + 1);
+                break;
+            case 'K':
+                u32ConsumerRate = strtoul(optarg, &pcKnee, 0);
+                u32ConsumerStallMs = (*pcKnee == ':') ? strtoul(pcKnee + 1, NULL, 0) : 0;
+                break;
+            case 'T':
+                bTunnels = true;
+                break;
+            case 'C':
+                pcCaptureFile = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n nodes] [-b baud] [-s slot us] [-g guard us] [-r messages/s] [-t seconds] [-d ppm] [-a] [-c [-w]]\n"
+                                "       [-P pings | -L messages/s] [-z bytes] [-q] [-S max baud] [-e knee baud] [-E seconds:knee baud] [-A]\n"
+                                "       [-K bytes/s[:stall ms]] [-T] [-C capture file]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    /* A slow consumer still has to take what queued on the way (lanes, driver buffer and FIFO Rx of every hop) at its average rate, and sit out a stall */
+    if(u32ConsumerRate > 0 && u32ConsumerStallMs < 1000)
+    {
+        u64DrainUs += (((uint64_t)(u8Nodes - 1) * (SIM_BULK_LANE_SIZE + SIM_FORWARD_LANE_SIZE + SIM_UART_TX_SIZE + SIM_RX_FIFO_SIZE) * 1000000000ULL) /
+                       ((uint64_t)u32ConsumerRate * (1000 - u32ConsumerStallMs))) + 1000000ULL;
+    }
+
+    if(u8Nodes < 2 || u8Nodes > SIM_MAX_NODES || u32Baud == 0 || u32Seconds == 0 || u32SlotUs > UINT16_MAX || u32GuardUs >= u32SlotUs ||
+       (bChain == true && bAloha == true) || ((bChain == true || bAdaptive == true) && u32Rate == 0) || (u32Pings > 0 && i64LoadRate >= 0) ||
+       i64LoadRate > UINT32_MAX || u32Seconds * 1000000ULL <= SIM_DRAIN_US || (u32MaxBaud > 0 && (bChain == false || u32Baud != LINK_SPEED_BASE_BAUD)) ||
+       (u32ConsumerRate > 0 && (bChain == false || u32ConsumerStallMs >= 1000)) ||
+       (bTunnels == true && (bChain == false || bAdaptive == true || u32MaxBaud > 0 || u32ConsumerRate > 0 || u32Pings > 0 || i64LoadRate >= 0 || pcCaptureFile != NULL)))
+    {
+        fprintf(stderr, "nodes 2..%d (the master included), guard < slot <= 65535 us, a chain has no slots and needs a rate (so does -A), ping or load,\n"
+                        "link speed on a chain from %lu baud, a slow consumer on a chain stalling less than a second,\n"
+                        "tunnels on a chain without -A, -S, -K, a bench or a capture\n",
+                SIM_MAX_NODES, LINK_SPEED_BASE_BAUD);
+        return 1;
+    }
+
+    u64ByteNs = 10000000000ULL / u32Baud;
+    u64TrafficEndNs = ((uint64_t)u32Seconds * 1000000000ULL) - (SIM_DRAIN_US * 1000ULL);
+    u64EndNs = u64TrafficEndNs + (u64DrainUs * 1000ULL);
+    /* -T: the same run without the tunnels first, their traffic must not change the imu delivery */
+    if(bTunnels == true)
+    {
+        bTunnels = false;
+        if(simStart(u32SlotUs, u32GuardUs, i32DriftPpm) == QUELL_ERROR)
+        {
+            return 1;
+        }
+        simRun();
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            asBaseline[u8Node].u32Offered = asNodes[u8Node].u32Offered;
+            asBaseline[u8Node].u32Delivered = asNodes[u8Node].u32Delivered;
+            asBaseline[u8Node].u64LatencyUs = asNodes[u8Node].u64LatencyUs;
+            asBaseline[u8Node].u32MaxLatencyUs = asNodes[u8Node].u32MaxLatencyUs;
+        }
+        bTunnels = true;
+    }
+
+    if(simStart(u32SlotUs, u32GuardUs, i32DriftPpm) == QUELL_ERROR)
+    {
+        return 1;
+    }
+
+    /* From the master to the farthest node, the terminal of the master would do the same */
+    if(u32Pings > 0 || i64LoadRate >= 0)
+    {
+        memset(&sBenchRequest, 0, sizeof(sBenchRequest));
+        sBenchRequest.eMode = (u32Pings > 0) ? LINK_BENCH_PING : LINK_BENCH_LOAD;
+        sBenchRequest.u8Destination = u8Nodes - 1;
+        sBenchRequest.u16Size = u16BenchSize;
+        sBenchRequest.u32Count = u32Pings;
+        sBenchRequest.u32Rate = (i64LoadRate > 0) ? (uint32_t)i64LoadRate : 0;
+        sBenchRequest.u32DurationUs = (uint32_t)(u64TrafficEndNs / 1000ULL);
+        psCurrent = &asNodes[0];
+        psBenchPort = simPortTo(&asNodes[0], sBenchRequest.u8Destination);
+        if(linkBench_request(&psBenchPort->sBench, &sBenchRequest) == QUELL_ERROR)
+        {
+            fprintf(stderr, "bench messages are %lu to %u bytes\n", MESSAGE_BENCH_SIZE, LINK_BENCH_MAX_SIZE);
+            return 1;
+        }
+    }
+
+    if(pcCaptureFile != NULL)
+    {
+        uint8_t *pu8Capture = malloc(SIM_CAPTURE_SIZE);
+
+        if(pu8Capture == NULL || capture_init(&sCapture, pu8Capture, SIM_CAPTURE_SIZE) == QUELL_ERROR)
+        {
+            fprintf(stderr, "no memory for the capture\n");
+            return 1;
+        }
+        bCapture = true;
+    }
+
+    simRun();
+
+    if(bCapture == true)
+    {
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                simCaptureFlush(&asNodes[u8Node].asPorts[u8Port], false);
+                simCaptureFlush(&asNodes[u8Node].asPorts[u8Port], true);
+            }
+        }
+        psCaptureFile = fopen(pcCaptureFile, "wb");
+        if(psCaptureFile == NULL || fwrite(sCapture.pu8Buffer, 1, sCapture.tUsed, psCaptureFile) != sCapture.tUsed || fclose(psCaptureFile) != 0)
+        {
+            perror(pcCaptureFile);
+            return 1;
+        }
+        printf("capture %s: %zu bytes, %u bytes did not fit\n", pcCaptureFile, sCapture.tUsed, sCapture.u32Dropped);
+        free(sCapture.pu8Buffer);
+    }
+
+    dSeconds = (double)u32Seconds - (SIM_DRAIN_US / 1e6);
+    dCycleUs = (double)u8Nodes * u32SlotUs;
+    dFrameUs = simImuFrameSize() * u64ByteNs / 1000.0;
+    for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+    {
+        for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+        {
+            u32RxErrors += asNodes[u8Node].asPorts[u8Port].sLink.u32RxErrors;
+        }
+    }
+
+    if(bChain == true)
+    {
+        printf("%u units in a chain, %u baud, %s, %u s: rx errors %u, %u byte imu frames (%.0f us on the wire)\n",
+               u8Nodes, u32Baud, (bStoreAndForward == true) ? "store and forward" : "cut through", u32Seconds, u32RxErrors,
+               simImuFrameSize(), dFrameUs);
+    }
+    else
+    {
+        /* Whole frames a slot takes, once the node noticed it started (up to a tick late) */
+        dGuaranteed = floor(((u32SlotUs - u32GuardUs - (SIM_TICK_NS / 1000.0)) * 1000.0 / u64ByteNs) / simImuFrameSize()) * (1e6 / dCycleUs);
+        printf("%u units, %u baud, %s, %u s: collisions %llu, bus busy %.1f%%, master beacons %u, rx errors %u\n",
+               u8Nodes, u32Baud, (bAloha == true) ? "no slots" : "tdma", u32Seconds, (unsigned long long)u64Collisions,
+               (100.0 * u64BusyNs) / u64EndNs, asNodes[0].sTdma.u32Beacons, u32RxErrors);
+        if(bAloha == false)
+        {
+            printf("cycle %.0f us (%u x %u us, guard %u us), %u byte frames, %.1f messages/s guaranteed per node\n",
+                   dCycleUs, u8Nodes, u32SlotUs, u32GuardUs, simImuFrameSize(), dGuaranteed);
+        }
+    }
+    printf("%4s %8s %9s %6s %7s %12s %12s %9s %7s %6s %6s\n", "node", "offered", "delivered", "drops", "msg/s", "latency avg", "latency max",
+           (bChain == true) ? "forwarded" : "wire B/s", (bChain == true) ? "hop avg" : "beacons", (bChain == true) ? "max" : "lost", "polo");
+
+    for(uint8_t u8Node = 1; u8Node < u8Nodes; u8Node++)
+    {
+        sim_node_t *psNode = &asNodes[u8Node];
+        double dRate = psNode->u32Delivered / dSeconds;
+        double dHopUs = (psNode->u32Hops > 0) ? psNode->u64HopNs / 1000.0 / psNode->u32Hops : 0.0;
+        uint32_t u32Overflows = 0;
+
+        printf("%4u %8u %9u %6u %7.1f %9.2f ms %9.2f ms ", u8Node, psNode->u32Offered, psNode->u32Delivered, psNode->u32SourceDrops, dRate,
+               (psNode->u32Delivered > 0) ? psNode->u64LatencyUs / 1000.0 / psNode->u32Delivered : 0.0, psNode->u32MaxLatencyUs / 1000.0);
+        if(bChain == true)
+        {
+            printf("%9u %4.0f us %3.0f us %3u/%u\n", psNode->u32Hops, dHopUs, psNode->u64MaxHopNs / 1000.0, psNode->u32Polos, psNode->u32Marcos);
+        }
+        else
+        {
+            printf("%9.0f %7u %6u %3u/%u\n", psNode->sTdma.u32TxBytes / (u32Seconds * 1.0), psNode->sTdma.u32Beacons, psNode->sTdma.u32BeaconsLost,
+                   psNode->u32Polos, psNode->u32Marcos);
+        }
+
+        for(uint8_t u8Port = 0; u8Port < psNode->u8Ports; u8Port++)
+        {
+            u32Overflows += psNode->asPorts[u8Port].u32RxOverflows;
+        }
+
+        if(bAloha == true || dKneeBaud > 0 || u64KneeChangeNs != UINT64_MAX)
+        {
+            continue;
+        }
+        if(u32MaxBaud > 0 || bAdaptive == true)
+        {
+            /* Link speed: queued at the source or dropped on the way while a link was quiet (answers too), counted below.
+               Congestion control: refused at the source until the rate came down, the queue delay bounded */
+            if(psNode->u32Delivered + psNode->u32SourceDrops > psNode->u32Offered || psNode->u32Polos > psNode->u32Marcos || u32Overflows > 0 ||
+               (bAdaptive == true && psNode->u32Delivered > 0 && psNode->u64LatencyUs / psNode->u32Delivered > 2 * CONGESTION_MAX_DELAY_US))
+            {
+                printf("     FAIL node %u\n", u8Node);
+                bFailed = true;
+            }
+            u32Missing += psNode->u32Offered - psNode->u32Delivered - psNode->u32SourceDrops + psNode->u32Marcos - psNode->u32Polos;
+            continue;
+        }
+        if((u32Rate > 0 && (bChain == true || u32Rate <= dGuaranteed) && (psNode->u32Delivered != psNode->u32Offered || psNode->u32SourceDrops > 0)) ||
+           (u32Rate == 0 && dRate < 0.95 * dGuaranteed) || psNode->u32Polos != psNode->u32Marcos || u32Overflows > 0 ||
+           (bChain == true && bStoreAndForward == false && u32ConsumerRate == 0 && psNode->u32Hops > 0 && dHopUs >= dFrameUs))
+        {
+            printf("     FAIL node %u\n", u8Node);
+            bFailed = true;
+        }
+    }
+
+    /* The tunnels only take the room the data leaves: the same imu messages arrive, each link they cross may have a tunnel frame on the wire
+       ahead of them, and the frame of a unit further out it held back may then go first. What the routers had no room for is all they lose */
+    if(bTunnels == true)
+    {
+        double dTunnelFrameUs = ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_CHANNEL_MAX_SIZE)) * u64ByteNs / 1000.0;
+        double dImuFrameUs = ADDRESSED_SIZE(PACKE_SIZE(MESSAGE_IMU_MAX_SIZE)) * u64ByteNs / 1000.0;
+        double dTunnelSeconds = u64EndNs / 1e9;
+        uint32_t u32Yielded = 0;
+        uint32_t u32TotalLost = 0;
+
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                u32Yielded += asNodes[u8Node].sRouter.asPorts[u8Port].u32Yielded;
+            }
+        }
+        printf("tunnels: routers yielded %u tunnel frames to the data\n", u32Yielded);
+
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            sim_node_t *psNode = &asNodes[u8Node];
+            sim_baseline_t *psBaseline = &asBaseline[u8Node];
+            double dAvgUs = (psNode->u32Delivered > 0) ? (double)psNode->u64LatencyUs / psNode->u32Delivered : 0.0;
+            double dBaselineAvgUs = (psBaseline->u32Delivered > 0) ? (double)psBaseline->u64LatencyUs / psBaseline->u32Delivered : 0.0;
+            uint32_t u32Lost = 0;
+
+            for(uint8_t u8Channel = 0; u8Channel < CHANNEL_TUNNELS; u8Channel++)
+            {
+                u32Lost += psNode->sChannels.asTunnels[u8Channel].u32RxLost + psNode->sChannels.asTunnels[u8Channel].u32RxOverflows;
+            }
+            u32TotalLost += u32Lost;
+            printf("node %u tunnels terminal %.0f B/s log %.0f B/s (caps %lu and %lu B/s on the wire), lost %u", u8Node,
+                   psNode->au32TunnelDelivered[MESSAGE_CHANNEL_TERMINAL] / dTunnelSeconds, psNode->au32TunnelDelivered[MESSAGE_CHANNEL_LOG] / dTunnelSeconds,
+                   CHANNEL_TERMINAL_CAP, CHANNEL_LOG_CAP, u32Lost);
+            if(u8Node > 0)
+            {
+                printf(", imu delivered %u latency avg %.2f ms max %.2f ms (without tunnels %u, %.2f ms, %.2f ms)", psNode->u32Delivered,
+                       dAvgUs / 1000.0, psNode->u32MaxLatencyUs / 1000.0, psBaseline->u32Delivered, dBaselineAvgUs / 1000.0, psBaseline->u32MaxLatencyUs / 1000.0);
+            }
+            printf("\n");
+
+            if((simTunnelRuns(u8Node, MESSAGE_CHANNEL_TERMINAL) == true && psNode->au32TunnelDelivered[MESSAGE_CHANNEL_TERMINAL] == 0) ||
+               (simTunnelRuns(u8Node, MESSAGE_CHANNEL_LOG) == true && psNode->au32TunnelDelivered[MESSAGE_CHANNEL_LOG] == 0) ||
+               psNode->au32TunnelDelivered[MESSAGE_CHANNEL_TERMINAL] > CHANNEL_TERMINAL_CAP * dTunnelSeconds + CHANNEL_BURST_MESSAGES * MESSAGE_CHANNEL_MAX_SIZE ||
+               psNode->au32TunnelDelivered[MESSAGE_CHANNEL_LOG] > CHANNEL_LOG_CAP * dTunnelSeconds + CHANNEL_BURST_MESSAGES * MESSAGE_CHANNEL_MAX_SIZE ||
+               (u8Node > 0 && (psNode->u32Delivered != psBaseline->u32Delivered || dAvgUs > dBaselineAvgUs + u8Node * dTunnelFrameUs ||
+                               psNode->u32MaxLatencyUs > psBaseline->u32MaxLatencyUs + u8Node * (dTunnelFrameUs + dImuFrameUs))))
+            {
+                printf("FAIL tunnels node %u\n", u8Node);
+                bFailed = true;
+            }
+        }
+        if(u32TotalLost > u32Yielded)
+        {
+            printf("FAIL tunnels lost %u messages, the routers yielded %u\n", u32TotalLost, u32Yielded);
+            bFailed = true;
+        }
+        for(uint8_t u8Node = 1; u8Node < u8Nodes; u8Node++)
+        {
+            if(asBaseline[u8Node].u32Delivered != asBaseline[u8Node].u32Offered)
+            {
+                printf("FAIL tunnels: the data alone overloads the chain (node %u delivered %u of %u without them), nothing to compare with\n",
+                       u8Node, asBaseline[u8Node].u32Delivered, asBaseline[u8Node].u32Offered);
+                bFailed = true;
+                break;
+            }
+        }
+    }
+
+    if(psBenchPort != NULL)
+    {
+        link_bench_t *psBench = &psBenchPort->sBench;
+
+        linkBench_print(psBench, "linksim");
+        linkBench_print(&asNodes[u8Nodes - 1].asPorts[0].sBench, "linksim far");
+        if(psBench->bRunning == true ||
+           (psBench->sRun.eMode == LINK_BENCH_PING && (psBench->u32Pongs != psBench->u32Sent || psBench->u32Sent != u32Pings)) ||
+           (psBench->sRun.eMode == LINK_BENCH_LOAD && bAloha == false &&
+            (psBench->bReport == false || psBench->sReport.u32Received + ((u32MaxBaud > 0) ? psBench->sReport.u32Lost : 0) != psBench->u32Sent ||
+             (u32MaxBaud == 0 && psBench->sReport.u32Lost > 0) || psBench->sReport.u32Bytes != psBench->sReport.u32Received * u16BenchSize)))
+        {
+            printf("FAIL bench\n");
+            bFailed = true;
+        }
+        u32Missing += psBench->sReport.u32Lost;
+
+        for(uint8_t u8Node = 1; u8Node < u8Nodes; u8Node++)
+        {
+            sim_node_t *psNode = &asNodes[u8Node];
+
+            /* A control packet only waits for the bytes already past the lanes: within the peer credit, the forward lane (hops after the first) and the frame going out */
+            uint64_t u64BoundNs = 2ULL * u8Node * ((SIM_RX_FIFO_SIZE + SIM_FORWARD_LANE_SIZE + ADDRESSED_SIZE(PACKE_SIZE(LINK_BENCH_MAX_SIZE))) * u64ByteNs + SIM_TICK_NS);
+
+            printf("node %u control round trip (marco and polo on the control lanes) avg %.2f ms max %.2f ms\n", u8Node,
+                   (psNode->u32Polos > 0) ? psNode->u64ControlNs / 1e6 / psNode->u32Polos : 0.0, psNode->u64MaxControlNs / 1e6);
+            if(bChain == true && u32MaxBaud == 0 && u32ConsumerRate == 0 && psNode->u64MaxControlNs > u64BoundNs)
+            {
+                printf("FAIL control node %u (over %.2f ms)\n", u8Node, u64BoundNs / 1e6);
+                bFailed = true;
+            }
+        }
+    }
+
+    /* The only way a message may get lost with link speed or congestion control on: a router gave up on a link backed up (behind a quiet one) */
+    if((u32MaxBaud > 0 || bAdaptive == true) && dKneeBaud == 0 && u64KneeChangeNs == UINT64_MAX)
+    {
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                u32RouterDrops += asNodes[u8Node].sRouter.asPorts[u8Port].u32Dropped;
+            }
+        }
+        printf("messages and answers missing %u, frames dropped by the routers %u\n", u32Missing, u32RouterDrops);
+        if(u32Missing > u32RouterDrops)
+        {
+            printf("FAIL lost\n");
+            bFailed = true;
+        }
+
+        /* Congestion control quenches the sources before the links back up that far */
+        if(bAdaptive == true && u32RouterDrops > 0)
+        {
+            printf("FAIL router drops\n");
+            bFailed = true;
+        }
+    }
+
+    for(uint8_t u8Node = 1; bAdaptive == true && u8Node < u8Nodes; u8Node++)
+    {
+        sim_node_t *psNode = &asNodes[u8Node];
+        char acTag[32];
+
+        printf("node %u imu samples offered %u delivered %u (%.1f/s of %u/s)\n", u8Node, psNode->u32SamplesOffered, psNode->u32SamplesDelivered,
+               psNode->u32SamplesDelivered / dSeconds, 4 * u32Rate);
+        fflush(stdout);
+        snprintf(acTag, sizeof(acTag), "node %u", u8Node);
+        congestion_print(&psNode->sCongestion, acTag);
+    }
+
+    fflush(stdout);
+    for(uint8_t u8Node = 0; u32MaxBaud > 0 && u8Node < u8Nodes; u8Node++)
+    {
+        for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+        {
+            sim_port_t *psPort = &asNodes[u8Node].asPorts[u8Port];
+            char acTag[32];
+
+            snprintf(acTag, sizeof(acTag), "node %u port %u", u8Node, u8Port);
+            linkSpeed_print(&psPort->sSpeed, acTag);
+            if(psPort->psPeer != NULL && (psPort->u32Baud != psPort->psPeer->u32Baud || psPort->sSpeed.eState != LINK_SPEED_STEADY))
+            {
+                printf("FAIL speed %s\n", acTag);
+                bFailed = true;
+            }
+        }
+    }
+
+    /* Whatever the consumer does, the credits keep every FIFO Rx from overflowing, the master's too */
+    if(u32ConsumerRate > 0)
+    {
+        for(uint8_t u8Node = 0; u8Node < u8Nodes; u8Node++)
+        {
+            for(uint8_t u8Port = 0; u8Port < asNodes[u8Node].u8Ports; u8Port++)
+            {
+                u32AllOverflows += asNodes[u8Node].asPorts[u8Port].u32RxOverflows;
+            }
+        }
+        printf("consumer node %u took %.0f B/s while the traffic ran (at most %u B/s, stalled %u ms a second), %llu bytes in all, rx overflows %u\n", u8Nodes - 1,
+               asNodes[u8Nodes - 1].u64ConsumedInTraffic / dSeconds, u32ConsumerRate, u32ConsumerStallMs,
+               (unsigned long long)asNodes[u8Nodes - 1].u64Consumed, u32AllOverflows);
+        if(u32AllOverflows > 0)
+        {
+            printf("FAIL overflow\n");
+            bFailed = true;
+        }
+
+        /* Under a load as fast as the lanes take it the credits keep it fed: at least its rate between the stalls */
+        if(i64LoadRate == 0 && asNodes[u8Nodes - 1].u64ConsumedInTraffic / dSeconds < u32ConsumerRate * (1000 - u32ConsumerStallMs) / 1000.0)
+        {
+            printf("FAIL consumer starved\n");
+            bFailed = true;
+        }
+    }
+
+    if(bAloha == false && u32MaxBaud == 0 && (u64Collisions > 0 || u32RxErrors > 0))
+    {
+        printf("FAIL %s\n", (bChain == true) ? "chain" : "bus");
+        bFailed = true;
+    }
+
+    return (bFailed == true) ? 1 : 0;
+}
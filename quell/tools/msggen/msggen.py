@@ -0,0 +1,388 @@
+#!/usr/bin/env python3
+"""
+MESSAGE GENERATOR (host tool)
+
+Reads the message schema (main/messages.schema, format described in its header) and writes messages.h
+and messages.c: one struct per message, its sizes and field offsets as #defines, and encode/decode
+functions that read and write every field at its fixed offset straight from/to the caller buffer.
+Every message size is checked against max_size with _Static_assert.
+
+Usage (from quell):
+    python3 tools/msggen/msggen.py main/messages.schema main            Write main/messages.h and .c
+    python3 tools/msggen/msggen.py --check main/messages.schema main    Fail if they are not up to date
+"""
+import os
+import re
+import sys
+
+TYPES = {
+    "u8": ("uint8_t", 1, False),
+    "u16": ("uint16_t", 2, False),
+    "u32": ("uint32_t", 4, False),
+    "u64": ("uint64_t", 8, False),
+    "i8": ("int8_t", 1, True),
+    "i16": ("int16_t", 2, True),
+    "i32": ("int32_t", 4, True),
+    "i64": ("int64_t", 8, True),
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+class Field:
+    def __init__(self, type_name, name, count, array, variable, description):
+        self.type_name = type_name
+        self.name = name
+        self.count = count          # Array length (maximum for a variable array), 1 for a scalar
+        self.array = array          # Declared with [], even of one item
+        self.variable = variable
+        self.description = description
+        self.offset = 0
+
+    @property
+    def c_type(self):
+        return TYPES[self.type_name][0]
+
+    @property
+    def size(self):
+        return TYPES[self.type_name][1]
+
+    @property
+    def is_array(self):
+        return self.array
+
+    @property
+    def member(self):
+        prefix = ("a" if self.is_array else "") + self.type_name
+        return prefix + camel(self.name, True)
+
+    @property
+    def count_member(self):
+        return "u16" + camel(self.name, True) + "Count"
+
+
+class Message:
+    def __init__(self, name, message_id, description):
+        self.name = name
+        self.message_id = message_id
+        self.description = description
+        self.consts = []
+        self.fields = []
+
+    @property
+    def macro(self):
+        return "MESSAGE_" + self.name.upper()
+
+    @property
+    def function(self):
+        return camel(self.name, True)
+
+    @property
+    def c_type(self):
+        return "message_" + self.name + "_t"
+
+    @property
+    def fixed_size(self):
+        size = 1 if self.message_id is not None else 0
+        for field in self.fields:
+            if not field.variable:
+                size += field.size * field.count
+        return size
+
+    @property
+    def max_size(self):
+        variable = self.variable_field
+        return self.fixed_size + (variable.size * variable.count if variable else 0)
+
+    @property
+    def variable_field(self):
+        return self.fields[-1] if self.fields and self.fields[-1].variable else None
+
+
+def camel(name, capital):
+    words = [word for word in name.split("_") if word]
+    text = "".join(word[0].upper() + word[1:] for word in words)
+    return text if capital else text[0].lower() + text[1:]
+
+
+def parse_number(text, line_number):
+    try:
+        return int(text, 0)
+    except ValueError:
+        raise SchemaError("line %d: '%s' is not a number" % (line_number, text))
+
+
+def parse(path):
+    max_size = None
+    messages = []
+    message = None
+
+    with open(path) as schema:
+        for line_number, raw in enumerate(schema, 1):
+            text, _, description = raw.partition("#")
+            description = description.strip()
+            words = text.split()
+            if not words:
+                continue
+
+            if words[0] == "max_size" and message is None and len(words) == 2:
+                max_size = parse_number(words[1], line_number)
+            elif words[0] == "message" and message is None and len(words) in (2, 3):
+                if not re.fullmatch(r"[a-z][a-z0-9_]*", words[1]) or any(m.name == words[1] for m in messages):
+                    raise SchemaError("line %d: bad or repeated message name '%s'" % (line_number, words[1]))
+                message_id = parse_number(words[2], line_number) if len(words) == 3 else None
+                if message_id is not None and not 0 <= message_id <= 0xFF:
+                    raise SchemaError("line %d: the id is a u8" % line_number)
+                if message_id is not None and any(m.message_id == message_id for m in messages):
+                    raise SchemaError("line %d: id 0x%02X already used" % (line_number, message_id))
+                message = Message(words[1], message_id, description)
+            elif words[0] == "end" and message is not None and len(words) == 1:
+                if not message.fields:
+                    raise SchemaError("line %d: message '%s' has no fields" % (line_number, message.name))
+                messages.append(message)
+                message = None
+            elif words[0] == "const" and message is not None and len(words) == 3:
+                if not re.fullmatch(r"[A-Z][A-Z0-9_]*", words[1]):
+                    raise SchemaError("line %d: const names are upper case" % line_number)
+                message.consts.append((words[1], words[2], description))
+            elif words[0] in TYPES and message is not None and len(words) == 2:
+                match = re.fullmatch(r"([a-z][a-z0-9_]*)(?:\[(\.\.)?([0-9a-fA-Fx]+)\])?", words[1])
+                if match is None:
+                    raise SchemaError("line %d: bad field '%s'" % (line_number, words[1]))
+                if message.variable_field is not None:
+                    raise SchemaError("line %d: the variable array must be the last field" % line_number)
+                if any(f.name == match.group(1) for f in message.fields):
+                    raise SchemaError("line %d: field '%s' repeated" % (line_number, match.group(1)))
+                count = parse_number(match.group(3), line_number) if match.group(3) else 1
+                if count < 1:
+                    raise SchemaError("line %d: arrays hold at least one item" % line_number)
+                message.fields.append(Field(words[0], match.group(1), count, match.group(3) is not None, match.group(2) is not None, description))
+            else:
+                raise SchemaError("line %d: unexpected '%s'" % (line_number, text.strip()))
+
+    if message is not None:
+        raise SchemaError("message '%s' has no end" % message.name)
+    if max_size is None:
+        raise SchemaError("max_size missing")
+
+    for message in messages:
+        offset = 1 if message.message_id is not None else 0
+        for field in message.fields:
+            field.offset = offset
+            offset += field.size * field.count
+        if message.max_size > max_size:
+            raise SchemaError("message '%s' can be %d bytes, max_size is %d" % (message.name, message.max_size, max_size))
+
+    return max_size, messages
+
+
+def table(message):
+    lines = ["    %s MESSAGE (Big Endian)" % message.name.upper().replace("_", " "),
+             "",
+             "    %-24s%-20s%-12s%s" % ("MESSAGE ITEM:", "LENGTH:", "OFFSET:", "DESCRIPTION:")]
+    if message.message_id is not None:
+        lines.append("    %-24s%-20s%-12s%s" % ("ID", "u8", "0", "0x%02X" % message.message_id))
+    for field in message.fields:
+        if field.variable:
+            length = "%s[0..%d]" % (field.type_name, field.count)
+        elif field.is_array:
+            length = "%s[%d]" % (field.type_name, field.count)
+        else:
+            length = field.type_name
+        item = " ".join(word.capitalize() for word in field.name.split("_"))
+        lines.append(("    %-24s%-20s%-12s%s" % (item, length, field.offset, field.description)).rstrip())
+    return lines
+
+
+def header(max_size, messages, schema_name):
+    out = ["/* Generated by tools/msggen/msggen.py from %s, do not edit */" % schema_name,
+           "#ifndef _MESSAGES_H_",
+           "#define _MESSAGES_H_",
+           "",
+           "#include <stdint.h>",
+           "#include <stdbool.h>",
+           "",
+           "#define MESSAGES_MAX_SIZE (%dUL)" % max_size]
+
+    for message in messages:
+        out += ["", "/*"]
+        if message.description:
+            out += ["    " + message.description, ""]
+        out += table(message)
+        out += ["*/"]
+        if message.message_id is not None:
+            out.append("#define %s_ID (0x%02X)" % (message.macro, message.message_id))
+        for name, value, description in message.consts:
+            out.append("#define %s_%s (%s)%s" % (message.macro, name, value, (" //" + description) if description else ""))
+        out.append("#define %s_SIZE (%dUL)%s" % (message.macro, message.fixed_size,
+                                                  " //Without the variable array" if message.variable_field else ""))
+        out.append("#define %s_MAX_SIZE (%dUL)" % (message.macro, message.max_size))
+        for field in message.fields:
+            out.append("#define %s_OFFSET_%s (%d)" % (message.macro, field.name.upper(), field.offset))
+        if message.variable_field:
+            out.append("#define %s_%s_MAX_COUNT (%d)" % (message.macro, message.variable_field.name.upper(), message.variable_field.count))
+        out += ["", "typedef struct", "{"]
+        members = []
+        for field in message.fields:
+            if field.is_array:
+                members.append(("    %s %s[%d];" % (field.c_type, field.member, field.count), field.description))
+            else:
+                members.append(("    %s %s;" % (field.c_type, field.member), field.description))
+            if field.variable:
+                members.append(("    uint16_t %s;" % field.count_member, "Items in %s" % field.member))
+        width = max(len(member) for member, _ in members) + 1
+        for member, description in members:
+            out.append((member.ljust(width) + "//" + description) if description else member)
+        out += ["}%s;" % message.c_type,
+                "",
+                '_Static_assert(%s_MAX_SIZE <= MESSAGES_MAX_SIZE, "%s message bigger than MESSAGES_MAX_SIZE");' % (message.macro, message.name)]
+
+    out.append("")
+    for message in messages:
+        out.append("int32_t messages_encode%s(const %s *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size);" % (message.function, message.c_type))
+        out.append("int32_t messages_decode%s(%s *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size);" % (message.function, message.c_type))
+    out += ["", "#endif /* _MESSAGES_H_ */", ""]
+    return "\n".join(out)
+
+
+def put(field, index):
+    item = "_psMessage->%s%s" % (field.member, "[%s]" % index if index else "")
+    offset = "%s_OFFSET_%s" % ("%s", field.name.upper())
+    return item, offset
+
+
+def source(messages, schema_name):
+    out = ["/* Generated by tools/msggen/msggen.py from %s, do not edit */" % schema_name,
+           '#include <string.h>',
+           '#include "messages.h"',
+           '#include "quell.h"',
+           ""]
+
+    sizes = sorted({TYPES[f.type_name][1] for m in messages for f in m.fields if TYPES[f.type_name][1] > 1})
+    for size in sizes:
+        bits = size * 8
+        out += ["static inline void messages_putU%d(uint8_t *_pu8Buffer, uint%d_t _u%dValue)" % (bits, bits, bits), "{"]
+        for byte in range(size):
+            shift = (size - 1 - byte) * 8
+            out.append("    _pu8Buffer[%d] = %s & 0xFF;" % (byte, ("(_u%dValue >> %d)" % (bits, shift)) if shift else ("_u%dValue" % bits)))
+        out += ["}", "",
+                "static inline uint%d_t messages_getU%d(const uint8_t *_pu8Buffer)" % (bits, bits), "{"]
+        terms = ["((uint%d_t)_pu8Buffer[%d] << %d)" % (bits, byte, (size - 1 - byte) * 8) for byte in range(size - 1)]
+        terms.append("(uint%d_t)_pu8Buffer[%d]" % (bits, size - 1))
+        out += ["    return %s;" % " | ".join(terms), "}", ""]
+
+    for message in messages:
+        variable = message.variable_field
+        macro = message.macro
+
+        # Encode
+        out += ["int32_t messages_encode%s(const %s *_psMessage, uint8_t *_pu8Buffer, uint16_t _u16BufferSize, uint16_t *_pu16Size)" % (message.function, message.c_type),
+                "{"]
+        if variable:
+            out += ["    uint16_t u16Size;", ""]
+        if variable:
+            out += ["    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _psMessage->%s > %s_%s_MAX_COUNT)" % (variable.count_member, macro, variable.name.upper()),
+                    "    {", "        return QUELL_ERROR;", "    }", "",
+                    "    u16Size = %s_SIZE + %s;" % (macro, ("(_psMessage->%s * %d)" % (variable.count_member, variable.size)) if variable.size > 1 else ("_psMessage->%s" % variable.count_member)),
+                    "    if(_u16BufferSize < u16Size)",
+                    "    {", "        return QUELL_ERROR;", "    }", ""]
+            size_expression = "u16Size"
+        else:
+            out += ["    if(_psMessage == NULL || _pu8Buffer == NULL || _pu16Size == NULL || _u16BufferSize < %s_SIZE)" % macro,
+                    "    {", "        return QUELL_ERROR;", "    }", ""]
+            size_expression = "%s_SIZE" % macro
+        if message.message_id is not None:
+            out.append("    _pu8Buffer[0] = %s_ID;" % macro)
+        for field in message.fields:
+            offset = "%s_OFFSET_%s" % (macro, field.name.upper())
+            cast = "(uint%d_t)" % (field.size * 8) if TYPES[field.type_name][2] else ""
+            if field.is_array and field.size == 1:
+                count = ("_psMessage->%s" % field.count_member) if field.variable else str(field.count)
+                out.append("    memcpy(&_pu8Buffer[%s], _psMessage->%s, %s);" % (offset, field.member, count))
+            elif field.is_array:
+                count = ("_psMessage->%s" % field.count_member) if field.variable else str(field.count)
+                out += ["    for(uint16_t u16Index = 0; u16Index < %s; u16Index++)" % count,
+                        "    {",
+                        "        messages_putU%d(&_pu8Buffer[%s + (u16Index * %d)], %s_psMessage->%s[u16Index]);" % (field.size * 8, offset, field.size, cast, field.member),
+                        "    }"]
+            elif field.size == 1:
+                out.append("    _pu8Buffer[%s] = %s_psMessage->%s;" % (offset, cast, field.member))
+            else:
+                out.append("    messages_putU%d(&_pu8Buffer[%s], %s_psMessage->%s);" % (field.size * 8, offset, cast, field.member))
+        out += ["", "    *_pu16Size = %s;" % size_expression, "    return QUELL_OK;", "}", ""]
+
+        # Decode
+        out += ["int32_t messages_decode%s(%s *_psMessage, const uint8_t *_pu8Message, uint16_t _u16Size)" % (message.function, message.c_type),
+                "{"]
+        if variable:
+            checks = ["_u16Size < %s_SIZE" % macro] if message.fixed_size > 0 else []
+            checks.append("_u16Size > %s_MAX_SIZE" % macro)
+            if variable.size > 1:
+                checks.append("((_u16Size - %s_SIZE) %% %d) != 0" % (macro, variable.size))
+            size_check = " || ".join(checks)
+        else:
+            size_check = "_u16Size != %s_SIZE" % macro
+        out += ["    if(_psMessage == NULL || _pu8Message == NULL || %s%s)" % (size_check, (" ||\n       _pu8Message[0] != %s_ID" % macro) if message.message_id is not None else ""),
+                "    {", "        return QUELL_ERROR;", "    }", ""]
+        if variable:
+            out += ["    _psMessage->%s = (_u16Size - %s_SIZE) / %d;" % (variable.count_member, macro, variable.size)]
+        for field in message.fields:
+            offset = "%s_OFFSET_%s" % (macro, field.name.upper())
+            cast = "(%s)" % field.c_type if TYPES[field.type_name][2] else ""
+            if field.is_array and field.size == 1:
+                count = ("_psMessage->%s" % field.count_member) if field.variable else str(field.count)
+                out.append("    memcpy(_psMessage->%s, &_pu8Message[%s], %s);" % (field.member, offset, count))
+            elif field.is_array:
+                count = ("_psMessage->%s" % field.count_member) if field.variable else str(field.count)
+                out += ["    for(uint16_t u16Index = 0; u16Index < %s; u16Index++)" % count,
+                        "    {",
+                        "        _psMessage->%s[u16Index] = %smessages_getU%d(&_pu8Message[%s + (u16Index * %d)]);" % (field.member, cast, field.size * 8, offset, field.size),
+                        "    }"]
+            elif field.size == 1:
+                out.append("    _psMessage->%s = %s_pu8Message[%s];" % (field.member, cast, offset))
+            else:
+                out.append("    _psMessage->%s = %smessages_getU%d(&_pu8Message[%s]);" % (field.member, cast, field.size * 8, offset))
+        out += ["", "    return QUELL_OK;", "}", ""]
+
+    return "\n".join(out).rstrip("\n") + "\n"
+
+
+def main(argv):
+    check = "--check" in argv
+    arguments = [argument for argument in argv if argument != "--check"]
+    if len(arguments) != 2:
+        sys.stderr.write("usage: msggen.py [--check] <messages.schema> <output directory>\n")
+        return 1
+
+    schema_path, output = arguments
+    try:
+        max_size, messages = parse(schema_path)
+    except (SchemaError, OSError) as error:
+        sys.stderr.write("%s: %s\n" % (schema_path, error))
+        return 1
+
+    schema_name = os.path.basename(schema_path)
+    files = {os.path.join(output, "messages.h"): header(max_size, messages, schema_name),
+             os.path.join(output, "messages.c"): source(messages, schema_name)}
+
+    stale = []
+    for path, text in files.items():
+        current = open(path).read() if os.path.exists(path) else None
+        if current == text:
+            continue
+        if check:
+            stale.append(path)
+        else:
+            with open(path, "w") as generated:
+                generated.write(text)
+
+    if stale:
+        sys.stderr.write("out of date, run msggen.py: %s\n" % " ".join(stale))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,346 @@
+/*
+    ORIENTATION BENCHMARK (host tool)
+
+    Runs every orientation filter (main/orientation.c), float and fixed point, over the same synthetic
+    IMU recording: a unit turning on all three axes (sums of sines), sampled and quantised like the imu
+    message, with gyro and accelerometer noise. Reports the cost per update (ns and, on x86, TSC cycles),
+    the tilt error against the true orientation and how far the fixed point quaternion is from the float
+    one of the same filter.
+
+    Build (from quell/tools/orientation):
+    gcc -O2 -Wall -I../host -I../../main -o orientationBench orientationBench.c ../../main/orientation.c -lm
+
+    Usage:
+    orientationBench [-r sample rate Hz] [-t seconds] [-g gyro noise dps] [-a accel noise g] [-w max rate dps] [-s seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+#include "quell.h"
+#include "messages.h"
+#include "orientation.h"
+
+#define BENCH_SUBSTEPS (16)         //Truth integration steps per sample
+#define BENCH_TIMING_ROUNDS (20)    //Passes over the recording for the timing
+#define BENCH_SETTLE_SECONDS (2.0)  //Left out of the error statistics (the filters start level)
+
+typedef struct
+{
+    int16_t ai16Accel[3];
+    int16_t ai16Gyro[3];
+    double adTruth[4];              //w, x, y, z
+}bench_sample_t;
+
+typedef struct
+{
+    double dTiltRms;                //Against the truth (rad)
+    double dTiltMax;
+    double dReferenceRms;           //Fixed point against float, whole rotation (rad)
+    double dReferenceMax;
+    double dNsPerUpdate;
+    double dCyclesPerUpdate;
+}bench_result_t;
+
+static uint64_t benchNowNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+static double benchGaussian(void)
+{
+    double dU = ((double)random() + 1.0) / 2147483649.0;
+    double dV = (double)random() / 2147483648.0;
+    return sqrt(-2.0 * log(dU)) * cos(2.0 * M_PI * dV);
+}
+
+static int16_t benchQuantise(double _dValue)
+{
+    double dRound = round(_dValue);
+    return (int16_t)((dRound > INT16_MAX) ? INT16_MAX : (dRound < INT16_MIN) ? INT16_MIN : dRound);
+}
+
+/* Body rate (rad/s), three unrelated sums of sines */
+static void benchRate(double _dTime, double _dMaxRate, double *_pdRate)
+{
+    _pdRate[0] = _dMaxRate * ((0.6 * sin(2.0 * M_PI * 0.31 * _dTime)) + (0.4 * sin(2.0 * M_PI * 1.7 * _dTime + 1.0)));
+    _pdRate[1] = _dMaxRate * ((0.5 * sin(2.0 * M_PI * 0.23 * _dTime + 2.0)) + (0.5 * sin(2.0 * M_PI * 2.3 * _dTime)));
+    _pdRate[2] = _dMaxRate * ((0.7 * sin(2.0 * M_PI * 0.13 * _dTime + 0.5)) + (0.3 * sin(2.0 * M_PI * 3.1 * _dTime + 1.5)));
+}
+
+/* q = q x exp(rate x dt / 2) */
+static void benchRotate(double *_pdQ, const double *_pdRate, double _dDt)
+{
+    double dAngle = sqrt((_pdRate[0] * _pdRate[0]) + (_pdRate[1] * _pdRate[1]) + (_pdRate[2] * _pdRate[2])) * _dDt;
+    double adR[4] = {1.0, 0.0, 0.0, 0.0};
+    double adQ[4];
+
+    if(dAngle > 0.0)
+    {
+        double dScale = sin(dAngle / 2.0) / (dAngle / _dDt);
+        adR[0] = cos(dAngle / 2.0);
+        adR[1] = _pdRate[0] * dScale;
+        adR[2] = _pdRate[1] * dScale;
+        adR[3] = _pdRate[2] * dScale;
+    }
+
+    adQ[0] = (_pdQ[0] * adR[0]) - (_pdQ[1] * adR[1]) - (_pdQ[2] * adR[2]) - (_pdQ[3] * adR[3]);
+    adQ[1] = (_pdQ[0] * adR[1]) + (_pdQ[1] * adR[0]) + (_pdQ[2] * adR[3]) - (_pdQ[3] * adR[2]);
+    adQ[2] = (_pdQ[0] * adR[2]) - (_pdQ[1] * adR[3]) + (_pdQ[2] * adR[0]) + (_pdQ[3] * adR[1]);
+    adQ[3] = (_pdQ[0] * adR[3]) + (_pdQ[1] * adR[2]) - (_pdQ[2] * adR[1]) + (_pdQ[3] * adR[0]);
+    memcpy(_pdQ, adQ, sizeof(adQ));
+}
+
+/* Earth z (gravity reaction) seen from the unit */
+static void benchGravity(const double *_pdQ, double *_pdGravity)
+{
+    _pdGravity[0] = 2.0 * ((_pdQ[1] * _pdQ[3]) - (_pdQ[0] * _pdQ[2]));
+    _pdGravity[1] = 2.0 * ((_pdQ[0] * _pdQ[1]) + (_pdQ[2] * _pdQ[3]));
+    _pdGravity[2] = (_pdQ[0] * _pdQ[0]) - (_pdQ[1] * _pdQ[1]) - (_pdQ[2] * _pdQ[2]) + (_pdQ[3] * _pdQ[3]);
+}
+
+static void benchRecord(bench_sample_t *_psSamples, uint32_t _u32Count, double _dRate, double _dMaxRate, double _dGyroNoise, double _dAccelNoise)
+{
+    double adQ[4] = {1.0, 0.0, 0.0, 0.0};
+    double dDt = 1.0 / _dRate;
+    double dGyroLsb = ((double)MESSAGE_IMU_GYRO_LSB_PER_KDPS / 1000.0) * (180.0 / M_PI);
+    double adRate[3];
+    double adGravity[3];
+
+    for(uint32_t u32Sample = 0; u32Sample < _u32Count; u32Sample++)
+    {
+        double dTime = u32Sample * dDt;
+
+        /* The gyro sees the rate at the sample, the truth moves on to the next sample */
+        benchRate(dTime, _dMaxRate, adRate);
+        benchGravity(adQ, adGravity);
+        for(uint8_t u8Axis = 0; u8Axis < 3; u8Axis++)
+        {
+            _psSamples[u32Sample].ai16Gyro[u8Axis] = benchQuantise((adRate[u8Axis] + (_dGyroNoise * benchGaussian())) * dGyroLsb);
+            _psSamples[u32Sample].ai16Accel[u8Axis] = benchQuantise((adGravity[u8Axis] + (_dAccelNoise * benchGaussian())) * MESSAGE_IMU_ACCEL_LSB_PER_G);
+        }
+
+        for(uint32_t u32Step = 0; u32Step < BENCH_SUBSTEPS; u32Step++)
+        {
+            benchRate(dTime + ((u32Step + 0.5) * dDt / BENCH_SUBSTEPS), _dMaxRate, adRate);
+            benchRotate(adQ, adRate, dDt / BENCH_SUBSTEPS);
+        }
+        memcpy(_psSamples[u32Sample].adTruth, adQ, sizeof(adQ));
+    }
+}
+
+/* Back to exactly unit length, near 1 acos turns a norm off by 1e-6 into 0.1 degree */
+static void benchUnit(const float *_pfQuaternion, double *_pdQ)
+{
+    double dNorm = sqrt(((double)_pfQuaternion[0] * _pfQuaternion[0]) + ((double)_pfQuaternion[1] * _pfQuaternion[1]) +
+                        ((double)_pfQuaternion[2] * _pfQuaternion[2]) + ((double)_pfQuaternion[3] * _pfQuaternion[3]));
+
+    for(uint8_t u8Index = 0; u8Index < 4; u8Index++)
+    {
+        _pdQ[u8Index] = _pfQuaternion[u8Index] / dNorm;
+    }
+}
+
+static double benchTilt(const double *_pdTruth, const float *_pfQuaternion)
+{
+    double adQ[4];
+    double adTruth[3];
+    double adEstimate[3];
+    double dDot;
+
+    benchUnit(_pfQuaternion, adQ);
+    benchGravity(_pdTruth, adTruth);
+    benchGravity(adQ, adEstimate);
+    dDot = (adTruth[0] * adEstimate[0]) + (adTruth[1] * adEstimate[1]) + (adTruth[2] * adEstimate[2]);
+    return acos((dDot > 1.0) ? 1.0 : dDot);
+}
+
+static double benchAngle(const float *_pfA, const float *_pfB)
+{
+    double adA[4];
+    double adB[4];
+    double dDot;
+
+    benchUnit(_pfA, adA);
+    benchUnit(_pfB, adB);
+    dDot = fabs((adA[0] * adB[0]) + (adA[1] * adB[1]) + (adA[2] * adB[2]) + (adA[3] * adB[3]));
+    return 2.0 * acos((dDot > 1.0) ? 1.0 : dDot);
+}
+
+static void benchFilter(orientation_filter_t _eFilter, float _fGain, const bench_sample_t *_psSamples, uint32_t _u32Count, uint32_t _u32PeriodUs,
+                        bench_result_t *_psFloat, bench_result_t *_psFixed)
+{
+    uint32_t u32Settle = (uint32_t)(BENCH_SETTLE_SECONDS * 1000000.0 / _u32PeriodUs);
+    orientation_float_t sFloat;
+    orientation_fixed_t sFixed;
+    float afFixed[4];
+    uint32_t u32Counted = 0;
+    uint64_t u64Start;
+    uint64_t u64Cycles;
+    volatile float fSink = 0.0f;
+
+    memset(_psFloat, 0, sizeof(bench_result_t));
+    memset(_psFixed, 0, sizeof(bench_result_t));
+
+    /* Accuracy: both variants side by side over the recording */
+    orientation_initFloat(&sFloat, _eFilter, _fGain, (float)MESSAGE_IMU_GYRO_LSB_PER_KDPS / 1000.0f, _u32PeriodUs);
+    orientation_initFixed(&sFixed, _eFilter, _fGain, (float)MESSAGE_IMU_GYRO_LSB_PER_KDPS / 1000.0f, _u32PeriodUs);
+    for(uint32_t u32Sample = 0; u32Sample < _u32Count; u32Sample++)
+    {
+        double dFloatTilt;
+        double dFixedTilt;
+        double dReference;
+
+        orientation_updateFloat(&sFloat, _psSamples[u32Sample].ai16Accel, _psSamples[u32Sample].ai16Gyro);
+        orientation_updateFixed(&sFixed, _psSamples[u32Sample].ai16Accel, _psSamples[u32Sample].ai16Gyro);
+        orientation_getFixed(&sFixed, afFixed);
+        if(u32Sample < u32Settle)
+        {
+            continue;
+        }
+
+        dFloatTilt = benchTilt(_psSamples[u32Sample].adTruth, sFloat.afQuaternion);
+        dFixedTilt = benchTilt(_psSamples[u32Sample].adTruth, afFixed);
+        dReference = benchAngle(sFloat.afQuaternion, afFixed);
+        _psFloat->dTiltRms += dFloatTilt * dFloatTilt;
+        _psFloat->dTiltMax = fmax(_psFloat->dTiltMax, dFloatTilt);
+        _psFixed->dTiltRms += dFixedTilt * dFixedTilt;
+        _psFixed->dTiltMax = fmax(_psFixed->dTiltMax, dFixedTilt);
+        _psFixed->dReferenceRms += dReference * dReference;
+        _psFixed->dReferenceMax = fmax(_psFixed->dReferenceMax, dReference);
+        u32Counted++;
+    }
+    if(u32Counted > 0)
+    {
+        _psFloat->dTiltRms = sqrt(_psFloat->dTiltRms / u32Counted);
+        _psFixed->dTiltRms = sqrt(_psFixed->dTiltRms / u32Counted);
+        _psFixed->dReferenceRms = sqrt(_psFixed->dReferenceRms / u32Counted);
+    }
+
+    /* Timing: one variant at a time, as the imu task runs them */
+    u64Start = benchNowNs();
+    u64Cycles = BENCH_CYCLES();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        for(uint32_t u32Sample = 0; u32Sample < _u32Count; u32Sample++)
+        {
+            orientation_updateFloat(&sFloat, _psSamples[u32Sample].ai16Accel, _psSamples[u32Sample].ai16Gyro);
+        }
+        fSink += sFloat.afQuaternion[0];
+    }
+    _psFloat->dCyclesPerUpdate = (double)(BENCH_CYCLES() - u64Cycles) / ((double)BENCH_TIMING_ROUNDS * _u32Count);
+    _psFloat->dNsPerUpdate = (double)(benchNowNs() - u64Start) / ((double)BENCH_TIMING_ROUNDS * _u32Count);
+
+    u64Start = benchNowNs();
+    u64Cycles = BENCH_CYCLES();
+    for(uint32_t u32Round = 0; u32Round < BENCH_TIMING_ROUNDS; u32Round++)
+    {
+        for(uint32_t u32Sample = 0; u32Sample < _u32Count; u32Sample++)
+        {
+            orientation_updateFixed(&sFixed, _psSamples[u32Sample].ai16Accel, _psSamples[u32Sample].ai16Gyro);
+        }
+        fSink += sFixed.ai32Quaternion[0];
+    }
+    _psFixed->dCyclesPerUpdate = (double)(BENCH_CYCLES() - u64Cycles) / ((double)BENCH_TIMING_ROUNDS * _u32Count);
+    _psFixed->dNsPerUpdate = (double)(benchNowNs() - u64Start) / ((double)BENCH_TIMING_ROUNDS * _u32Count);
+    (void)fSink;
+}
+
+static void benchPrint(const char *_pcName, const char *_pcVariant, const bench_result_t *_psResult, bool _bReference)
+{
+    printf("%-14s %-6s %8.1f %10.1f %9.3f %9.3f", _pcName, _pcVariant, _psResult->dNsPerUpdate, _psResult->dCyclesPerUpdate,
+           _psResult->dTiltRms * 180.0 / M_PI, _psResult->dTiltMax * 180.0 / M_PI);
+    if(_bReference == true)
+    {
+        printf(" %10.5f %10.5f", _psResult->dReferenceRms * 180.0 / M_PI, _psResult->dReferenceMax * 180.0 / M_PI);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    double dRate = 200.0;
+    double dSeconds = 60.0;
+    double dGyroNoise = 0.1;
+    double dAccelNoise = 0.01;
+    double dMaxRate = 180.0;
+    uint32_t u32Seed = 1;
+    static const char *apcName[ORIENTATION_FILTER_COUNT] = {"madgwick", "complementary"};
+    static const float afGain[ORIENTATION_FILTER_COUNT] = {ORIENTATION_MADGWICK_BETA, ORIENTATION_COMPLEMENTARY_KP};
+    bench_sample_t *psSamples;
+    uint32_t u32Count;
+    uint32_t u32PeriodUs;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "r:t:g:a:w:s:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'r':
+                dRate = strtod(optarg, NULL);
+                break;
+            case 't':
+                dSeconds = strtod(optarg, NULL);
+                break;
+            case 'g':
+                dGyroNoise = strtod(optarg, NULL);
+                break;
+            case 'a':
+                dAccelNoise = strtod(optarg, NULL);
+                break;
+            case 'w':
+                dMaxRate = strtod(optarg, NULL);
+                break;
+            case 's':
+                u32Seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r sample rate Hz] [-t seconds] [-g gyro noise dps] [-a accel noise g] [-w max rate dps] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    u32PeriodUs = (uint32_t)round(1000000.0 / dRate);
+    u32Count = (uint32_t)(dSeconds * dRate);
+    if(dRate <= 0.0 || u32PeriodUs == 0 || u32PeriodUs > UINT16_MAX || dSeconds <= BENCH_SETTLE_SECONDS)
+    {
+        fprintf(stderr, "sample period must fit the imu message (1 to 65535 us), and the run be longer than %.0f s\n", BENCH_SETTLE_SECONDS);
+        return 1;
+    }
+    psSamples = (bench_sample_t*) malloc(u32Count * sizeof(bench_sample_t));
+    if(psSamples == NULL)
+    {
+        return 1;
+    }
+
+    srandom(u32Seed);
+    benchRecord(psSamples, u32Count, 1000000.0 / u32PeriodUs, dMaxRate * M_PI / 180.0, dGyroNoise * M_PI / 180.0, dAccelNoise);
+
+    printf("%u samples at %u us, rate up to %.0f dps, noise gyro %.3f dps accel %.3f g\n", u32Count, u32PeriodUs, dMaxRate, dGyroNoise, dAccelNoise);
+    printf("%-14s %-6s %8s %10s %9s %9s %10s %10s\n", "filter", "", "ns/upd", "cycles/upd", "tilt rms", "tilt max", "vs float", "vs float");
+    printf("%-14s %-6s %8s %10s %9s %9s %10s %10s\n", "", "", "", "(tsc)", "(deg)", "(deg)", "rms (deg)", "max (deg)");
+    for(uint8_t u8Filter = 0; u8Filter < ORIENTATION_FILTER_COUNT; u8Filter++)
+    {
+        bench_result_t sFloat;
+        bench_result_t sFixed;
+
+        benchFilter((orientation_filter_t)u8Filter, afGain[u8Filter], psSamples, u32Count, u32PeriodUs, &sFloat, &sFixed);
+        benchPrint(apcName[u8Filter], "float", &sFloat, false);
+        benchPrint(apcName[u8Filter], "fixed", &sFixed, true);
+    }
+
+    free(psSamples);
+
+    return 0;
+}
@@ -0,0 +1,272 @@
+/*
+    QCAP REPLAY (host tool)
+
+    Replays the received bytes of a link capture (see main/capture.h) through the firmware parser
+    (processIncomingCommunication), as fast as possible or at the recorded pace, and reports the
+    parser throughput. Also rebuilds a .qcap file from the "CAP" lines of a terminal "capture dump".
+
+    Build (from quell/tools/qcap):
+    gcc -O2 -Wall -I../host -I../../main -I../../main/ProtocolTask -o qcapReplay qcapReplay.c \
+        ../../main/capture.c ../../main/FIFO.c ../../main/crc.c ../../main/ProtocolTask/protocol.c ../../main/ProtocolTask/flowControl.c ../../main/ProtocolTask/tdma.c ../../main/ProtocolTask/router.c ../../main/ProtocolTask/linkBench.c ../../main/ProtocolTask/linkSpeed.c ../../main/ProtocolTask/channel.c ../../main/fec.c ../../main/sampleBus.c ../../main/messages.c
+
+    Usage:
+    qcapReplay [-p] [-l link] [-r repeat] <capture.qcap>       Replay (-p: recorded pace, default link 1)
+    qcapReplay -x <terminal.log> <capture.qcap>                Rebuild a capture from a terminal dump
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "quell.h"
+#include "FIFO.h"
+#include "capture.h"
+#include "protocol.h"
+
+#define REPLAY_FIFO_SIZE (512UL)
+
+typedef struct
+{
+    uint64_t u64Bytes;
+    uint64_t u64Records;
+    uint64_t u64Packets;
+    uint64_t u64Rejected;   //Calls that consumed bytes without a valid packet (bad CRC, garbage)
+}replay_stats_t;
+
+static uint64_t replayNowNs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+static void replayProcess(fifo_t *_psFIFORx, fifo_t *_psFIFOTx, protocol_link_t *_psLink, replay_stats_t *_psStats)
+{
+    size_t tBefore;
+    size_t tAfter;
+
+    for(;;)
+    {
+        FIFO_count(_psFIFORx, &tBefore);
+        if(processIncomingCommunication(_psFIFORx, _psFIFOTx, _psLink, NULL) == QUELL_OK)
+        {
+            _psStats->u64Packets++;
+        }
+        else
+        {
+            /* Nothing consumed means a packet is still incomplete */
+            FIFO_count(_psFIFORx, &tAfter);
+            if(tAfter == tBefore)
+            {
+                break;
+            }
+            _psStats->u64Rejected++;
+        }
+
+        /* Acknowledgements are not part of the replay */
+        FIFO_clean(_psFIFOTx);
+    }
+}
+
+static int replayCapture(const uint8_t *_pu8Capture, size_t _tSize, uint8_t _u8Link, int _iRepeat, int _iPaced)
+{
+    char acFIFORx[REPLAY_FIFO_SIZE];
+    char acFIFOTx[REPLAY_FIFO_SIZE];
+    fifo_t sFIFORx;
+    fifo_t sFIFOTx;
+    protocol_link_t sLink;
+    replay_stats_t sStats;
+    capture_record_t sRecord;
+    uint64_t u64Start;
+    uint64_t u64Elapsed;
+
+    memset(&sStats, 0, sizeof(sStats));
+    FIFO_init(&sFIFORx, acFIFORx, sizeof(acFIFORx));
+    FIFO_init(&sFIFOTx, acFIFOTx, sizeof(acFIFOTx));
+    protocolLink_init(&sLink, sizeof(acFIFORx), 0);
+
+    u64Start = replayNowNs();
+    for(int iPass = 0; iPass < _iRepeat; iPass++)
+    {
+        size_t tOffset = 0;
+        uint64_t u64PassStart = replayNowNs();
+        uint32_t u32FirstTimestamp = 0;
+        int iFirst = 1;
+
+        while(capture_nextRecord(_pu8Capture, _tSize, &tOffset, &sRecord) == QUELL_OK)
+        {
+            if(sRecord.bTx == true || sRecord.u8Link != _u8Link)
+            {
+                continue;
+            }
+
+            /* Recorded pace: wait until the record is due (timestamps are microseconds, wrapping) */
+            if(_iPaced)
+            {
+                if(iFirst)
+                {
+                    u32FirstTimestamp = sRecord.u32Timestamp;
+                    iFirst = 0;
+                }
+                uint64_t u64Due = u64PassStart + (uint64_t)(uint32_t)(sRecord.u32Timestamp - u32FirstTimestamp) * 1000ULL;
+                while(replayNowNs() < u64Due);
+            }
+
+            for(uint16_t u16Index = 0; u16Index < sRecord.u16Length; u16Index++)
+            {
+                /* The firmware FIFO Rx never overflows thanks to the credits, so make room the same way */
+                if(FIFO_put(&sFIFORx, (char)sRecord.pu8Data[u16Index]) == false)
+                {
+                    replayProcess(&sFIFORx, &sFIFOTx, &sLink, &sStats);
+                    if(FIFO_put(&sFIFORx, (char)sRecord.pu8Data[u16Index]) == false)
+                    {
+                        /* Garbage filling the FIFO, drop it like the firmware would trim it */
+                        FIFO_clean(&sFIFORx);
+                        FIFO_put(&sFIFORx, (char)sRecord.pu8Data[u16Index]);
+                    }
+                }
+            }
+            replayProcess(&sFIFORx, &sFIFOTx, &sLink, &sStats);
+
+            sStats.u64Bytes += sRecord.u16Length;
+            sStats.u64Records++;
+        }
+    }
+    u64Elapsed = replayNowNs() - u64Start;
+
+    printf("link %u: %llu records, %llu bytes, %llu packets, %llu rejected, %llu credits\n", _u8Link,
+           (unsigned long long)sStats.u64Records, (unsigned long long)sStats.u64Bytes,
+           (unsigned long long)sStats.u64Packets, (unsigned long long)sStats.u64Rejected,
+           (unsigned long long)sLink.sFlowControl.u32CreditsReceived);
+    printf("fec frames %u, corrected %u, failures %u\n", sLink.u32RxFECFrames, sLink.u32RxFECCorrected, sLink.u32RxFECFailures);
+    if(u64Elapsed > 0)
+    {
+        printf("%.3f ms, %.2f MB/s, %.0f packets/s, %.1f ns/byte\n", u64Elapsed / 1e6,
+               (sStats.u64Bytes * 1e3) / u64Elapsed, (sStats.u64Packets * 1e9) / u64Elapsed,
+               (sStats.u64Bytes > 0) ? (double)u64Elapsed / sStats.u64Bytes : 0.0);
+    }
+
+    return 0;
+}
+
+/* Turns "CAP <offset> <hex>" lines of a terminal log back into the capture bytes */
+static int replayConvertLog(const char *_pcLogFile, const char *_pcCaptureFile)
+{
+    FILE *psLog;
+    FILE *psCapture;
+    char *pcLine = NULL;
+    size_t tLineSize = 0;
+    size_t tWritten = 0;
+
+    psLog = fopen(_pcLogFile, "r");
+    psCapture = fopen(_pcCaptureFile, "wb");
+    if(psLog == NULL || psCapture == NULL)
+    {
+        perror("open");
+        return 1;
+    }
+
+    while(getline(&pcLine, &tLineSize, psLog) > 0)
+    {
+        char *pcCap = strstr(pcLine, "CAP ");
+        unsigned int uiOffset;
+        int iConsumed;
+
+        if(pcCap == NULL || sscanf(pcCap, "CAP %x %n", &uiOffset, &iConsumed) != 1 || uiOffset != tWritten)
+        {
+            continue;
+        }
+
+        for(char *pcHex = pcCap + iConsumed; pcHex[0] != 0 && pcHex[1] != 0; pcHex += 2)
+        {
+            unsigned int uiByte;
+            if(sscanf(pcHex, "%2x", &uiByte) != 1)
+            {
+                break;
+            }
+            fputc(uiByte, psCapture);
+            tWritten++;
+        }
+    }
+
+    free(pcLine);
+    fclose(psLog);
+    fclose(psCapture);
+    printf("%zu bytes written to %s\n", tWritten, _pcCaptureFile);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int iPaced = 0;
+    int iRepeat = 1;
+    uint8_t u8Link = 1;
+    int iOption;
+    int iFile;
+    struct stat sStat;
+    uint8_t *pu8Capture;
+
+    while((iOption = getopt(argc, argv, "pl:r:x")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'p':
+                iPaced = 1;
+                break;
+            case 'l':
+                u8Link = (uint8_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                iRepeat = atoi(optarg);
+                break;
+            case 'x':
+                if(optind + 2 != argc)
+                {
+                    fprintf(stderr, "usage: %s -x <terminal.log> <capture.qcap>\n", argv[0]);
+                    return 1;
+                }
+                return replayConvertLog(argv[optind], argv[optind + 1]);
+            default:
+                fprintf(stderr, "usage: %s [-p] [-l link] [-r repeat] <capture.qcap>\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-p] [-l link] [-r repeat] <capture.qcap>\n", argv[0]);
+        return 1;
+    }
+
+    /* Map the whole capture, records are parsed in place */
+    iFile = open(argv[optind], O_RDONLY);
+    if(iFile < 0 || fstat(iFile, &sStat) != 0 || sStat.st_size == 0)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    pu8Capture = mmap(NULL, sStat.st_size, PROT_READ, MAP_PRIVATE, iFile, 0);
+    close(iFile);
+    if(pu8Capture == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    if(capture_checkHeader(pu8Capture, sStat.st_size) == QUELL_ERROR)
+    {
+        fprintf(stderr, "%s: not a QCAP v%u file\n", argv[optind], CAPTURE_VERSION);
+        return 1;
+    }
+
+    replayCapture(pu8Capture, sStat.st_size, u8Link, (iRepeat > 0) ? iRepeat : 1, iPaced);
+
+    munmap(pu8Capture, sStat.st_size);
+    return 0;
+}
@@ -0,0 +1,349 @@
+/*
+    REORDER BUFFER TESTS (host tool)
+
+    The reorder buffer of the imu task (main/reorder.c) fed the way a link delivers: every unit samples
+    a slow sine on its own clock (the timestamps wrap during the run), sends a batch of samples at a
+    time, and every batch arrives after the delay of its unit plus a random jitter, so batches overtake
+    each other when the jitter is longer than a batch. Some are lost (-l). Like the imu task, the
+    buffer is emptied on a 1 ms tick. The sources stop a second before the end, so the last windows
+    have to go out by the quiet rule.
+
+    For every watermark (all of them, or -w) and fill, per window:
+    - windows come out in order, one after the other, and every sample not flagged is the one sent;
+    - the wait (first sample in to window out) stays within the window span plus the watermark;
+    - with no loss, the latency (last sample taken to window out) stays within the watermark plus the
+      delay, jitter and batch span, and a jitter below the watermark makes nothing late;
+    - a jitter longer than the batch span (the default, 100 ms against 4 x 10 ms) reorders samples once
+      the watermark is longer than a batch too, and the late samples go down as the watermark goes up
+      (and are fewer at the last one, when it is longer than a batch).
+    Reports the gaps, late and reordered samples, the latency and the error of the filled samples
+    against the signal. Any failure makes the exit status 1.
+
+    Build (from quell/tools/reorder):
+    gcc -O2 -Wall -I../host -I../../main -o reorderBench reorderBench.c ../../main/reorder.c -lm
+
+    Usage:
+    reorderBench [-w watermark ms] [-j jitter ms] [-l loss %] [-n window] [-b batch] [-p period us] [-t seconds] [-s seed]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "quell.h"
+#include "reorder.h"
+
+#define BENCH_UNITS (3)
+#define BENCH_TICK_US (1000ULL)
+#define BENCH_QUIET_US (1000000ULL)         //No new samples at the end
+#define BENCH_AMPLITUDE (8000.0)
+#define BENCH_SIGNAL_HZ (2.0)
+#define BENCH_CLOCK_START ((uint32_t)(0xFFFFFFFFUL - 5000000UL))    //The unit clocks wrap 5 s in
+
+static const uint32_t au32DelayUs[BENCH_UNITS] = {2000, 9000, 12000};  //Chest, hands a hop or two away
+static const uint32_t au32WatermarksMs[] = {0, 5, 10, 20, 40, 80};
+static const char *apcFillName[REORDER_FILL_COUNT] = {"flag", "hold", "interpolate"};
+
+typedef struct
+{
+    uint64_t u64ArrivalUs;
+    uint8_t u8Unit;
+    uint32_t u32First;                  //Sample number
+}bench_batch_t;
+
+typedef struct
+{
+    uint64_t u64Sent;
+    uint64_t u64Windows;
+    uint64_t u64Gaps;
+    uint64_t u64Late;
+    uint64_t u64Reordered;
+    uint64_t u64LatencyUs;
+    uint64_t u64MaxLatencyUs;
+    uint32_t u32MaxWaitUs;
+    double dFillSquares;
+    uint32_t u32Failures;
+}bench_result_t;
+
+static uint64_t u64NowUs;
+static uint32_t u32Period = 10000;
+static uint8_t u8Batch = 4;
+static uint8_t u8Window = 8;
+static uint32_t u32JitterUs = 100000;
+static uint32_t u32LossPercent = 0;
+static uint32_t u32Seconds = 60;
+static uint32_t u32Seed = 1;
+static uint32_t u32Random;
+
+static uint32_t benchNowUs(void)
+{
+    return (uint32_t)u64NowUs;
+}
+
+static uint32_t benchRandom(void)
+{
+    u32Random ^= u32Random << 13;
+    u32Random ^= u32Random >> 17;
+    u32Random ^= u32Random << 5;
+    return u32Random;
+}
+
+static int16_t benchValue(uint8_t _u8Unit, uint32_t _u32Sample, uint8_t _u8Channel)
+{
+    double dTime = (double)_u32Sample * u32Period / 1e6;
+    return (int16_t)lround(BENCH_AMPLITUDE * sin((2.0 * M_PI * BENCH_SIGNAL_HZ * dTime) + _u8Channel + _u8Unit));
+}
+
+static int benchCompare(const void *_pvA, const void *_pvB)
+{
+    const bench_batch_t *psA = _pvA;
+    const bench_batch_t *psB = _pvB;
+    return (psA->u64ArrivalUs > psB->u64ArrivalUs) - (psA->u64ArrivalUs < psB->u64ArrivalUs);
+}
+
+static uint32_t benchRun(uint32_t _u32WatermarkUs, reorder_fill_t _eFill, bench_result_t *_psResult)
+{
+    uint32_t u32Batches = (uint32_t)(((u32Seconds * 1000000ULL) - BENCH_QUIET_US) / ((uint64_t)u8Batch * u32Period));
+    bench_batch_t *psBatches = calloc((size_t)u32Batches * BENCH_UNITS, sizeof(bench_batch_t));
+    reorder_t asReorder[BENCH_UNITS];
+    bool abStarted[BENCH_UNITS] = {false};
+    uint32_t au32NextSample[BENCH_UNITS];
+    uint32_t au32LastArrived[BENCH_UNITS] = {0};
+    uint32_t u32Count = 0;
+    uint32_t u32Next = 0;
+    uint32_t u32MaxDelay = 0;
+    int16_t ai16Samples[REORDER_MAX_WINDOW * REORDER_CHANNELS];
+    reorder_window_t sWindow;
+
+    memset(_psResult, 0, sizeof(bench_result_t));
+    u32Random = u32Seed;
+    u64NowUs = 0;
+    if(psBatches == NULL)
+    {
+        return 1;
+    }
+
+    for(uint8_t u8Unit = 0; u8Unit < BENCH_UNITS; u8Unit++)
+    {
+        if(reorder_init(&asReorder[u8Unit], u8Window, _u32WatermarkUs, _eFill, benchNowUs) == QUELL_ERROR)
+        {
+            free(psBatches);
+            return 1;
+        }
+        u32MaxDelay = (au32DelayUs[u8Unit] > u32MaxDelay) ? au32DelayUs[u8Unit] : u32MaxDelay;
+
+        /* A batch leaves once its last sample is taken */
+        for(uint32_t u32Index = 0; u32Index < u32Batches; u32Index++)
+        {
+            uint32_t u32Jitter = (u32JitterUs > 0) ? benchRandom() % (u32JitterUs + 1) : 0;
+
+            _psResult->u64Sent += u8Batch;
+            if(benchRandom() % 100 < u32LossPercent)
+            {
+                continue;
+            }
+            psBatches[u32Count].u8Unit = u8Unit;
+            psBatches[u32Count].u32First = u32Index * u8Batch;
+            psBatches[u32Count].u64ArrivalUs = ((uint64_t)(psBatches[u32Count].u32First + u8Batch - 1) * u32Period) + au32DelayUs[u8Unit] + u32Jitter;
+            u32Count++;
+        }
+    }
+    qsort(psBatches, u32Count, sizeof(bench_batch_t), benchCompare);
+
+    for(u64NowUs = 0; u64NowUs < u32Seconds * 1000000ULL; u64NowUs += BENCH_TICK_US)
+    {
+        while(u32Next < u32Count && psBatches[u32Next].u64ArrivalUs <= u64NowUs)
+        {
+            bench_batch_t *psBatch = &psBatches[u32Next++];
+
+            for(uint8_t u8Sample = 0; u8Sample < u8Batch; u8Sample++)
+            {
+                for(uint8_t u8Channel = 0; u8Channel < REORDER_CHANNELS; u8Channel++)
+                {
+                    ai16Samples[(u8Sample * REORDER_CHANNELS) + u8Channel] = benchValue(psBatch->u8Unit, psBatch->u32First + u8Sample, u8Channel);
+                }
+            }
+            reorder_push(&asReorder[psBatch->u8Unit], BENCH_CLOCK_START + (psBatch->u32First * u32Period), (uint16_t)u32Period, ai16Samples, u8Batch);
+            au32LastArrived[psBatch->u8Unit] = (psBatch->u32First + u8Batch > au32LastArrived[psBatch->u8Unit]) ? psBatch->u32First + u8Batch : au32LastArrived[psBatch->u8Unit];
+        }
+
+        for(uint8_t u8Unit = 0; u8Unit < BENCH_UNITS; u8Unit++)
+        {
+            while(reorder_pop(&asReorder[u8Unit], &sWindow) == QUELL_OK)
+            {
+                uint32_t u32First = (sWindow.u32Timestamp - BENCH_CLOCK_START) / u32Period;
+                uint64_t u64Latency = u64NowUs - ((uint64_t)(u32First + u8Window - 1) * u32Period);
+
+                if(abStarted[u8Unit] == true && u32First != au32NextSample[u8Unit])
+                {
+                    printf("    FAIL unit %u window at sample %u, expected %u\n", u8Unit, u32First, au32NextSample[u8Unit]);
+                    _psResult->u32Failures++;
+                }
+                abStarted[u8Unit] = true;
+                au32NextSample[u8Unit] = u32First + u8Window;
+
+                for(uint8_t u8Index = 0; u8Index < sWindow.u8Length; u8Index++)
+                {
+                    for(uint8_t u8Channel = 0; u8Channel < REORDER_CHANNELS; u8Channel++)
+                    {
+                        double dError = sWindow.aai16Samples[u8Index][u8Channel] - benchValue(u8Unit, u32First + u8Index, u8Channel);
+
+                        if((sWindow.u32GapMask & (1UL << u8Index)) != 0)
+                        {
+                            _psResult->dFillSquares += dError * dError;
+                        }
+                        else if(dError != 0.0)
+                        {
+                            printf("    FAIL unit %u sample %u is not the one sent\n", u8Unit, u32First + u8Index);
+                            _psResult->u32Failures++;
+                            break;
+                        }
+                    }
+                }
+
+                _psResult->u64Windows++;
+                _psResult->u64LatencyUs += u64Latency;
+                _psResult->u64MaxLatencyUs = (u64Latency > _psResult->u64MaxLatencyUs) ? u64Latency : _psResult->u64MaxLatencyUs;
+            }
+        }
+    }
+
+    for(uint8_t u8Unit = 0; u8Unit < BENCH_UNITS; u8Unit++)
+    {
+        reorder_t *psReorder = &asReorder[u8Unit];
+
+        _psResult->u64Gaps += psReorder->u32Gaps;
+        _psResult->u64Late += psReorder->u32Late;
+        _psResult->u64Reordered += psReorder->u32Reordered;
+        _psResult->u32MaxWaitUs = (psReorder->u32MaxWaitUs > _psResult->u32MaxWaitUs) ? psReorder->u32MaxWaitUs : _psResult->u32MaxWaitUs;
+
+        /* Everything that arrived went out once the unit was quiet */
+        if(abStarted[u8Unit] == false || au32NextSample[u8Unit] < au32LastArrived[u8Unit] || psReorder->u32Restarts > 0 || psReorder->u32Duplicates > 0)
+        {
+            printf("    FAIL unit %u still holds samples (or restarted)\n", u8Unit);
+            _psResult->u32Failures++;
+        }
+    }
+
+    if(_psResult->u32MaxWaitUs > ((uint32_t)u8Window * u32Period) + _u32WatermarkUs + BENCH_TICK_US)
+    {
+        printf("    FAIL a window waited %u us\n", _psResult->u32MaxWaitUs);
+        _psResult->u32Failures++;
+    }
+    if(u32LossPercent == 0 && _psResult->u64MaxLatencyUs > _u32WatermarkUs + u32MaxDelay + u32JitterUs + ((uint64_t)u8Batch * u32Period) + BENCH_TICK_US)
+    {
+        printf("    FAIL latency %llu us\n", (unsigned long long)_psResult->u64MaxLatencyUs);
+        _psResult->u32Failures++;
+    }
+    if(u32JitterUs > (uint32_t)u8Batch * u32Period && _u32WatermarkUs > (uint32_t)u8Batch * u32Period && _psResult->u64Reordered == 0)
+    {
+        printf("    FAIL nothing reordered with the jitter longer than a batch\n");
+        _psResult->u32Failures++;
+    }
+    if(u32LossPercent == 0 && u32JitterUs + BENCH_TICK_US <= _u32WatermarkUs && _psResult->u64Late > 0)
+    {
+        printf("    FAIL %llu late samples with the jitter below the watermark\n", (unsigned long long)_psResult->u64Late);
+        _psResult->u32Failures++;
+    }
+
+    free(psBatches);
+    return _psResult->u32Failures;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t u32Watermarks = sizeof(au32WatermarksMs) / sizeof(au32WatermarksMs[0]);
+    const uint32_t *pu32Watermarks = au32WatermarksMs;
+    uint32_t u32OnlyMs;
+    uint32_t u32Failures = 0;
+    uint64_t au64FirstLate[REORDER_FILL_COUNT];
+    uint64_t au64LastLate[REORDER_FILL_COUNT];
+    bench_result_t sResult;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "w:j:l:n:b:p:t:s:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'w':
+                u32OnlyMs = strtoul(optarg, NULL, 0);
+                pu32Watermarks = &u32OnlyMs;
+                u32Watermarks = 1;
+                break;
+            case 'j':
+                u32JitterUs = strtoul(optarg, NULL, 0) * 1000UL;
+                break;
+            case 'l':
+                u32LossPercent = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                u8Window = (uint8_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                u8Batch = (uint8_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                u32Period = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                u32Seconds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                u32Seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-w watermark ms] [-j jitter ms] [-l loss %%] [-n window] [-b batch] [-p period us] [-t seconds] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(u8Window == 0 || u8Window > REORDER_MAX_WINDOW || u8Batch == 0 || u8Batch > REORDER_MAX_WINDOW || u32Period == 0 || u32Period > UINT16_MAX ||
+       u32Seconds < 2 || u32Seed == 0 || u32LossPercent >= 100)
+    {
+        fprintf(stderr, "window and batch 1..%u, period 1..65535 us, at least 2 s, seed not 0, loss below 100%%\n", REORDER_MAX_WINDOW);
+        return 1;
+    }
+
+    printf("%u units, %u us period, batches of %u, windows of %u, delays %u/%u/%u us + jitter up to %u us, loss %u%%, %u s\n",
+           BENCH_UNITS, u32Period, u8Batch, u8Window, au32DelayUs[0], au32DelayUs[1], au32DelayUs[2], u32JitterUs, u32LossPercent, u32Seconds);
+    printf("%9s %-12s %8s %7s %7s %9s %11s %11s %9s %10s\n", "watermark", "fill", "windows", "gaps %", "late", "reordered", "latency avg", "latency max", "wait max", "fill rms");
+
+    for(uint32_t u32Index = 0; u32Index < u32Watermarks; u32Index++)
+    {
+        for(uint8_t u8Fill = 0; u8Fill < REORDER_FILL_COUNT; u8Fill++)
+        {
+            uint32_t u32RunFailures = benchRun(pu32Watermarks[u32Index] * 1000UL, (reorder_fill_t)u8Fill, &sResult);
+
+            printf("%6u ms %-12s %8llu %7.3f %7llu %9llu %8.1f ms %8.1f ms %6.1f ms %10.1f %s\n", pu32Watermarks[u32Index], apcFillName[u8Fill],
+                   (unsigned long long)sResult.u64Windows, (100.0 * sResult.u64Gaps) / (sResult.u64Windows * u8Window), (unsigned long long)sResult.u64Late,
+                   (unsigned long long)sResult.u64Reordered, (sResult.u64Windows > 0) ? sResult.u64LatencyUs / 1000.0 / sResult.u64Windows : 0.0,
+                   sResult.u64MaxLatencyUs / 1000.0, sResult.u32MaxWaitUs / 1000.0,
+                   (sResult.u64Gaps > 0) ? sqrt(sResult.dFillSquares / (sResult.u64Gaps * REORDER_CHANNELS)) : 0.0, (u32RunFailures == 0) ? "" : "FAIL");
+            u32Failures += u32RunFailures;
+
+            /* The watermarks go up, a longer wait can only take more samples in time */
+            if(u32Index > 0 && u32JitterUs > (uint32_t)u8Batch * u32Period && sResult.u64Late > au64LastLate[u8Fill])
+            {
+                printf("    FAIL %llu late samples, %llu at the watermark before\n", (unsigned long long)sResult.u64Late, (unsigned long long)au64LastLate[u8Fill]);
+                u32Failures++;
+            }
+            au64FirstLate[u8Fill] = (u32Index == 0) ? sResult.u64Late : au64FirstLate[u8Fill];
+            au64LastLate[u8Fill] = sResult.u64Late;
+        }
+    }
+    for(uint8_t u8Fill = 0; u8Fill < REORDER_FILL_COUNT && u32Watermarks > 1 && u32JitterUs > (uint32_t)u8Batch * u32Period &&
+                            pu32Watermarks[u32Watermarks - 1] * 1000UL > (uint32_t)u8Batch * u32Period; u8Fill++)
+    {
+        if(au64LastLate[u8Fill] >= au64FirstLate[u8Fill])
+        {
+            printf("    FAIL %s: %llu late samples at the last watermark, %llu at the first\n", apcFillName[u8Fill],
+                   (unsigned long long)au64LastLate[u8Fill], (unsigned long long)au64FirstLate[u8Fill]);
+            u32Failures++;
+        }
+    }
+
+    printf("%s\n", (u32Failures == 0) ? "all tests passed" : "FAILED");
+
+    return (u32Failures == 0) ? 0 : 1;
+}
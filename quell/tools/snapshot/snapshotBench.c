@@ -0,0 +1,287 @@
+/*
+    SNAPSHOT STRESS TEST (host tool)
+
+    A writer thread publishes structures through a snapshot (main/snapshot.c) while a reader thread on
+    another core copies the newest one as fast as it can, for -t milliseconds. Every word of a structure
+    is its version, so a copy mixing two of them shows. The same runs with a mutex around both copies, and
+    with no protection at all (the torn copies then show the check works), for comparison.
+
+    Reports per row: the writer cost per structure and the reader cost per copy (thread CPU time), the
+    reads, the reader retries and give-ups (SNAPSHOT_MAX_RETRIES overtaken in a row) per million reads,
+    the torn copies and versions going backwards. Torn or backwards copies through the snapshot or the
+    mutex make the exit status 1. The writer goes flat out, then paced at -p ns per structure (the imu
+    task publishes a window every few milliseconds).
+
+    Build (from quell/tools/snapshot):
+    gcc -O2 -Wall -pthread -I../../main -o snapshotBench snapshotBench.c ../../main/snapshot.c
+
+    Usage:
+    snapshotBench [-t milliseconds] [-b structure bytes] [-p writer period ns]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "quell.h"
+#include "snapshot.h"
+
+#define BENCH_MAX_BYTES (16384)
+
+typedef enum
+{
+    BENCH_SNAPSHOT = 0,
+    BENCH_MUTEX,
+    BENCH_NONE,
+    BENCH_MODE_COUNT
+}bench_mode_t;
+
+typedef struct
+{
+    bench_mode_t eMode;
+    uint32_t u32PeriodNs;
+    volatile int iDone;
+    volatile int iReaderReady;
+
+    /* Writer */
+    uint64_t u64Writes;
+    uint64_t u64WriteNs;
+
+    /* Reader */
+    uint64_t u64Reads;
+    uint64_t u64ReadNs;
+    uint32_t u32Retries;
+    uint64_t u64GaveUp;
+    uint64_t u64Torn;
+    uint64_t u64Backwards;
+}bench_run_t;
+
+static const char *apcModeName[BENCH_MODE_COUNT] = {"snapshot", "mutex", "none"};
+static uint32_t u32Milliseconds = 1000;
+static uint32_t u32Words;
+
+static snapshot_t sSnapshot;
+static uint32_t *pu32Buffers;           //The 2 buffers of the snapshot, the mutex and unprotected runs use the first
+static pthread_mutex_t sMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t benchNs(clockid_t _tClock)
+{
+    struct timespec sTime;
+    clock_gettime(_tClock, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000000000ULL) + sTime.tv_nsec;
+}
+
+static void benchPin(int _iCpu)
+{
+    cpu_set_t sSet;
+    long lCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(lCpus < 2)
+    {
+        return;
+    }
+    CPU_ZERO(&sSet);
+    CPU_SET(_iCpu % lCpus, &sSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(sSet), &sSet);
+}
+
+static void* benchReader(void *_pvArgument)
+{
+    bench_run_t *psRun = (bench_run_t*)_pvArgument;
+    uint32_t au32Copy[BENCH_MAX_BYTES / 4];
+    uint32_t u32Last = 0;
+    uint64_t u64Start;
+
+    benchPin(1);
+    psRun->iReaderReady = 1;
+    u64Start = benchNs(CLOCK_THREAD_CPUTIME_ID);
+    while(psRun->iDone == 0)
+    {
+        switch(psRun->eMode)
+        {
+            case BENCH_SNAPSHOT:
+                if(snapshot_read(&sSnapshot, au32Copy, u32Words * 4, &psRun->u32Retries) == QUELL_ERROR)
+                {
+                    psRun->u64GaveUp += (sSnapshot.u32Published > 0) ? 1 : 0;
+                    continue;
+                }
+                break;
+            case BENCH_MUTEX:
+                pthread_mutex_lock(&sMutex);
+                memcpy(au32Copy, pu32Buffers, u32Words * 4);
+                pthread_mutex_unlock(&sMutex);
+                break;
+            default:
+                memcpy(au32Copy, (const void*)pu32Buffers, u32Words * 4);
+                break;
+        }
+        psRun->u64Reads++;
+
+        /* Version 0 is the initial zeroed structure of the mutex and unprotected runs */
+        for(uint32_t u32Word = 1; u32Word < u32Words; u32Word++)
+        {
+            if(au32Copy[u32Word] != au32Copy[0])
+            {
+                psRun->u64Torn++;
+                break;
+            }
+        }
+        psRun->u64Backwards += (au32Copy[0] < u32Last) ? 1 : 0;
+        u32Last = au32Copy[0];
+    }
+    psRun->u64ReadNs = benchNs(CLOCK_THREAD_CPUTIME_ID) - u64Start;
+
+    return NULL;
+}
+
+static void benchWrite(bench_run_t *_psRun, uint32_t _u32Version)
+{
+    uint32_t *pu32Structure;
+
+    switch(_psRun->eMode)
+    {
+        case BENCH_SNAPSHOT:
+            pu32Structure = (uint32_t*)snapshot_claim(&sSnapshot);
+            for(uint32_t u32Word = 0; u32Word < u32Words; u32Word++)
+            {
+                pu32Structure[u32Word] = _u32Version;
+            }
+            snapshot_publish(&sSnapshot);
+            break;
+        case BENCH_MUTEX:
+            pthread_mutex_lock(&sMutex);
+            for(uint32_t u32Word = 0; u32Word < u32Words; u32Word++)
+            {
+                pu32Buffers[u32Word] = _u32Version;
+            }
+            pthread_mutex_unlock(&sMutex);
+            break;
+        default:
+            for(uint32_t u32Word = 0; u32Word < u32Words; u32Word++)
+            {
+                ((volatile uint32_t*)pu32Buffers)[u32Word] = _u32Version;
+            }
+            break;
+    }
+}
+
+static uint32_t benchRun(bench_mode_t _eMode, uint32_t _u32PeriodNs)
+{
+    bench_run_t sRun;
+    pthread_t tReader;
+    uint64_t u64End;
+    uint64_t u64Next;
+    uint64_t u64Start;
+    uint32_t u32Version = 1;
+    uint32_t u32Failures = 0;
+
+    memset(&sRun, 0, sizeof(sRun));
+    sRun.eMode = _eMode;
+    sRun.u32PeriodNs = _u32PeriodNs;
+    memset(pu32Buffers, 0, u32Words * 4 * 2);
+    snapshot_init(&sSnapshot, pu32Buffers, u32Words * 4);
+    benchWrite(&sRun, u32Version++);
+
+    pthread_create(&tReader, NULL, benchReader, &sRun);
+    while(sRun.iReaderReady == 0)
+    {
+        sched_yield();
+    }
+
+    benchPin(0);
+    u64End = benchNs(CLOCK_MONOTONIC) + ((uint64_t)u32Milliseconds * 1000000ULL);
+    u64Next = benchNs(CLOCK_MONOTONIC);
+    while(benchNs(CLOCK_MONOTONIC) < u64End)
+    {
+        if(_u32PeriodNs > 0)
+        {
+            u64Next += _u32PeriodNs;
+            while(benchNs(CLOCK_MONOTONIC) < u64Next);
+        }
+        u64Start = benchNs(CLOCK_THREAD_CPUTIME_ID);
+        benchWrite(&sRun, u32Version++);
+        sRun.u64WriteNs += benchNs(CLOCK_THREAD_CPUTIME_ID) - u64Start;
+        sRun.u64Writes++;
+    }
+    sRun.iDone = 1;
+    pthread_join(tReader, NULL);
+
+    printf("%-9s %-9s %-10.1f %-10.1f %-11llu %-12.1f %-12.1f %-8llu %llu\n", apcModeName[_eMode],
+           (_u32PeriodNs > 0) ? "paced" : "flat out", (double)sRun.u64WriteNs / sRun.u64Writes,
+           (sRun.u64Reads > 0) ? (double)sRun.u64ReadNs / sRun.u64Reads : 0.0, (unsigned long long)sRun.u64Reads,
+           (sRun.u64Reads > 0) ? (1e6 * sRun.u32Retries) / sRun.u64Reads : 0.0,
+           (sRun.u64Reads > 0) ? (1e6 * sRun.u64GaveUp) / sRun.u64Reads : 0.0,
+           (unsigned long long)sRun.u64Torn, (unsigned long long)sRun.u64Backwards);
+
+    if(_eMode != BENCH_NONE && (sRun.u64Torn > 0 || sRun.u64Backwards > 0))
+    {
+        printf("    FAIL %s let %llu torn and %llu older copies through\n", apcModeName[_eMode],
+               (unsigned long long)sRun.u64Torn, (unsigned long long)sRun.u64Backwards);
+        u32Failures++;
+    }
+    if(_eMode == BENCH_SNAPSHOT && sRun.u64Reads == 0)
+    {
+        printf("    FAIL the reader got nothing\n");
+        u32Failures++;
+    }
+
+    return u32Failures;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t u32Bytes = 1176;           //sizeof(imu_snapshot_t) on the ESP32
+    uint32_t u32PeriodNs = 20000;
+    uint32_t u32Failures = 0;
+    int iOption;
+
+    while((iOption = getopt(argc, argv, "t:b:p:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 't':
+                u32Milliseconds = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                u32Bytes = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                u32PeriodNs = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t milliseconds] [-b structure bytes] [-p writer period ns]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(u32Bytes < 8 || u32Bytes > BENCH_MAX_BYTES || u32Milliseconds == 0 || u32PeriodNs == 0)
+    {
+        fprintf(stderr, "structure 8..%u bytes, time and period > 0\n", BENCH_MAX_BYTES);
+        return 1;
+    }
+    u32Words = u32Bytes / 4;
+    pu32Buffers = aligned_alloc(64, ((u32Words * 4 * 2) + 63) & ~63U);
+    if(pu32Buffers == NULL)
+    {
+        return 1;
+    }
+
+    printf("structures of %u bytes, %u ms a run, paced writer every %u ns, %ld cpus\n",
+           u32Words * 4, u32Milliseconds, u32PeriodNs, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-9s %-9s %-10s %-10s %-11s %-12s %-12s %-8s %s\n", "mode", "writer", "write ns", "read ns", "reads",
+           "retries/M", "gave up/M", "torn", "backwards");
+    for(bench_mode_t eMode = BENCH_SNAPSHOT; eMode < BENCH_MODE_COUNT; eMode++)
+    {
+        u32Failures += benchRun(eMode, 0);
+        u32Failures += benchRun(eMode, u32PeriodNs);
+    }
+
+    printf("%s\n", (u32Failures == 0) ? "all tests passed" : "FAILED");
+    free(pu32Buffers);
+
+    return (u32Failures == 0) ? 0 : 1;
+}
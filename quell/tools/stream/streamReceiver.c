@@ -0,0 +1,359 @@
+/*
+    STREAM RECEIVER (host tool)
+
+    Puts the UART0 terminal in binary stream mode (main/TerminalTask/terminalStream.h), follows it to the
+    stream baud rate and receives the packets with the firmware parser (getPacketFromFIFO/verifyPacket).
+    Every valid stream message is appended to the output file as a u16 Big Endian length followed by
+    the message (type, sequence, timestamp, payload). Ctrl-C (or -t) sends the stop sequence and waits
+    for the end message, which leaves the board back in text mode.
+
+    Build (from quell/tools/stream):
+    gcc -O2 -Wall -I../host -I../../main -I../../main/ProtocolTask -I../../main/TerminalTask -o streamReceiver streamReceiver.c \
+        ../../main/FIFO.c ../../main/crc.c ../../main/ProtocolTask/protocol.c ../../main/ProtocolTask/flowControl.c ../../main/ProtocolTask/tdma.c ../../main/ProtocolTask/router.c ../../main/ProtocolTask/linkBench.c ../../main/ProtocolTask/linkSpeed.c ../../main/ProtocolTask/channel.c ../../main/fec.c ../../main/sampleBus.c ../../main/messages.c
+
+    Usage:
+    streamReceiver -d /dev/ttyUSB0 [-b baud] [-s bus|stats|all] [-o messages.bin] [-t seconds]
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include "quell.h"
+#include "FIFO.h"
+#include "protocol.h"
+#include "terminalStream.h"
+#include "messages.h"
+
+#define RECEIVER_FIFO_SIZE (8192UL)
+#define RECEIVER_READ_SIZE (1024UL)
+#define RECEIVER_PACKET_SIZE (512UL)
+#define RECEIVER_ANSWER_TIMEOUT_MS (2000UL)
+#define RECEIVER_END_TIMEOUT_MS (1000UL)
+
+typedef struct
+{
+    uint64_t u64Bytes;
+    uint64_t u64Messages;
+    uint64_t u64Bus;
+    uint64_t u64Stats;
+    uint64_t u64Gaps;           //Messages missing from the sequence (lost on the board or on the wire)
+    uint64_t u64Rejected;       //Packets that failed the CRC16 (lost on the wire)
+    bool bEnd;
+    bool bFirst;
+    uint16_t u16NextSequence;
+}receiver_stats_t;
+
+static volatile sig_atomic_t iStop = 0;
+
+static void receiverSignal(int _iSignal)
+{
+    iStop = 1;
+}
+
+static uint64_t receiverNowMs(void)
+{
+    struct timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000ULL) + (sTime.tv_nsec / 1000000ULL);
+}
+
+static speed_t receiverSpeed(uint32_t _u32BaudRate)
+{
+    static const struct
+    {
+        uint32_t u32BaudRate;
+        speed_t tSpeed;
+    }asSpeeds[] = {{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+                   {230400, B230400}, {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+                   {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+                   {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000}};
+
+    for(size_t tIndex = 0; tIndex < sizeof(asSpeeds) / sizeof(asSpeeds[0]); tIndex++)
+    {
+        if(asSpeeds[tIndex].u32BaudRate == _u32BaudRate)
+        {
+            return asSpeeds[tIndex].tSpeed;
+        }
+    }
+
+    return B0;
+}
+
+static int receiverSetBaudRate(int _iFile, uint32_t _u32BaudRate)
+{
+    struct termios sTermios;
+    speed_t tSpeed = receiverSpeed(_u32BaudRate);
+
+    if(tSpeed == B0 || tcgetattr(_iFile, &sTermios) != 0)
+    {
+        return -1;
+    }
+
+    cfmakeraw(&sTermios);
+    sTermios.c_cflag |= CLOCAL | CREAD;
+    sTermios.c_cc[VMIN] = 0;
+    sTermios.c_cc[VTIME] = 0;
+    cfsetispeed(&sTermios, tSpeed);
+    cfsetospeed(&sTermios, tSpeed);
+
+    /* Bytes still in flight belong to the old rate */
+    return tcsetattr(_iFile, TCSADRAIN, &sTermios);
+}
+
+static ssize_t receiverRead(int _iFile, uint8_t *_pu8Buffer, size_t _tSize, int _iTimeoutMs)
+{
+    struct pollfd sPoll = {.fd = _iFile, .events = POLLIN};
+
+    if(poll(&sPoll, 1, _iTimeoutMs) <= 0)
+    {
+        return 0;
+    }
+
+    return read(_iFile, _pu8Buffer, _tSize);
+}
+
+/* Text mode: send the command and wait for "stream on" before following the baud rate */
+static int receiverStart(int _iFile, const char *_pcSource, uint32_t _u32BaudRate)
+{
+    char acCommand[64];
+    char acAnswer[512];
+    size_t tAnswer = 0;
+    uint64_t u64Deadline = receiverNowMs() + RECEIVER_ANSWER_TIMEOUT_MS;
+
+    snprintf(acCommand, sizeof(acCommand), "\rstream %s %u\r", _pcSource, _u32BaudRate);
+    if(write(_iFile, acCommand, strlen(acCommand)) != (ssize_t)strlen(acCommand))
+    {
+        return -1;
+    }
+
+    while(receiverNowMs() < u64Deadline && tAnswer < sizeof(acAnswer) - 1)
+    {
+        ssize_t tRead = receiverRead(_iFile, (uint8_t*)&acAnswer[tAnswer], sizeof(acAnswer) - 1 - tAnswer, 10);
+        if(tRead > 0)
+        {
+            tAnswer += tRead;
+            acAnswer[tAnswer] = 0;
+            if(strstr(acAnswer, "stream on") != NULL && strchr(strstr(acAnswer, "stream on"), '\n') != NULL)
+            {
+                return receiverSetBaudRate(_iFile, _u32BaudRate);
+            }
+        }
+    }
+
+    fprintf(stderr, "no \"stream on\" answer (got %zu bytes)\n", tAnswer);
+    return -1;
+}
+
+static void receiverMessage(const uint8_t *_pu8Message, uint16_t _u16Size, FILE *_psOutput, receiver_stats_t *_psStats)
+{
+    message_stream_header_t sHeader;
+    uint8_t au8Length[2];
+
+    if(_u16Size < MESSAGE_STREAM_HEADER_SIZE || messages_decodeStreamHeader(&sHeader, _pu8Message, MESSAGE_STREAM_HEADER_SIZE) == QUELL_ERROR)
+    {
+        _psStats->u64Rejected++;
+        return;
+    }
+
+    if(_psStats->bFirst == false && sHeader.u16Sequence != _psStats->u16NextSequence)
+    {
+        _psStats->u64Gaps += (uint16_t)(sHeader.u16Sequence - _psStats->u16NextSequence);
+    }
+    _psStats->bFirst = false;
+    _psStats->u16NextSequence = sHeader.u16Sequence + 1;
+    _psStats->u64Messages++;
+
+    switch(sHeader.u8Type)
+    {
+        case TERMINAL_STREAM_TYPE_BUS:
+            _psStats->u64Bus++;
+            break;
+        case TERMINAL_STREAM_TYPE_STATS:
+            _psStats->u64Stats++;
+            break;
+        case TERMINAL_STREAM_TYPE_END:
+            _psStats->bEnd = true;
+            break;
+        default:
+            break;
+    }
+
+    if(_psOutput != NULL)
+    {
+        au8Length[0] = (_u16Size >> 8) & 0xFF;
+        au8Length[1] = _u16Size & 0xFF;
+        fwrite(au8Length, 1, sizeof(au8Length), _psOutput);
+        fwrite(_pu8Message, 1, _u16Size, _psOutput);
+    }
+}
+
+static void receiverParse(fifo_t *_psFIFO, FILE *_psOutput, receiver_stats_t *_psStats)
+{
+    uint8_t au8Packet[RECEIVER_PACKET_SIZE];
+    uint16_t u16PacketSize;
+    size_t tBefore;
+    size_t tAfter;
+
+    for(;;)
+    {
+        FIFO_count(_psFIFO, &tBefore);
+        if(getPacketFromFIFO(_psFIFO, NULL, au8Packet, sizeof(au8Packet), &u16PacketSize) == QUELL_OK)
+        {
+            if(verifyPacket(au8Packet, u16PacketSize) == QUELL_OK)
+            {
+                receiverMessage(&au8Packet[4], MESSAGE_SIZE(u16PacketSize), _psOutput, _psStats);
+            }
+            else
+            {
+                _psStats->u64Rejected++;
+            }
+            continue;
+        }
+
+        /* Nothing consumed means the next packet is not complete yet */
+        FIFO_count(_psFIFO, &tAfter);
+        if(tAfter == tBefore)
+        {
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *pcDevice = NULL;
+    const char *pcSource = "all";
+    const char *pcOutput = NULL;
+    uint32_t u32BaudRate = 921600;
+    uint32_t u32Seconds = 0;
+    char acFIFO[RECEIVER_FIFO_SIZE];
+    uint8_t au8Read[RECEIVER_READ_SIZE];
+    fifo_t sFIFO;
+    receiver_stats_t sStats;
+    FILE *psOutput = NULL;
+    uint64_t u64Start;
+    uint64_t u64LastReport;
+    uint64_t u64LastBytes = 0;
+    uint64_t u64StopDeadline = 0;
+    int iOption;
+    int iFile;
+
+    while((iOption = getopt(argc, argv, "d:b:s:o:t:")) != -1)
+    {
+        switch(iOption)
+        {
+            case 'd':
+                pcDevice = optarg;
+                break;
+            case 'b':
+                u32BaudRate = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                pcSource = optarg;
+                break;
+            case 'o':
+                pcOutput = optarg;
+                break;
+            case 't':
+                u32Seconds = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                pcDevice = NULL;
+                optind = argc;
+                break;
+        }
+    }
+
+    if(pcDevice == NULL || receiverSpeed(u32BaudRate) == B0)
+    {
+        fprintf(stderr, "usage: %s -d <device> [-b baud] [-s bus|stats|all] [-o messages.bin] [-t seconds]\n", argv[0]);
+        return 1;
+    }
+
+    iFile = open(pcDevice, O_RDWR | O_NOCTTY);
+    if(iFile < 0 || receiverSetBaudRate(iFile, TERMINAL_STREAM_TEXT_BAUD_RATE) != 0)
+    {
+        perror(pcDevice);
+        return 1;
+    }
+    if(pcOutput != NULL && (psOutput = fopen(pcOutput, "wb")) == NULL)
+    {
+        perror(pcOutput);
+        return 1;
+    }
+
+    signal(SIGINT, receiverSignal);
+    signal(SIGTERM, receiverSignal);
+
+    if(receiverStart(iFile, pcSource, u32BaudRate) != 0)
+    {
+        return 1;
+    }
+
+    memset(&sStats, 0, sizeof(sStats));
+    sStats.bFirst = true;
+    FIFO_init(&sFIFO, acFIFO, sizeof(acFIFO));
+    u64Start = u64LastReport = receiverNowMs();
+
+    while(sStats.bEnd == false)
+    {
+        uint64_t u64Now = receiverNowMs();
+
+        /* Stop sequence once, then wait a little for the end message */
+        if(u64StopDeadline == 0 && (iStop || (u32Seconds > 0 && u64Now - u64Start >= u32Seconds * 1000ULL)))
+        {
+            if(write(iFile, TERMINAL_STREAM_STOP, strlen(TERMINAL_STREAM_STOP)) != (ssize_t)strlen(TERMINAL_STREAM_STOP))
+            {
+                break;
+            }
+            u64StopDeadline = u64Now + RECEIVER_END_TIMEOUT_MS;
+        }
+        if(u64StopDeadline != 0 && u64Now >= u64StopDeadline)
+        {
+            fprintf(stderr, "no end message\n");
+            break;
+        }
+
+        size_t tFree;
+        FIFO_free(&sFIFO, &tFree);
+        ssize_t tRead = receiverRead(iFile, au8Read, (tFree < sizeof(au8Read)) ? tFree : sizeof(au8Read), 50);
+        for(ssize_t tIndex = 0; tIndex < tRead; tIndex++)
+        {
+            FIFO_put(&sFIFO, (char)au8Read[tIndex]);
+        }
+        sStats.u64Bytes += (tRead > 0) ? tRead : 0;
+        receiverParse(&sFIFO, psOutput, &sStats);
+
+        if(u64Now - u64LastReport >= 1000)
+        {
+            fprintf(stderr, "%.1f kB/s, %llu messages (%llu bus, %llu stats), %llu missing, %llu bad packets\n",
+                    (sStats.u64Bytes - u64LastBytes) / (double)(u64Now - u64LastReport),
+                    (unsigned long long)sStats.u64Messages, (unsigned long long)sStats.u64Bus, (unsigned long long)sStats.u64Stats,
+                    (unsigned long long)sStats.u64Gaps, (unsigned long long)sStats.u64Rejected);
+            u64LastReport = u64Now;
+            u64LastBytes = sStats.u64Bytes;
+        }
+    }
+
+    /* The board is back at the text baud rate */
+    receiverSetBaudRate(iFile, TERMINAL_STREAM_TEXT_BAUD_RATE);
+    close(iFile);
+    if(psOutput != NULL)
+    {
+        fclose(psOutput);
+    }
+
+    printf("%llu bytes in %.1f s, %llu messages (%llu bus, %llu stats), %llu missing, %llu bad packets%s\n",
+           (unsigned long long)sStats.u64Bytes, (receiverNowMs() - u64Start) / 1000.0,
+           (unsigned long long)sStats.u64Messages, (unsigned long long)sStats.u64Bus, (unsigned long long)sStats.u64Stats,
+           (unsigned long long)sStats.u64Gaps, (unsigned long long)sStats.u64Rejected, (sStats.bEnd == true) ? "" : " (no end message)");
+
+    return 0;
+}